@@ -0,0 +1,379 @@
+#include <stdio.h>
+#include <string.h>
+#include "esp_log.h"
+#include "cJSON.h"
+#include "bluetooth.h"
+#include "ble_commands.h"
+#include "switch_controller.h"
+#include "sensor_binding.h"
+#include "wire_format.h"
+#include "rule_engine.h"
+#include "trace.h"
+#include "config_store.h"
+#include "relay_usage.h"
+#include "boot_phase.h"
+#include "wifi_stats.h"
+
+static const char *TAG = "ble_cmd";
+
+#define LIST_SENSORS_PAGE 4     // bindings per list_sensors reply
+#define TRACE_PAGE_RECORDS 8    // trace records per reply
+
+static void send_rule_table(void)
+{
+    rule_table_t table;
+    char rows_hex[RULE_TABLE_ROWS * 2 + 1];
+    char response[256];
+
+    switch_controller_get_rule_table(&table);
+    rule_table_rows_to_hex(&table, rows_hex, sizeof(rows_hex));
+    snprintf(response, sizeof(response),
+             "{\"rules\":\"%s\",\"delays\":{\"TEMP\":%lu,\"PRESENCE\":%lu,\"LUX\":%lu}}",
+             rows_hex,
+             (unsigned long)table.off_delay_ms[RULE_REASON_TEMP],
+             (unsigned long)table.off_delay_ms[RULE_REASON_PRESENCE],
+             (unsigned long)table.off_delay_ms[RULE_REASON_LUX]);
+    ble_client_send(response);
+}
+
+static void send_stats(void)
+{
+    static char response[SWITCH_STATS_JSON_MAX];
+
+    switch_controller_format_stats(response, sizeof(response));
+    ble_client_send(response);
+}
+
+// {"cmd":"set_rules","rows":"<128 hex digits>","delays":{"TEMP":60000,"PRESENCE":5000,"LUX":5000}}
+// Either part may be omitted to keep the current value.
+static void update_rule_table(const cJSON *root)
+{
+    rule_table_t table;
+    bool valid = true;
+
+    switch_controller_get_rule_table(&table);
+
+    cJSON *rows = cJSON_GetObjectItem(root, "rows");
+    if (rows != NULL) {
+        valid = cJSON_IsString(rows) && rule_table_rows_from_hex(&table, rows->valuestring);
+    }
+
+    cJSON *delays = cJSON_GetObjectItem(root, "delays");
+    if (valid && delays != NULL && cJSON_IsObject(delays)) {
+        for (int reason = RULE_REASON_TEMP; reason < RULE_REASON_COUNT; reason++) {
+            cJSON *delay = cJSON_GetObjectItem(delays, rule_reason_name((rule_reason_t)reason));
+            if (delay == NULL || !cJSON_IsNumber(delay)) {
+                continue;
+            }
+            // Range-check the double: casting one of 2^32 or more to uint32_t is undefined
+            if (!(delay->valuedouble >= 0 && delay->valuedouble <= RULE_MAX_OFF_DELAY_MS)) {
+                valid = false;
+                break;
+            }
+            table.off_delay_ms[reason] = (uint32_t)delay->valuedouble;
+        }
+    }
+
+    esp_err_t err = valid ? switch_controller_set_rule_table(&table) : ESP_ERR_INVALID_ARG;
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Rule table update rejected: %s", esp_err_to_name(err));
+    }
+    ble_client_send(err == ESP_OK ? "{\"rules_status\":\"ok\"}" : "{\"rules_status\":\"error\"}");
+}
+
+// "channel" is optional and defaults to 0 for single-gang apps; a channel that is
+// present but not a whole number below SWITCH_CHANNEL_COUNT is rejected, not mapped to 0
+static bool command_channel(const cJSON *root, uint8_t *channel)
+{
+    cJSON *item = cJSON_GetObjectItem(root, "channel");
+    *channel = 0;
+    if (item == NULL) {
+        return true;
+    }
+    if (!cJSON_IsNumber(item) || !(item->valuedouble >= 0 && item->valuedouble < SWITCH_CHANNEL_COUNT) ||
+        item->valuedouble != (double)(int)item->valuedouble) {
+        ESP_LOGE(TAG, "Invalid channel");
+        return false;
+    }
+    *channel = (uint8_t)item->valuedouble;
+    return true;
+}
+
+// {"cmd":"switch","channel":1,"state":"ON"}
+static void switch_channel_command(const cJSON *root)
+{
+    uint8_t channel;
+    bool channel_ok = command_channel(root, &channel);
+    cJSON *state = cJSON_GetObjectItem(root, "state");
+    esp_err_t err = ESP_ERR_INVALID_ARG;
+    bool on = false;
+
+    if (channel_ok && state != NULL && cJSON_IsString(state)) {
+        // Queued for the control task; the reply echoes the requested state
+        on = strcmp(state->valuestring, "ON") == 0;
+        err = switch_controller_override(channel, on);
+    }
+
+    char response[64];
+    snprintf(response, sizeof(response), "{\"channel\":%d,\"state\":\"%s\"}", channel,
+             err == ESP_OK ? (on ? "ON" : "OFF") : "error");
+    ble_client_send(response);
+}
+
+// {"cmd":"bind_sensor"|"unbind_sensor","channel":1,"mac":"AA:BB:CC:DD:EE:FF"}
+static void bind_sensor_command(const cJSON *root, bool bind)
+{
+    cJSON *mac_str = cJSON_GetObjectItem(root, "mac");
+    uint8_t mac[6];
+    uint8_t channel;
+    esp_err_t err = ESP_ERR_INVALID_ARG;
+
+    if (command_channel(root, &channel) && mac_str != NULL && cJSON_IsString(mac_str) &&
+        wire_mac_from_string(mac_str->valuestring, strlen(mac_str->valuestring), mac)) {
+        err = bind ? sensor_binding_add(mac, channel) : sensor_binding_remove(mac, channel);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Sensor binding rejected: %s", esp_err_to_name(err));
+    }
+    ble_client_send(err == ESP_OK ? "{\"bind_status\":\"ok\"}" : "{\"bind_status\":\"error\"}");
+}
+
+// {"cmd":"list_sensors","offset":0} -> one page of bindings
+static void list_sensors_command(const cJSON *root)
+{
+    sensor_binding_info_t info[LIST_SENSORS_PAGE];
+    char response[512];
+    size_t offset = 0;
+
+    cJSON *offset_item = cJSON_GetObjectItem(root, "offset");
+    if (offset_item != NULL && cJSON_IsNumber(offset_item) && offset_item->valueint > 0) {
+        offset = offset_item->valueint;
+    }
+
+    size_t n = sensor_binding_list(offset, info, LIST_SENSORS_PAGE);
+    int pos = snprintf(response, sizeof(response), "{\"total\":%d,\"offset\":%d,\"expiry\":%u,\"sensors\":[",
+                       (int)sensor_binding_count(), (int)offset, sensor_binding_get_expiry());
+    for (size_t i = 0; i < n; i++) {
+        char mac[18];
+        wire_mac_to_string(info[i].mac, mac, sizeof(mac));
+        pos += snprintf(response + pos, sizeof(response) - pos,
+                        "%s{\"mac\":\"%s\",\"channel\":%d,\"live\":%s,\"occupied\":%s,\"age\":%ld}",
+                        i > 0 ? "," : "", mac, info[i].channel,
+                        info[i].live ? "true" : "false", info[i].occupied ? "true" : "false",
+                        info[i].age_s == UINT32_MAX ? -1L : (long)info[i].age_s);
+    }
+    snprintf(response + pos, sizeof(response) - pos, "]}");
+    ble_client_send(response);
+}
+
+// {"cmd":"trace","from":0} -> one hex-encoded trace page; send "next" back for the following one
+static void trace_command(const cJSON *root)
+{
+    uint8_t page[TRACE_PAGE_HEADER + TRACE_PAGE_RECORDS * sizeof(trace_record_t)];
+    char response[2 * sizeof(page) + 64];
+    uint32_t cursor = 0;
+
+    cJSON *from = cJSON_GetObjectItem(root, "from");
+    if (from != NULL && cJSON_IsNumber(from) && from->valuedouble > 0 && from->valuedouble <= UINT32_MAX) {
+        cursor = (uint32_t)from->valuedouble;
+    }
+
+    size_t len = trace_dump_page(&cursor, page, sizeof(page));
+    int pos = snprintf(response, sizeof(response), "{\"trace\":\"");
+    for (size_t i = 0; i < len; i++) {
+        pos += snprintf(response + pos, sizeof(response) - pos, "%02x", page[i]);
+    }
+    snprintf(response + pos, sizeof(response) - pos, "\",\"next\":%lu,\"last\":%s}",
+             (unsigned long)cursor, (page[3] & TRACE_PAGE_LAST) ? "true" : "false");
+    ble_client_send(response);
+}
+
+// {"cmd":"set_fusion","channel":0,"mode":"OR"|"AND"|"QUORUM","quorum":2,"expiry":300}
+static void set_fusion_command(const cJSON *root)
+{
+    uint8_t channel;
+    fusion_mode_t mode;
+    uint8_t quorum;
+
+    if (!command_channel(root, &channel)) {
+        ble_client_send("{\"fusion_status\":\"error\"}");
+        return;
+    }
+    esp_err_t err = ESP_OK;
+    sensor_binding_get_fusion(channel, &mode, &quorum);
+    cJSON *mode_item = cJSON_GetObjectItem(root, "mode");
+    if (mode_item != NULL && (!cJSON_IsString(mode_item) || !fusion_mode_from_string(mode_item->valuestring, &mode))) {
+        err = ESP_ERR_INVALID_ARG;
+    }
+    cJSON *quorum_item = cJSON_GetObjectItem(root, "quorum");
+    if (quorum_item != NULL && cJSON_IsNumber(quorum_item) && quorum_item->valueint >= 0 && quorum_item->valueint <= 255) {
+        quorum = (uint8_t)quorum_item->valueint;
+    }
+    if (err == ESP_OK) {
+        err = sensor_binding_set_fusion(channel, mode, quorum);
+    }
+
+    cJSON *expiry = cJSON_GetObjectItem(root, "expiry");
+    if (err == ESP_OK && expiry != NULL && cJSON_IsNumber(expiry)) {
+        err = (expiry->valueint > 0 && expiry->valueint <= UINT16_MAX) ?
+              sensor_binding_set_expiry((uint16_t)expiry->valueint) : ESP_ERR_INVALID_ARG;
+    }
+
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Fusion update rejected: %s", esp_err_to_name(err));
+    }
+    ble_client_send(err == ESP_OK ? "{\"fusion_status\":\"ok\"}" : "{\"fusion_status\":\"error\"}");
+}
+
+// {"cmd":"history","before":0} -> newest relay changes first; send "next" back as "before" for older ones
+static void history_command(const cJSON *root)
+{
+    static char response[SWITCH_STATS_JSON_MAX];
+    uint32_t before = 0;
+
+    cJSON *before_item = cJSON_GetObjectItem(root, "before");
+    if (before_item != NULL && cJSON_IsNumber(before_item) && before_item->valuedouble > 0 && before_item->valuedouble <= UINT32_MAX) {
+        before = (uint32_t)before_item->valuedouble;
+    }
+    switch_controller_format_history(before, SWITCH_HISTORY_BLE_PAGE, response, sizeof(response));
+    ble_client_send(response);
+}
+
+// {"cmd":"usage","channel":0} -> ON time, cycles and hourly/daily rollups of one relay
+static void usage_command(const cJSON *root)
+{
+    static char response[SWITCH_STATS_JSON_MAX];
+    uint8_t channel;
+
+    if (!command_channel(root, &channel)) {
+        ble_client_send("{\"usage_status\":\"error\"}");
+        return;
+    }
+    relay_usage_format(channel, response, sizeof(response));
+    ble_client_send(response);
+}
+
+// {"cmd":"set_power_on","policy":"off"|"on"|"restore"}
+static void set_power_on_command(const cJSON *root)
+{
+    static const char *const policies[CONFIG_POWER_ON_COUNT] = { "off", "on", "restore" };
+    cJSON *policy = cJSON_GetObjectItem(root, "policy");
+
+    for (int i = 0; policy != NULL && cJSON_IsString(policy) && i < CONFIG_POWER_ON_COUNT; i++) {
+        if (strcmp(policy->valuestring, policies[i]) == 0) {
+            config_store_set_power_on((config_power_on_t)i);
+            config_store_save_later();
+            ble_client_send("{\"power_on_status\":\"ok\"}");
+            return;
+        }
+    }
+    ESP_LOGE(TAG, "Unknown power-on policy");
+    ble_client_send("{\"power_on_status\":\"error\"}");
+}
+
+void ble_command_dispatch(const char *data, size_t len)
+{
+    // Parse JSON
+    cJSON *root = cJSON_ParseWithLength(data, len);
+    if (root != NULL) {
+        cJSON *cmd = cJSON_GetObjectItem(root, "cmd");
+        if (cmd == NULL || !cJSON_IsString(cmd)) {
+            ESP_LOGW(TAG, "Missing cmd");
+        }else if (strcmp(cmd->valuestring, "get_deviceid") == 0) {
+            ESP_LOGD(TAG, "Device ID to app: %s", DEVICE_ID);
+            char device_id_json[100];
+            snprintf(device_id_json, sizeof(device_id_json), "{\"device_id\":\"%s\",\"device_type\":\"AIOS_1\"}", DEVICE_ID);
+            ble_client_send(device_id_json);
+        }else if (strcmp(cmd->valuestring, "set_temperature") == 0) {
+            ESP_LOGI(TAG, "Temperature Request");
+            cJSON *value = cJSON_GetObjectItem(root, "value");
+            if (value != NULL && cJSON_IsNumber(value) &&
+                ((value->valueint >= 15 && value->valueint <= 45) || value->valueint == 0)) {
+                ESP_LOGE(TAG, "Temperature_value : %d", value->valueint);
+                g_sensor_config.temperature_value = value->valueint;
+                config_store_set_temperature(value->valueint);
+                config_store_save_later();
+                update_temperature_threshold(value->valueint);
+            }
+        }else if (strcmp(cmd->valuestring, "presence_trigger") == 0) {
+            ESP_LOGI(TAG, "Presence Trigger Request");
+            cJSON *value = cJSON_GetObjectItem(root, "value");
+            if (value != NULL && cJSON_IsString(value)) {
+                strlcpy(g_sensor_config.presence_state, value->valuestring, sizeof(g_sensor_config.presence_state));
+                config_store_set_presence_state(g_sensor_config.presence_state);
+                config_store_save_later();
+                update_presence_switch_state(value->valuestring);
+            }
+        }else if (strcmp(cmd->valuestring, "set_lux") == 0) {
+            ESP_LOGI(TAG, "Light Trigger Request");
+            cJSON *value = cJSON_GetObjectItem(root, "value");
+            if (value != NULL && cJSON_IsNumber(value)) {
+                int lux_val = value->valueint;
+                if (lux_val >= 0 && lux_val <= 3500) {
+                    g_sensor_config.light_value = (uint16_t)lux_val;
+                    ESP_LOGE(TAG, "Light_value : %d", g_sensor_config.light_value);
+                    config_store_set_lux((uint16_t)lux_val);
+                    config_store_save_later();
+                    update_light_threshold((uint16_t)lux_val);
+                } else {
+                    ESP_LOGE(TAG, "Light value out of range: %d (0-3000)", lux_val);
+                }
+            }
+        }else if (strcmp(cmd->valuestring, "get_rules") == 0) {
+            ESP_LOGI(TAG, "Rule Table Request");
+            send_rule_table();
+        }else if (strcmp(cmd->valuestring, "set_rules") == 0) {
+            ESP_LOGI(TAG, "Rule Table Update");
+            update_rule_table(root);
+        }else if (strcmp(cmd->valuestring, "reset_rules") == 0) {
+            ESP_LOGI(TAG, "Rule Table Reset");
+            rule_table_t table;
+            rule_table_build_default(&table);
+            esp_err_t err = switch_controller_set_rule_table(&table);
+            ble_client_send(err == ESP_OK ? "{\"rules_status\":\"ok\"}" : "{\"rules_status\":\"error\"}");
+        }else if (strcmp(cmd->valuestring, "stats") == 0) {
+            ESP_LOGI(TAG, "Stats Request");
+            send_stats();
+        }else if (strcmp(cmd->valuestring, "reset_stats") == 0) {
+            ESP_LOGI(TAG, "Stats Reset");
+            switch_controller_reset_stats();
+            ble_client_send("{\"stats_status\":\"reset\"}");
+        }else if (strcmp(cmd->valuestring, "trace") == 0) {
+            trace_command(root);
+        }else if (strcmp(cmd->valuestring, "history") == 0) {
+            history_command(root);
+        }else if (strcmp(cmd->valuestring, "boot") == 0) {
+            char response[160];
+            boot_phase_format(response, sizeof(response));
+            ble_client_send(response);
+        }else if (strcmp(cmd->valuestring, "wifi") == 0) {
+            char response[WIFI_STATS_JSON_MAX];
+            wifi_stats_format(response, sizeof(response));
+            ble_client_send(response);
+        }else if (strcmp(cmd->valuestring, "usage") == 0) {
+            ESP_LOGI(TAG, "Relay Usage Request");
+            usage_command(root);
+        }else if (strcmp(cmd->valuestring, "set_power_on") == 0) {
+            ESP_LOGI(TAG, "Power-on Policy Update");
+            set_power_on_command(root);
+        }else if (strcmp(cmd->valuestring, "switch") == 0) {
+            ESP_LOGI(TAG, "Switch Override Request");
+            switch_channel_command(root);
+        }else if (strcmp(cmd->valuestring, "bind_sensor") == 0) {
+            ESP_LOGI(TAG, "Sensor Binding Request");
+            bind_sensor_command(root, true);
+        }else if (strcmp(cmd->valuestring, "unbind_sensor") == 0) {
+            ESP_LOGI(TAG, "Sensor Unbinding Request");
+            bind_sensor_command(root, false);
+        }else if (strcmp(cmd->valuestring, "list_sensors") == 0) {
+            ESP_LOGI(TAG, "Sensor List Request");
+            list_sensors_command(root);
+        }else if (strcmp(cmd->valuestring, "set_fusion") == 0) {
+            ESP_LOGI(TAG, "Sensor Fusion Update");
+            set_fusion_command(root);
+        }else{
+            //Nothing to do
+        }
+        cJSON_Delete(root);
+    }
+}
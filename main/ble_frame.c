@@ -0,0 +1,197 @@
+#include <string.h>
+#include "ble_frame.h"
+
+void ble_frag_begin(ble_frag_t *frag, const void *data, size_t len, size_t chunk, uint8_t id)
+{
+    if (chunk < BLE_FRAME_MIN_CHUNK) {
+        chunk = BLE_FRAME_MIN_CHUNK;
+    }
+    frag->data = (const uint8_t *)data;
+    frag->len = len;
+    frag->offset = 0;
+    frag->chunk = chunk;
+    frag->id = id & BLE_FRAME_ID_MASK;
+    frag->index = 0;
+    // A leading byte >= 0x80 would be taken for a fragment header
+    frag->framed = len > chunk || (len > 0 && (frag->data[0] & BLE_FRAME_FLAG_FRAGMENT));
+    frag->done = false;
+}
+
+size_t ble_frag_next(ble_frag_t *frag, uint8_t *scratch, const uint8_t **out)
+{
+    if (frag->done) {
+        return 0;
+    }
+
+    if (!frag->framed) {
+        // Zero copy: the payload goes out as it is
+        frag->done = true;
+        *out = frag->data;
+        return frag->len;
+    }
+
+    bool first = frag->offset == 0;
+    size_t hdr = first ? BLE_FRAME_FIRST_HDR_LEN : 1;
+    size_t take = frag->len - frag->offset;
+    if (take > frag->chunk - hdr) {
+        take = frag->chunk - hdr;
+    }
+    bool last = frag->offset + take == frag->len;
+
+    uint8_t tag = first ? frag->id : (frag->index & BLE_FRAME_ID_MASK);
+    scratch[0] = BLE_FRAME_FLAG_FRAGMENT | tag |
+                 (first ? BLE_FRAME_FLAG_FIRST : 0) | (last ? BLE_FRAME_FLAG_LAST : 0);
+    if (first) {
+        scratch[1] = frag->len & 0xFF;
+        scratch[2] = (frag->len >> 8) & 0xFF;
+    }
+    memcpy(scratch + hdr, frag->data + frag->offset, take);
+    frag->offset += take;
+    frag->index++;
+    frag->done = last;
+    *out = scratch;
+    return hdr + take;
+}
+
+void ble_reasm_init(ble_reasm_t *reasm, uint8_t *buf, size_t cap)
+{
+    reasm->buf = buf;
+    reasm->cap = cap;
+    reasm->len = 0;
+    reasm->expected = 0;
+    reasm->id = 0;
+    reasm->next = 0;
+    reasm->active = false;
+    reasm->errors = 0;
+}
+
+static int reasm_drop(ble_reasm_t *reasm)
+{
+    reasm->active = false;
+    reasm->errors++;
+    return -1;
+}
+
+int ble_reasm_feed(ble_reasm_t *reasm, const uint8_t *data, size_t len)
+{
+    if (len == 0) {
+        return reasm_drop(reasm);
+    }
+
+    if (!(data[0] & BLE_FRAME_FLAG_FRAGMENT)) {
+        // Unframed: a whole message. One in the middle of a fragmented message means it was lost
+        if (reasm->active) {
+            reasm->errors++;
+            reasm->active = false;
+        }
+        if (len > reasm->cap) {
+            return reasm_drop(reasm);
+        }
+        memcpy(reasm->buf, data, len);
+        reasm->len = len;
+        return (int)len;
+    }
+
+    uint8_t tag = data[0] & BLE_FRAME_ID_MASK;
+    size_t hdr = 1;
+    if (data[0] & BLE_FRAME_FLAG_FIRST) {
+        if (reasm->active) {
+            reasm->errors++;             // the previous message lost its tail
+        }
+        if (len < BLE_FRAME_FIRST_HDR_LEN) {
+            return reasm_drop(reasm);
+        }
+        reasm->expected = data[1] | (size_t)data[2] << 8;
+        if (reasm->expected > reasm->cap) {
+            return reasm_drop(reasm);
+        }
+        reasm->id = tag;
+        reasm->next = 1;
+        reasm->len = 0;
+        reasm->active = true;
+        hdr = BLE_FRAME_FIRST_HDR_LEN;
+    } else if (!reasm->active || tag != (reasm->next & BLE_FRAME_ID_MASK)) {
+        return reasm_drop(reasm);        // lost, reordered, or the tail of a message whose start was lost
+    } else {
+        reasm->next++;
+    }
+
+    size_t take = len - hdr;
+    if (reasm->len + take > reasm->expected) {
+        return reasm_drop(reasm);
+    }
+    memcpy(reasm->buf + reasm->len, data + hdr, take);
+    reasm->len += take;
+
+    if (data[0] & BLE_FRAME_FLAG_LAST) {
+        reasm->active = false;
+        if (reasm->len != reasm->expected) {
+            reasm->errors++;
+            return -1;
+        }
+        return (int)reasm->len;
+    }
+    return 0;
+}
+
+/* ---------------- Prepared writes ---------------- */
+void ble_prep_init(ble_prep_t *prep, uint8_t *buf, size_t cap)
+{
+    prep->buf = buf;
+    prep->cap = cap;
+    prep->held = false;
+    ble_prep_reset(prep);
+}
+
+void ble_prep_reset(ble_prep_t *prep)
+{
+    prep->len = 0;
+    prep->handle = 0;
+    prep->failed = false;
+}
+
+ble_prep_status_t ble_prep_write(ble_prep_t *prep, uint16_t handle, size_t offset,
+                                 const uint8_t *data, size_t len)
+{
+    ble_prep_status_t status = BLE_PREP_OK;
+    if (prep->held) {
+        status = BLE_PREP_BUSY;
+    } else if (prep->handle != 0 && prep->handle != handle) {
+        status = BLE_PREP_OTHER_HANDLE;
+    } else if (offset > prep->len) {
+        status = BLE_PREP_BAD_OFFSET;
+    } else if (offset + len > prep->cap) {
+        status = BLE_PREP_TOO_LONG;
+    }
+    if (status != BLE_PREP_OK) {
+        // The queued write to the other handle is not ours to spoil
+        if (status != BLE_PREP_OTHER_HANDLE && status != BLE_PREP_BUSY) {
+            prep->failed = true;
+        }
+        return status;
+    }
+
+    prep->handle = handle;
+    memcpy(prep->buf + offset, data, len);
+    if (offset + len > prep->len) {
+        prep->len = offset + len;
+    }
+    return BLE_PREP_OK;
+}
+
+size_t ble_prep_take(ble_prep_t *prep, uint16_t *handle)
+{
+    size_t len = prep->failed ? 0 : prep->len;
+    *handle = prep->handle;
+    if (len > 0) {
+        prep->buf[len] = '\0';
+        prep->held = true;
+    }
+    ble_prep_reset(prep);
+    return len;
+}
+
+void ble_prep_release(ble_prep_t *prep)
+{
+    prep->held = false;
+}
@@ -25,6 +25,13 @@
 #include "cJSON.h"
 #include "bluetooth.h"
 #include "switch_controller.h"
+#include "ble_commands.h"
+#include "trace.h"
+#include "config_store.h"
+#include "esp_timer.h"
+#include "ble_frame.h"
+#include "freertos/semphr.h"
+#include "freertos/queue.h"
 
 #define WIFI_CONNECTED_BIT BIT0
 #define WIFI_FAIL_BIT      BIT1
@@ -108,11 +115,13 @@ uint16_t heart_rate_handle_table[HRS_IDX_NB];
 
 esp_gatt_if_t interface_type = 0;
 uint16_t conn_id = 0;
+#define BLE_DEFAULT_MTU 23
+#define BLE_LOCAL_MTU   517                  // offered in the MTU exchange: the ATT maximum
+static uint16_t ble_mtu = BLE_DEFAULT_MTU;   // ATT MTU of the current connection
+static bool ble_connected = false;
 char pair_status = 0;
-char data_validation[300] = {0,};
 
 wifi_credentials_t wifi_credentials;
-static prepare_type_env_t prepare_write_env_b;
 struct gatts_profile_inst {
     esp_gatts_cb_t gatts_cb;
     uint16_t gatts_if;
@@ -176,9 +185,9 @@ static const esp_gatts_attr_db_t gatt_db[HRS_IDX_NB] =
     {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&character_declaration_uuid, ESP_GATT_PERM_READ,
       CHAR_DECLARATION_SIZE, CHAR_DECLARATION_SIZE, (uint8_t *)&char_prop_read_notify}},
 
-    /* Characteristic Value - Allow reading and writing without encryption */
+    /* Characteristic Value - Allow reading and writing without encryption; answered by the app */
     [IDX_CHAR_VAL_A] =
-    {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_128, (uint8_t *)&GATTS_CHAR_UUID_TEST_A, ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE,
+    {{ESP_GATT_RSP_BY_APP}, {ESP_UUID_LEN_128, (uint8_t *)&GATTS_CHAR_UUID_TEST_A, ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE,
       GATTS_DEMO_CHAR_VAL_LEN_MAX, sizeof(char_value), (uint8_t *)char_value}},
 
     /* Client Characteristic Configuration Descriptor - Allow reading and writing without encryption */
@@ -191,9 +200,9 @@ static const esp_gatts_attr_db_t gatt_db[HRS_IDX_NB] =
     {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&character_declaration_uuid, ESP_GATT_PERM_READ,
       CHAR_DECLARATION_SIZE, CHAR_DECLARATION_SIZE, (uint8_t *)&char_prop_read_notify}},
 
-    /* Characteristic Value - Allow reading and writing without encryption */
+    /* Characteristic Value - Allow reading and writing without encryption; answered by the app */
     [IDX_CHAR_VAL_B]  =
-    {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_128, (uint8_t *)&GATTS_CHAR_UUID_TEST_B, ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE,
+    {{ESP_GATT_RSP_BY_APP}, {ESP_UUID_LEN_128, (uint8_t *)&GATTS_CHAR_UUID_TEST_B, ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE,
       GATTS_DEMO_CHAR_VAL_LEN_MAX, sizeof(char_value), (uint8_t *)char_value}},
 
 	  /* Client Characteristic Configuration Descriptor - Allow reading and writing without encryption */
@@ -314,14 +323,14 @@ static void gap_event_handler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param
         case ESP_GAP_BLE_ADV_DATA_RAW_SET_COMPLETE_EVT:
             adv_config_done &= (~adv_config_flag);
             if (adv_config_done == 0){
-				printf("\n ESP_GAP_BLE_ADV_DATA_RAW_SET_COMPLETE_EVT adv start");
+                ESP_LOGD(GATTS_TABLE_TAG, "ESP_GAP_BLE_ADV_DATA_RAW_SET_COMPLETE_EVT - starting advertising");
                 esp_ble_gap_start_advertising(&adv_params);
             }
             break;
         case ESP_GAP_BLE_SCAN_RSP_DATA_RAW_SET_COMPLETE_EVT:
             adv_config_done &= (~scan_rsp_config_flag);
             if (adv_config_done == 0){
-				printf("\n case ESP_GAP_BLE_SCAN_RSP_DATA_RAW_SET_COMPLETE_EVT:adv start");
+                ESP_LOGD(GATTS_TABLE_TAG, "ESP_GAP_BLE_SCAN_RSP_DATA_RAW_SET_COMPLETE_EVT - starting advertising");
                 esp_ble_gap_start_advertising(&adv_params);
             }
             break;
@@ -334,7 +343,7 @@ static void gap_event_handler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param
             }
             break;
         case ESP_GAP_BLE_SCAN_RSP_DATA_SET_COMPLETE_EVT:
-			printf("\n ESP_GAP_BLE_SCAN_RSP_DATA_SET_COMPLETE_EVT--------");
+            ESP_LOGD(GATTS_TABLE_TAG, "ESP_GAP_BLE_SCAN_RSP_DATA_SET_COMPLETE_EVT");
             adv_config_done &= (~scan_rsp_config_flag);
 			if (adv_config_done == 0) {
 				esp_ble_gap_start_advertising(&adv_params);
@@ -461,189 +470,457 @@ static void gap_event_handler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param
             break;
     }
 }
+/* ---------------- Send path ---------------- */
+#define BLE_TX_READY_BIT BIT0       // controller not congested
+#define BLE_TX_CONF_BIT  BIT1       // last indication confirmed
+#define BLE_TX_WAIT_MS   1000
+#define BLE_TX_TRIES     5
+#define BLE_TX_RETRY_MS  20         // lets the controller drain its buffers
+
+static EventGroupHandle_t ble_tx_events = NULL;
+static SemaphoreHandle_t ble_tx_lock = NULL;
+static uint8_t ble_tx_scratch[BLE_LOCAL_MTU];   // fragment being sent, under ble_tx_lock
+static uint8_t ble_tx_id;                       // message id of the next payload, under ble_tx_lock
+static uint16_t ble_cccd_b;                     // client configuration of characteristic B
+static TaskHandle_t ble_cb_task = NULL;         // Bluedroid task that runs the GATTS callbacks
+
+esp_err_t ble_send(const void *data, size_t len)
+{
+    if (!ble_connected) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (len == 0 || len > BLE_FRAME_MAX_MESSAGE) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    // The callback task delivers the CONGEST and CONF events, so it cannot wait for them
+    bool in_callback = xTaskGetCurrentTaskHandle() == ble_cb_task;
+    TickType_t wait = in_callback ? 0 : pdMS_TO_TICKS(BLE_TX_WAIT_MS);
+    // Indications cost a round trip per fragment: only if the client enabled nothing else
+    bool confirm = (ble_cccd_b & 0x0003) == 0x0002;
+
+    if (xSemaphoreTake(ble_tx_lock, in_callback ? pdMS_TO_TICKS(BLE_TX_RETRY_MS) : wait) != pdTRUE) {
+        return ESP_ERR_TIMEOUT;
+    }
+
+    ble_frag_t frag;
+    ble_frag_begin(&frag, data, len, ble_mtu - 3, ble_tx_id++);
+    const uint8_t *out;
+    size_t n;
+    uint8_t index = 0;
+    esp_err_t err = ESP_OK;
+    while ((n = ble_frag_next(&frag, ble_tx_scratch, &out)) > 0) {
+        xEventGroupWaitBits(ble_tx_events, BLE_TX_READY_BIT, pdFALSE, pdTRUE, wait);
+        for (int tries = 0; tries < BLE_TX_TRIES; tries++) {
+            xEventGroupClearBits(ble_tx_events, BLE_TX_CONF_BIT);
+            err = esp_ble_gatts_send_indicate(interface_type, conn_id, heart_rate_handle_table[IDX_CHAR_VAL_B],
+                                              n, (uint8_t *)out, confirm);
+            if (err == ESP_OK) {
+                break;
+            }
+            vTaskDelay(pdMS_TO_TICKS(BLE_TX_RETRY_MS));
+        }
+        trace_record(TRACE_BLE_SEND, index++, n, err);
+        if (err != ESP_OK) {
+            break;
+        }
+        if (confirm && !in_callback &&
+            !(xEventGroupWaitBits(ble_tx_events, BLE_TX_CONF_BIT, pdTRUE, pdTRUE, wait) & BLE_TX_CONF_BIT)) {
+            err = ESP_ERR_TIMEOUT;
+            break;
+        }
+    }
+    xSemaphoreGive(ble_tx_lock);
+    return err;
+}
+
 void ble_client_send(char *data) {
-	cJSON *root   = cJSON_Parse(data);
-	char *jsonStr = cJSON_Print(root);
 #if DEBUG_PRINT_EN
-	printf("\njson data = %s\n", jsonStr);
+	printf("\njson data = %s\n", data);
 #endif
-	uint16_t len = strlen(jsonStr);
-	printf("\nlen = %d\n", len);
-	esp_err_t err = -1;
-
-	err = esp_ble_gatts_send_indicate(interface_type, conn_id,
-			heart_rate_handle_table[IDX_CHAR_VAL_B], len, (uint8_t*) jsonStr,
-			false);
+	esp_err_t err = ble_send(data, strlen(data));
 	if (err == ESP_OK) {
+#if DEBUG_PRINT_EN
 		printf("\nsend data to client: %s\n", data);
+#endif
 	} else {
-		printf("\nFailure sending: %s, error: %s\n", data, esp_err_to_name(err));
+		ESP_LOGW(TAG, "Failure sending: %s, error: %s", data, esp_err_to_name(err));
 	}
-	cJSON_Delete(root);
-	free(jsonStr);
 }
 
-void example_exec_write_event_env(prepare_type_env_t *prepare_write_env, esp_ble_gatts_cb_param_t *param){
-    if (param->exec_write.exec_write_flag == ESP_GATT_PREP_WRITE_EXEC && prepare_write_env->prepare_buf){
-        esp_log_buffer_hex(GATTS_TABLE_TAG, prepare_write_env->prepare_buf, prepare_write_env->prepare_len);
-    }else{
-        ESP_LOGI(GATTS_TABLE_TAG,"ESP_GATT_PREP_WRITE_CANCEL");
-    }
+/* ---------------- Scan stream ---------------- */
+#define SCAN_FRAME_MIN  100         // one network per frame still fits; ble_send() fragments it
 
-   printf("data recived:%s\n",prepare_write_env->prepare_buf);
-    snprintf(data_validation, sizeof(data_validation), "%s",prepare_write_env->prepare_buf);
-   printf("total data len:%d",prepare_write_env->prepare_len);
-    data_validation[prepare_write_env->prepare_len]='\0';
-#if DEBUG_PRINT_EN
-    printf("\n exec_write_event Data received :%s\nlen : %d\n",data_validation,prepare_write_env->prepare_len);
-#endif
-    if (prepare_write_env->prepare_buf) {
-        free(prepare_write_env->prepare_buf);
-        prepare_write_env->prepare_buf = NULL;
+static void scan_frame_send(const char *frame, size_t len, void *ctx)
+{
+    esp_err_t err = ble_send(frame, len);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to send scan frame: %s", esp_err_to_name(err));
     }
-    prepare_write_env->prepare_len = 0;
 }
 
-void example_prepare_write_event_env(esp_gatt_if_t gatts_if, prepare_type_env_t *prepare_write_env, esp_ble_gatts_cb_param_t *param)
+static void scan_found(uint8_t channel, const scan_ap_t *ap, void *ctx)
 {
-//	ESP_LOGI(GATTS_TABLE_TAG, "prepare write, handle = %d, value len = %d", param->write.handle, param->write.len);
-    esp_gatt_status_t status = ESP_GATT_OK;
-    if (prepare_write_env->prepare_buf == NULL) {
-        prepare_write_env->prepare_buf = (uint8_t *)malloc(PREPARE_BUF_MAX_SIZE * sizeof(uint8_t));
-        prepare_write_env->prepare_len = 0;
-        if (prepare_write_env->prepare_buf == NULL) {
-            ESP_LOGE(GATTS_TABLE_TAG, "%s, Gatt_server prep no mem", __func__);
-            status = ESP_GATT_NO_RESOURCES;
-        }
+    scan_framer_t *framer = (scan_framer_t *)ctx;
+    if (ap != NULL) {
+        scan_framer_add(framer, channel, ap);
     } else {
-        if(param->write.offset > PREPARE_BUF_MAX_SIZE) {
-            status = ESP_GATT_INVALID_OFFSET;
-        } else if ((param->write.offset + param->write.len) > PREPARE_BUF_MAX_SIZE) {
-            status = ESP_GATT_INVALID_ATTR_LEN;
-        }
+        scan_framer_flush(framer);       // channel complete: push what it found
     }
-    /*send response when param->write.need_rsp is true */
-    if (param->write.need_rsp){
-        esp_gatt_rsp_t *gatt_rsp = (esp_gatt_rsp_t *)malloc(sizeof(esp_gatt_rsp_t));
-        if (gatt_rsp != NULL){
-            gatt_rsp->attr_value.len = param->write.len;
-            gatt_rsp->attr_value.handle = param->write.handle;
-            gatt_rsp->attr_value.offset = param->write.offset;
-            gatt_rsp->attr_value.auth_req = ESP_GATT_AUTH_REQ_NONE;
-            memcpy(gatt_rsp->attr_value.value, param->write.value, param->write.len);
-            esp_err_t response_err = esp_ble_gatts_send_response(gatts_if, param->write.conn_id, param->write.trans_id, status, gatt_rsp);
-            if (response_err != ESP_OK){
-               ESP_LOGE(GATTS_TABLE_TAG, "Send response error");
-            }
-            free(gatt_rsp);
-        }else{
-            ESP_LOGE(GATTS_TABLE_TAG, "%s, malloc failed", __func__);
-        }
-    }
-    if (status != ESP_GATT_OK){
-        return;
-    }
-    memcpy(prepare_write_env->prepare_buf + param->write.offset,
-           param->write.value,
-           param->write.len);
-	printf("\n----%s----",param->write.value);
-    prepare_write_env->prepare_len += param->write.len;
 }
 
-// Task to handle WiFi scanning for BLE callbacks
+// Task to handle WiFi scanning for BLE callbacks: streams the networks of each channel as it completes
 void wifi_scan_callback_task(void *pvParameters) {
     scan_task_params_t *params = (scan_task_params_t *)pvParameters;
+    scan_framer_t framer;
     vTaskDelay(100 / portTICK_PERIOD_MS);
 
-    char *response = malloc(1000);
-    if (!response) {
-        ESP_LOGE(TAG, "Failed to allocate memory for response");
-        free(params);
-        vTaskDelete(NULL);
-        return;
+    size_t frame_max = ble_mtu - 3;      // ATT notification header
+    if (frame_max < SCAN_FRAME_MIN) {
+        frame_max = SCAN_FRAME_MIN;
     }
+    scan_framer_init(&framer, frame_max, scan_frame_send, NULL);
 
-    // Make sure we're not in a connecting state before scanning
-    EventBits_t bits = xEventGroupGetBits(s_wifi_event_group);
-    bool is_connecting = !(bits & WIFI_CONNECTED_BIT) && !(bits & WIFI_FAIL_BIT);
+    int64_t start = esp_timer_get_time();
+    bool cached = false;
+    int networks = 0;
+    esp_err_t err = wifi_scan_stream(scan_found, &framer, &cached, &networks);
+    if (err != ESP_OK) {
+        char response[96];
+        int len = snprintf(response, sizeof(response),
+                           "{\"event_type\":\"scan_list\",\"data\":{\"error\":\"%s\"}}", esp_err_to_name(err));
+        scan_frame_send(response, len, NULL);
+    }
+    uint32_t ms = (uint32_t)((esp_timer_get_time() - start) / 1000);
+    scan_framer_end(&framer, networks, ms, cached);
+    ESP_LOGI(TAG, "Scan streamed: %d networks in %u frames, %u skipped, %lu ms%s",
+             networks, framer.frames, framer.skipped, (unsigned long)ms, cached ? " (cached)" : "");
 
-    if (is_connecting) {
-        // If we're in connecting state, set the FAIL bit to allow scanning
-        ESP_LOGW(TAG, "WiFi was in connecting state, resetting state to allow scanning");
-        xEventGroupSetBits(s_wifi_event_group, WIFI_FAIL_BIT);
-        vTaskDelay(100 / portTICK_PERIOD_MS); // Small delay to let state change take effect
+    free(params);
+    vTaskDelete(NULL);
+}
+
+/* ---------------- Provisioning ---------------- */
+#define PROVISION_TASK_STACK 4096
+
+static volatile bool provision_running;   // set by the command worker, cleared by the provisioning task
+
+// Joining the AP takes up to ~35 s: run it apart so the command worker keeps answering
+static void provision_task(void *arg)
+{
+    connect_wifi_with_new_credentials_task();
+    provision_running = false;
+    vTaskDelete(NULL);
+}
+
+void get_wifi_credentials_from_app(const cJSON *ssid, const cJSON *password, const cJSON *device_id) {
+    if (provision_running) {
+        // The running attempt still reads wifi_credentials
+        ESP_LOGW(TAG, "Provisioning already in progress, credentials ignored");
+        ble_client_send("{\"wifi_status\":\"error\",\"message\":\"busy\"}");
+        return;
+    }
+    if (!cJSON_IsString(ssid) || !cJSON_IsString(password)) {
+        ESP_LOGE(TAG, "Missing or invalid SSID or PASSWORD in JSON");
+        ble_client_send("{\"wifi_status\":\"error\",\"message\":\"Missing SSID or PASSWORD\"}");
+        return;
+    }
+    if (!cJSON_IsString(device_id)) {
+        ESP_LOGE(TAG, "Missing or invalid device_id in JSON");
+        ble_client_send("{\"wifi_status\":\"error\",\"message\":\"Missing device_id\"}");
+        return;
+    }
+    // Free previous credentials if they exist
+    if (wifi_credentials.ssid != NULL) {
+        free(wifi_credentials.ssid);
+        wifi_credentials.ssid = NULL;
+    }
+    if (wifi_credentials.password != NULL) {
+        free(wifi_credentials.password);
+        wifi_credentials.password = NULL;
+    }
+    if (wifi_credentials.device_id != NULL) {
+        free(wifi_credentials.device_id);
+        wifi_credentials.device_id = NULL;
     }
 
-    memset(response, 0, 1000);
-    scan_wifi_networks(response);
-
-    printf("\nScan Response:\n%s\n", response);
-    size_t resp_len = strlen(response);
-    ESP_LOGI(TAG, "Response length: %d", resp_len);
-
-    if (resp_len > 0 && resp_len < 1000) {
-        int resp = esp_ble_gatts_send_indicate(
-            params->gatts_if,
-            params->conn_id,
-            heart_rate_handle_table[IDX_CHAR_VAL_B],
-            resp_len,
-            (uint8_t *)response,
-            false
-        );
-        printf("\nBLE response: %d\n", resp);
-        if (resp != ESP_OK) {
-            ESP_LOGE(TAG, "Failed to send BLE response: %d", resp);
+    // Allocate and copy values into wifi_credentials structure
+    wifi_credentials.ssid = malloc(strlen(ssid->valuestring) + 1);
+    wifi_credentials.password = malloc(strlen(password->valuestring) + 1);
+    wifi_credentials.device_id = malloc(strlen(device_id->valuestring) + 1);
+
+    if (wifi_credentials.ssid && wifi_credentials.password && wifi_credentials.device_id) {
+        strcpy((char *)wifi_credentials.ssid, ssid->valuestring);
+        strcpy((char *)wifi_credentials.password, password->valuestring);
+        strcpy((char *)wifi_credentials.device_id, device_id->valuestring);
+        ESP_LOGW(TAG, "Received WiFi credentials - SSID and device_id: %s <----> %s", wifi_credentials.ssid,wifi_credentials.device_id);
+        
+        wifi_creds_ready = true;
+        // Connect to WiFi with new credentials
+        provision_running = true;
+        if (xTaskCreate(provision_task, "provision", PROVISION_TASK_STACK, NULL, 5, NULL) != pdPASS) {
+            provision_running = false;
+            ESP_LOGE(TAG, "Failed to start the provisioning task");
+            ble_client_send("{\"wifi_status\":\"error\",\"message\":\"Failed to start provisioning\"}");
         }
     } else {
-        ESP_LOGE(TAG, "Invalid response length");
+        ESP_LOGE(TAG, "Memory allocation failed for WiFi credentials");
+        ble_client_send("{\"wifi_status\":\"error\",\"message\":\"Memory allocation failed\"}");
     }
+}
 
-    // Always set the FAIL bit after scanning to ensure we're not stuck in connecting state
-    xEventGroupSetBits(s_wifi_event_group, WIFI_FAIL_BIT);
+/* ---------------- Writes ---------------- */
+static uint8_t ble_write_arena[BLE_WRITE_ARENA_SIZE + 1];   // long write being collected, NUL-terminated on execute
+static ble_prep_t ble_prep;
 
-    free(response);
-    free(params);
-    vTaskDelete(NULL);
+/* A complete value written to characteristic A or B: short, or collected from prepared writes. Runs on the command worker */
+static void ble_write_value(esp_gatt_if_t gatts_if, uint16_t conn, uint16_t handle, const uint8_t *value, size_t len)
+{
+    const char *data = (const char *)value;
+#if DEBUG_PRINT_EN
+    printf("Data received :%.*s\nlen : %d\n", (int)len, data, (int)len);
+#endif
+    if(heart_rate_handle_table[IDX_CHAR_VAL_A] == handle){
+        ESP_LOGI(GATTS_TABLE_TAG, "WRITE IDX_CHAR_VAL_A");
+        if(len == strlen(AUTH_KEY) && memcmp(data, AUTH_KEY, len) == 0){
+            ESP_LOGD(GATTS_TABLE_TAG, "Auth key accepted");
+        }
+        // Check if this is a JSON command
+        else if(len > 0 && data[0] == '{') {
+            ble_command_dispatch(data, len);
+        }
+        else{
+            ESP_LOGW(GATTS_TABLE_TAG, "Authentication failed");
+        }
+    }
+    else if(heart_rate_handle_table[IDX_CHAR_VAL_B] == handle){
+        ESP_LOGI(GATTS_TABLE_TAG, "WRITE IDX_CHAR_VAL_B");
+        ESP_LOGI(TAG, "conn_id = %d", conn);
+
+        // Parse JSON to validate the request
+        cJSON *root = cJSON_ParseWithLength(data, len);
+        if (root == NULL) {
+            ESP_LOGW(GATTS_TABLE_TAG, "JSON parse error");
+            return;
+        }
+
+        // Check if this is a WiFi scan request
+        cJSON *cmd_type = cJSON_GetObjectItem(root, "cmd_type");
+        if (cmd_type != NULL && cJSON_IsString(cmd_type)) {
+            if (strcmp(cmd_type->valuestring, "scan_list") == 0) {
+                // Create a task to handle WiFi scanning to avoid conflicts with BLE
+                scan_task_params_t *params = malloc(sizeof(scan_task_params_t));
+                if (params != NULL) {
+                    params->gatts_if = gatts_if;
+                    params->conn_id = conn;
+
+                    xTaskCreate(
+                        wifi_scan_callback_task,
+                        "wifi_scan_task",
+                        8192,
+                        (void*)params,  // Pass the parameter structure
+                        5,
+                        NULL
+                    );
+                } else {
+                    ESP_LOGE(TAG, "Failed to allocate memory for task parameters");
+                }
+            } else if (strcmp(cmd_type->valuestring, "verify_device") == 0) {
+                // Handle device ID verification
+                ESP_LOGI(TAG, "Device id Verification");
+                cJSON *device_id = cJSON_GetObjectItem(root, "device_id");
+                if (device_id != NULL && cJSON_IsString(device_id)) {
+                    // Check if the device ID matches
+                    bool is_verified = check_device_id(device_id->valuestring);
+
+                    // Send verification response
+                    send_device_verification_response(is_verified);
+
+                    ESP_LOGI(TAG, "Device verification request processed");
+                } else {
+                    ESP_LOGE(TAG, "Missing or invalid device_id in verification request");
+                    send_device_verification_response(false);
+                }
+            } else if (strcmp(cmd_type->valuestring, "connect") == 0) {
+                // Handle WiFi credentials if present
+                ESP_LOGI(TAG, "WiFi Connection Request");
+                cJSON *ssid = cJSON_GetObjectItem(root, "ssid");
+                cJSON *password = cJSON_GetObjectItem(root, "password");
+                cJSON *device_id = cJSON_GetObjectItem(root, "device_id");
+
+                // Checks the types itself; the password is never logged
+                ESP_LOGD(TAG, "SSID: %s, device ID: %s",
+                         cJSON_IsString(ssid) ? ssid->valuestring : "(missing)",
+                         cJSON_IsString(device_id) ? device_id->valuestring : "(missing)");
+                get_wifi_credentials_from_app(ssid, password, device_id);
+            } else {
+                ESP_LOGW(TAG, "Unknown command type: %s", cmd_type->valuestring);
+            }
+        } else {
+            // Handle WiFi credentials if present (for backward compatibility)
+            cJSON *ssid = cJSON_GetObjectItem(root, "SSID");
+            cJSON *password = cJSON_GetObjectItem(root, "PASSWORD");
+            cJSON *device_id = cJSON_GetObjectItem(root, "device_id");
+            if (ssid != NULL || password != NULL) {
+                get_wifi_credentials_from_app(ssid, password, device_id);
+            }
+        }
+
+        cJSON_Delete(root);
+    }
 }
 
-void get_wifi_credentials_from_app(const cJSON *ssid, const cJSON *password, const cJSON *device_id) {
-    if (ssid && password && ssid->valuestring && password->valuestring) {
-        // Free previous credentials if they exist
-        if (wifi_credentials.ssid != NULL) {
-            free(wifi_credentials.ssid);
-            wifi_credentials.ssid = NULL;
+static void ble_prepare_write(esp_gatt_if_t gatts_if, esp_ble_gatts_cb_param_t *param)
+{
+    static esp_gatt_rsp_t gatt_rsp;      // callback context only; too big for its stack
+    esp_gatt_status_t status = ESP_GATT_OK;
+
+    switch (ble_prep_write(&ble_prep, param->write.handle, param->write.offset,
+                           param->write.value, param->write.len)) {
+        case BLE_PREP_OK:
+            break;
+        case BLE_PREP_BAD_OFFSET:
+            status = ESP_GATT_INVALID_OFFSET;
+            break;
+        case BLE_PREP_TOO_LONG:
+            status = ESP_GATT_INVALID_ATTR_LEN;
+            break;
+        case BLE_PREP_OTHER_HANDLE:
+            status = ESP_GATT_PREPARE_Q_FULL;
+            break;
+        case BLE_PREP_BUSY:
+            status = ESP_GATT_BUSY;
+            break;
+    }
+    if (status != ESP_GATT_OK) {
+        ESP_LOGW(GATTS_TABLE_TAG, "Prepared write rejected: offset %d len %d status 0x%x",
+                 param->write.offset, param->write.len, status);
+    }
+
+    /*send response when param->write.need_rsp is true */
+    if (param->write.need_rsp){
+        gatt_rsp.attr_value.len = param->write.len;
+        gatt_rsp.attr_value.handle = param->write.handle;
+        gatt_rsp.attr_value.offset = param->write.offset;
+        gatt_rsp.attr_value.auth_req = ESP_GATT_AUTH_REQ_NONE;
+        memcpy(gatt_rsp.attr_value.value, param->write.value, param->write.len);
+        esp_err_t response_err = esp_ble_gatts_send_response(gatts_if, param->write.conn_id, param->write.trans_id, status, &gatt_rsp);
+        if (response_err != ESP_OK){
+           ESP_LOGE(GATTS_TABLE_TAG, "Send response error");
         }
-        if (wifi_credentials.password != NULL) {
-            free(wifi_credentials.password);
-            wifi_credentials.password = NULL;
+    }
+}
+
+/* Read of characteristic A or B: ESP_GATT_RSP_BY_APP, so the stack leaves the response to us */
+static void ble_read_value(esp_gatt_if_t gatts_if, esp_ble_gatts_cb_param_t *param)
+{
+    static esp_gatt_rsp_t gatt_rsp;      // callback context only; too big for its stack
+    esp_gatt_status_t status = ESP_GATT_OK;
+
+    if (!param->read.need_rsp) {
+        return;
+    }
+    memset(&gatt_rsp, 0, sizeof(gatt_rsp));
+    gatt_rsp.attr_value.handle = param->read.handle;
+    gatt_rsp.attr_value.offset = param->read.offset;
+    gatt_rsp.attr_value.auth_req = ESP_GATT_AUTH_REQ_NONE;
+    if (param->read.offset > sizeof(char_value)) {
+        status = ESP_GATT_INVALID_OFFSET;
+    } else {
+        gatt_rsp.attr_value.len = sizeof(char_value) - param->read.offset;
+        memcpy(gatt_rsp.attr_value.value, char_value + param->read.offset, gatt_rsp.attr_value.len);
+    }
+    if (esp_ble_gatts_send_response(gatts_if, param->read.conn_id, param->read.trans_id, status, &gatt_rsp) != ESP_OK) {
+        ESP_LOGE(GATTS_TABLE_TAG, "Send response error");
+    }
+}
+
+/* ---------------- Command worker ---------------- */
+/*
+ * Commands can block (settings touch flash, provisioning hands off to its own
+ * task), so the GATTS callback only queues the written value. Replies go out
+ * from the worker as notifications. A write that finds the queue full is
+ * answered with {"error":"busy"} so the client knows to send it again.
+ */
+#define BLE_CMD_QUEUE_LEN   4
+#define BLE_CMD_SHORT_MAX   (BLE_LOCAL_MTU - 3)     // longest value one write request carries
+#define BLE_CMD_TASK_STACK  6144
+
+typedef struct {
+    esp_gatt_if_t gatts_if;
+    uint16_t conn;
+    uint16_t handle;
+    bool in_arena;                   // a long write: the value is in ble_write_arena, held until handled
+    size_t len;
+    uint8_t value[BLE_CMD_SHORT_MAX + 1];
+} ble_cmd_t;
+
+static QueueHandle_t ble_cmd_queue = NULL;
+static uint32_t ble_cmd_dropped;     // commands lost to a full queue
+
+static void ble_cmd_task(void *arg)
+{
+    static ble_cmd_t cmd;            // this task only; too big for its stack
+    for (;;) {
+        if (xQueueReceive(ble_cmd_queue, &cmd, portMAX_DELAY) != pdTRUE) {
+            continue;
         }
-        if (wifi_credentials.device_id != NULL) {
-            free(wifi_credentials.device_id);
-            wifi_credentials.device_id = NULL;
+        ble_write_value(cmd.gatts_if, cmd.conn, cmd.handle,
+                        cmd.in_arena ? ble_write_arena : cmd.value, cmd.len);
+        if (cmd.in_arena) {
+            ble_prep_release(&ble_prep);
         }
+    }
+}
 
+/* Callback context: hand a written value to the worker without waiting */
+static bool ble_cmd_post(esp_gatt_if_t gatts_if, uint16_t conn, uint16_t handle,
+                         const uint8_t *value, size_t len, bool in_arena)
+{
+    static ble_cmd_t cmd;            // callback context only
+    if (!in_arena && len > BLE_CMD_SHORT_MAX) {
+        ESP_LOGE(GATTS_TABLE_TAG, "Write of %d bytes too long", (int)len);
+        return false;
+    }
+    cmd.gatts_if = gatts_if;
+    cmd.conn = conn;
+    cmd.handle = handle;
+    cmd.in_arena = in_arena;
+    cmd.len = len;
+    if (!in_arena) {
+        memcpy(cmd.value, value, len);
+        cmd.value[len] = '\0';
+    }
+    if (xQueueSend(ble_cmd_queue, &cmd, 0) != pdTRUE) {
+        ble_cmd_dropped++;
+        ESP_LOGW(GATTS_TABLE_TAG, "Command queue full, write dropped (%lu so far)", (unsigned long)ble_cmd_dropped);
+        ble_client_send("{\"error\":\"busy\"}");
+        return false;
+    }
+    return true;
+}
 
-        // Allocate and copy values into wifi_credentials structure
-        wifi_credentials.ssid = malloc(strlen(ssid->valuestring) + 1);
-        wifi_credentials.password = malloc(strlen(password->valuestring) + 1);
-        wifi_credentials.device_id = malloc(strlen(device_id->valuestring) + 1);
-
-        if (wifi_credentials.ssid && wifi_credentials.password) {
-            strcpy((char *)wifi_credentials.ssid, ssid->valuestring);
-            strcpy((char *)wifi_credentials.password, password->valuestring);
-            strcpy((char *)wifi_credentials.device_id, device_id->valuestring);
-            ESP_LOGW(TAG, "Received WiFi credentials - SSID and device_id: %s <----> %s", wifi_credentials.ssid,wifi_credentials.device_id);
-            
-            wifi_creds_ready = true;
-            // Connect to WiFi with new credentials
-            connect_wifi_with_new_credentials_task();
-        } else {
-            ESP_LOGE(TAG, "Memory allocation failed for WiFi credentials");
-            ble_client_send("{\"wifi_status\":\"error\",\"message\":\"Memory allocation failed\"}");
+static void ble_exec_write(esp_gatt_if_t gatts_if, esp_ble_gatts_cb_param_t *param)
+{
+    // The values are ESP_GATT_RSP_BY_APP, so the execute request waits for this response
+    esp_ble_gatts_send_response(gatts_if, param->exec_write.conn_id, param->exec_write.trans_id, ESP_GATT_OK, NULL);
+
+    uint16_t handle;
+    size_t len = ble_prep_take(&ble_prep, &handle);
+    if (param->exec_write.exec_write_flag != ESP_GATT_PREP_WRITE_EXEC){
+        ESP_LOGI(GATTS_TABLE_TAG,"ESP_GATT_PREP_WRITE_CANCEL");
+        if (len > 0) {
+            ble_prep_release(&ble_prep);     // taken just now, nobody else has it
         }
-    } else {
-        ESP_LOGE(TAG, "Missing or invalid SSID or PASSWORD in JSON");
-        ble_client_send("{\"wifi_status\":\"error\",\"message\":\"Missing SSID or PASSWORD\"}");
+        return;
+    }
+    if (len == 0) {
+        ESP_LOGW(GATTS_TABLE_TAG, "Long write discarded");
+        return;
+    }
+    ESP_LOGI(GATTS_TABLE_TAG, "Long write: %d bytes", (int)len);
+    // Handed over in place: the arena stays held until the worker is done with it
+    if (!ble_cmd_post(gatts_if, param->exec_write.conn_id, handle, ble_write_arena, len, true)) {
+        ble_prep_release(&ble_prep);
     }
 }
 
@@ -651,7 +928,7 @@ static void gatts_profile_event_handler(esp_gatts_cb_event_t event, esp_gatt_if_
 {
     switch (event) {
         case ESP_GATTS_REG_EVT:
-			printf("\n ----ESP_GATTS_REG_EVT-----");
+            ESP_LOGD(GATTS_TABLE_TAG, "ESP_GATTS_REG_EVT");
             ESP_LOGI(GATTS_TABLE_TAG, "Setting BLE device name to: %s", BLE_DEVICE_NAME);
             esp_ble_gap_set_device_name((const char *)BLE_DEVICE_NAME);
             esp_ble_gap_config_local_privacy(true);
@@ -661,159 +938,29 @@ static void gatts_profile_event_handler(esp_gatts_cb_event_t event, esp_gatt_if_
             ESP_LOGI(GATTS_TABLE_TAG, "ESP_GATTS_CONNECT_EVT, conn_id = %d", param->connect.conn_id);
             interface_type = gatts_if;
             conn_id = param->connect.conn_id;
+            ble_connected = true;
             esp_ble_set_encryption(param->connect.remote_bda, ESP_BLE_SEC_ENCRYPT_MITM);
             break;
         case ESP_GATTS_DISCONNECT_EVT:
             ESP_LOGI(TAG, "Client disconnected");
             is_authenticated = false; // Reset authentication on disconnect
             conn_id = 0;
+            ble_mtu = BLE_DEFAULT_MTU;
+            ble_connected = false;
+            ble_cccd_b = 0;
+            // Release a sender waiting for a congestion or confirmation event that will not come
+            xEventGroupSetBits(ble_tx_events, BLE_TX_READY_BIT | BLE_TX_CONF_BIT);
+            ble_prep_reset(&ble_prep);
             esp_ble_gap_start_advertising(&adv_params);
             break;
         case ESP_GATTS_WRITE_EVT:
-        printf("\n ****************ESP_GATTS_WRITE_EVT*******************");
+        trace_record(TRACE_BLE_WRITE, param->write.is_prep, param->write.len, param->write.handle);
         if (!param->write.is_prep){
 
-            snprintf(data_validation, sizeof(data_validation), "%s",param->write.value);
-            printf("Data received :%s\nlen : %d\n",data_validation,param->write.len);
-#if DEBUG_PRINT_EN
-             printf("Data received :%s\nlen : %d\n",data_validation,param->write.len);
-#endif
-             if(heart_rate_handle_table[IDX_CHAR_VAL_A] == param->write.handle){
-               	ESP_LOGI(GATTS_TABLE_TAG, "WRITE IDX_CHAR_VAL_A");
-                if((strcmp(data_validation,AUTH_KEY)==0) ){
-                    printf("\nAUTH DONE\n");
-                }
-                // Check if this is a JSON command
-                else if(data_validation[0] == '{') {
-                    // Parse JSON
-                    cJSON *root = cJSON_Parse(data_validation);
-                    if (root != NULL) {
-                        cJSON *cmd = cJSON_GetObjectItem(root, "cmd");
-                        if (cmd != NULL && cJSON_IsString(cmd) && strcmp(cmd->valuestring, "get_deviceid") == 0) {
-                            printf("\nDevice ID To App : %s\n",DEVICE_ID);
-                            char device_id_json[100];
-                            sprintf(device_id_json, "{\"device_id\":\"%s\",\"device_type\":\"AIOS_1\"}", DEVICE_ID);
-                            ble_client_send(device_id_json);
-                        }else if (strcmp(cmd->valuestring, "set_temperature") == 0) {
-                            ESP_LOGI(TAG, "Temperature Request");
-                            cJSON *value = cJSON_GetObjectItem(root, "value");
-                            ESP_LOGE(TAG, "Temperature_value : %d", value->valueint);
-                            if((value->valueint >= 15 && value->valueint <= 45) || value->valueint == 0){
-                                g_sensor_config.temperature_value = value->valueint;
-                                store_wifi_credentials_to_nvs();
-                                update_temperature_threshold(value->valueint);
-                            }
-                        }else if (strcmp(cmd->valuestring, "presence_trigger") == 0) {
-                            ESP_LOGI(TAG, "Presence Trigger Request");
-                            cJSON *value = cJSON_GetObjectItem(root, "value");
-                            if (value != NULL && cJSON_IsString(value)) {
-                                strcpy(g_sensor_config.presence_state, value->valuestring);
-                                store_wifi_credentials_to_nvs();
-                                update_presence_switch_state(value->valuestring);
-                            }
-                        }else if (strcmp(cmd->valuestring, "set_lux") == 0) {
-                            ESP_LOGI(TAG, "Light Trigger Request");
-                            cJSON *value = cJSON_GetObjectItem(root, "value");
-                            if (value != NULL && cJSON_IsNumber(value)) {
-                                int lux_val = value->valueint;
-                                if (lux_val >= 0 && lux_val <= 3500) {
-                                    g_sensor_config.light_value = (uint16_t)lux_val;
-                                    ESP_LOGE(TAG, "Light_value : %d", g_sensor_config.light_value);
-                                    store_wifi_credentials_to_nvs();
-                                    update_light_threshold((uint16_t)lux_val);
-                                } else {
-                                    ESP_LOGE(TAG, "Light value out of range: %d (0-3000)", lux_val);
-                                }
-                            }
-                        }else{
-                            //Nothing to do
-                        }
-                        cJSON_Delete(root);
-                    }
-                }
-                else{
-                    printf("\n!!! Authentication failed : disconnecting from client !!!\n");
-                }
-            }
-            else if(heart_rate_handle_table[IDX_CHAR_VAL_B] == param->write.handle){
-               	ESP_LOGI(GATTS_TABLE_TAG, "WRITE IDX_CHAR_VAL_B");
-                ESP_LOGI(TAG, "param->write.conn_id = %d", param->write.conn_id);
-
-                // Parse JSON to validate the request
-                cJSON *root = cJSON_Parse((const char *)data_validation);
-                if (root == NULL) {
-                    printf("JSON Parse Error!\n");
-                    return;
-                }
-
-                // Check if this is a WiFi scan request
-                cJSON *cmd_type = cJSON_GetObjectItem(root, "cmd_type");
-                if (cmd_type != NULL && cJSON_IsString(cmd_type)) {
-                    if (strcmp(cmd_type->valuestring, "scan_list") == 0) {
-                        // Create a task to handle WiFi scanning to avoid conflicts with BLE
-                        scan_task_params_t *params = malloc(sizeof(scan_task_params_t));
-                        if (params != NULL) {
-                            params->gatts_if = gatts_if;
-                            params->conn_id = param->write.conn_id;
-
-                            xTaskCreate(
-                                wifi_scan_callback_task,
-                                "wifi_scan_task",
-                                8192,
-                                (void*)params,  // Pass the parameter structure
-                                5,
-                                NULL
-                            );
-                        } else {
-                            ESP_LOGE(TAG, "Failed to allocate memory for task parameters");
-                        }
-                    } else if (strcmp(cmd_type->valuestring, "verify_device") == 0) {
-                        // Handle device ID verification
-                        ESP_LOGI(TAG, "Device id Verification");
-                        cJSON *device_id = cJSON_GetObjectItem(root, "device_id");
-                        if (device_id != NULL && cJSON_IsString(device_id)) {
-                            // Check if the device ID matches
-                            bool is_verified = check_device_id(device_id->valuestring);
-
-                            // Send verification response
-                            send_device_verification_response(is_verified);
-
-                            ESP_LOGI(TAG, "Device verification request processed");
-                        } else {
-                            ESP_LOGE(TAG, "Missing or invalid device_id in verification request");
-                            send_device_verification_response(false);
-                        }
-                    } else if (strcmp(cmd_type->valuestring, "connect") == 0) {
-                        // Handle WiFi credentials if present
-                        ESP_LOGI(TAG, "WiFi Connection Request");
-                        cJSON *ssid = cJSON_GetObjectItem(root, "ssid");
-                        cJSON *password = cJSON_GetObjectItem(root, "password");
-                        cJSON *device_id = cJSON_GetObjectItem(root, "device_id");
-
-                        if (ssid != NULL && password != NULL) {
-                            printf("SSID: %s\n", ssid->valuestring);
-                            printf("PASSWORD: %s\n", password->valuestring);
-                            printf("Device ID: %s\n", device_id->valuestring);
-                            get_wifi_credentials_from_app(ssid, password, device_id);
-                            
-                        } else {
-                            printf("Missing SSID or PASSWORD in JSON\n");
-                            ble_client_send("{\"wifi_status\":\"error\",\"message\":\"Missing SSID or PASSWORD\"}");
-                        }
-                    } else {
-                        ESP_LOGW(TAG, "Unknown command type: %s", cmd_type->valuestring);
-                    }
-                } else {
-                    // Handle WiFi credentials if present (for backward compatibility)
-                    cJSON *ssid = cJSON_GetObjectItem(root, "SSID");
-                    cJSON *password = cJSON_GetObjectItem(root, "PASSWORD");
-                    cJSON *device_id = cJSON_GetObjectItem(root, "device_id");
-                    if (ssid != NULL && password != NULL) {
-                        get_wifi_credentials_from_app(ssid, password, device_id);
-                    }
-                }
-
-                cJSON_Delete(root);
+            if (heart_rate_handle_table[IDX_CHAR_VAL_A] == param->write.handle ||
+                heart_rate_handle_table[IDX_CHAR_VAL_B] == param->write.handle) {
+                ble_cmd_post(gatts_if, param->write.conn_id, param->write.handle,
+                             param->write.value, param->write.len, false);
             }
             else if (heart_rate_handle_table[IDX_CHAR_CFG_A] == param->write.handle && param->write.len == 2){
 //					ESP_LOGI(GATTS_TABLE_TAG, "NOTIFY DATA");
@@ -848,6 +995,7 @@ static void gatts_profile_event_handler(esp_gatts_cb_event_t event, esp_gatt_if_
 
             }else if (heart_rate_handle_table[IDX_CHAR_CFG_B] == param->write.handle && param->write.len == 2){
                 uint16_t descr_value = param->write.value[1]<<8 | param->write.value[0];
+                ble_cccd_b = descr_value;
                 if (descr_value == 0x0001){
 //                        ESP_LOGI(GATTS_TABLE_TAG, "notify enable B");
                     uint8_t notify_data[15];
@@ -881,39 +1029,27 @@ static void gatts_profile_event_handler(esp_gatts_cb_event_t event, esp_gatt_if_
             }
             /* send response when param->write.need_rsp is true*/
             if (param->write.need_rsp){
-                printf("send response");
                 esp_ble_gatts_send_response(gatts_if, param->write.conn_id, param->write.trans_id, ESP_GATT_OK, NULL);
             }
         }
         else{
             /* handle prepare write */
-            example_prepare_write_event_env(gatts_if, &prepare_write_env_b, param);
+            ble_prepare_write(gatts_if, param);
         }
         break;
+        case ESP_GATTS_READ_EVT:
+            ble_read_value(gatts_if, param);
+            break;
         case ESP_GATTS_EXEC_WRITE_EVT:
             ESP_LOGI(GATTS_TABLE_TAG, "ESP_GATTS_EXEC_WRITE_EVT");
-            printf("Full received data: %.*s\n", prepare_write_env_b.prepare_len, prepare_write_env_b.prepare_buf);
-            // Parse JSON
-            cJSON *root = cJSON_Parse((const char *)prepare_write_env_b.prepare_buf);
-            if (root == NULL) {
-                printf("JSON Parse Error!\n");
-                return;
-            }
-
-            cJSON *ssid = cJSON_GetObjectItem(root, "SSID");
-            cJSON *password = cJSON_GetObjectItem(root, "PASSWORD");
-            cJSON *device_id = cJSON_GetObjectItem(root, "device_id");
-
-            if (ssid && password) {
-                get_wifi_credentials_from_app(ssid, password, device_id);
-            }
-            cJSON_Delete(root);
-            example_exec_write_event_env(&prepare_write_env_b, param);
+            ble_exec_write(gatts_if, param);
             break;
         case ESP_GATTS_MTU_EVT:
             ESP_LOGI(GATTS_TABLE_TAG, "ESP_GATTS_MTU_EVT, MTU %d", param->mtu.mtu);
+            ble_mtu = param->mtu.mtu;
             break;
         case ESP_GATTS_CONF_EVT:
+            xEventGroupSetBits(ble_tx_events, BLE_TX_CONF_BIT);
             // ESP_LOGI(GATTS_TABLE_TAG, "ESP_GATTS_CONF_EVT, status = %d, attr_handle %d", param->conf.status, param->conf.handle);
             break;
         case ESP_GATTS_START_EVT:
@@ -938,8 +1074,15 @@ static void gatts_profile_event_handler(esp_gatts_cb_event_t event, esp_gatt_if_
         case ESP_GATTS_OPEN_EVT:
         case ESP_GATTS_CANCEL_OPEN_EVT:
         case ESP_GATTS_CLOSE_EVT:
-        case ESP_GATTS_LISTEN_EVT:
+            break;
         case ESP_GATTS_CONGEST_EVT:
+            if (param->congest.congested) {
+                xEventGroupClearBits(ble_tx_events, BLE_TX_READY_BIT);
+            } else {
+                xEventGroupSetBits(ble_tx_events, BLE_TX_READY_BIT);
+            }
+            break;
+        case ESP_GATTS_LISTEN_EVT:
         case ESP_GATTS_UNREG_EVT:
         case ESP_GATTS_DELETE_EVT:
         default:
@@ -949,6 +1092,9 @@ static void gatts_profile_event_handler(esp_gatts_cb_event_t event, esp_gatt_if_
 
 static void gatts_event_handler(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if, esp_ble_gatts_cb_param_t *param)
 {
+    if (ble_cb_task == NULL) {
+        ble_cb_task = xTaskGetCurrentTaskHandle();
+    }
 
     /* If event is register event, store the gatts_if for each profile */
     if (event == ESP_GATTS_REG_EVT) {
@@ -1011,6 +1157,21 @@ esp_err_t bluetooth_init(void)
         return ret;
     }
 
+    ble_tx_events = xEventGroupCreate();
+    ble_tx_lock = xSemaphoreCreateMutex();
+    ble_prep_init(&ble_prep, ble_write_arena, BLE_WRITE_ARENA_SIZE);
+    if (ble_tx_events == NULL || ble_tx_lock == NULL) {
+        ESP_LOGE(TAG, "Failed to create the BLE send lock");
+        return ESP_ERR_NO_MEM;
+    }
+    ble_cmd_queue = xQueueCreate(BLE_CMD_QUEUE_LEN, sizeof(ble_cmd_t));
+    if (ble_cmd_queue == NULL ||
+        xTaskCreate(ble_cmd_task, "ble_cmd", BLE_CMD_TASK_STACK, NULL, 5, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to start the BLE command worker");
+        return ESP_ERR_NO_MEM;
+    }
+    xEventGroupSetBits(ble_tx_events, BLE_TX_READY_BIT);
+
     // Register callbacks
     ret = esp_ble_gatts_register_callback(gatts_event_handler);
     if (ret) {
@@ -1031,6 +1192,12 @@ esp_err_t bluetooth_init(void)
         return ret;
     }
 
+    // Let the client raise the MTU as far as it can; ble_send() fragments to whatever it settles on
+    ret = esp_ble_gatt_set_local_mtu(BLE_LOCAL_MTU);
+    if (ret) {
+        ESP_LOGW(TAG, "Set local MTU failed: %s", esp_err_to_name(ret));
+    }
+
 
      /* set the security iocap & auth_req & key size & init key response key parameters to the stack*/
     esp_ble_auth_req_t auth_req = ESP_LE_AUTH_REQ_SC_MITM_BOND;    
@@ -1085,7 +1252,7 @@ void connect_wifi_with_new_credentials_task(void) {
         strlcpy((char *)wifi_config.sta.ssid, (const char *)wifi_credentials.ssid, sizeof(wifi_config.sta.ssid));
         strlcpy((char *)wifi_config.sta.password, (const char *)wifi_credentials.password, sizeof(wifi_config.sta.password));
 
-        ESP_LOGI(TAG, "*****New WiFi credentials: SSID=%s, Password=%s", wifi_config.sta.ssid, wifi_config.sta.password);
+        ESP_LOGI(TAG, "New WiFi credentials: SSID=%s", wifi_config.sta.ssid);
     } else {
         ESP_LOGE(TAG, "WiFi credentials are NULL");
         ble_client_send("{\"wifi_status\":\"error\",\"message\":\"Invalid WiFi credentials\"}");
@@ -1163,7 +1330,10 @@ void connect_wifi_with_new_credentials_task(void) {
             if (ip_info.ip.addr != 0) {
                 // Connection successful - NOW we can save the credentials to NVS
                 ESP_LOGI(TAG, "WiFi connection successful with valid IP address - saving credentials to NVS");
-                store_wifi_credentials_to_nvs();  // Save credentials after successful connection
+                config_store_set_wifi((char *)wifi_credentials.ssid, (char *)wifi_credentials.password);
+                config_store_set_device_id((char *)wifi_credentials.device_id);
+                wifi_cache_current_ap();
+                config_store_flush();  // Save credentials after successful connection
 
                 // Create JSON response with connection status
                 char response[100];
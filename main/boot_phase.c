@@ -0,0 +1,54 @@
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "boot_phase.h"
+
+static const char *TAG = "BOOT";
+
+static atomic_uint phase_ms[BOOT_PHASE_COUNT];
+
+static const char *const phase_names[BOOT_PHASE_COUNT] = {
+    "app", "storage", "relays", "control", "wifi_start", "udp", "ble", "wifi_ip",
+};
+
+void boot_phase_mark(boot_phase_t phase)
+{
+    if (phase >= BOOT_PHASE_COUNT) {
+        return;
+    }
+    // 0 means "not reached", so a phase at the very first millisecond reads as 1
+    unsigned int ms = (unsigned int)(esp_timer_get_time() / 1000);
+    unsigned int unset = 0;
+    if (atomic_compare_exchange_strong(&phase_ms[phase], &unset, ms ? ms : 1)) {
+        ESP_LOGI(TAG, "%s ready at %u ms", phase_names[phase], ms);
+    }
+}
+
+uint32_t boot_phase_ms(boot_phase_t phase)
+{
+    return phase < BOOT_PHASE_COUNT ? atomic_load(&phase_ms[phase]) : 0;
+}
+
+const char *boot_phase_name(boot_phase_t phase)
+{
+    return phase < BOOT_PHASE_COUNT ? phase_names[phase] : "unknown";
+}
+
+int boot_phase_format(char *buf, size_t size)
+{
+    size_t n = snprintf(buf, size, "{\"boot\":{");
+    bool first = true;
+    for (int i = 0; i < BOOT_PHASE_COUNT && n < size; i++) {
+        uint32_t ms = boot_phase_ms(i);
+        if (ms != 0) {
+            n += snprintf(buf + n, size - n, "%s\"%s\":%lu", first ? "" : ",", phase_names[i], (unsigned long)ms);
+            first = false;
+        }
+    }
+    if (n < size) {
+        n += snprintf(buf + n, size - n, "}}");
+    }
+    return n < size ? (int)n : (int)size - 1;
+}
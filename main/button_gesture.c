@@ -0,0 +1,87 @@
+#include "button_gesture.h"
+
+void button_gesture_init(button_gesture_t *button, bool pressed)
+{
+    button->state = pressed ? BUTTON_DOWN_LONG : BUTTON_IDLE;    // held at boot: not a gesture
+    button->pressed = pressed;
+    button->raw_pressed = pressed;
+    button->clicks = 0;
+    button->settle_us = 0;
+    button->press_us = 0;
+    button->release_us = 0;
+}
+
+/* Debounced level changed at time_us */
+static uint32_t button_transition(button_gesture_t *button, bool pressed, int64_t time_us)
+{
+    button->pressed = pressed;
+    button->settle_us = time_us + BUTTON_DEBOUNCE_US;
+
+    if (pressed) {
+        button->press_us = time_us;
+        button->clicks = (button->state == BUTTON_WAIT_SECOND) ? button->clicks + 1 : 1;
+        button->state = BUTTON_DOWN;
+        return BUTTON_EVT_PRESS;
+    }
+
+    button->release_us = time_us;
+    uint32_t events = BUTTON_EVT_RELEASE;
+    if (button->state == BUTTON_DOWN_LONG) {
+        button->state = BUTTON_IDLE;
+    } else if (button->clicks >= 2) {
+        events |= BUTTON_EVT_DOUBLE;
+        button->state = BUTTON_IDLE;
+    } else {
+        button->state = BUTTON_WAIT_SECOND;
+    }
+    return events;
+}
+
+uint32_t button_gesture_edge(button_gesture_t *button, bool pressed, int64_t time_us)
+{
+    // Time-based events that fell due before this edge come first
+    uint32_t events = button_gesture_poll(button, time_us);
+
+    button->raw_pressed = pressed;
+    if (time_us < button->settle_us || pressed == button->pressed) {
+        // Bounce, or a repeat of the current level; settled later by poll
+        return events;
+    }
+    return events | button_transition(button, pressed, time_us);
+}
+
+uint32_t button_gesture_poll(button_gesture_t *button, int64_t now_us)
+{
+    uint32_t events = 0;
+
+    // Bounce window over and the pin ended up at the other level: take it now
+    if (button->settle_us != 0 && now_us >= button->settle_us) {
+        int64_t settle_us = button->settle_us;
+        button->settle_us = 0;
+        if (button->raw_pressed != button->pressed) {
+            events |= button_transition(button, button->raw_pressed, settle_us);
+        }
+    }
+
+    if (button->state == BUTTON_DOWN && now_us - button->press_us >= BUTTON_LONG_PRESS_US) {
+        button->state = BUTTON_DOWN_LONG;
+        events |= BUTTON_EVT_LONG;
+    } else if (button->state == BUTTON_WAIT_SECOND &&
+               now_us - button->release_us >= BUTTON_DOUBLE_WINDOW_US) {
+        button->state = BUTTON_IDLE;
+        events |= BUTTON_EVT_SINGLE;
+    }
+    return events;
+}
+
+int64_t button_gesture_deadline(const button_gesture_t *button)
+{
+    if (button->settle_us != 0) {
+        return button->settle_us;
+    }
+    switch (button->state) {
+        case BUTTON_DOWN:        return button->press_us + BUTTON_LONG_PRESS_US;
+        case BUTTON_WAIT_SECOND: return button->release_us + BUTTON_DOUBLE_WINDOW_US;
+        default:                 return 0;
+    }
+}
@@ -0,0 +1,493 @@
+#include <string.h>
+#include "cmd_parser.h"
+
+/*
+ * Minimal JSON scanner for the sensor command path.
+ *
+ * Only the keys the switch cares about are decoded; everything else is
+ * skipped without being materialised. The scanner walks the buffer once,
+ * never allocates and keeps string values as pointers into the buffer.
+ */
+
+#define MAX_NESTED_COMMAND 1   // "command" may embed one level of sensor JSON
+
+typedef struct {
+    char *pos;
+    char *end;
+} scanner_t;
+
+static int parse_object(scanner_t *s, udp_command_t *out, int nesting);
+
+/* ---------------- Lexical helpers ---------------- */
+static void skip_ws(scanner_t *s)
+{
+    while (s->pos < s->end &&
+           (*s->pos == ' ' || *s->pos == '\t' || *s->pos == '\n' || *s->pos == '\r')) {
+        s->pos++;
+    }
+}
+
+static bool consume(scanner_t *s, char c)
+{
+    skip_ws(s);
+    if (s->pos < s->end && *s->pos == c) {
+        s->pos++;
+        return true;
+    }
+    return false;
+}
+
+static bool match_literal(scanner_t *s, const char *lit, size_t lit_len)
+{
+    if ((size_t)(s->end - s->pos) < lit_len || memcmp(s->pos, lit, lit_len) != 0) {
+        return false;
+    }
+    s->pos += lit_len;
+    return true;
+}
+
+static int hex_value(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+/*
+ * Scan a string starting at the opening quote. On return start and len
+ * describe the raw contents and *escaped tells whether a backslash was seen.
+ */
+static bool scan_string(scanner_t *s, char **start, size_t *len, bool *escaped)
+{
+    if (s->pos >= s->end || *s->pos != '"') {
+        return false;
+    }
+    char *p = ++s->pos;
+    bool esc = false;
+    while (p < s->end && *p != '"') {
+        if (*p == '\\') {
+            esc = true;
+            p++;
+            if (p >= s->end) {
+                return false;
+            }
+        }
+        p++;
+    }
+    if (p >= s->end) {
+        return false;
+    }
+    *start = s->pos;
+    *len = (size_t)(p - s->pos);
+    *escaped = esc;
+    s->pos = p + 1;
+    return true;
+}
+
+/*
+ * Decode JSON escapes in place. The decoded text is never longer than the
+ * raw text, so it fits where it is. Returns the decoded length and writes
+ * a terminator after it, which lands on or before the closing quote.
+ */
+static size_t unescape_in_place(char *str, size_t len)
+{
+    char *src = str;
+    char *dst = str;
+    char *end = str + len;
+
+    while (src < end) {
+        if (*src != '\\') {
+            *dst++ = *src++;
+            continue;
+        }
+        src++;
+        switch (*src) {
+            case 'b': *dst++ = '\b'; src++; break;
+            case 'f': *dst++ = '\f'; src++; break;
+            case 'n': *dst++ = '\n'; src++; break;
+            case 'r': *dst++ = '\r'; src++; break;
+            case 't': *dst++ = '\t'; src++; break;
+            case 'u': {
+                int code = 0;
+                int i;
+                for (i = 1; i <= 4 && src + i < end; i++) {
+                    int h = hex_value(src[i]);
+                    if (h < 0) {
+                        break;
+                    }
+                    code = (code << 4) | h;
+                }
+                // Keys and values used by the switch are ASCII only
+                *dst++ = (i == 5 && code < 0x80) ? (char)code : '?';
+                src += i;
+                break;
+            }
+            default:
+                *dst++ = *src++;  // \" \\ \/ and anything unexpected
+                break;
+        }
+    }
+    *dst = '\0';
+    return (size_t)(dst - str);
+}
+
+static bool parse_number(scanner_t *s, float *value)
+{
+    char *p = s->pos;
+    bool negative = false;
+    bool digits = false;
+    float result = 0.0f;
+
+    if (p < s->end && (*p == '-' || *p == '+')) {
+        negative = (*p == '-');
+        p++;
+    }
+    while (p < s->end && *p >= '0' && *p <= '9') {
+        result = result * 10.0f + (float)(*p - '0');
+        digits = true;
+        p++;
+    }
+    if (p < s->end && *p == '.') {
+        float scale = 0.1f;
+        p++;
+        while (p < s->end && *p >= '0' && *p <= '9') {
+            result += (float)(*p - '0') * scale;
+            scale *= 0.1f;
+            digits = true;
+            p++;
+        }
+    }
+    if (!digits) {
+        return false;
+    }
+    if (p < s->end && (*p == 'e' || *p == 'E')) {
+        bool exp_negative = false;
+        int exponent = 0;
+        p++;
+        if (p < s->end && (*p == '-' || *p == '+')) {
+            exp_negative = (*p == '-');
+            p++;
+        }
+        while (p < s->end && *p >= '0' && *p <= '9') {
+            if (exponent < 38) {
+                exponent = exponent * 10 + (*p - '0');
+            }
+            p++;
+        }
+        while (exponent-- > 0) {
+            result = exp_negative ? result / 10.0f : result * 10.0f;
+        }
+    }
+
+    *value = negative ? -result : result;
+    s->pos = p;
+    return true;
+}
+
+// Non-negative integer that fits in 32 bits, parsed exactly (no float rounding)
+static bool parse_uint32(scanner_t *s, uint32_t *value)
+{
+    char *p = s->pos;
+    uint64_t result = 0;
+
+    if (p >= s->end || *p < '0' || *p > '9') {
+        return false;
+    }
+    while (p < s->end && *p >= '0' && *p <= '9') {
+        result = result * 10 + (uint64_t)(*p - '0');
+        if (result > UINT32_MAX) {
+            return false;
+        }
+        p++;
+    }
+    if (p < s->end && (*p == '.' || *p == 'e' || *p == 'E')) {
+        return false;
+    }
+
+    *value = (uint32_t)result;
+    s->pos = p;
+    return true;
+}
+
+// Skip any JSON value (used for keys we do not care about)
+static bool skip_value(scanner_t *s)
+{
+    char *start;
+    size_t len;
+    bool escaped;
+    float number;
+
+    skip_ws(s);
+    if (s->pos >= s->end) {
+        return false;
+    }
+    switch (*s->pos) {
+        case '"':
+            return scan_string(s, &start, &len, &escaped);
+        case 't':
+            return match_literal(s, "true", 4);
+        case 'f':
+            return match_literal(s, "false", 5);
+        case 'n':
+            return match_literal(s, "null", 4);
+        case '{':
+        case '[': {
+            int depth = 0;
+            while (s->pos < s->end) {
+                char c = *s->pos;
+                if (c == '"') {
+                    if (!scan_string(s, &start, &len, &escaped)) {
+                        return false;
+                    }
+                    continue;
+                }
+                s->pos++;
+                if (c == '{' || c == '[') {
+                    depth++;
+                } else if (c == '}' || c == ']') {
+                    if (--depth == 0) {
+                        return true;
+                    }
+                }
+            }
+            return false;
+        }
+        default:
+            return parse_number(s, &number);
+    }
+}
+
+static bool parse_bool(scanner_t *s, bool *value)
+{
+    skip_ws(s);
+    if (match_literal(s, "true", 4)) {
+        *value = true;
+        return true;
+    }
+    if (match_literal(s, "false", 5)) {
+        *value = false;
+        return true;
+    }
+    return false;
+}
+
+static sensor_origin_t origin_from_string(const char *str, size_t len)
+{
+    if (cmd_field_equals(str, len, "TEMP")) {
+        return SENSOR_ORIGIN_TEMP;
+    }
+    if (cmd_field_equals(str, len, "MOTION")) {
+        return SENSOR_ORIGIN_MOTION;
+    }
+    if (cmd_field_equals(str, len, "LUX")) {
+        return SENSOR_ORIGIN_LUX;
+    }
+    return SENSOR_ORIGIN_OTHER;
+}
+
+/* ---------------- Key handlers ---------------- */
+static bool parse_string_field(scanner_t *s, const char **value, size_t *value_len)
+{
+    char *start;
+    size_t len;
+    bool escaped;
+
+    skip_ws(s);
+    if (!scan_string(s, &start, &len, &escaped)) {
+        return false;
+    }
+    if (escaped) {
+        len = unescape_in_place(start, len);
+    }
+    *value = start;
+    *value_len = len;
+    return true;
+}
+
+static bool parse_command_field(scanner_t *s, udp_command_t *out, int nesting)
+{
+    skip_ws(s);
+    if (s->pos >= s->end) {
+        return false;
+    }
+
+    if (*s->pos == '{') {
+        // Sensor data sent as an object rather than an escaped string
+        if (nesting >= MAX_NESTED_COMMAND) {
+            return skip_value(s);
+        }
+        return parse_object(s, out, nesting + 1) == 0;
+    }
+
+    if (*s->pos != '"') {
+        return skip_value(s);
+    }
+
+    char *start;
+    size_t len;
+    bool escaped;
+    if (!scan_string(s, &start, &len, &escaped)) {
+        return false;
+    }
+    if (escaped) {
+        len = unescape_in_place(start, len);
+    }
+
+    // Nested form: the string itself is the sensor JSON object
+    char *p = start;
+    while (p < start + len && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) {
+        p++;
+    }
+    if (p < start + len && *p == '{' && nesting < MAX_NESTED_COMMAND) {
+        scanner_t inner = { .pos = p, .end = start + len };
+        if (parse_object(&inner, out, nesting + 1) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool parse_member(scanner_t *s, const char *key, size_t key_len,
+                         udp_command_t *out, int nesting)
+{
+    uint32_t field = 0;
+    bool ok;
+
+    if (cmd_field_equals(key, key_len, "command")) {
+        field = CMD_FIELD_COMMAND;
+        ok = parse_command_field(s, out, nesting);
+    } else if (cmd_field_equals(key, key_len, "source")) {
+        field = CMD_FIELD_SOURCE;
+        ok = parse_string_field(s, &out->source, &out->source_len);
+    } else if (cmd_field_equals(key, key_len, "device_id")) {
+        field = CMD_FIELD_DEVICE_ID;
+        ok = parse_string_field(s, &out->device_id, &out->device_id_len);
+    } else if (cmd_field_equals(key, key_len, "cmd") && nesting == 0) {
+        field = CMD_FIELD_CMD;
+        ok = parse_string_field(s, &out->cmd, &out->cmd_len);
+    } else if (cmd_field_equals(key, key_len, "presence_detected")) {
+        field = CMD_FIELD_PRESENCE;
+        ok = parse_bool(s, &out->reading.presence_detected);
+    } else if (cmd_field_equals(key, key_len, "motion_detected")) {
+        field = CMD_FIELD_MOTION;
+        ok = parse_bool(s, &out->reading.motion_detected);
+    } else if (cmd_field_equals(key, key_len, "temperature")) {
+        field = CMD_FIELD_TEMPERATURE;
+        skip_ws(s);
+        ok = parse_number(s, &out->reading.temperature);
+    } else if (cmd_field_equals(key, key_len, "lux")) {
+        field = CMD_FIELD_LUX;
+        skip_ws(s);
+        ok = parse_number(s, &out->reading.lux);
+    } else if (cmd_field_equals(key, key_len, "origin")) {
+        const char *origin;
+        size_t origin_len;
+        field = CMD_FIELD_ORIGIN;
+        ok = parse_string_field(s, &origin, &origin_len);
+        if (ok) {
+            out->reading.origin = origin_from_string(origin, origin_len);
+        }
+    } else if (cmd_field_equals(key, key_len, "seq")) {
+        field = CMD_FIELD_SEQ;
+        skip_ws(s);
+        ok = parse_uint32(s, &out->seq.seq);
+        out->seq.has_seq = ok;
+    } else if (cmd_field_equals(key, key_len, "ts")) {
+        field = CMD_FIELD_TS;
+        skip_ws(s);
+        ok = parse_uint32(s, &out->seq.sender_ms);
+        out->seq.has_ts = ok;
+    } else if (cmd_field_equals(key, key_len, "before") && nesting == 0) {
+        field = CMD_FIELD_BEFORE;
+        skip_ws(s);
+        ok = parse_uint32(s, &out->before);
+    } else if (cmd_field_equals(key, key_len, "from") && nesting == 0) {
+        field = CMD_FIELD_FROM;
+        skip_ws(s);
+        ok = parse_uint32(s, &out->from);
+    } else if (cmd_field_equals(key, key_len, "channel")) {
+        float channel;
+        field = CMD_FIELD_CHANNEL;
+        skip_ws(s);
+        ok = parse_number(s, &channel);
+        if (ok && (channel < 0.0f || channel > 255.0f || channel != (float)(uint8_t)channel)) {
+            // Never fall back to channel 0 for a bad channel number
+            return false;
+        }
+        if (ok) {
+            out->channel = (uint8_t)channel;
+        }
+    } else {
+        return skip_value(s);
+    }
+
+    if (ok) {
+        out->fields |= field;
+        if (field & (CMD_FIELD_PRESENCE | CMD_FIELD_MOTION)) {
+            out->reading.has |= SENSOR_HAS_OCCUPANCY;
+        } else if (field == CMD_FIELD_TEMPERATURE) {
+            out->reading.has |= SENSOR_HAS_TEMPERATURE;
+        } else if (field == CMD_FIELD_LUX) {
+            out->reading.has |= SENSOR_HAS_LUX;
+        }
+        return true;
+    }
+    // A key with a value of the wrong type is treated like a missing key
+    return skip_value(s);
+}
+
+/* Returns 0 on success, -1 on malformed input */
+static int parse_object(scanner_t *s, udp_command_t *out, int nesting)
+{
+    if (!consume(s, '{')) {
+        return -1;
+    }
+    if (consume(s, '}')) {
+        return 0;
+    }
+
+    do {
+        char *key;
+        size_t key_len;
+        bool escaped;
+
+        skip_ws(s);
+        if (!scan_string(s, &key, &key_len, &escaped) || !consume(s, ':')) {
+            return -1;
+        }
+        if (!parse_member(s, key, key_len, out, nesting)) {
+            return -1;
+        }
+    } while (consume(s, ','));
+
+    return consume(s, '}') ? 0 : -1;
+}
+
+/* ---------------- Public API ---------------- */
+bool cmd_field_equals(const char *field, size_t field_len, const char *expected)
+{
+    size_t expected_len = strlen(expected);
+    return field != NULL && field_len == expected_len && memcmp(field, expected, field_len) == 0;
+}
+
+bool cmd_parse_udp_packet(char *buf, size_t len, udp_command_t *out)
+{
+    if (buf == NULL || out == NULL) {
+        return false;
+    }
+
+    memset(out, 0, sizeof(*out));
+    scanner_t s = { .pos = buf, .end = buf + len };
+
+    if (parse_object(&s, out, 0) != 0) {
+        return false;
+    }
+
+    if (out->fields & CMD_FIELD_CMD) {
+        return true;
+    }
+    return (out->fields & CMD_FIELD_SOURCE) &&
+           (out->fields & CMD_FIELD_DEVICE_ID) &&
+           (out->fields & CMD_FIELD_SENSOR_MASK);
+}
@@ -0,0 +1,385 @@
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "esp_rom_crc.h"
+#include "nvs.h"
+#include "config_store.h"
+
+static const char *TAG = "CONFIG";
+
+/* NVS blob: 8-byte header (magic, version, payload length, CRC32 of the payload), then the fields */
+#define BLOB_MAGIC       0x43        // 'C'
+#define BLOB_VERSION     3
+#define BLOB_HEADER_LEN  8
+#define BLOB_V1_LEN      (sizeof(((device_config_t *)0)->ssid) + \
+                          sizeof(((device_config_t *)0)->password) + \
+                          sizeof(((device_config_t *)0)->device_id) + \
+                          sizeof(((device_config_t *)0)->presence_state) + 1 + 2)
+#define BLOB_V2_LEN      (BLOB_V1_LEN + 1)    // v2 adds the power-on policy
+#define BLOB_PAYLOAD_LEN (BLOB_V2_LEN + 8)    // v3 adds the cached AP (BSSID, channel, auth mode)
+#define BLOB_MAX_LEN     (BLOB_HEADER_LEN + BLOB_PAYLOAD_LEN)
+
+static device_config_t config;
+static uint32_t dirty = 0;
+static SemaphoreHandle_t config_lock = NULL;
+
+/* Deferred saving */
+static TaskHandle_t writer_task = NULL;
+static int64_t save_first_us = 0;        // first pending request, 0 if none
+static uint32_t save_pending = 0;        // requests since the last flush
+static config_store_stats_t stats;
+
+/* ---------------- Blob encoding ---------------- */
+static uint8_t *put_str(uint8_t *p, const char *s, size_t size)
+{
+    memset(p, 0, size);
+    strlcpy((char *)p, s, size);
+    return p + size;
+}
+
+static const uint8_t *get_str(const uint8_t *p, char *s, size_t size)
+{
+    memcpy(s, p, size);
+    s[size - 1] = '\0';
+    return p + size;
+}
+
+static size_t config_encode(const device_config_t *cfg, uint8_t *blob)
+{
+    uint8_t *p = blob + BLOB_HEADER_LEN;
+    p = put_str(p, cfg->ssid, sizeof(cfg->ssid));
+    p = put_str(p, cfg->password, sizeof(cfg->password));
+    p = put_str(p, cfg->device_id, sizeof(cfg->device_id));
+    p = put_str(p, cfg->presence_state, sizeof(cfg->presence_state));
+    *p++ = (uint8_t)cfg->temperature_threshold;
+    *p++ = cfg->lux_threshold & 0xFF;
+    *p++ = cfg->lux_threshold >> 8;
+    *p++ = cfg->power_on;
+    memcpy(p, cfg->ap_bssid, sizeof(cfg->ap_bssid));
+    p += sizeof(cfg->ap_bssid);
+    *p++ = cfg->ap_channel;
+    *p++ = cfg->ap_authmode;
+
+    uint16_t payload_len = p - blob - BLOB_HEADER_LEN;
+    uint32_t crc = esp_rom_crc32_le(0, blob + BLOB_HEADER_LEN, payload_len);
+    blob[0] = BLOB_MAGIC;
+    blob[1] = BLOB_VERSION;
+    blob[2] = payload_len & 0xFF;
+    blob[3] = payload_len >> 8;
+    memcpy(&blob[4], &crc, 4);
+    return p - blob;
+}
+
+static bool config_decode(const uint8_t *blob, size_t len, device_config_t *cfg, bool *migrated)
+{
+    if (len < BLOB_HEADER_LEN || blob[0] != BLOB_MAGIC) {
+        ESP_LOGW(TAG, "Settings blob has a bad header");
+        return false;
+    }
+    uint16_t payload_len = blob[2] | (blob[3] << 8);
+    uint32_t crc;
+    memcpy(&crc, &blob[4], 4);
+    if (payload_len != len - BLOB_HEADER_LEN ||
+        esp_rom_crc32_le(0, blob + BLOB_HEADER_LEN, payload_len) != crc) {
+        ESP_LOGW(TAG, "Settings blob failed its CRC check");
+        return false;
+    }
+
+    // Each version extends the previous layout; fields it lacks keep their defaults
+    uint8_t version = blob[1];
+    size_t expected = (version == 1) ? BLOB_V1_LEN : (version == 2) ? BLOB_V2_LEN :
+                      (version == 3) ? BLOB_PAYLOAD_LEN : 0;
+    if (expected == 0 || payload_len != expected) {
+        ESP_LOGW(TAG, "Settings blob version %u is not supported", version);
+        return false;
+    }
+
+    const uint8_t *p = blob + BLOB_HEADER_LEN;
+    p = get_str(p, cfg->ssid, sizeof(cfg->ssid));
+    p = get_str(p, cfg->password, sizeof(cfg->password));
+    p = get_str(p, cfg->device_id, sizeof(cfg->device_id));
+    p = get_str(p, cfg->presence_state, sizeof(cfg->presence_state));
+    cfg->temperature_threshold = (int8_t)p[0];
+    cfg->lux_threshold = p[1] | (p[2] << 8);
+    if (version >= 2 && p[3] < CONFIG_POWER_ON_COUNT) {
+        cfg->power_on = p[3];
+    }
+    if (version >= 3) {
+        memcpy(cfg->ap_bssid, &p[4], sizeof(cfg->ap_bssid));
+        cfg->ap_channel = p[10];
+        cfg->ap_authmode = p[11];
+    }
+    *migrated = (version != BLOB_VERSION);
+    return true;
+}
+
+static void config_defaults(device_config_t *cfg)
+{
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->power_on = CONFIG_POWER_ON_RESTORE;
+}
+
+/* ---------------- Legacy migration ---------------- */
+static void config_import_legacy(device_config_t *cfg)
+{
+    // Older firmware stored one NVS key per setting; the keys are left in place
+    char ssid[100] = {0}, password[100] = {0}, device_id[32] = {0}, presence[10] = {0};
+    int8_t temperature = 0;
+    uint16_t lux = 0;
+
+    nvs_read_wifi_credentials(ssid, password, device_id, &temperature, presence, &lux);
+    strlcpy(cfg->ssid, ssid, sizeof(cfg->ssid));
+    strlcpy(cfg->password, password, sizeof(cfg->password));
+    strlcpy(cfg->device_id, device_id, sizeof(cfg->device_id));
+    strlcpy(cfg->presence_state, presence, sizeof(cfg->presence_state));
+    cfg->temperature_threshold = temperature;
+    cfg->lux_threshold = lux;
+}
+
+/* ---------------- Persistence ---------------- */
+// Write the blob if any field is dirty; *wrote tells whether flash was touched
+static esp_err_t config_commit(bool *wrote)
+{
+    uint8_t blob[BLOB_MAX_LEN];
+
+    *wrote = false;
+    xSemaphoreTake(config_lock, portMAX_DELAY);
+    uint32_t fields = dirty;
+    size_t len = config_encode(&config, blob);
+    dirty = 0;
+    xSemaphoreGive(config_lock);
+
+    if (fields == 0) {
+        return ESP_OK;
+    }
+    esp_err_t err = nvs_store_config(blob, len);
+    if (err != ESP_OK) {
+        // Keep the fields dirty so the next commit retries them
+        xSemaphoreTake(config_lock, portMAX_DELAY);
+        dirty |= fields;
+        xSemaphoreGive(config_lock);
+        return err;
+    }
+    xSemaphoreTake(config_lock, portMAX_DELAY);
+    stats.flash_writes++;
+    xSemaphoreGive(config_lock);
+    *wrote = true;
+    ESP_LOGI(TAG, "Settings stored (changed fields 0x%02lx)", (unsigned long)fields);
+    return ESP_OK;
+}
+
+/* ---------------- Background writer ---------------- */
+static void config_writer_task(void *pvParameter)
+{
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        // Wait for CONFIG_SAVE_DEBOUNCE_MS without a new request, but not past the cap
+        for (;;) {
+            xSemaphoreTake(config_lock, portMAX_DELAY);
+            int64_t first_us = save_first_us;
+            xSemaphoreGive(config_lock);
+            if (first_us == 0) {
+                break;                   // flushed by someone else meanwhile
+            }
+            int64_t left_ms = CONFIG_SAVE_MAX_DELAY_MS - (esp_timer_get_time() - first_us) / 1000;
+            if (left_ms <= 0) {
+                break;
+            }
+            TickType_t wait = pdMS_TO_TICKS(left_ms < CONFIG_SAVE_DEBOUNCE_MS ? left_ms : CONFIG_SAVE_DEBOUNCE_MS);
+            if (ulTaskNotifyTake(pdTRUE, wait) == 0) {
+                break;
+            }
+        }
+        config_store_flush();
+    }
+}
+
+/* ---------------- Public API ---------------- */
+esp_err_t config_store_init(void)
+{
+    if (config_lock == NULL) {
+        config_lock = xSemaphoreCreateMutex();
+        if (config_lock == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    uint8_t blob[BLOB_MAX_LEN];
+    size_t len = sizeof(blob);
+    bool migrated = false;
+    config_defaults(&config);
+    esp_err_t err = nvs_load_config(blob, &len);
+    if (err == ESP_OK && config_decode(blob, len, &config, &migrated)) {
+        ESP_LOGI(TAG, "Settings loaded (SSID '%s', device ID '%s')", config.ssid, config.device_id);
+        // An older layout is rewritten in the current one
+        dirty = migrated ? CONFIG_FIELD_ALL : 0;
+    } else {
+        ESP_LOGI(TAG, "No valid settings blob, importing per-key settings");
+        config_defaults(&config);
+        config_import_legacy(&config);
+        dirty = CONFIG_FIELD_ALL;
+    }
+    bool wrote;
+    err = config_commit(&wrote);
+
+    if (writer_task == NULL &&
+        xTaskCreate(config_writer_task, "config_writer", 3072, NULL, 2, &writer_task) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create settings writer task, saving synchronously");
+    }
+    return err;
+}
+
+void config_store_get(device_config_t *out)
+{
+    xSemaphoreTake(config_lock, portMAX_DELAY);
+    *out = config;
+    xSemaphoreGive(config_lock);
+}
+
+static void config_set_str(uint32_t field, char *dst, size_t size, const char *value)
+{
+    if (value == NULL) {
+        return;
+    }
+    xSemaphoreTake(config_lock, portMAX_DELAY);
+    if (strncmp(dst, value, size - 1) != 0) {
+        strlcpy(dst, value, size);
+        dirty |= field;
+    }
+    xSemaphoreGive(config_lock);
+}
+
+void config_store_set_wifi(const char *ssid, const char *password)
+{
+    xSemaphoreTake(config_lock, portMAX_DELAY);
+    bool new_network = ssid != NULL && strncmp(config.ssid, ssid, sizeof(config.ssid) - 1) != 0;
+    xSemaphoreGive(config_lock);
+
+    config_set_str(CONFIG_FIELD_SSID, config.ssid, sizeof(config.ssid), ssid);
+    if (new_network) {
+        // The cached AP belonged to the old network
+        config_store_set_ap(NULL, 0, 0);
+    }
+    config_set_str(CONFIG_FIELD_PASSWORD, config.password, sizeof(config.password), password);
+}
+
+void config_store_set_device_id(const char *device_id)
+{
+    config_set_str(CONFIG_FIELD_DEVICE_ID, config.device_id, sizeof(config.device_id), device_id);
+}
+
+void config_store_set_presence_state(const char *state)
+{
+    config_set_str(CONFIG_FIELD_PRESENCE, config.presence_state, sizeof(config.presence_state), state);
+}
+
+void config_store_set_temperature(int8_t threshold)
+{
+    xSemaphoreTake(config_lock, portMAX_DELAY);
+    if (config.temperature_threshold != threshold) {
+        config.temperature_threshold = threshold;
+        dirty |= CONFIG_FIELD_TEMPERATURE;
+    }
+    xSemaphoreGive(config_lock);
+}
+
+void config_store_set_lux(uint16_t threshold)
+{
+    xSemaphoreTake(config_lock, portMAX_DELAY);
+    if (config.lux_threshold != threshold) {
+        config.lux_threshold = threshold;
+        dirty |= CONFIG_FIELD_LUX;
+    }
+    xSemaphoreGive(config_lock);
+}
+
+void config_store_set_power_on(config_power_on_t policy)
+{
+    if (policy >= CONFIG_POWER_ON_COUNT) {
+        return;
+    }
+    xSemaphoreTake(config_lock, portMAX_DELAY);
+    if (config.power_on != policy) {
+        config.power_on = policy;
+        dirty |= CONFIG_FIELD_POWER_ON;
+    }
+    xSemaphoreGive(config_lock);
+}
+
+void config_store_set_ap(const uint8_t bssid[6], uint8_t channel, uint8_t authmode)
+{
+    static const uint8_t none[6] = {0};
+    if (channel == 0) {
+        bssid = none;
+        authmode = 0;
+    }
+    xSemaphoreTake(config_lock, portMAX_DELAY);
+    if (memcmp(config.ap_bssid, bssid, sizeof(config.ap_bssid)) != 0 ||
+        config.ap_channel != channel || config.ap_authmode != authmode) {
+        memcpy(config.ap_bssid, bssid, sizeof(config.ap_bssid));
+        config.ap_channel = channel;
+        config.ap_authmode = authmode;
+        dirty |= CONFIG_FIELD_AP;
+    }
+    xSemaphoreGive(config_lock);
+}
+
+uint32_t config_store_dirty(void)
+{
+    return dirty;
+}
+
+void config_store_save_later(void)
+{
+    xSemaphoreTake(config_lock, portMAX_DELAY);
+    stats.save_requests++;
+    save_pending++;
+    if (save_first_us == 0) {
+        save_first_us = esp_timer_get_time();
+    }
+    xSemaphoreGive(config_lock);
+
+    if (writer_task != NULL) {
+        xTaskNotifyGive(writer_task);
+    } else {
+        config_store_flush();
+    }
+}
+
+esp_err_t config_store_flush(void)
+{
+    xSemaphoreTake(config_lock, portMAX_DELAY);
+    uint32_t requests = save_pending;
+    save_pending = 0;
+    save_first_us = 0;
+    xSemaphoreGive(config_lock);
+
+    bool wrote;
+    esp_err_t err = config_commit(&wrote);
+
+    // Without deferral, every request would have been a write of its own
+    if (err == ESP_OK && requests > (wrote ? 1 : 0)) {
+        xSemaphoreTake(config_lock, portMAX_DELAY);
+        stats.writes_saved += requests - (wrote ? 1 : 0);
+        xSemaphoreGive(config_lock);
+    }
+    return err;
+}
+
+void config_store_get_stats(config_store_stats_t *out)
+{
+    xSemaphoreTake(config_lock, portMAX_DELAY);
+    *out = stats;
+    xSemaphoreGive(config_lock);
+}
+
+void config_store_reset_stats(void)
+{
+    xSemaphoreTake(config_lock, portMAX_DELAY);
+    memset(&stats, 0, sizeof(stats));
+    xSemaphoreGive(config_lock);
+}
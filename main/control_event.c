@@ -0,0 +1,77 @@
+#include "control_event.h"
+
+void ctrl_ring_init(ctrl_ring_t *ring)
+{
+    for (unsigned int i = 0; i < CTRL_RING_SIZE; i++) {
+        atomic_init(&ring->cells[i].seq, i);
+    }
+    atomic_init(&ring->head, 0);
+    ring->tail = 0;
+}
+
+bool ctrl_ring_push(ctrl_ring_t *ring, const ctrl_event_t *event, unsigned int headroom)
+{
+    unsigned int pos = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    ctrl_ring_cell_t *cell;
+
+    for (;;) {
+        cell = &ring->cells[pos & CTRL_RING_MASK];
+        unsigned int seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+        int diff = (int)(seq - pos);
+
+        if (diff == 0) {
+            if (headroom > 0) {
+                // The cell `headroom` ahead must be free too, or the reserve is in use
+                unsigned int ahead = pos + headroom;
+                unsigned int ahead_seq = atomic_load_explicit(&ring->cells[ahead & CTRL_RING_MASK].seq,
+                                                              memory_order_acquire);
+                if ((int)(ahead_seq - ahead) < 0) {
+                    return false;
+                }
+            }
+            // Cell is free for this lap: claim it
+            if (atomic_compare_exchange_weak_explicit(&ring->head, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // Consumer has not released this cell yet: ring is full
+            return false;
+        } else {
+            // Another producer claimed it first
+            pos = atomic_load_explicit(&ring->head, memory_order_relaxed);
+        }
+    }
+
+    cell->event = *event;
+    atomic_store_explicit(&cell->seq, pos + 1, memory_order_release);
+    return true;
+}
+
+bool ctrl_ring_pop(ctrl_ring_t *ring, ctrl_event_t *event)
+{
+    unsigned int pos = ring->tail;
+    ctrl_ring_cell_t *cell = &ring->cells[pos & CTRL_RING_MASK];
+    unsigned int seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+
+    if ((int)(seq - (pos + 1)) < 0) {
+        // Not published yet (empty, or a producer is mid-write)
+        return false;
+    }
+
+    *event = cell->event;
+    atomic_store_explicit(&cell->seq, pos + CTRL_RING_SIZE, memory_order_release);
+    ring->tail = pos + 1;
+    return true;
+}
+
+const char *ctrl_event_type_name(ctrl_event_type_t type)
+{
+    switch (type) {
+        case CTRL_EVT_BUTTON:   return "button";
+        case CTRL_EVT_SENSOR:   return "sensor";
+        case CTRL_EVT_TIMER:    return "timer";
+        case CTRL_EVT_OVERRIDE: return "override";
+        default:                return "unknown";
+    }
+}
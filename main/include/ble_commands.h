@@ -0,0 +1,13 @@
+#ifndef BLE_COMMANDS_H
+#define BLE_COMMANDS_H
+
+#include <stddef.h>
+
+/*
+ * JSON commands written to characteristic A ({"cmd": ...}). Replies go out
+ * through ble_client_send. Kept apart from the GATT plumbing in bluetooth.c
+ * so the simulation build can drive the same handlers.
+ */
+void ble_command_dispatch(const char *data, size_t len);
+
+#endif /* BLE_COMMANDS_H */
@@ -0,0 +1,116 @@
+#ifndef BLE_FRAME_H
+#define BLE_FRAME_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Splitting BLE replies into notifications the negotiated MTU can carry,
+ * and putting them back together on the receiving side.
+ *
+ * A payload that fits in one notification and starts with a byte below
+ * 0x80 (every JSON reply does) is sent as is, so short replies look the
+ * same as before. Anything else is split into fragments that start with a
+ * one-byte header:
+ *
+ *   bit 7     always 1: marks a fragment
+ *   bit 6     first fragment; a little-endian uint16 total length follows
+ *   bit 5     last fragment
+ *   bits 0-4  first fragment: message id; later ones: fragment index
+ *             (1, 2, ... modulo 32), so a lost or reordered one shows
+ *
+ * Plain C with no ESP-IDF dependencies; the reassembler is what an app
+ * (or a host test) runs on the notifications it receives.
+ *
+ * The other direction, a long write from the app, arrives as ATT prepared
+ * writes; ble_prep_t collects them into a caller-owned arena.
+ */
+
+#define BLE_FRAME_FLAG_FRAGMENT 0x80
+#define BLE_FRAME_FLAG_FIRST    0x40
+#define BLE_FRAME_FLAG_LAST     0x20
+#define BLE_FRAME_ID_MASK       0x1F
+#define BLE_FRAME_FIRST_HDR_LEN 3            // header byte and total length
+#define BLE_FRAME_MIN_CHUNK     4            // smallest notification payload accepted (MTU 23 gives 20)
+#define BLE_FRAME_MAX_MESSAGE   0xFFFF       // limit of the length field
+
+typedef struct {
+    const uint8_t *data;
+    size_t len;
+    size_t offset;               // next payload byte to send
+    size_t chunk;                // notification payload size (MTU - 3)
+    uint8_t id;
+    uint8_t index;               // of the next fragment, 0 for the first
+    bool framed;
+    bool done;
+} ble_frag_t;
+
+// Split len bytes of data into notifications of at most chunk bytes; data must outlive the split
+void ble_frag_begin(ble_frag_t *frag, const void *data, size_t len, size_t chunk, uint8_t id);
+
+/*
+ * Next notification: *out points into data when the payload goes unframed,
+ * else into scratch (at least chunk bytes). Returns its length, 0 when done.
+ */
+size_t ble_frag_next(ble_frag_t *frag, uint8_t *scratch, const uint8_t **out);
+
+typedef struct {
+    uint8_t *buf;
+    size_t cap;
+    size_t len;                  // bytes collected so far
+    size_t expected;             // total length from the first fragment
+    uint8_t id;                  // of the message in progress
+    uint8_t next;                // index of the fragment expected next
+    bool active;                 // a fragmented message is in progress
+    uint32_t errors;             // fragments dropped (lost, out of order, too long)
+} ble_reasm_t;
+
+void ble_reasm_init(ble_reasm_t *reasm, uint8_t *buf, size_t cap);
+
+/*
+ * Feed one notification. Returns the message length once it is complete (the
+ * message is in buf), 0 while more fragments are needed, -1 if the
+ * notification was dropped and counted in errors.
+ */
+int ble_reasm_feed(ble_reasm_t *reasm, const uint8_t *data, size_t len);
+
+/* ---------------- Prepared writes ---------------- */
+typedef enum {
+    BLE_PREP_OK = 0,
+    BLE_PREP_BAD_OFFSET,         // would leave a gap in the value
+    BLE_PREP_TOO_LONG,           // does not fit in the arena
+    BLE_PREP_OTHER_HANDLE,       // one long write at a time
+    BLE_PREP_BUSY,               // the previous value has not been handled yet
+} ble_prep_status_t;
+
+typedef struct {
+    uint8_t *buf;                // cap + 1 bytes: the value is NUL-terminated on take
+    size_t cap;
+    size_t len;
+    uint16_t handle;             // attribute being written, 0 when idle
+    bool failed;                 // a fragment was rejected; the write is discarded
+    volatile bool held;          // a taken value is still in use; released by its consumer
+} ble_prep_t;
+
+void ble_prep_init(ble_prep_t *prep, uint8_t *buf, size_t cap);
+
+// Copy one prepared write fragment into the arena
+ble_prep_status_t ble_prep_write(ble_prep_t *prep, uint16_t handle, size_t offset,
+                                 const uint8_t *data, size_t len);
+
+/*
+ * On execute: the complete value (NUL-terminated, in buf) and its handle.
+ * Returns its length, or 0 if there is none or a fragment was rejected.
+ * A value that is returned holds the arena, and new writes are refused,
+ * until ble_prep_release().
+ */
+size_t ble_prep_take(ble_prep_t *prep, uint16_t *handle);
+
+// The taken value has been handled; may be called from another task
+void ble_prep_release(ble_prep_t *prep);
+
+// Drop a write in progress (cancelled, or the link went down); a held value stays held
+void ble_prep_reset(ble_prep_t *prep);
+
+#endif /* BLE_FRAME_H */
@@ -5,15 +5,21 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/event_groups.h"
 #include "esp_gatts_api.h"
+#include "scan_cache.h"
 
 //macro definitions
 #define PROFILE_NUM                 1
 #define PROFILE_APP_IDX             0
 #define SVC_INST_ID                 0
 
-// Maximum characteristic value length
-#define GATTS_DEMO_CHAR_VAL_LEN_MAX 1024
-#define PREPARE_BUF_MAX_SIZE        1024
+// Longest value a prepared (long) write can carry, e.g. a whole rule table; override at build time
+#ifndef BLE_WRITE_ARENA_SIZE
+#define BLE_WRITE_ARENA_SIZE        4096
+#endif
+
+// Maximum characteristic value length: the ATT limit. Longer commands are collected in the
+// write arena by the app (the A/B values are ESP_GATT_RSP_BY_APP), not by the stack
+#define GATTS_DEMO_CHAR_VAL_LEN_MAX 512
 #define CHAR_DECLARATION_SIZE       (sizeof(uint8_t))
 
 #define adv_config_flag      (1 << 0)
@@ -30,10 +36,6 @@ typedef struct {
     esp_gatt_if_t gatts_if;
     uint16_t conn_id;
 } scan_task_params_t;
-typedef struct {
-    uint8_t                 *prepare_buf;
-    int                     prepare_len;
-} prepare_type_env_t;
 
 // Global variables - declare as extern
 extern volatile bool wifi_creds_ready;
@@ -48,11 +50,15 @@ esp_err_t bluetooth_init(void);
 void bluetooth_start_advertising(void);
 void bluetooth_stop_advertising(void);
 // void nvs_read_wifi_credentials(char *read_ssid, char *read_password, char *read_device_id, int8_t *temperature_value, char *read_presence_state);
-void store_wifi_credentials_to_nvs(void);
 void wifi_init_sta(void);
 void scan_wifi_networks(char* response);
+// Scan channel by channel, or replay the cache (channel 0) if it is fresh; *cached tells which
+esp_err_t wifi_scan_stream(scan_found_t found, void *ctx, bool *cached, int *networks);
+void wifi_cache_current_ap(void);
 void wifi_scan_callback_task(void *pvParameters);
 void connect_wifi_with_new_credentials_task(void);      //*pvParameters
+// Notify the app; payloads larger than the MTU are split as described in ble_frame.h
+esp_err_t ble_send(const void *data, size_t len);
 void ble_client_send(char *data);
 bool check_device_id(const char* received_device_id);
 void send_device_verification_response(bool is_verified);
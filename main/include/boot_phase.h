@@ -0,0 +1,36 @@
+#ifndef BOOT_PHASE_H
+#define BOOT_PHASE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Boot timeline: the esp_timer time at which each subsystem became ready,
+ * so boot-to-ready can be tracked across firmware versions. Each phase keeps
+ * its first mark; marking is a single 32-bit store and safe from any task.
+ * Reported by {"cmd":"boot"} over UDP and BLE.
+ */
+
+typedef enum {
+    BOOT_PHASE_APP = 0,          // app_main entered
+    BOOT_PHASE_STORAGE,          // NVS, settings, journal and usage loaded
+    BOOT_PHASE_RELAYS,           // relays driven to their power-on state
+    BOOT_PHASE_CONTROL,          // control loop and buttons live
+    BOOT_PHASE_WIFI_START,       // Wi-Fi driver started, association under way
+    BOOT_PHASE_UDP,              // UDP listener bound
+    BOOT_PHASE_BLE,              // BLE stack up and advertising
+    BOOT_PHASE_WIFI_IP,          // first IP address
+    BOOT_PHASE_COUNT,
+} boot_phase_t;
+
+void boot_phase_mark(boot_phase_t phase);
+
+// Milliseconds since esp_timer start, 0 if the phase has not been reached
+uint32_t boot_phase_ms(boot_phase_t phase);
+
+const char *boot_phase_name(boot_phase_t phase);
+
+// {"boot":{"app":312,...}} with the phases reached so far; returns the length written
+int boot_phase_format(char *buf, size_t size);
+
+#endif /* BOOT_PHASE_H */
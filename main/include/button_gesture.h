@@ -0,0 +1,60 @@
+#ifndef BUTTON_GESTURE_H
+#define BUTTON_GESTURE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Debounce and gesture recognition for one push button, driven by
+ * timestamped edges captured in the GPIO ISR.
+ *
+ * The first edge that changes the debounced level is acted on at once;
+ * edges within BUTTON_DEBOUNCE_US after it are treated as bounce. If the
+ * raw level still differs when that window ends, the change is applied
+ * then, so short glitches cannot leave the state stuck. On top of the
+ * debounced level, presses are classified as single, double or long.
+ *
+ * Plain C with no ESP-IDF dependencies: feed it synthetic edge traces on
+ * the host to test it.
+ */
+
+#define BUTTON_DEBOUNCE_US      30000       // bounce window after an accepted edge
+#define BUTTON_DOUBLE_WINDOW_US 400000      // release to second press for a double press
+#define BUTTON_LONG_PRESS_US    3000000     // hold time for a long press
+
+// Events returned as a bit mask by button_gesture_edge() and button_gesture_poll()
+#define BUTTON_EVT_PRESS   (1u << 0)   // debounced press, reported immediately
+#define BUTTON_EVT_RELEASE (1u << 1)
+#define BUTTON_EVT_SINGLE  (1u << 2)   // one short press, no second press followed
+#define BUTTON_EVT_DOUBLE  (1u << 3)   // two short presses within the double window
+#define BUTTON_EVT_LONG    (1u << 4)   // held for BUTTON_LONG_PRESS_US (reported while held)
+
+typedef enum {
+    BUTTON_IDLE = 0,
+    BUTTON_DOWN,                 // pressed, not yet long
+    BUTTON_DOWN_LONG,            // long press reported, waiting for release
+    BUTTON_WAIT_SECOND,          // released after one short press
+} button_state_t;
+
+typedef struct {
+    button_state_t state;
+    bool pressed;                // debounced level
+    bool raw_pressed;            // level after the most recent edge
+    uint8_t clicks;              // presses in the current gesture
+    int64_t settle_us;           // edges before this time are bounce
+    int64_t press_us;            // time of the last accepted press
+    int64_t release_us;          // time of the last accepted release
+} button_gesture_t;
+
+void button_gesture_init(button_gesture_t *button, bool pressed);
+
+// Feed one edge; `pressed` is the pin level sampled with it
+uint32_t button_gesture_edge(button_gesture_t *button, bool pressed, int64_t time_us);
+
+// Advance time without an edge (settling, long press, double-press timeout)
+uint32_t button_gesture_poll(button_gesture_t *button, int64_t now_us);
+
+// Time at which button_gesture_poll() next has work to do, or 0 if none
+int64_t button_gesture_deadline(const button_gesture_t *button);
+
+#endif /* BUTTON_GESTURE_H */
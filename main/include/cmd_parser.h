@@ -0,0 +1,60 @@
+#ifndef CMD_PARSER_H
+#define CMD_PARSER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "sensor_data.h"
+
+// Bits set in udp_command_t.fields for every key that was found
+#define CMD_FIELD_COMMAND     (1u << 0)
+#define CMD_FIELD_SOURCE      (1u << 1)
+#define CMD_FIELD_DEVICE_ID   (1u << 2)
+#define CMD_FIELD_PRESENCE    (1u << 3)
+#define CMD_FIELD_MOTION      (1u << 4)
+#define CMD_FIELD_TEMPERATURE (1u << 5)
+#define CMD_FIELD_LUX         (1u << 6)
+#define CMD_FIELD_ORIGIN      (1u << 7)
+#define CMD_FIELD_CHANNEL     (1u << 8)
+#define CMD_FIELD_CMD         (1u << 9)
+#define CMD_FIELD_SEQ         (1u << 10)
+#define CMD_FIELD_TS          (1u << 11)
+#define CMD_FIELD_BEFORE      (1u << 12)
+#define CMD_FIELD_FROM        (1u << 13)
+
+#define CMD_FIELD_SENSOR_MASK (CMD_FIELD_PRESENCE | CMD_FIELD_MOTION | CMD_FIELD_TEMPERATURE | CMD_FIELD_LUX)
+
+// Result of parsing one UDP datagram. String fields point into the
+// receive buffer (no copies) and are NOT NUL-terminated.
+typedef struct {
+    const char *source;
+    size_t source_len;
+    const char *device_id;
+    size_t device_id_len;
+    const char *cmd;             // control request such as "stats", instead of sensor data
+    size_t cmd_len;
+    uint8_t channel;             // relay channel, 0 when the key is absent
+    sensor_reading_t reading;
+    sensor_seq_t seq;            // "seq" and "ts", both optional
+    uint32_t before;             // "before": paging cursor of a "history" request
+    uint32_t from;               // "from": paging cursor of a "trace" request
+    uint32_t fields;
+} udp_command_t;
+
+/*
+ * Parse a sensor command in a single pass without heap allocation.
+ *
+ * Accepts both the nested form, where "command" holds the sensor JSON as an
+ * escaped string (or as an object), and the flat form with the sensor keys
+ * at the top level. The buffer is modified in place (escaped strings are
+ * decoded where they lie) and must stay alive while `out` is used.
+ *
+ * Returns true if the packet is well-formed and either carries source,
+ * device_id and at least one sensor field, or is a request with a "cmd" key.
+ */
+bool cmd_parse_udp_packet(char *buf, size_t len, udp_command_t *out);
+
+// Compare a parsed (non-terminated) string field against a C string
+bool cmd_field_equals(const char *field, size_t field_len, const char *expected);
+
+#endif /* CMD_PARSER_H */
@@ -0,0 +1,91 @@
+#ifndef CONFIG_STORE_H
+#define CONFIG_STORE_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+/*
+ * Device settings, loaded once at boot and served from RAM.
+ *
+ * The settings live in NVS as one versioned blob with a CRC32, so boot
+ * reads a single key instead of two nvs_get_* calls per setting. Setters
+ * update the RAM copy and mark the fields that actually changed. Saving is
+ * deferred to a background writer that waits for the changes to settle, so
+ * a burst of updates costs one flash write, and skips the write entirely
+ * when nothing is dirty. If there is no valid blob, the per-key entries
+ * written by older firmware are imported once.
+ */
+
+#define CONFIG_SSID_MAX     32
+#define CONFIG_PASSWORD_MAX 64
+
+#define CONFIG_SAVE_DEBOUNCE_MS  2000    // quiet time before a deferred save is written
+#define CONFIG_SAVE_MAX_DELAY_MS 10000   // upper bound from the first request to the write
+
+// Relay state applied at power-on, before the radios start
+typedef enum {
+    CONFIG_POWER_ON_OFF = 0,
+    CONFIG_POWER_ON_ON,
+    CONFIG_POWER_ON_RESTORE,     // last state in the relay journal, OFF if there is none
+    CONFIG_POWER_ON_COUNT,
+} config_power_on_t;
+
+typedef struct {
+    char ssid[CONFIG_SSID_MAX + 1];
+    char password[CONFIG_PASSWORD_MAX + 1];
+    char device_id[32];          // sensor bound to channel 0
+    char presence_state[10];     // switch mode, "ON"/"OFF"/"AUTO"
+    int8_t temperature_threshold;
+    uint16_t lux_threshold;
+    uint8_t power_on;            // config_power_on_t
+    uint8_t ap_bssid[6];         // AP of the last successful connect to `ssid`
+    uint8_t ap_channel;          // 0 if no AP is cached
+    uint8_t ap_authmode;         // wifi_auth_mode_t
+} device_config_t;
+
+// Dirty mask bits, one per field
+#define CONFIG_FIELD_SSID        (1u << 0)
+#define CONFIG_FIELD_PASSWORD    (1u << 1)
+#define CONFIG_FIELD_DEVICE_ID   (1u << 2)
+#define CONFIG_FIELD_PRESENCE    (1u << 3)
+#define CONFIG_FIELD_TEMPERATURE (1u << 4)
+#define CONFIG_FIELD_LUX         (1u << 5)
+#define CONFIG_FIELD_POWER_ON    (1u << 6)
+#define CONFIG_FIELD_AP          (1u << 7)
+#define CONFIG_FIELD_ALL         0xFFu
+
+typedef struct {
+    uint32_t save_requests;      // config_store_save_later() calls
+    uint32_t flash_writes;       // blobs written
+    uint32_t writes_saved;       // requests that did not need a write of their own
+} config_store_stats_t;
+
+// Call once after nvs_init(); migrates legacy keys if needed and starts the writer
+esp_err_t config_store_init(void);
+
+// Copy of the current settings
+void config_store_get(device_config_t *config);
+
+// RAM only; a value equal to the current one leaves the field clean
+// A new SSID also forgets the cached AP
+void config_store_set_wifi(const char *ssid, const char *password);
+void config_store_set_device_id(const char *device_id);
+void config_store_set_presence_state(const char *state);
+void config_store_set_temperature(int8_t threshold);
+void config_store_set_lux(uint16_t threshold);
+void config_store_set_power_on(config_power_on_t policy);
+// Remember the AP to connect to directly next time; channel 0 forgets it
+void config_store_set_ap(const uint8_t bssid[6], uint8_t channel, uint8_t authmode);
+
+uint32_t config_store_dirty(void);
+
+// Ask the background writer to persist dirty fields once changes settle
+void config_store_save_later(void);
+
+// Write dirty fields now (provisioning done, before a restart)
+esp_err_t config_store_flush(void);
+
+void config_store_get_stats(config_store_stats_t *stats);
+void config_store_reset_stats(void);
+
+#endif /* CONFIG_STORE_H */
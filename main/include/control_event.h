@@ -0,0 +1,64 @@
+#ifndef CONTROL_EVENT_H
+#define CONTROL_EVENT_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "sensor_data.h"
+
+/*
+ * Events consumed by the switch control task, and the bounded MPSC ring
+ * that carries them.
+ *
+ * The ring is a Vyukov-style array of cells tagged with sequence numbers:
+ * producers claim a cell with one compare-and-swap and publish it with a
+ * release store, so tasks and ISRs can post concurrently without a lock and
+ * without ever blocking. A full ring rejects the event instead of waiting.
+ * Only the control task pops. Plain C11 with no ESP-IDF dependencies.
+ */
+
+typedef enum {
+    CTRL_EVT_BUTTON = 0,         // debounced button press
+    CTRL_EVT_SENSOR,             // fused reading for a channel
+    CTRL_EVT_TIMER,              // timer wheel tick
+    CTRL_EVT_OVERRIDE,           // manual ON/OFF (BLE)
+    CTRL_EVT_COUNT,
+} ctrl_event_type_t;
+
+typedef struct {
+    uint8_t type;                // ctrl_event_type_t
+    uint8_t channel;
+    bool on;                     // CTRL_EVT_OVERRIDE only
+    int64_t timestamp_us;        // esp_timer time the source saw the event
+    sensor_reading_t reading;    // CTRL_EVT_SENSOR only
+} ctrl_event_t;
+
+#define CTRL_RING_SIZE 32        // power of two
+#define CTRL_RING_MASK (CTRL_RING_SIZE - 1)
+#define CTRL_RING_RESERVED 8     // cells kept free for button and override events
+
+typedef struct {
+    atomic_uint seq;
+    ctrl_event_t event;
+} ctrl_ring_cell_t;
+
+typedef struct {
+    ctrl_ring_cell_t cells[CTRL_RING_SIZE];
+    atomic_uint head;            // next position to claim (producers)
+    unsigned int tail;           // next position to read (consumer only)
+} ctrl_ring_t;
+
+void ctrl_ring_init(ctrl_ring_t *ring);
+
+/*
+ * Any context, never blocks. Returns false if fewer than headroom + 1 cells
+ * are free, so low-priority producers can leave room for urgent ones.
+ */
+bool ctrl_ring_push(ctrl_ring_t *ring, const ctrl_event_t *event, unsigned int headroom);
+
+// Single consumer. Returns false if no published event is waiting.
+bool ctrl_ring_pop(ctrl_ring_t *ring, ctrl_event_t *event);
+
+const char *ctrl_event_type_name(ctrl_event_type_t type);
+
+#endif /* CONTROL_EVENT_H */
@@ -0,0 +1,60 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+/*
+ * Append-only log of relay state changes in the "journal" data partition.
+ *
+ * Records are 16 bytes and fill the partition front to back, one 4 KB
+ * sector at a time; the sector after the head is erased just before it is
+ * reused, so every sector wears evenly and the oldest history is dropped
+ * first. Each record carries a sequence number and a CRC16: at boot the
+ * head is found from the first record of each sector plus one sector scan,
+ * and torn writes from a power cut are skipped.
+ *
+ * Appends are queued and written by a low-priority task, so the control
+ * task never waits for flash.
+ */
+
+#define JOURNAL_PARTITION_SUBTYPE 0x40
+#define JOURNAL_SECTOR_SIZE       4096
+
+#define JOURNAL_SOURCE_POWER_ON   0xFF    // state set by the power-on policy
+
+#define JOURNAL_FLAG_ON           (1u << 0)   // relay state after the change
+#define JOURNAL_FLAG_WALL_CLOCK   (1u << 1)   // time is Unix seconds, else seconds since boot
+
+typedef struct {
+    uint32_t seq;                // 0xFFFFFFFF in an erased slot
+    uint32_t time;
+    uint8_t channel;
+    uint8_t flags;               // JOURNAL_FLAG_*
+    uint8_t source;              // ctrl_event_type_t that changed the relay
+    uint8_t origin;              // rule_reason_t behind a sensor or timer change
+    uint16_t reserved;
+    uint16_t crc;                // CRC16 of the 14 bytes above
+} journal_record_t;
+
+_Static_assert(sizeof(journal_record_t) == 16, "journal record must stay 16 bytes");
+
+// Find the partition and the head; fast enough to run before the radios start
+esp_err_t journal_init(void);
+
+// State recorded by the newest record for the channel; false if there is none
+bool journal_last_state(uint8_t channel, bool *on);
+
+// Any task, never blocks; dropped (and counted) if the queue is full
+void journal_append(uint8_t channel, bool on, uint8_t source, uint8_t origin);
+
+/*
+ * Up to max records older than `before`, newest first (before = 0 starts at
+ * the newest). Returns the number read; continue from the seq of the last one.
+ */
+int journal_read(uint32_t before, journal_record_t *out, int max);
+
+uint32_t journal_dropped(void);
+
+#endif /* JOURNAL_H */
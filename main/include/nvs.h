@@ -2,12 +2,32 @@
 #define NVS_H
 
 #include <stddef.h>
+#include <stdint.h>
 #include "esp_err.h"
+#include "rule_engine.h"
 
+// Per-key settings written by older firmware, read once when migrating to the settings blob
 void nvs_read_wifi_credentials(char *read_ssid, char *read_password, char *read_device_id, int8_t *temperature_value, char *read_presence_state, uint16_t *light_value);
 
-void store_wifi_credentials_to_nvs(void);
-
 void nvs_init(void);
 
+esp_err_t nvs_load_rule_table(rule_table_t *table);
+
+esp_err_t nvs_store_rule_table(const rule_table_t *table);
+
+// Per-channel device_id written by older firmware, read once when migrating to sensor bindings
+esp_err_t nvs_load_channel_binding(uint8_t channel, char *device_id, size_t len);
+
+esp_err_t nvs_load_sensor_bindings(void *blob, size_t *len);
+
+esp_err_t nvs_store_sensor_bindings(const void *blob, size_t len);
+
+esp_err_t nvs_load_config(void *blob, size_t *len);
+
+esp_err_t nvs_store_config(const void *blob, size_t len);
+
+esp_err_t nvs_load_relay_usage(void *blob, size_t *len);
+
+esp_err_t nvs_store_relay_usage(const void *blob, size_t len);
+
 #endif /* NVS_H */
\ No newline at end of file
@@ -0,0 +1,50 @@
+#ifndef RATE_LIMIT_H
+#define RATE_LIMIT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Admission control for the UDP receiver: one token bucket per source
+ * IPv4 address plus a global bucket, checked before a datagram is parsed.
+ *
+ * Buckets hold milli-tokens and refill from the elapsed time on each
+ * check, so admitting a packet costs a table probe and a few integer ops.
+ * The source table is small and fixed; when it is full the least recently
+ * seen source is evicted. Plain C with no ESP-IDF dependencies.
+ */
+
+#define RATE_LIMIT_SOURCES        16
+#define RATE_LIMIT_SOURCE_RATE    20      // packets/s per source
+#define RATE_LIMIT_SOURCE_BURST   40
+#define RATE_LIMIT_GLOBAL_RATE    100     // packets/s over all sources
+#define RATE_LIMIT_GLOBAL_BURST   200
+
+typedef struct {
+    uint32_t tokens_milli;
+    int64_t last_us;
+} token_bucket_t;
+
+typedef struct {
+    uint32_t addr;
+    bool used;
+    token_bucket_t bucket;
+} rate_limit_source_t;
+
+typedef struct {
+    rate_limit_source_t sources[RATE_LIMIT_SOURCES];
+    token_bucket_t global;
+} rate_limiter_t;
+
+typedef enum {
+    RATE_LIMIT_PASS = 0,
+    RATE_LIMIT_SOURCE,           // this source is over its rate
+    RATE_LIMIT_GLOBAL,           // all sources together are over the cap
+} rate_limit_result_t;
+
+void rate_limit_init(rate_limiter_t *limiter, int64_t now_us);
+
+// Take one token from the source's bucket, then from the global one
+rate_limit_result_t rate_limit_admit(rate_limiter_t *limiter, uint32_t addr, int64_t now_us);
+
+#endif /* RATE_LIMIT_H */
@@ -0,0 +1,63 @@
+#ifndef RELAY_USAGE_H
+#define RELAY_USAGE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "switch_controller.h"
+
+/*
+ * ON time and switching cycles per relay, for energy reports and relay
+ * replacement planning.
+ *
+ * Counters live in RAM and the control task updates them on every relay
+ * change without touching flash. ON time and cycles are also rolled up into
+ * hourly and daily buckets (UTC, once SNTP has set the clock) kept in fixed
+ * rings. A low-priority task charges running ON time once a minute and
+ * writes everything to NVS as one blob at most every USAGE_FLUSH_INTERVAL_S,
+ * and only if something changed; a power cut loses at most that much.
+ */
+
+#define USAGE_HOURS            24        // hourly buckets kept
+#define USAGE_DAYS             30        // daily buckets kept
+#define USAGE_TICK_MS          60000     // running ON time is charged this often
+#define USAGE_FLUSH_INTERVAL_S 1800      // minimum time between NVS writes
+
+// What turned the relay ON; its ON time and cycle are attributed to it
+typedef enum {
+    USAGE_ORIGIN_BUTTON = 0,
+    USAGE_ORIGIN_OVERRIDE,       // BLE app
+    USAGE_ORIGIN_POWER_ON,       // power-on policy
+    USAGE_ORIGIN_TEMP,
+    USAGE_ORIGIN_PRESENCE,
+    USAGE_ORIGIN_LUX,
+    USAGE_ORIGIN_OTHER,          // sensor decision without a rule reason
+    USAGE_ORIGIN_COUNT,
+} usage_origin_t;
+
+// Lifetime counters of one relay
+typedef struct {
+    uint32_t on_seconds;
+    uint32_t cycles;             // OFF -> ON transitions
+    uint32_t origin_seconds[USAGE_ORIGIN_COUNT];
+    uint32_t origin_cycles[USAGE_ORIGIN_COUNT];
+} relay_usage_totals_t;
+
+// Call once after nvs_init(); loads the saved counters and starts the flush task
+esp_err_t relay_usage_init(void);
+
+// Control task, on every relay transition; never waits for flash
+void relay_usage_switch(uint8_t channel, bool on, usage_origin_t origin);
+
+void relay_usage_get_totals(uint8_t channel, relay_usage_totals_t *totals);
+
+// Write the counters now if they changed (before a restart)
+esp_err_t relay_usage_flush(void);
+
+// Totals and rollups of one channel as compact JSON; returns the length written
+int relay_usage_format(uint8_t channel, char *buf, size_t size);
+
+const char *usage_origin_name(usage_origin_t origin);
+
+#endif /* RELAY_USAGE_H */
@@ -0,0 +1,94 @@
+#ifndef RULE_ENGINE_H
+#define RULE_ENGINE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "sensor_data.h"
+
+/*
+ * Table-driven switch policy.
+ *
+ * Each sensor reading is reduced to a handful of input bits; the bits index
+ * a 64-row table whose entry says whether the switch should be ON and which
+ * reason (and therefore which OFF delay) applies. The default table
+ * reproduces the original hard-coded decision tree; other policies can be
+ * uploaded over BLE without reflashing.
+ */
+
+typedef enum {
+    SWITCH_MODE_OFF = 0,
+    SWITCH_MODE_ON,
+} switch_mode_t;
+
+typedef enum {
+    RULE_REASON_NONE = 0,
+    RULE_REASON_TEMP,
+    RULE_REASON_PRESENCE,
+    RULE_REASON_LUX,
+    RULE_REASON_COUNT,
+} rule_reason_t;
+
+/*
+ * Input bits (index into rule_table_t.rows). Temperature is compared with a
+ * single configured threshold, so a table can act on "below" or "at/above"
+ * but not on a band between two temperatures; that would take a second
+ * threshold bit, doubling the rows and changing the stored blob and the
+ * set_rules format, and is left to a firmware update.
+ */
+#define RULE_IN_TEMP_ENABLED  (1u << 0)   // temperature threshold configured
+#define RULE_IN_TEMP_ABOVE    (1u << 1)   // temperature >= threshold
+#define RULE_IN_MODE_ON       (1u << 2)   // presence trigger mode is ON
+#define RULE_IN_OCCUPIED      (1u << 3)   // presence or motion detected
+#define RULE_IN_LUX_ENABLED   (1u << 4)   // lux threshold configured (>= RULE_LUX_MIN_THRESHOLD)
+#define RULE_IN_DARK          (1u << 5)   // lux <= threshold
+#define RULE_INPUT_BITS       6
+#define RULE_TABLE_ROWS       (1u << RULE_INPUT_BITS)
+
+// Row encoding
+#define RULE_ROW_ON           0x80
+#define RULE_ROW_REASON_MASK  0x03
+
+#define RULE_TABLE_MAGIC      0x52        // 'R'
+#define RULE_TABLE_VERSION    1
+#define RULE_MAX_OFF_DELAY_MS (24u * 60u * 60u * 1000u)
+#define RULE_LUX_MIN_THRESHOLD 5
+
+// Persisted as a single NVS blob
+typedef struct {
+    uint8_t magic;
+    uint8_t version;
+    uint16_t reserved;
+    uint32_t off_delay_ms[RULE_REASON_COUNT];    // per-origin OFF delay, indexed by rule_reason_t
+    uint8_t rows[RULE_TABLE_ROWS];
+} rule_table_t;
+
+typedef struct {
+    bool turn_on;
+    rule_reason_t reason;
+    uint32_t off_delay_ms;
+} rule_decision_t;
+
+void rule_table_build_default(rule_table_t *table);
+bool rule_table_validate(const rule_table_t *table);
+
+uint8_t rule_inputs(const sensor_reading_t *reading, int8_t temp_threshold,
+                    uint16_t lux_threshold, switch_mode_t mode);
+
+static inline void rule_evaluate(const rule_table_t *table, uint8_t inputs, rule_decision_t *decision)
+{
+    uint8_t row = table->rows[inputs & (RULE_TABLE_ROWS - 1)];
+    decision->turn_on = (row & RULE_ROW_ON) != 0;
+    decision->reason = (rule_reason_t)(row & RULE_ROW_REASON_MASK);
+    decision->off_delay_ms = table->off_delay_ms[decision->reason];
+}
+
+const char *rule_reason_name(rule_reason_t reason);
+switch_mode_t switch_mode_from_string(const char *str);
+const char *switch_mode_name(switch_mode_t mode);
+
+// Rows as 2 hex digits each, for the BLE get_rules/set_rules commands
+void rule_table_rows_to_hex(const rule_table_t *table, char *out, size_t out_len);
+bool rule_table_rows_from_hex(rule_table_t *table, const char *hex);
+
+#endif /* RULE_ENGINE_H */
@@ -0,0 +1,90 @@
+#ifndef SCAN_CACHE_H
+#define SCAN_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Result of the last Wi-Fi scan, one entry per SSID.
+ *
+ * A mesh or a multi-AP office shows the same SSID from several BSSIDs; only
+ * the strongest is kept, since that is the one the station would join. When
+ * more SSIDs are heard than fit, the weakest are dropped. After a scan the
+ * list is sorted by RSSI, strongest first, and served until it is older
+ * than SCAN_CACHE_TTL_MS, so an app refreshing its list does not make the
+ * switch scan again each time.
+ *
+ * A scan can also be streamed while it runs: scan_framer_t packs the APs of
+ * each channel into self-contained JSON frames no longer than the link
+ * allows, and ends the stream with a scan_end marker.
+ *
+ * No ESP-IDF types (authmode is a plain byte), so it also builds on the host.
+ */
+
+#define SCAN_CACHE_MAX_APS 64
+#define SCAN_CACHE_TTL_MS  15000
+
+typedef struct {
+    char ssid[33];               // NUL-terminated; hidden networks are not cached
+    uint8_t bssid[6];
+    int8_t rssi;
+    uint8_t channel;
+    uint8_t authmode;            // wifi_auth_mode_t
+} scan_ap_t;
+
+typedef struct {
+    scan_ap_t aps[SCAN_CACHE_MAX_APS];
+    uint8_t count;
+    uint16_t dropped;            // SSIDs left out because the list was full
+    int64_t taken_us;            // completion time of the scan, 0 if there is none
+} scan_cache_t;
+
+// Empty the list before merging the results of a new scan
+void scan_cache_begin(scan_cache_t *cache);
+
+// Add one scan record; true if it added an SSID or found a stronger BSSID for one
+bool scan_cache_merge(scan_cache_t *cache, const scan_ap_t *ap);
+
+// Sort by RSSI and stamp the list as taken at now_us
+void scan_cache_finish(scan_cache_t *cache, int64_t now_us);
+
+bool scan_cache_fresh(const scan_cache_t *cache, int64_t now_us);
+
+// {"event_type":"scan_list","data":{"<ssid>":"<rssi>",...}}, strongest first; the
+// weakest entries are left out if buf is too small. Returns the length written
+int scan_cache_format(const scan_cache_t *cache, char *buf, size_t size);
+
+/* ---------------- Streaming ---------------- */
+#define SCAN_FRAME_MAX 512           // largest frame built (the ATT value limit)
+
+// A scan result as it arrives; ap is NULL once the channel is complete
+typedef void (*scan_found_t)(uint8_t channel, const scan_ap_t *ap, void *ctx);
+
+// Called with each finished frame; frame is NUL-terminated
+typedef void (*scan_frame_sink_t)(const char *frame, size_t len, void *ctx);
+
+typedef struct {
+    char buf[SCAN_FRAME_MAX + 1];
+    size_t max_len;
+    size_t len;                  // 0 while no frame is open
+    uint8_t channel;             // of the open frame; 0 for entries replayed from the cache
+    uint16_t entries;            // in the open frame
+    uint16_t frames;             // sent so far, scan_end included
+    uint16_t skipped;            // entries too long for a frame of max_len
+    scan_frame_sink_t sink;
+    void *ctx;
+} scan_framer_t;
+
+void scan_framer_init(scan_framer_t *framer, size_t max_len, scan_frame_sink_t sink, void *ctx);
+
+// {"event_type":"scan_list","ch":<channel>,"data":{...}}; a full frame or a new channel sends the open one
+void scan_framer_add(scan_framer_t *framer, uint8_t channel, const scan_ap_t *ap);
+
+// Send the open frame, if any (a channel is complete)
+void scan_framer_flush(scan_framer_t *framer);
+
+// Flush, then {"event_type":"scan_end","networks":N,"skipped":S,"cached":B,"ms":T}
+void scan_framer_end(scan_framer_t *framer, int networks, uint32_t ms, bool cached);
+
+#endif /* SCAN_CACHE_H */
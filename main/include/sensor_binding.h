@@ -0,0 +1,89 @@
+#ifndef SENSOR_BINDING_H
+#define SENSOR_BINDING_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "sensor_data.h"
+
+/*
+ * Sensors allowed to drive each relay channel.
+ *
+ * Bindings are keyed by (6-byte MAC, channel) and found through a small
+ * open-addressed hash table, so a packet is matched in O(1) whatever the
+ * number of bound sensors. Each binding remembers when it was last heard
+ * and whether it last reported occupancy; the occupancy of a channel is a
+ * vote (OR, AND or quorum) over its bindings that are still live.
+ */
+
+#define SENSOR_BINDING_MAX        64
+#define SENSOR_BINDING_HASH_SLOTS 128     // power of two, at most half full
+#define SENSOR_BINDING_DEFAULT_EXPIRY_S 300
+#define SENSOR_SEQ_WINDOW         64      // sequence numbers remembered per binding
+
+typedef enum {
+    FUSION_OR = 0,               // any live sensor reports occupancy
+    FUSION_AND,                  // every live sensor reports occupancy
+    FUSION_QUORUM,               // at least `quorum` live sensors report occupancy
+} fusion_mode_t;
+
+// Outcome of sensor_binding_report()
+typedef enum {
+    SENSOR_REPORT_OK = 0,
+    SENSOR_REPORT_RESTART,       // accepted; sender rebooted since its last accepted packet, window reset
+    SENSOR_REPORT_UNBOUND,       // sensor not bound to the channel
+    SENSOR_REPORT_DUPLICATE,     // sequence number already seen
+    SENSOR_REPORT_REORDERED,     // older than the newest accepted packet
+    SENSOR_REPORT_STALE,         // older than the whole window, and not a restart
+} sensor_report_t;
+
+static inline bool sensor_report_accepted(sensor_report_t result)
+{
+    return result == SENSOR_REPORT_OK || result == SENSOR_REPORT_RESTART;
+}
+
+// Snapshot of one binding, for list_sensors
+typedef struct {
+    uint8_t mac[6];
+    uint8_t channel;
+    bool live;                   // heard from within the expiry timeout
+    bool occupied;
+    uint32_t age_s;              // seconds since last packet, UINT32_MAX if never heard
+} sensor_binding_info_t;
+
+// Load bindings from NVS and make sure the provisioned device_id drives channel 0
+esp_err_t sensor_binding_init(const char *legacy_device_id);
+
+esp_err_t sensor_binding_add(const uint8_t mac[6], uint8_t channel);
+esp_err_t sensor_binding_remove(const uint8_t mac[6], uint8_t channel);
+size_t sensor_binding_count(void);
+
+/*
+ * Record a reading from a sensor. If the packet carries a sequence number it
+ * must be newer than every packet accepted from that binding, checked against
+ * a SENSOR_SEQ_WINDOW-wide bitmap; duplicates and late packets are rejected
+ * before the reading touches the vote. When accepted, *occupied is the fused
+ * occupancy of the channel.
+ */
+sensor_report_t sensor_binding_report(const uint8_t mac[6], uint8_t channel,
+                                      const sensor_reading_t *reading,
+                                      const sensor_seq_t *seq, bool *occupied);
+
+bool sensor_binding_occupied(uint8_t channel);
+
+// Drop sensors that have been silent too long; returns a mask of channels whose vote changed
+uint32_t sensor_binding_expire(void);
+
+esp_err_t sensor_binding_set_fusion(uint8_t channel, fusion_mode_t mode, uint8_t quorum);
+esp_err_t sensor_binding_set_expiry(uint16_t expiry_s);
+void sensor_binding_get_fusion(uint8_t channel, fusion_mode_t *mode, uint8_t *quorum);
+uint16_t sensor_binding_get_expiry(void);
+
+// Copy up to max bindings starting at offset; returns the number copied
+size_t sensor_binding_list(size_t offset, sensor_binding_info_t *out, size_t max);
+
+const char *fusion_mode_name(fusion_mode_t mode);
+bool fusion_mode_from_string(const char *str, fusion_mode_t *mode);
+
+#endif /* SENSOR_BINDING_H */
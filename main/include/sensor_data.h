@@ -0,0 +1,38 @@
+#ifndef SENSOR_DATA_H
+#define SENSOR_DATA_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Sensor type that produced a reading ("origin" in the command format)
+typedef enum {
+    SENSOR_ORIGIN_OTHER = 0,
+    SENSOR_ORIGIN_TEMP,
+    SENSOR_ORIGIN_MOTION,
+    SENSOR_ORIGIN_LUX,
+} sensor_origin_t;
+
+// Bits in sensor_reading_t.has for the values a packet actually carried
+#define SENSOR_HAS_OCCUPANCY   (1u << 0)   // presence_detected and/or motion_detected
+#define SENSOR_HAS_TEMPERATURE (1u << 1)
+#define SENSOR_HAS_LUX         (1u << 2)
+
+// Decoded sensor state carried by a single UDP packet
+typedef struct {
+    bool presence_detected;
+    bool motion_detected;
+    float temperature;           // degrees Celsius, 0 if not reported
+    float lux;                   // 0 if not reported
+    sensor_origin_t origin;
+    uint8_t has;                 // SENSOR_HAS_* bits
+} sensor_reading_t;
+
+// Optional ordering info a sensor may attach to its packets
+typedef struct {
+    bool has_seq;
+    bool has_ts;
+    uint32_t seq;                // +1 per packet, starts again when the sensor reboots
+    uint32_t sender_ms;          // sender's uptime clock, ms
+} sensor_seq_t;
+
+#endif /* SENSOR_DATA_H */
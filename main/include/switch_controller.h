@@ -1,11 +1,37 @@
 #ifndef SWITCH_CONTROLLER_H
 #define SWITCH_CONTROLLER_H
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "driver/gpio.h"
+#include "rule_engine.h"
+#include "control_event.h"
+
 #define UDP_PORT 9999
+
+// Number of relay channels on the board (1, 2 or 4 gang)
+#ifndef SWITCH_CHANNEL_COUNT
+#define SWITCH_CHANNEL_COUNT 1
+#endif
+#if SWITCH_CHANNEL_COUNT != 1 && SWITCH_CHANNEL_COUNT != 2 && SWITCH_CHANNEL_COUNT != 4
+#error "SWITCH_CHANNEL_COUNT must be 1, 2 or 4"
+#endif
+
+// Channel 0 pins, kept for the single-gang board
 #define RELAY_PIN GPIO_NUM_3
 #define LED_PIN GPIO_NUM_7
 #define SWITCH_PIN GPIO_NUM_5
 
+typedef struct {
+    gpio_num_t relay;
+    gpio_num_t led;              // GPIO_NUM_NC if the channel has no status LED
+    gpio_num_t button;
+} switch_channel_pins_t;
+
+extern const switch_channel_pins_t g_channel_pins[SWITCH_CHANNEL_COUNT];
+
 typedef struct {
     char presence_state[10];     // "ON"/"OFF"
     int8_t temperature_value;
@@ -14,12 +40,73 @@ typedef struct {
 
 extern sensor_config_t g_sensor_config;
 
+// UDP receive path counters
+typedef struct {
+    uint32_t received;           // datagrams read from the socket
+    uint32_t rate_limited;       // rejected by the per-source token bucket
+    uint32_t global_limited;     // rejected by the global token bucket
+    uint32_t parse_errors;       // malformed JSON or binary frames
+    uint32_t id_mismatch;        // wrong source, or sensor not bound to the channel
+    uint32_t seq_duplicate;      // sequence number already seen
+    uint32_t seq_reordered;      // arrived after a newer packet from the same sensor
+    uint32_t seq_stale;          // older than the sequence window
+    uint32_t sender_restarts;    // sensor started counting again (accepted)
+    uint32_t collapsed;          // superseded by a newer packet from the same sensor in one batch
+    uint32_t dropped;            // dropped by lwIP before reaching the socket (needs LWIP_STATS)
+} udp_rx_stats_t;
+
+/*
+ * Log2 latency histogram: bucket 0 counts 0 us, bucket i counts
+ * [2^(i-1), 2^i) us and the last bucket is open-ended (>= 262 ms).
+ */
+#define LATENCY_BUCKET_COUNT 20
+
+// Source-to-relay latency of events that drove a relay, per event source
+typedef struct {
+    uint32_t count;
+    uint32_t max_us;
+    uint64_t total_us;
+    uint32_t dropped;            // events rejected because the control queue was full
+    uint32_t buckets[LATENCY_BUCKET_COUNT];
+} latency_stats_t;
+
+// Everything reported by the "stats" command
+typedef struct {
+    udp_rx_stats_t rx;
+    uint32_t duplicates;         // sensor decisions ignored because the channel was already there
+    uint32_t relay_transitions;  // relay actually changed state
+    uint32_t settings_writes;    // settings blobs written to flash
+    uint32_t settings_saved;     // deferred save requests that needed no write of their own
+    latency_stats_t latency[CTRL_EVT_COUNT];
+} switch_stats_t;
+
+// Relays, buttons and the control loop; needs no network
 void switch_controller_init();
+// UDP listener; call once the network stack is initialised (it binds before an AP is joined)
+void switch_controller_start_udp(void);
 void process_command(const char* command, const char* origin);
 void udp_receiver_task(void *pvParameters);
 void set_switch_state(bool on);
+bool switch_controller_get_channel_state(uint8_t channel);
+esp_err_t switch_controller_override(uint8_t channel, bool on);
+void switch_controller_get_latency(ctrl_event_type_t source, latency_stats_t *stats);
 void update_temperature_threshold(int8_t new_threshold);
 void update_presence_switch_state(char *new_state);
 void update_light_threshold(uint16_t new_threshold);
+void switch_controller_get_rx_stats(udp_rx_stats_t *stats);
+void switch_controller_get_stats(switch_stats_t *stats);
+void switch_controller_reset_stats(void);
+#define SWITCH_STATS_JSON_MAX 1024  // histograms are trimmed of trailing empty buckets
+// Compact JSON snapshot of switch_controller_get_stats(); returns the length written
+int switch_controller_format_stats(char *buf, size_t size);
+#define SWITCH_HISTORY_UDP_PAGE 12  // journal records per reply; fits SWITCH_STATS_JSON_MAX
+#define SWITCH_HISTORY_BLE_PAGE 4
+#define SWITCH_TRACE_UDP_PAGE   16  // trace records per reply, so a request is answered by one small datagram
+// Up to max relay changes older than `before` (0 = newest) as JSON, with the cursor for the next page
+int switch_controller_format_history(uint32_t before, int max, char *buf, size_t size);
+// Relay level to drive at boot, from the power-on policy and the journal
+bool switch_controller_power_on_state(uint8_t channel);
+esp_err_t switch_controller_set_rule_table(const rule_table_t *table);
+void switch_controller_get_rule_table(rule_table_t *table);
 
 #endif
\ No newline at end of file
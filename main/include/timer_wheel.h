@@ -0,0 +1,63 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Hierarchical timing wheel.
+ *
+ * Four levels (256 + 3 x 64 slots) cover delays of up to 2^26 ticks with
+ * O(1) schedule/cancel and amortised O(1) expiry. Entries are intrusive, so
+ * the wheel never allocates; the caller supplies the tick source and any
+ * locking, so the host test can drive it tick by tick.
+ */
+
+#define TIMER_WHEEL_L0_BITS   8
+#define TIMER_WHEEL_LN_BITS   6
+#define TIMER_WHEEL_LEVELS    4
+#define TIMER_WHEEL_L0_SIZE   (1u << TIMER_WHEEL_L0_BITS)
+#define TIMER_WHEEL_LN_SIZE   (1u << TIMER_WHEEL_LN_BITS)
+#define TIMER_WHEEL_MAX_TICKS ((1u << (TIMER_WHEEL_L0_BITS + (TIMER_WHEEL_LEVELS - 1) * TIMER_WHEEL_LN_BITS)) - 1)
+
+typedef struct timer_wheel_entry timer_wheel_entry_t;
+typedef void (*timer_wheel_cb_t)(timer_wheel_entry_t *entry, void *arg);
+
+struct timer_wheel_entry {
+    timer_wheel_entry_t *next;
+    timer_wheel_entry_t *prev;
+    timer_wheel_entry_t **slot;  // list head currently holding the entry
+    uint32_t expires;            // absolute tick
+    timer_wheel_cb_t callback;
+    void *arg;
+    bool pending;
+};
+
+typedef struct {
+    uint32_t now;                // next tick to be processed
+    uint32_t count;              // pending entries
+    timer_wheel_entry_t *l0[TIMER_WHEEL_L0_SIZE];
+    timer_wheel_entry_t *ln[TIMER_WHEEL_LEVELS - 1][TIMER_WHEEL_LN_SIZE];
+} timer_wheel_t;
+
+void timer_wheel_init(timer_wheel_t *wheel);
+void timer_wheel_entry_init(timer_wheel_entry_t *entry, timer_wheel_cb_t callback, void *arg);
+
+// (Re)arm an entry to fire after delay_ticks ticks (clamped to TIMER_WHEEL_MAX_TICKS)
+void timer_wheel_schedule(timer_wheel_t *wheel, timer_wheel_entry_t *entry, uint32_t delay_ticks);
+void timer_wheel_cancel(timer_wheel_t *wheel, timer_wheel_entry_t *entry);
+
+// Process `ticks` ticks, running the callback of every entry that expires
+void timer_wheel_advance(timer_wheel_t *wheel, uint32_t ticks);
+
+static inline bool timer_wheel_empty(const timer_wheel_t *wheel)
+{
+    return wheel->count == 0;
+}
+
+static inline bool timer_wheel_pending(const timer_wheel_entry_t *entry)
+{
+    return entry->pending;
+}
+
+#endif /* TIMER_WHEEL_H */
@@ -0,0 +1,73 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Binary trace ring for hot-path events.
+ *
+ * Recording an event costs one atomic increment and a 16-byte store: no
+ * formatting, no locks, no UART. Any task or ISR may record. The ring keeps
+ * the newest TRACE_RING_SIZE records and is pulled as binary pages over UDP
+ * or BLE ({"cmd":"trace"}); tools/trace_decode.py turns pages into text.
+ *
+ * Page layout (little-endian): 16-byte header, then `count` records.
+ *   0  u8   magic 0xA7
+ *   1  u8   version (1)
+ *   2  u8   count
+ *   3  u8   flags (bit0: last page, nothing newer was recorded)
+ *   4  u64  esp_timer time of the dump, us
+ *   12 u32  sequence number of the next record to be written
+ */
+
+#define TRACE_RING_SIZE     256          // power of two
+#define TRACE_PAGE_MAGIC    0xA7
+#define TRACE_PAGE_VERSION  1
+#define TRACE_PAGE_HEADER   16
+#define TRACE_PAGE_LAST     0x01
+
+// Event ids; keep in sync with tools/trace_decode.py
+typedef enum {
+    TRACE_UDP_RX = 1,            // a1 = length, a2 = source IPv4 address
+    TRACE_UDP_REJECT,            // a0 = trace_reject_t, a1 = channel, a2 = seq if any
+    TRACE_SENSOR_EVAL,           // a0 = channel, a1 = rule inputs, a2 = turn_on | reason << 8
+    TRACE_RELAY,                 // a0 = channel, a1 = on | ctrl_event_type_t << 8, a2 = latency us
+    TRACE_BUTTON,                // a0 = channel, a1 = BUTTON_EVT_* mask, a2 = debounced level
+    TRACE_OFF_TIMER_START,       // a0 = channel, a2 = delay ms
+    TRACE_OFF_TIMER_FIRE,        // a0 = channel
+    TRACE_CTRL_DROP,             // a0 = ctrl_event_type_t, a1 = channel
+    TRACE_BLE_WRITE,             // a1 = length, a2 = attribute handle
+    TRACE_BLE_SEND,              // a0 = fragment index, a1 = length, a2 = esp_err_t
+} trace_event_t;
+
+typedef enum {
+    TRACE_REJECT_PARSE = 0,      // malformed JSON or binary frame
+    TRACE_REJECT_SOURCE,         // not AIOS_SENSOR, or device_id is not a MAC
+    TRACE_REJECT_UNBOUND,        // sensor not bound to the channel
+    TRACE_REJECT_DUPLICATE,      // sequence number already seen, a2 = seq
+    TRACE_REJECT_REORDERED,      // older than the newest accepted packet, a2 = seq
+    TRACE_REJECT_STALE,          // older than the sequence window, a2 = seq
+    TRACE_REJECT_RATE,           // token bucket, a1 = rate_limit_result_t, a2 = source IPv4 address
+} trace_reject_t;
+
+typedef struct {
+    uint32_t seq;
+    uint32_t timestamp_us;       // low 32 bits of esp_timer time
+    uint8_t id;                  // trace_event_t
+    uint8_t a0;
+    uint16_t a1;
+    uint32_t a2;
+} trace_record_t;
+
+void trace_record(uint8_t id, uint8_t a0, uint16_t a1, uint32_t a2);
+
+/*
+ * Fill `buf` with one page of records starting at *cursor (0 = oldest still
+ * held) and advance the cursor. Returns the page length, or 0 if `size`
+ * cannot hold a header and one record.
+ */
+size_t trace_dump_page(uint32_t *cursor, uint8_t *buf, size_t size);
+
+#endif /* TRACE_H */
@@ -13,6 +13,7 @@
 #include "esp_bt_defs.h"
 #include "esp_gap_ble_api.h"
 #include "esp_gatts_api.h"
+#include "scan_cache.h"
 
 // WiFi connection status bits
 #define WIFI_CONNECTED_BIT  BIT0
@@ -44,6 +45,10 @@ extern uint16_t heart_rate_handle_table[];
 // Function declarations
 void wifi_init_sta(void);
 void scan_wifi_networks(char* response);
+// Scan channel by channel, or replay the cache (channel 0) if it is fresh; *cached tells which
+esp_err_t wifi_scan_stream(scan_found_t found, void *ctx, bool *cached, int *networks);
+// Store the BSSID, channel and auth mode of the current AP if it serves the stored SSID
+void wifi_cache_current_ap(void);
 void connect_wifi_with_new_credentials_task(void);
 
 #endif /* WIFI_H */
@@ -0,0 +1,67 @@
+#ifndef WIFI_RECONNECT_H
+#define WIFI_RECONNECT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * When to try the AP again after the station lost it or an attempt failed.
+ *
+ * Each failed attempt in a row doubles the wait, up to a cap that depends on
+ * why the link went down: a beacon timeout is usually over in seconds, an AP
+ * that cannot be found is probably rebooting, and a rejected password will
+ * not fix itself, so it backs off furthest. Every wait is jittered by a
+ * per-device generator seeded from the MAC, so a building full of switches
+ * that lost the same AP does not come back in lockstep.
+ *
+ * Plain C with no ESP-IDF dependencies: drive it with synthetic disconnects
+ * and a fake clock on the host (the simulation's `reconnect` command does).
+ */
+
+typedef enum {
+    WIFI_DISC_LINK = 0,          // beacon timeout, kicked by the AP, anything unclassified
+    WIFI_DISC_NO_AP,             // SSID or cached BSSID not found
+    WIFI_DISC_AUTH,              // password rejected or handshake failed
+    WIFI_DISC_CLASS_COUNT,
+} wifi_disc_class_t;
+
+// Wait before the first retry and its cap, per class
+#define WIFI_RECONNECT_LINK_BASE_MS   1000
+#define WIFI_RECONNECT_LINK_CAP_MS    60000
+#define WIFI_RECONNECT_NO_AP_BASE_MS  4000
+#define WIFI_RECONNECT_NO_AP_CAP_MS   120000
+#define WIFI_RECONNECT_AUTH_BASE_MS   30000
+#define WIFI_RECONNECT_AUTH_CAP_MS    600000
+
+typedef enum {
+    WIFI_RECONNECT_IDLE = 0,     // never connected, no attempt yet
+    WIFI_RECONNECT_CONNECTING,   // attempt in progress
+    WIFI_RECONNECT_WAITING,      // next attempt at due_us
+    WIFI_RECONNECT_CONNECTED,
+} wifi_reconnect_state_t;
+
+typedef struct {
+    wifi_reconnect_state_t state;
+    uint32_t rng;                // jitter generator, never 0
+    uint16_t failures;           // failed attempts since the last connect
+    int64_t due_us;              // next attempt, while WAITING
+    int64_t down_since_us;       // when the link was lost, 0 if it was never up
+} wifi_reconnect_t;
+
+void wifi_reconnect_init(wifi_reconnect_t *rc, const uint8_t mac[6]);
+
+// An attempt starts now (first connect, or a due retry)
+void wifi_reconnect_attempt(wifi_reconnect_t *rc, int64_t now_us);
+
+// The link went down or an attempt failed; returns the wait before the next attempt in ms
+uint32_t wifi_reconnect_disconnected(wifi_reconnect_t *rc, wifi_disc_class_t cls, int64_t now_us);
+
+// Got an IP address; returns how long the link was down in ms, 0 if it had never been up
+uint32_t wifi_reconnect_connected(wifi_reconnect_t *rc, int64_t now_us);
+
+// True once the wait is over; the caller then connects and calls wifi_reconnect_attempt()
+bool wifi_reconnect_due(const wifi_reconnect_t *rc, int64_t now_us);
+
+const char *wifi_disc_class_name(wifi_disc_class_t cls);
+
+#endif /* WIFI_RECONNECT_H */
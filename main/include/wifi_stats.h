@@ -0,0 +1,59 @@
+#ifndef WIFI_STATS_H
+#define WIFI_STATS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "wifi_reconnect.h"
+
+/*
+ * Association timing, so the effect of connecting straight to the cached
+ * AP is visible across a fleet (for instance after a site-wide power cut).
+ *
+ * A connect cycle starts with the first attempt after boot or a disconnect
+ * and ends when an IP address arrives; retries and scan fallbacks inside
+ * the cycle count towards its time. Outages are timed from the loss of a
+ * working link to the next IP address. Written only by the Wi-Fi event task,
+ * except the scan counters, which the scanning task updates under the scan lock.
+ */
+
+typedef struct {
+    uint32_t attempts;           // esp_wifi_connect() calls from the event handler
+    uint32_t fast_attempts;      // of those, aimed at the cached BSSID and channel
+    uint32_t fallbacks;          // cached AP not reachable, switched to a full scan
+    uint32_t connects;           // cycles that reached an IP address
+    uint32_t last_assoc_ms;      // cycle start to association, last cycle
+    uint32_t last_ip_ms;         // cycle start to IP address, last cycle
+    uint32_t max_ip_ms;
+    uint64_t total_ip_ms;        // for the average over `connects`
+    bool last_fast;              // last association was to the cached AP
+    uint8_t channel;             // channel of the last association
+    uint32_t disconnects[WIFI_DISC_CLASS_COUNT];  // link losses and failed attempts, by class
+    uint32_t retry_ms;           // last wait scheduled before a retry
+    uint32_t outages;            // working links lost and regained
+    uint32_t last_down_ms;       // link lost to IP address again, last outage
+    uint32_t max_down_ms;
+    uint32_t scan_hits;          // scan requests answered from the cache
+    uint32_t scan_misses;        // scan requests that had to scan
+    uint32_t scan_failures;      // of those, scans the driver refused or aborted
+    uint32_t last_scan_ms;       // duration of the last completed scan
+    uint32_t first_result_ms;    // scan start to the first network found, last scan
+    uint32_t max_scan_ms;
+} wifi_stats_t;
+
+void wifi_stats_connect_start(bool fast);
+void wifi_stats_fallback(void);
+void wifi_stats_associated(uint8_t channel, bool fast);
+void wifi_stats_got_ip(void);
+void wifi_stats_disconnected(wifi_disc_class_t cls, uint32_t retry_ms);
+void wifi_stats_reconnected(uint32_t down_ms);
+void wifi_stats_scan_hit(void);
+void wifi_stats_scan_done(bool ok, uint32_t duration_ms, uint32_t first_ms);
+
+void wifi_stats_get(wifi_stats_t *stats);
+
+#define WIFI_STATS_JSON_MAX 512
+// {"wifi":{...}}; returns the length written
+int wifi_stats_format(char *buf, size_t size);
+
+#endif /* WIFI_STATS_H */
@@ -0,0 +1,72 @@
+#ifndef WIRE_FORMAT_H
+#define WIRE_FORMAT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "sensor_data.h"
+
+/*
+ * Compact binary sensor frame accepted on UDP_PORT next to the JSON format.
+ * Plain C with no ESP-IDF dependencies so sensors and host tools can link
+ * the same encoder/decoder.
+ *
+ * Layout (little-endian):
+ *   0      magic (WIRE_MAGIC)
+ *   1      version
+ *   2..7   sensor MAC address
+ *   8      origin (sensor_origin_t)
+ *   9      flags (WIRE_FLAG_*)
+ *   10     relay channel (0 for single-gang switches)
+ *   11     reserved, must be zero
+ *   12..13 temperature, signed, 0.01 degC
+ *   14..17 lux, unsigned, 0.01 lux
+ * Version 2 appends:
+ *   18..21 sequence number
+ *   22..25 sender uptime, ms
+ */
+#define WIRE_MAGIC          0xA5    // never the first byte of a JSON packet
+#define WIRE_VERSION        1
+#define WIRE_VERSION_SEQ    2
+#define WIRE_FRAME_V1_LEN   18
+#define WIRE_FRAME_V2_LEN   26
+
+#define WIRE_FLAG_PRESENCE  (1u << 0)
+#define WIRE_FLAG_MOTION    (1u << 1)
+#define WIRE_FLAG_HAS_TEMP  (1u << 2)
+#define WIRE_FLAG_HAS_LUX   (1u << 3)
+#define WIRE_FLAG_HAS_OCCUPANCY (1u << 4)   // presence/motion bits are a report; absent on temp/lux-only sensors
+
+typedef struct {
+    uint8_t device_mac[6];
+    uint8_t channel;
+    uint8_t flags;
+    sensor_reading_t reading;
+    sensor_seq_t seq;            // version 2 frames only
+} wire_frame_t;
+
+// True if the buffer starts like a binary frame (checked before any JSON parsing)
+static inline bool wire_is_binary(const uint8_t *buf, size_t len)
+{
+    return len > 0 && buf[0] == WIRE_MAGIC;
+}
+
+/*
+ * Encode a frame. Presence/motion flags are taken from frame->reading;
+ * HAS_TEMP/HAS_LUX are taken from frame->flags. HAS_OCCUPANCY is set when
+ * frame->flags or reading.has says the sensor reports occupancy, or when
+ * presence or motion is set. A version 2 frame is written
+ * when frame->seq.has_seq is set. Returns the number of bytes written, or 0
+ * if the buffer is too small.
+ */
+size_t wire_encode(const wire_frame_t *frame, uint8_t *buf, size_t buf_len);
+
+// Decode a version 1 or 2 frame in constant time. Returns false on bad magic/version/length
+// (the datagram must be exactly one frame) or a non-zero reserved byte.
+bool wire_decode(const uint8_t *buf, size_t len, wire_frame_t *frame);
+
+// "AA:BB:CC:DD:EE:FF" <-> 6 bytes
+bool wire_mac_from_string(const char *str, size_t len, uint8_t mac[6]);
+void wire_mac_to_string(const uint8_t mac[6], char *out, size_t out_len);
+
+#endif /* WIRE_FORMAT_H */
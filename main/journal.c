@@ -0,0 +1,311 @@
+#include <stddef.h>
+#include <string.h>
+#include <time.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+#include "switch_controller.h"
+#include "journal.h"
+
+static const char *TAG = "JOURNAL";
+
+#define RECORD_SIZE        sizeof(journal_record_t)
+#define RECORDS_PER_SECTOR (JOURNAL_SECTOR_SIZE / RECORD_SIZE)
+#define SCAN_CHUNK         32        // records per flash read when scanning; divides a sector
+#define SEQ_ERASED         0xFFFFFFFFu
+#define WALL_CLOCK_MIN     1600000000    // time() below this has not been set by SNTP
+#define QUEUE_LEN          16
+
+typedef enum {
+    SLOT_ERASED = 0,
+    SLOT_VALID,
+    SLOT_TORN,                   // partly written when power was lost
+} slot_state_t;
+
+static const esp_partition_t *partition = NULL;
+static uint32_t slot_count;      // records the partition holds
+static uint32_t head_slot;       // next slot to write
+static uint32_t next_seq = 1;
+static bool last_known[SWITCH_CHANNEL_COUNT];
+static bool last_on[SWITCH_CHANNEL_COUNT];
+static QueueHandle_t journal_queue = NULL;
+static SemaphoreHandle_t journal_lock = NULL;   // head_slot and next_seq, for readers
+static uint32_t dropped;
+
+/* ---------------- Records ---------------- */
+static uint16_t record_crc(const journal_record_t *record)
+{
+    return esp_rom_crc16_le(0, (const uint8_t *)record, offsetof(journal_record_t, crc));
+}
+
+static slot_state_t slot_state(const journal_record_t *record)
+{
+    const uint8_t *bytes = (const uint8_t *)record;
+    for (size_t i = 0; i < RECORD_SIZE; i++) {
+        if (bytes[i] != 0xFF) {
+            return (record->seq != SEQ_ERASED && record->crc == record_crc(record)) ? SLOT_VALID : SLOT_TORN;
+        }
+    }
+    return SLOT_ERASED;
+}
+
+static esp_err_t read_slots(uint32_t first, journal_record_t *records, uint32_t count)
+{
+    return esp_partition_read(partition, first * RECORD_SIZE, records, count * RECORD_SIZE);
+}
+
+/*
+ * Visit valid records backwards from `slot` (exclusive), newest first, over at
+ * most max_slots slots. Stops at erased flash, which is never older than the
+ * oldest record, or when visit returns false.
+ */
+typedef bool (*journal_visit_t)(const journal_record_t *record, void *ctx);
+
+static void journal_walk_back(uint32_t slot, uint32_t max_slots, journal_visit_t visit, void *ctx)
+{
+    journal_record_t chunk[SCAN_CHUNK];
+
+    while (max_slots > 0) {
+        if (slot == 0) {
+            slot = slot_count;
+        }
+        // Chunks stay aligned, so they never straddle the end of the partition
+        uint32_t n = (slot % SCAN_CHUNK) ? slot % SCAN_CHUNK : SCAN_CHUNK;
+        if (n > max_slots) {
+            n = max_slots;
+        }
+        uint32_t first = slot - n;
+        if (read_slots(first, chunk, n) != ESP_OK) {
+            return;
+        }
+        for (int i = n - 1; i >= 0; i--) {
+            slot_state_t state = slot_state(&chunk[i]);
+            if (state == SLOT_ERASED) {
+                return;
+            }
+            if (state == SLOT_VALID && !visit(&chunk[i], ctx)) {
+                return;
+            }
+        }
+        slot = first;
+        max_slots -= n;
+    }
+}
+
+/* ---------------- Boot scan ---------------- */
+static void journal_find_head(void)
+{
+    uint32_t sectors = slot_count / RECORDS_PER_SECTOR;
+    uint32_t head_sector = UINT32_MAX;
+    uint32_t head_seq = 0;
+    journal_record_t chunk[SCAN_CHUNK];
+
+    // The sector whose first record is newest holds the head
+    for (uint32_t s = 0; s < sectors; s++) {
+        if (read_slots(s * RECORDS_PER_SECTOR, chunk, 1) != ESP_OK) {
+            continue;
+        }
+        slot_state_t state = slot_state(&chunk[0]);
+        if (state == SLOT_TORN) {
+            // Rare: the first write into this sector was cut; use the next one
+            if (read_slots(s * RECORDS_PER_SECTOR + 1, chunk, 1) != ESP_OK) {
+                continue;
+            }
+            state = slot_state(&chunk[0]);
+        }
+        if (state == SLOT_VALID && (head_sector == UINT32_MAX || chunk[0].seq > head_seq)) {
+            head_sector = s;
+            head_seq = chunk[0].seq;
+        }
+    }
+
+    if (head_sector == UINT32_MAX) {
+        head_slot = 0;
+        next_seq = 1;
+        return;
+    }
+
+    // Within that sector the head is the first erased slot, or the next sector if it is full
+    next_seq = head_seq + 1;
+    head_slot = ((head_sector + 1) * RECORDS_PER_SECTOR) % slot_count;
+    for (uint32_t base = 0; base < RECORDS_PER_SECTOR; base += SCAN_CHUNK) {
+        uint32_t first = head_sector * RECORDS_PER_SECTOR + base;
+        if (read_slots(first, chunk, SCAN_CHUNK) != ESP_OK) {
+            break;
+        }
+        for (uint32_t i = 0; i < SCAN_CHUNK; i++) {
+            slot_state_t state = slot_state(&chunk[i]);
+            if (state == SLOT_ERASED) {
+                head_slot = first + i;
+                return;
+            }
+            if (state == SLOT_VALID && chunk[i].seq >= next_seq) {
+                next_seq = chunk[i].seq + 1;
+            }
+        }
+    }
+}
+
+static bool visit_last_state(const journal_record_t *record, void *ctx)
+{
+    int *missing = ctx;
+    if (record->channel < SWITCH_CHANNEL_COUNT && !last_known[record->channel]) {
+        last_known[record->channel] = true;
+        last_on[record->channel] = (record->flags & JOURNAL_FLAG_ON) != 0;
+        (*missing)--;
+    }
+    return *missing > 0;
+}
+
+/* ---------------- Writer task ---------------- */
+static void journal_task(void *pvParameter)
+{
+    journal_record_t record;
+
+    for (;;) {
+        if (xQueueReceive(journal_queue, &record, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+
+        // Entering a sector: it holds the oldest records (or nothing), erase it first
+        if (head_slot % RECORDS_PER_SECTOR == 0) {
+            esp_err_t err = esp_partition_erase_range(partition, head_slot * RECORD_SIZE, JOURNAL_SECTOR_SIZE);
+            if (err != ESP_OK) {
+                ESP_LOGE(TAG, "Failed to erase sector at slot %lu: %s", (unsigned long)head_slot, esp_err_to_name(err));
+            }
+        }
+
+        record.seq = next_seq;
+        record.reserved = 0xFFFF;
+        record.crc = record_crc(&record);
+        esp_err_t err = esp_partition_write(partition, head_slot * RECORD_SIZE, &record, RECORD_SIZE);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to write record %lu: %s", (unsigned long)record.seq, esp_err_to_name(err));
+        }
+
+        // Advance even after a failed write; the slot reads back as torn and is skipped
+        xSemaphoreTake(journal_lock, portMAX_DELAY);
+        head_slot = (head_slot + 1) % slot_count;
+        next_seq++;
+        xSemaphoreGive(journal_lock);
+    }
+}
+
+/* ---------------- Public API ---------------- */
+esp_err_t journal_init(void)
+{
+    partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, JOURNAL_PARTITION_SUBTYPE, "journal");
+    if (partition == NULL) {
+        ESP_LOGW(TAG, "No journal partition, relay history is disabled");
+        return ESP_ERR_NOT_FOUND;
+    }
+    slot_count = (partition->size / JOURNAL_SECTOR_SIZE) * RECORDS_PER_SECTOR;
+    if (slot_count < 2 * RECORDS_PER_SECTOR) {
+        ESP_LOGE(TAG, "Journal partition needs at least two sectors");
+        partition = NULL;
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    int64_t start_us = esp_timer_get_time();
+    journal_find_head();
+    int missing = SWITCH_CHANNEL_COUNT;
+    journal_walk_back(head_slot, slot_count, visit_last_state, &missing);
+    ESP_LOGI(TAG, "Journal head at slot %lu, next seq %lu (scan %ld us)",
+             (unsigned long)head_slot, (unsigned long)next_seq, (long)(esp_timer_get_time() - start_us));
+
+    journal_lock = xSemaphoreCreateMutex();
+    journal_queue = xQueueCreate(QUEUE_LEN, sizeof(journal_record_t));
+    if (journal_lock == NULL || journal_queue == NULL ||
+        xTaskCreate(journal_task, "journal", 2560, NULL, 2, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to start the journal writer");
+        journal_queue = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+bool journal_last_state(uint8_t channel, bool *on)
+{
+    if (channel >= SWITCH_CHANNEL_COUNT || !last_known[channel]) {
+        return false;
+    }
+    *on = last_on[channel];
+    return true;
+}
+
+void journal_append(uint8_t channel, bool on, uint8_t source, uint8_t origin)
+{
+    if (journal_queue == NULL) {
+        return;
+    }
+
+    journal_record_t record = {
+        .channel = channel,
+        .flags = on ? JOURNAL_FLAG_ON : 0,
+        .source = source,
+        .origin = origin,
+    };
+    time_t now = time(NULL);
+    if (now >= WALL_CLOCK_MIN) {
+        record.time = (uint32_t)now;
+        record.flags |= JOURNAL_FLAG_WALL_CLOCK;
+    } else {
+        record.time = (uint32_t)(esp_timer_get_time() / 1000000);
+    }
+
+    if (xQueueSend(journal_queue, &record, 0) != pdTRUE) {
+        dropped++;
+    }
+}
+
+typedef struct {
+    uint32_t before;
+    journal_record_t *out;
+    int max;
+    int count;
+} journal_page_t;
+
+static bool visit_page(const journal_record_t *record, void *ctx)
+{
+    journal_page_t *page = ctx;
+    if (record->seq < page->before) {
+        page->out[page->count++] = *record;
+    }
+    return page->count < page->max;
+}
+
+int journal_read(uint32_t before, journal_record_t *out, int max)
+{
+    if (journal_queue == NULL || max <= 0) {
+        return 0;
+    }
+
+    xSemaphoreTake(journal_lock, portMAX_DELAY);
+    uint32_t head = head_slot;
+    uint32_t newest = next_seq;
+    xSemaphoreGive(journal_lock);
+
+    if (before == 0 || before > newest) {
+        before = newest;
+    }
+    // Each newer record took at least one slot, so skip that many without reading them
+    uint32_t skip = newest - before;
+    if (skip >= slot_count) {
+        return 0;
+    }
+    uint32_t slot = (head + slot_count - skip) % slot_count;
+
+    journal_page_t page = { .before = before, .out = out, .max = max };
+    journal_walk_back(slot, slot_count - skip, visit_page, &page);
+    return page.count;
+}
+
+uint32_t journal_dropped(void)
+{
+    return dropped;
+}
@@ -7,10 +7,15 @@
 #include "esp_netif.h"
 #include "driver/gpio.h"
 #include "esp_mac.h"
+#include "esp_system.h"
 #include "version.h"
 #include "led.h"
 #include "bluetooth.h"
 #include "nvs.h"
+#include "config_store.h"
+#include "journal.h"
+#include "relay_usage.h"
+#include "boot_phase.h"
 #include "wifi.h"
 #include "switch_controller.h"
 
@@ -19,22 +24,43 @@ static const char *TAG = "SWITCH";
 
 void gpio_init(void)
 {
+    uint64_t mask = 0;
+    for (int ch = 0; ch < SWITCH_CHANNEL_COUNT; ch++) {
+        mask |= 1ULL << g_channel_pins[ch].relay;
+        if (g_channel_pins[ch].led != GPIO_NUM_NC) {
+            mask |= 1ULL << g_channel_pins[ch].led;
+        }
+    }
+
     gpio_config_t io_conf = {
-        .pin_bit_mask = (1ULL << RELAY_PIN) | (1ULL << LED_PIN),
+        .pin_bit_mask = mask,
         .mode = GPIO_MODE_OUTPUT,
         .pull_up_en = 0,
         .pull_down_en = 0,
         .intr_type = GPIO_INTR_DISABLE
     };
     gpio_config(&io_conf);
-    gpio_set_level(RELAY_PIN, 0);
-    gpio_set_level(LED_PIN, 0);
+    // Relays come back per the power-on policy, before BLE and Wi-Fi start
+    for (int ch = 0; ch < SWITCH_CHANNEL_COUNT; ch++) {
+        int level = switch_controller_power_on_state(ch) ? 1 : 0;
+        gpio_set_level(g_channel_pins[ch].relay, level);
+        if (g_channel_pins[ch].led != GPIO_NUM_NC) {
+            gpio_set_level(g_channel_pins[ch].led, level);
+        }
+    }
 }
 
 
+static void flush_settings_on_restart(void)
+{
+    config_store_flush();
+    relay_usage_flush();
+}
 
 void app_main(void)
 {
+    boot_phase_mark(BOOT_PHASE_APP);
+
     // Display version information
     ESP_LOGI(TAG, "Starting application - Firmware Version: %s", SW_FIRMWARE_VERSION);
 
@@ -54,38 +80,35 @@ void app_main(void)
     ESP_LOGI(TAG, "Device ID: %s", DEVICE_ID);
 
     nvs_init();
+    config_store_init();
+    // Deferred setting changes and relay usage must reach flash before esp_restart()
+    esp_register_shutdown_handler(flush_settings_on_restart);
+    journal_init();
+    relay_usage_init();
+    boot_phase_mark(BOOT_PHASE_STORAGE);
 
     // rgb_led_init();
     // rgb_led_set_red();
 
     gpio_init();
+    boot_phase_mark(BOOT_PHASE_RELAYS);
 
-    // Initialize Bluetooth
-    esp_err_t ret = bluetooth_init();
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to initialize Bluetooth: %s", esp_err_to_name(ret));
-        return;
-    }
+    // Buttons and relays work from here on, whether or not a network ever shows up
+    switch_controller_init();
+    boot_phase_mark(BOOT_PHASE_CONTROL);
 
+    // Association runs in the Wi-Fi driver while BLE starts; UDP binds now and hears packets once an IP arrives
     wifi_init_sta();
+    boot_phase_mark(BOOT_PHASE_WIFI_START);
+    switch_controller_start_udp();
 
-    esp_netif_ip_info_t ip_info;
-    esp_netif_t* netif = esp_netif_get_handle_from_ifkey("WIFI_STA_DEF");
-    if (netif != NULL) {
-        esp_netif_get_ip_info(netif, &ip_info);
-        if (ip_info.ip.addr != 0) {
-            ESP_LOGI(TAG, "IP Address: " IPSTR, IP2STR(&ip_info.ip));
-        } else {
-            ESP_LOGW(TAG, "WiFi connected but no IP address assigned yet");
-        }
+    esp_err_t ret = bluetooth_init();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to initialize Bluetooth: %s", esp_err_to_name(ret));
     } else {
-        ESP_LOGW(TAG, "WiFi network interface not available");
+        boot_phase_mark(BOOT_PHASE_BLE);
     }
 
-    vTaskDelay(pdMS_TO_TICKS(5000));    
-
-    switch_controller_init();
-
     ESP_LOGI(TAG, "Switch ready to receive commands");
     while (1) {
         vTaskDelay(pdMS_TO_TICKS(2000));
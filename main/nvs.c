@@ -1,3 +1,4 @@
+#include <stdio.h>
 #include <string.h>
 #include "nvs.h"
 #include "nvs_flash.h"
@@ -99,81 +100,170 @@ void nvs_read_wifi_credentials(char *read_ssid, char *read_password, char *read_
     nvs_close(nvs_handle);
 }
 
-void store_wifi_credentials_to_nvs(void) {
-
+esp_err_t nvs_load_rule_table(rule_table_t *table) {
     nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open("storage", NVS_READONLY, &nvs_handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    size_t len = sizeof(*table);
+    err = nvs_get_blob(nvs_handle, "rule_tbl", table, &len);
+    if (err == ESP_OK && len != sizeof(*table)) {
+        ESP_LOGW(TAG, "Rule table blob has unexpected size %d", (int)len);
+        err = ESP_ERR_INVALID_SIZE;
+    } else if (err == ESP_OK) {
+        ESP_LOGI(TAG, "Read rule table from NVS");
+    }
+
+    nvs_close(nvs_handle);
+    return err;
+}
 
+esp_err_t nvs_store_rule_table(const rule_table_t *table) {
+    nvs_handle_t nvs_handle;
     esp_err_t err = nvs_open("storage", NVS_READWRITE, &nvs_handle);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Failed to open NVS handle: %s", esp_err_to_name(err));
-        return;
+        return err;
     }
 
-    // Store SSID
-    if(wifi_credentials.ssid != NULL && strlen((char *)wifi_credentials.ssid) > 0) {
-        err = nvs_set_str(nvs_handle, "ssid", (const char *)wifi_credentials.ssid);
-        if (err != ESP_OK) {
-            ESP_LOGE(TAG, "Failed to store SSID to NVS: %s", esp_err_to_name(err));
-            nvs_close(nvs_handle);
-            return;
-        }
+    err = nvs_set_blob(nvs_handle, "rule_tbl", table, sizeof(*table));
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs_handle);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to store rule table to NVS: %s", esp_err_to_name(err));
+    } else {
+        ESP_LOGI(TAG, "Rule table stored in NVS successfully");
     }
 
-    // Store password
-    if(wifi_credentials.password){
-        err = nvs_set_str(nvs_handle, "password", (const char *)wifi_credentials.password);
-        if (err != ESP_OK) {
-            ESP_LOGE(TAG, "Failed to store password to NVS: %s", esp_err_to_name(err));
-            nvs_close(nvs_handle);
-            return;
-        }
+    nvs_close(nvs_handle);
+    return err;
+}
+
+esp_err_t nvs_load_channel_binding(uint8_t channel, char *device_id, size_t len) {
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open("storage", NVS_READONLY, &nvs_handle);
+    if (err != ESP_OK) {
+        return err;
     }
-    if(wifi_credentials.device_id){
-        err = nvs_set_str(nvs_handle, "device_id", (const char *)wifi_credentials.device_id);
-        if (err != ESP_OK) {
-            ESP_LOGE(TAG, "Failed to store device_id to NVS: %s", esp_err_to_name(err));
-            nvs_close(nvs_handle);
-            return;
-        }
+
+    char key[12];
+    snprintf(key, sizeof(key), "ch_bind%u", channel);
+    err = nvs_get_str(nvs_handle, key, device_id, &len);
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "Read channel %u binding from NVS: %s", channel, device_id);
     }
-    //store presence state
-    if(strlen(g_sensor_config.presence_state) > 0) {
-        err = nvs_set_str(nvs_handle, "pre_stat", (const char *)g_sensor_config.presence_state);
-        if (err != ESP_OK) {
-            ESP_LOGE(TAG, "Failed to store presence state to NVS: %s", esp_err_to_name(err));
-        } else {
-            ESP_LOGI(TAG, "Presence state stored in NVS successfully: %s", g_sensor_config.presence_state);
-        }
+
+    nvs_close(nvs_handle);
+    return err;
+}
+
+esp_err_t nvs_load_sensor_bindings(void *blob, size_t *len) {
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open("storage", NVS_READONLY, &nvs_handle);
+    if (err != ESP_OK) {
+        return err;
     }
 
-    if((g_sensor_config.temperature_value > 15 && g_sensor_config.temperature_value < 45) || g_sensor_config.temperature_value == 0) {
-        ESP_LOGI(TAG, "Temperature value: %d", g_sensor_config.temperature_value);
-        err = nvs_set_i8(nvs_handle, "temp_val", g_sensor_config.temperature_value);
-        if (err != ESP_OK){
-            ESP_LOGE(TAG, "Failed to store temperature value to NVS: %s", esp_err_to_name(err));
-        }else{
-            ESP_LOGI(TAG, "Temperature value stored in NVS successfully: %d", g_sensor_config.temperature_value);
-        }
-        
+    err = nvs_get_blob(nvs_handle, "sensor_bind", blob, len);
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "Read sensor bindings from NVS (%d bytes)", (int)*len);
     }
-    if(g_sensor_config.light_value > 0) {
-        err = nvs_set_u16(nvs_handle, "light_val", g_sensor_config.light_value);
-        if (err != ESP_OK) {
-            ESP_LOGE(TAG, "Failed to store light value to NVS: %s", esp_err_to_name(err));
-        } else {
-            ESP_LOGI(TAG, "Light value stored in NVS successfully: %d", g_sensor_config.light_value);
-        }
+
+    nvs_close(nvs_handle);
+    return err;
+}
+
+esp_err_t nvs_store_sensor_bindings(const void *blob, size_t len) {
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open("storage", NVS_READWRITE, &nvs_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to open NVS handle: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    err = nvs_set_blob(nvs_handle, "sensor_bind", blob, len);
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs_handle);
     }
-    
-    // Commit changes
-    err = nvs_commit(nvs_handle);
     if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to commit NVS changes: %s", esp_err_to_name(err));
+        ESP_LOGE(TAG, "Failed to store sensor bindings to NVS: %s", esp_err_to_name(err));
     } else {
-        ESP_LOGI(TAG, "All credentials saved to NVS successfully");
+        ESP_LOGI(TAG, "Sensor bindings stored in NVS successfully");
+    }
+
+    nvs_close(nvs_handle);
+    return err;
+}
+
+esp_err_t nvs_load_config(void *blob, size_t *len) {
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open("storage", NVS_READONLY, &nvs_handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    err = nvs_get_blob(nvs_handle, "config", blob, len);
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "Read settings from NVS (%d bytes)", (int)*len);
+    }
+
+    nvs_close(nvs_handle);
+    return err;
+}
+
+esp_err_t nvs_store_config(const void *blob, size_t len) {
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open("storage", NVS_READWRITE, &nvs_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to open NVS handle: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    err = nvs_set_blob(nvs_handle, "config", blob, len);
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs_handle);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to store settings to NVS: %s", esp_err_to_name(err));
+    }
+
+    nvs_close(nvs_handle);
+    return err;
+}
+
+esp_err_t nvs_load_relay_usage(void *blob, size_t *len) {
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open("storage", NVS_READONLY, &nvs_handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    err = nvs_get_blob(nvs_handle, "usage", blob, len);
+    nvs_close(nvs_handle);
+    return err;
+}
+
+esp_err_t nvs_store_relay_usage(const void *blob, size_t len) {
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open("storage", NVS_READWRITE, &nvs_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to open NVS handle: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    err = nvs_set_blob(nvs_handle, "usage", blob, len);
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs_handle);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to store relay usage to NVS: %s", esp_err_to_name(err));
     }
 
     nvs_close(nvs_handle);
+    return err;
 }
 
 void nvs_init(void) {
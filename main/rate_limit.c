@@ -0,0 +1,66 @@
+#include <string.h>
+#include "rate_limit.h"
+
+static void bucket_fill(token_bucket_t *bucket, uint32_t burst, int64_t now_us)
+{
+    bucket->tokens_milli = burst * 1000;
+    bucket->last_us = now_us;
+}
+
+static bool bucket_take(token_bucket_t *bucket, uint32_t rate, uint32_t burst, int64_t now_us)
+{
+    int64_t elapsed_us = now_us - bucket->last_us;
+    if (elapsed_us > 0) {
+        // rate tokens/s is rate milli-tokens per ms
+        uint64_t refill = (uint64_t)elapsed_us * rate / 1000;
+        uint64_t tokens = bucket->tokens_milli + refill;
+        bucket->tokens_milli = tokens > burst * 1000 ? burst * 1000 : (uint32_t)tokens;
+        bucket->last_us = now_us;
+    }
+    if (bucket->tokens_milli < 1000) {
+        return false;
+    }
+    bucket->tokens_milli -= 1000;
+    return true;
+}
+
+static rate_limit_source_t *source_lookup(rate_limiter_t *limiter, uint32_t addr, int64_t now_us)
+{
+    rate_limit_source_t *oldest = &limiter->sources[0];
+
+    for (int i = 0; i < RATE_LIMIT_SOURCES; i++) {
+        rate_limit_source_t *src = &limiter->sources[i];
+        if (src->used && src->addr == addr) {
+            return src;
+        }
+        if (!src->used) {
+            oldest = src;
+        } else if (oldest->used && src->bucket.last_us < oldest->bucket.last_us) {
+            oldest = src;
+        }
+    }
+
+    // New source: take a free slot, or evict the one heard from least recently
+    oldest->used = true;
+    oldest->addr = addr;
+    bucket_fill(&oldest->bucket, RATE_LIMIT_SOURCE_BURST, now_us);
+    return oldest;
+}
+
+void rate_limit_init(rate_limiter_t *limiter, int64_t now_us)
+{
+    memset(limiter, 0, sizeof(*limiter));
+    bucket_fill(&limiter->global, RATE_LIMIT_GLOBAL_BURST, now_us);
+}
+
+rate_limit_result_t rate_limit_admit(rate_limiter_t *limiter, uint32_t addr, int64_t now_us)
+{
+    rate_limit_source_t *src = source_lookup(limiter, addr, now_us);
+    if (!bucket_take(&src->bucket, RATE_LIMIT_SOURCE_RATE, RATE_LIMIT_SOURCE_BURST, now_us)) {
+        return RATE_LIMIT_SOURCE;
+    }
+    if (!bucket_take(&limiter->global, RATE_LIMIT_GLOBAL_RATE, RATE_LIMIT_GLOBAL_BURST, now_us)) {
+        return RATE_LIMIT_GLOBAL;
+    }
+    return RATE_LIMIT_PASS;
+}
@@ -0,0 +1,371 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_rom_crc.h"
+#include "nvs.h"
+#include "relay_usage.h"
+
+static const char *TAG = "USAGE";
+
+/* NVS blob: 8-byte header (magic, version, channel count, 0, CRC32 of the payload), then usage_data_t */
+#define BLOB_MAGIC      0x55        // 'U'
+#define BLOB_VERSION    1
+#define BLOB_HEADER_LEN 8
+#define BLOB_LEN        (BLOB_HEADER_LEN + sizeof(usage_data_t))
+
+#define WALL_CLOCK_MIN  1600000000  // time() below this has not been set by SNTP
+#define SECONDS_PER_HOUR 3600
+#define HOURS_PER_DAY   24
+
+/* Persisted counters; the rings are indexed by period number modulo their length */
+typedef struct {
+    relay_usage_totals_t totals[SWITCH_CHANNEL_COUNT];
+    uint32_t hour;               // newest hourly bucket, hours since the Unix epoch; 0 if never set
+    uint32_t day;                // newest daily bucket, days since the Unix epoch
+    uint16_t hour_seconds[USAGE_HOURS][SWITCH_CHANNEL_COUNT];
+    uint16_t hour_cycles[USAGE_HOURS][SWITCH_CHANNEL_COUNT];
+    uint32_t day_seconds[USAGE_DAYS][SWITCH_CHANNEL_COUNT];
+    uint16_t day_cycles[USAGE_DAYS][SWITCH_CHANNEL_COUNT];
+} usage_data_t;
+
+/* Live relay state, RAM only */
+typedef struct {
+    bool on;
+    uint8_t origin;              // usage_origin_t of the last OFF -> ON
+    int64_t charged_us;          // ON time is accounted up to here
+    int64_t carry_us;            // less than a second not yet accounted
+    uint32_t unsynced_seconds;   // accrued before the clock was set this boot
+    uint16_t unsynced_cycles;
+} usage_channel_t;
+
+static usage_data_t data;
+static usage_channel_t channels[SWITCH_CHANNEL_COUNT];
+static bool clock_seen;          // buckets are only charged once the wall clock is known
+static bool dirty;
+static int64_t flushed_us;
+static SemaphoreHandle_t usage_lock = NULL;
+static SemaphoreHandle_t flush_lock = NULL;   // serialises users of the blob buffer
+static uint8_t blob[BLOB_LEN];
+
+static const char *const origin_names[USAGE_ORIGIN_COUNT] = {
+    "button", "override", "power_on", "temp", "presence", "lux", "other",
+};
+
+const char *usage_origin_name(usage_origin_t origin)
+{
+    return origin < USAGE_ORIGIN_COUNT ? origin_names[origin] : "unknown";
+}
+
+/* ---------------- Accounting (usage_lock held) ---------------- */
+static uint16_t add_u16(uint16_t value, uint32_t add)
+{
+    return (value + add > UINT16_MAX) ? UINT16_MAX : value + add;
+}
+
+static void bucket_add(uint8_t channel, uint32_t seconds, uint32_t cycles)
+{
+    if (!clock_seen) {
+        channels[channel].unsynced_seconds += seconds;
+        channels[channel].unsynced_cycles = add_u16(channels[channel].unsynced_cycles, cycles);
+        return;
+    }
+    uint32_t h = data.hour % USAGE_HOURS;
+    uint32_t d = data.day % USAGE_DAYS;
+    data.hour_seconds[h][channel] = add_u16(data.hour_seconds[h][channel], seconds);
+    data.hour_cycles[h][channel] = add_u16(data.hour_cycles[h][channel], cycles);
+    data.day_seconds[d][channel] += seconds;
+    data.day_cycles[d][channel] = add_u16(data.day_cycles[d][channel], cycles);
+}
+
+// Account ON time of a channel up to now_us
+static void usage_charge(uint8_t channel, int64_t now_us)
+{
+    usage_channel_t *ch = &channels[channel];
+    if (!ch->on || now_us <= ch->charged_us) {
+        return;
+    }
+    ch->carry_us += now_us - ch->charged_us;
+    ch->charged_us = now_us;
+    uint32_t seconds = ch->carry_us / 1000000;
+    if (seconds == 0) {
+        return;
+    }
+    ch->carry_us %= 1000000;
+
+    relay_usage_totals_t *totals = &data.totals[channel];
+    totals->on_seconds += seconds;
+    totals->origin_seconds[ch->origin] += seconds;
+    bucket_add(channel, seconds, 0);
+    dirty = true;
+}
+
+static void usage_charge_all(int64_t now_us)
+{
+    for (uint8_t i = 0; i < SWITCH_CHANNEL_COUNT; i++) {
+        usage_charge(i, now_us);
+    }
+}
+
+// Make `hour` the newest bucket, clearing the ones skipped since the last
+static void usage_open_hour(uint32_t hour)
+{
+    bool fresh = (data.hour == 0);
+    uint32_t hours = (fresh || hour - data.hour >= USAGE_HOURS) ? USAGE_HOURS : hour - data.hour;
+    for (uint32_t h = hour - hours + 1; h <= hour; h++) {
+        memset(data.hour_seconds[h % USAGE_HOURS], 0, sizeof(data.hour_seconds[0]));
+        memset(data.hour_cycles[h % USAGE_HOURS], 0, sizeof(data.hour_cycles[0]));
+    }
+
+    uint32_t day = hour / HOURS_PER_DAY;
+    uint32_t days = (fresh || day - data.day >= USAGE_DAYS) ? USAGE_DAYS : day - data.day;
+    for (uint32_t d = day - days + 1; d <= day; d++) {
+        memset(data.day_seconds[d % USAGE_DAYS], 0, sizeof(data.day_seconds[0]));
+        memset(data.day_cycles[d % USAGE_DAYS], 0, sizeof(data.day_cycles[0]));
+    }
+
+    data.hour = hour;
+    data.day = day;
+    dirty = true;
+}
+
+// Move to the current hour bucket; ON time before an hour boundary stays in the old one
+static void usage_roll(int64_t now_us)
+{
+    time_t wall = time(NULL);
+    if (wall < WALL_CLOCK_MIN) {
+        return;
+    }
+    uint32_t hour = wall / SECONDS_PER_HOUR;
+
+    if (!clock_seen) {
+        // First time the clock is known: what accrued until now goes to the current hour
+        usage_charge_all(now_us);
+        clock_seen = true;
+        if (data.hour == 0 || hour > data.hour) {
+            usage_open_hour(hour);
+        }
+        for (uint8_t i = 0; i < SWITCH_CHANNEL_COUNT; i++) {
+            bucket_add(i, channels[i].unsynced_seconds, channels[i].unsynced_cycles);
+            channels[i].unsynced_seconds = 0;
+            channels[i].unsynced_cycles = 0;
+        }
+        return;
+    }
+
+    // A clock stepped backwards keeps using the newest bucket
+    if (hour > data.hour) {
+        usage_charge_all(now_us - (int64_t)(wall - (time_t)hour * SECONDS_PER_HOUR) * 1000000);
+        usage_open_hour(hour);
+    }
+}
+
+/* ---------------- Persistence ---------------- */
+static size_t usage_encode(uint8_t *out)
+{
+    uint32_t crc = esp_rom_crc32_le(0, (const uint8_t *)&data, sizeof(data));
+    out[0] = BLOB_MAGIC;
+    out[1] = BLOB_VERSION;
+    out[2] = SWITCH_CHANNEL_COUNT;
+    out[3] = 0;
+    memcpy(&out[4], &crc, 4);
+    memcpy(out + BLOB_HEADER_LEN, &data, sizeof(data));
+    return BLOB_LEN;
+}
+
+static bool usage_decode(const uint8_t *in, size_t len)
+{
+    // A different board size or layout starts from zero rather than misattributing counters
+    if (len != BLOB_LEN || in[0] != BLOB_MAGIC || in[1] != BLOB_VERSION || in[2] != SWITCH_CHANNEL_COUNT) {
+        ESP_LOGW(TAG, "Usage blob has a different layout, starting from zero");
+        return false;
+    }
+    uint32_t crc;
+    memcpy(&crc, &in[4], 4);
+    if (esp_rom_crc32_le(0, in + BLOB_HEADER_LEN, sizeof(data)) != crc) {
+        ESP_LOGW(TAG, "Usage blob failed its CRC check, starting from zero");
+        return false;
+    }
+    memcpy(&data, in + BLOB_HEADER_LEN, sizeof(data));
+    return true;
+}
+
+static void usage_flush_task(void *pvParameter)
+{
+    for (;;) {
+        vTaskDelay(pdMS_TO_TICKS(USAGE_TICK_MS));
+
+        int64_t now_us = esp_timer_get_time();
+        xSemaphoreTake(usage_lock, portMAX_DELAY);
+        usage_roll(now_us);
+        usage_charge_all(now_us);
+        bool due = dirty && now_us - flushed_us >= (int64_t)USAGE_FLUSH_INTERVAL_S * 1000000;
+        xSemaphoreGive(usage_lock);
+
+        if (due) {
+            relay_usage_flush();
+        }
+    }
+}
+
+/* ---------------- Public API ---------------- */
+esp_err_t relay_usage_init(void)
+{
+    usage_lock = xSemaphoreCreateMutex();
+    flush_lock = xSemaphoreCreateMutex();
+    if (usage_lock == NULL || flush_lock == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    size_t len = sizeof(blob);
+    esp_err_t err = nvs_load_relay_usage(blob, &len);
+    if (err != ESP_OK || !usage_decode(blob, len)) {
+        memset(&data, 0, sizeof(data));
+    } else {
+        ESP_LOGI(TAG, "Relay 0: %lu s ON, %lu cycles",
+                 (unsigned long)data.totals[0].on_seconds, (unsigned long)data.totals[0].cycles);
+    }
+    flushed_us = esp_timer_get_time();
+
+    if (xTaskCreate(usage_flush_task, "usage", 2560, NULL, 2, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create usage task, counters are not saved");
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+void relay_usage_switch(uint8_t channel, bool on, usage_origin_t origin)
+{
+    if (usage_lock == NULL || channel >= SWITCH_CHANNEL_COUNT || origin >= USAGE_ORIGIN_COUNT) {
+        return;
+    }
+
+    int64_t now_us = esp_timer_get_time();
+    xSemaphoreTake(usage_lock, portMAX_DELAY);
+    usage_roll(now_us);
+    usage_charge(channel, now_us);
+
+    usage_channel_t *ch = &channels[channel];
+    if (on && !ch->on) {
+        relay_usage_totals_t *totals = &data.totals[channel];
+        totals->cycles++;
+        totals->origin_cycles[origin]++;
+        bucket_add(channel, 0, 1);
+        ch->origin = origin;
+        ch->charged_us = now_us;
+        dirty = true;
+    }
+    ch->on = on;
+    xSemaphoreGive(usage_lock);
+}
+
+void relay_usage_get_totals(uint8_t channel, relay_usage_totals_t *totals)
+{
+    memset(totals, 0, sizeof(*totals));
+    if (usage_lock == NULL || channel >= SWITCH_CHANNEL_COUNT) {
+        return;
+    }
+    int64_t now_us = esp_timer_get_time();
+    xSemaphoreTake(usage_lock, portMAX_DELAY);
+    usage_roll(now_us);
+    usage_charge(channel, now_us);
+    *totals = data.totals[channel];
+    xSemaphoreGive(usage_lock);
+}
+
+esp_err_t relay_usage_flush(void)
+{
+    if (usage_lock == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(flush_lock, portMAX_DELAY);
+    int64_t now_us = esp_timer_get_time();
+    xSemaphoreTake(usage_lock, portMAX_DELAY);
+    usage_roll(now_us);
+    usage_charge_all(now_us);
+    bool changed = dirty;
+    size_t len = usage_encode(blob);
+    dirty = false;
+    flushed_us = now_us;
+    xSemaphoreGive(usage_lock);
+
+    esp_err_t err = ESP_OK;
+    if (changed) {
+        err = nvs_store_relay_usage(blob, len);
+        if (err != ESP_OK) {
+            xSemaphoreTake(usage_lock, portMAX_DELAY);
+            dirty = true;
+            xSemaphoreGive(usage_lock);
+        }
+    }
+    xSemaphoreGive(flush_lock);
+    return err;
+}
+
+int relay_usage_format(uint8_t channel, char *buf, size_t size)
+{
+    if (usage_lock == NULL || channel >= SWITCH_CHANNEL_COUNT) {
+        return snprintf(buf, size, "{\"usage\":null}");
+    }
+
+    int64_t now_us = esp_timer_get_time();
+    xSemaphoreTake(usage_lock, portMAX_DELAY);
+    usage_roll(now_us);
+    usage_charge(channel, now_us);
+
+    const relay_usage_totals_t *totals = &data.totals[channel];
+    size_t n = snprintf(buf, size, "{\"usage\":{\"ch\":%u,\"on\":%lu,\"cyc\":%lu,\"by\":{",
+                        channel, (unsigned long)totals->on_seconds, (unsigned long)totals->cycles);
+    bool first = true;
+    for (int o = 0; o < USAGE_ORIGIN_COUNT && n < size; o++) {
+        if (totals->origin_seconds[o] != 0 || totals->origin_cycles[o] != 0) {
+            n += snprintf(buf + n, size - n, "%s\"%s\":[%lu,%lu]", first ? "" : ",", origin_names[o],
+                          (unsigned long)totals->origin_seconds[o], (unsigned long)totals->origin_cycles[o]);
+            first = false;
+        }
+    }
+
+    // Rollups oldest first, ending at the current period; ON time in minutes
+    uint32_t hours = (data.hour == 0) ? 0 : USAGE_HOURS;
+    uint32_t days = (data.hour == 0) ? 0 : USAGE_DAYS;
+    if (n < size) {
+        n += snprintf(buf + n, size - n, "},\"hour\":%lu,\"h\":[",
+                      (unsigned long)data.hour * SECONDS_PER_HOUR);
+    }
+    for (uint32_t i = 0; i < hours && n < size; i++) {
+        uint32_t h = (data.hour + 1 + i) % USAGE_HOURS;
+        n += snprintf(buf + n, size - n, "%s%u", i ? "," : "", (data.hour_seconds[h][channel] + 30) / 60);
+    }
+    if (n < size) {
+        n += snprintf(buf + n, size - n, "],\"hc\":[");
+    }
+    for (uint32_t i = 0; i < hours && n < size; i++) {
+        uint32_t h = (data.hour + 1 + i) % USAGE_HOURS;
+        n += snprintf(buf + n, size - n, "%s%u", i ? "," : "", data.hour_cycles[h][channel]);
+    }
+    if (n < size) {
+        n += snprintf(buf + n, size - n, "],\"day\":%lu,\"d\":[",
+                      (unsigned long)data.day * SECONDS_PER_HOUR * HOURS_PER_DAY);
+    }
+    for (uint32_t i = 0; i < days && n < size; i++) {
+        uint32_t d = (data.day + 1 + i) % USAGE_DAYS;
+        n += snprintf(buf + n, size - n, "%s%lu", i ? "," : "", (unsigned long)(data.day_seconds[d][channel] + 30) / 60);
+    }
+    if (n < size) {
+        n += snprintf(buf + n, size - n, "],\"dc\":[");
+    }
+    for (uint32_t i = 0; i < days && n < size; i++) {
+        uint32_t d = (data.day + 1 + i) % USAGE_DAYS;
+        n += snprintf(buf + n, size - n, "%s%u", i ? "," : "", data.day_cycles[d][channel]);
+    }
+    if (n < size) {
+        n += snprintf(buf + n, size - n, "]}}");
+    }
+    xSemaphoreGive(usage_lock);
+    return n < size ? (int)n : (int)size - 1;
+}
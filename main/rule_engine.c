@@ -0,0 +1,155 @@
+#include <stdio.h>
+#include <string.h>
+#include "rule_engine.h"
+
+#define DEFAULT_TEMP_DELAY_MS     60000   // 1 minute for TEMP origin
+#define DEFAULT_MOTION_DELAY_MS   5000    // 5 secs minimum safe delay
+
+/*
+ * The original decision tree from process_sensor_data, kept only to
+ * generate the default table so that the shipped policy cannot drift.
+ */
+static uint8_t legacy_decision(uint8_t in)
+{
+    bool mode_on = (in & RULE_IN_MODE_ON) != 0;
+    bool occupied = (in & RULE_IN_OCCUPIED) != 0;
+    bool turn_on = false;
+    rule_reason_t reason = RULE_REASON_PRESENCE;
+
+    if (in & RULE_IN_TEMP_ENABLED) {
+        if (in & RULE_IN_TEMP_ABOVE) {
+            // Above threshold: presence decides in ON mode, otherwise OFF
+            turn_on = mode_on && occupied;
+        } else {
+            // Below threshold -> OFF
+            reason = RULE_REASON_TEMP;
+        }
+    } else {
+        // No temperature threshold set - use switch mode
+        turn_on = mode_on && occupied;
+    }
+
+    if ((in & RULE_IN_LUX_ENABLED) && mode_on) {
+        // Dark + presence -> ON, bright or empty -> OFF
+        turn_on = occupied && (in & RULE_IN_DARK);
+        reason = RULE_REASON_LUX;
+    }
+
+    return (turn_on ? RULE_ROW_ON : 0) | (uint8_t)reason;
+}
+
+void rule_table_build_default(rule_table_t *table)
+{
+    memset(table, 0, sizeof(*table));
+    table->magic = RULE_TABLE_MAGIC;
+    table->version = RULE_TABLE_VERSION;
+    table->off_delay_ms[RULE_REASON_NONE] = DEFAULT_MOTION_DELAY_MS;
+    table->off_delay_ms[RULE_REASON_TEMP] = DEFAULT_TEMP_DELAY_MS;
+    table->off_delay_ms[RULE_REASON_PRESENCE] = DEFAULT_MOTION_DELAY_MS;
+    table->off_delay_ms[RULE_REASON_LUX] = DEFAULT_MOTION_DELAY_MS;
+
+    for (uint32_t in = 0; in < RULE_TABLE_ROWS; in++) {
+        table->rows[in] = legacy_decision((uint8_t)in);
+    }
+}
+
+bool rule_table_validate(const rule_table_t *table)
+{
+    if (table->magic != RULE_TABLE_MAGIC || table->version != RULE_TABLE_VERSION) {
+        return false;
+    }
+    for (int i = 0; i < RULE_REASON_COUNT; i++) {
+        if (table->off_delay_ms[i] > RULE_MAX_OFF_DELAY_MS) {
+            return false;
+        }
+    }
+    for (uint32_t i = 0; i < RULE_TABLE_ROWS; i++) {
+        if (table->rows[i] & ~(RULE_ROW_ON | RULE_ROW_REASON_MASK)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+uint8_t rule_inputs(const sensor_reading_t *reading, int8_t temp_threshold,
+                    uint16_t lux_threshold, switch_mode_t mode)
+{
+    uint8_t in = 0;
+
+    if (temp_threshold != 0) {
+        in |= RULE_IN_TEMP_ENABLED;
+        if (reading->temperature >= temp_threshold) {
+            in |= RULE_IN_TEMP_ABOVE;
+        }
+    }
+    if (mode == SWITCH_MODE_ON) {
+        in |= RULE_IN_MODE_ON;
+    }
+    if (reading->presence_detected || reading->motion_detected) {
+        in |= RULE_IN_OCCUPIED;
+    }
+    if (lux_threshold >= RULE_LUX_MIN_THRESHOLD) {
+        in |= RULE_IN_LUX_ENABLED;
+        if (reading->lux <= lux_threshold) {
+            in |= RULE_IN_DARK;
+        }
+    }
+    return in;
+}
+
+const char *rule_reason_name(rule_reason_t reason)
+{
+    switch (reason) {
+        case RULE_REASON_TEMP:     return "TEMP";
+        case RULE_REASON_PRESENCE: return "PRESENCE";
+        case RULE_REASON_LUX:      return "LUX";
+        default:                   return "NONE";
+    }
+}
+
+switch_mode_t switch_mode_from_string(const char *str)
+{
+    return (str != NULL && strcmp(str, "ON") == 0) ? SWITCH_MODE_ON : SWITCH_MODE_OFF;
+}
+
+const char *switch_mode_name(switch_mode_t mode)
+{
+    return mode == SWITCH_MODE_ON ? "ON" : "OFF";
+}
+
+void rule_table_rows_to_hex(const rule_table_t *table, char *out, size_t out_len)
+{
+    size_t pos = 0;
+    for (uint32_t i = 0; i < RULE_TABLE_ROWS && pos + 3 <= out_len; i++) {
+        pos += snprintf(out + pos, out_len - pos, "%02X", table->rows[i]);
+    }
+    if (out_len > 0 && pos < out_len) {
+        out[pos] = '\0';
+    }
+}
+
+static int hex_nibble(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+bool rule_table_rows_from_hex(rule_table_t *table, const char *hex)
+{
+    if (hex == NULL || strlen(hex) != RULE_TABLE_ROWS * 2) {
+        return false;
+    }
+    uint8_t rows[RULE_TABLE_ROWS];
+    for (uint32_t i = 0; i < RULE_TABLE_ROWS; i++) {
+        int hi = hex_nibble(hex[i * 2]);
+        int lo = hex_nibble(hex[i * 2 + 1]);
+        if (hi < 0 || lo < 0) {
+            return false;
+        }
+        rows[i] = (uint8_t)((hi << 4) | lo);
+    }
+    memcpy(table->rows, rows, sizeof(rows));
+    return true;
+}
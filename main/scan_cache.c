@@ -0,0 +1,209 @@
+#include <stdio.h>
+#include <string.h>
+#include "scan_cache.h"
+
+void scan_cache_begin(scan_cache_t *cache)
+{
+    cache->count = 0;
+    cache->dropped = 0;
+    cache->taken_us = 0;
+}
+
+bool scan_cache_merge(scan_cache_t *cache, const scan_ap_t *ap)
+{
+    if (ap->ssid[0] == '\0') {
+        return false;
+    }
+
+    for (int i = 0; i < cache->count; i++) {
+        if (strcmp(cache->aps[i].ssid, ap->ssid) == 0) {
+            if (ap->rssi <= cache->aps[i].rssi) {
+                return false;
+            }
+            cache->aps[i] = *ap;
+            return true;
+        }
+    }
+
+    if (cache->count < SCAN_CACHE_MAX_APS) {
+        cache->aps[cache->count++] = *ap;
+        return true;
+    }
+
+    // Full: the new SSID replaces the weakest one if it is stronger
+    int weakest = 0;
+    for (int i = 1; i < cache->count; i++) {
+        if (cache->aps[i].rssi < cache->aps[weakest].rssi) {
+            weakest = i;
+        }
+    }
+    cache->dropped++;
+    if (ap->rssi <= cache->aps[weakest].rssi) {
+        return false;
+    }
+    cache->aps[weakest] = *ap;
+    return true;
+}
+
+void scan_cache_finish(scan_cache_t *cache, int64_t now_us)
+{
+    // Insertion sort, strongest first; stable for equal RSSI
+    for (int i = 1; i < cache->count; i++) {
+        scan_ap_t ap = cache->aps[i];
+        int j = i;
+        while (j > 0 && cache->aps[j - 1].rssi < ap.rssi) {
+            cache->aps[j] = cache->aps[j - 1];
+            j--;
+        }
+        cache->aps[j] = ap;
+    }
+    cache->taken_us = now_us ? now_us : 1;
+}
+
+bool scan_cache_fresh(const scan_cache_t *cache, int64_t now_us)
+{
+    return cache->taken_us != 0 && now_us - cache->taken_us < (int64_t)SCAN_CACHE_TTL_MS * 1000;
+}
+
+/* SSIDs are arbitrary bytes: escape what would break the JSON string */
+static int json_escape(const char *in, char *out, size_t size)
+{
+    size_t n = 0;
+    for (; *in != '\0'; in++) {
+        unsigned char c = (unsigned char)*in;
+        char tmp[7];
+        int len;
+        if (c == '"' || c == '\\') {
+            tmp[0] = '\\';
+            tmp[1] = (char)c;
+            len = 2;
+        } else if (c < 0x20) {
+            len = snprintf(tmp, sizeof(tmp), "\\u%04x", c);
+        } else {
+            tmp[0] = (char)c;
+            len = 1;
+        }
+        if (n + len >= size) {
+            break;
+        }
+        memcpy(out + n, tmp, len);
+        n += len;
+    }
+    out[n] = '\0';
+    return (int)n;
+}
+
+/* One "ssid":"rssi" member, with a leading comma unless it is the first */
+static int format_entry(const scan_ap_t *ap, bool first, char *out, size_t size)
+{
+    char ssid[sizeof(ap->ssid) * 6];
+    json_escape(ap->ssid, ssid, sizeof(ssid));
+    return snprintf(out, size, "%s\"%s\":\"%d\"", first ? "" : ",", ssid, ap->rssi);
+}
+
+#define ENTRY_MAX (sizeof(((scan_ap_t *)0)->ssid) * 6 + 16)
+
+int scan_cache_format(const scan_cache_t *cache, char *buf, size_t size)
+{
+    static const char tail[] = "}}";
+    int n = snprintf(buf, size, "{\"event_type\":\"scan_list\",\"data\":{");
+    if (n < 0 || (size_t)n + sizeof(tail) > size) {
+        if (size > 0) {
+            buf[0] = '\0';
+        }
+        return 0;
+    }
+
+    for (int i = 0; i < cache->count; i++) {
+        char entry[ENTRY_MAX];
+        int len = format_entry(&cache->aps[i], i == 0, entry, sizeof(entry));
+        // Sorted strongest first, so running out of room drops the weakest
+        if ((size_t)(n + len) + sizeof(tail) > size) {
+            break;
+        }
+        memcpy(buf + n, entry, len);
+        n += len;
+    }
+    memcpy(buf + n, tail, sizeof(tail));
+    return n + (int)sizeof(tail) - 1;
+}
+
+/* ---------------- Streaming ---------------- */
+static const char frame_tail[] = "}}";
+
+void scan_framer_init(scan_framer_t *framer, size_t max_len, scan_frame_sink_t sink, void *ctx)
+{
+    framer->max_len = max_len < SCAN_FRAME_MAX ? max_len : SCAN_FRAME_MAX;
+    framer->len = 0;
+    framer->channel = 0;
+    framer->entries = 0;
+    framer->frames = 0;
+    framer->skipped = 0;
+    framer->sink = sink;
+    framer->ctx = ctx;
+}
+
+static void framer_send(scan_framer_t *framer, size_t len)
+{
+    framer->frames++;
+    framer->sink(framer->buf, len, framer->ctx);
+}
+
+void scan_framer_flush(scan_framer_t *framer)
+{
+    if (framer->entries == 0) {
+        framer->len = 0;             // nothing but the header
+        return;
+    }
+    memcpy(framer->buf + framer->len, frame_tail, sizeof(frame_tail));
+    framer_send(framer, framer->len + sizeof(frame_tail) - 1);
+    framer->len = 0;
+    framer->entries = 0;
+}
+
+static bool framer_open(scan_framer_t *framer, uint8_t channel)
+{
+    int n = snprintf(framer->buf, sizeof(framer->buf), "{\"event_type\":\"scan_list\",\"ch\":%u,\"data\":{", channel);
+    if (n < 0 || (size_t)n + sizeof(frame_tail) - 1 > framer->max_len) {
+        return false;
+    }
+    framer->len = n;
+    framer->channel = channel;
+    framer->entries = 0;
+    return true;
+}
+
+void scan_framer_add(scan_framer_t *framer, uint8_t channel, const scan_ap_t *ap)
+{
+    if (framer->len != 0 && framer->channel != channel) {
+        scan_framer_flush(framer);
+    }
+    if (framer->len == 0 && !framer_open(framer, channel)) {
+        framer->skipped++;
+        return;
+    }
+
+    char entry[ENTRY_MAX];
+    int len = format_entry(ap, framer->entries == 0, entry, sizeof(entry));
+    if (framer->len + len + sizeof(frame_tail) - 1 > framer->max_len && framer->entries > 0) {
+        scan_framer_flush(framer);
+        framer_open(framer, channel);
+        len = format_entry(ap, true, entry, sizeof(entry));
+    }
+    if (framer->len + len + sizeof(frame_tail) - 1 > framer->max_len) {
+        framer->skipped++;               // even alone it does not fit; the frame stays open
+        return;
+    }
+    memcpy(framer->buf + framer->len, entry, len);
+    framer->len += len;
+    framer->entries++;
+}
+
+void scan_framer_end(scan_framer_t *framer, int networks, uint32_t ms, bool cached)
+{
+    scan_framer_flush(framer);
+    int n = snprintf(framer->buf, sizeof(framer->buf),
+                     "{\"event_type\":\"scan_end\",\"networks\":%d,\"skipped\":%u,\"cached\":%s,\"ms\":%lu}",
+                     networks, framer->skipped, cached ? "true" : "false", (unsigned long)ms);
+    framer_send(framer, (n < (int)sizeof(framer->buf)) ? (size_t)n : sizeof(framer->buf) - 1);
+}
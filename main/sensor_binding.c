@@ -0,0 +1,502 @@
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include "switch_controller.h"
+#include "sensor_binding.h"
+#include "wire_format.h"
+
+static const char *TAG = "SENSOR_BIND";
+
+#define HASH_MASK        (SENSOR_BINDING_HASH_SLOTS - 1)
+#define HASH_EMPTY       (-1)
+
+/* NVS blob: 8-byte header, 2 bytes of fusion settings per channel, then 7 bytes per binding */
+#define BLOB_MAGIC       0x42        // 'B'
+#define BLOB_VERSION     1
+#define BLOB_CHANNELS    4           // largest board, so the blob survives a channel-count change
+#define BLOB_HEADER_LEN  (8 + BLOB_CHANNELS * 2)
+#define BLOB_ENTRY_LEN   7
+#define BLOB_MAX_LEN     (BLOB_HEADER_LEN + SENSOR_BINDING_MAX * BLOB_ENTRY_LEN)
+
+typedef struct {
+    uint8_t mac[6];
+    uint8_t channel;
+    bool live;                   // heard from within the expiry timeout
+    bool voter;                  // has reported occupancy at least once
+    bool occupied;               // last reported presence || motion
+    int64_t last_seen_us;        // 0 until the first packet
+    bool seq_valid;              // seq_high/seq_seen hold a window
+    uint32_t seq_high;           // newest accepted sequence number
+    uint64_t seq_seen;           // bit i: seq_high - i was received
+    uint32_t sender_ms;          // sender clock of the newest accepted packet
+} binding_t;
+
+typedef struct {
+    fusion_mode_t mode;
+    uint8_t quorum;
+    uint8_t voters;              // live bindings that report occupancy
+    uint8_t occupied;            // ... of which currently occupied
+} channel_vote_t;
+
+static binding_t bindings[SENSOR_BINDING_MAX];
+static size_t binding_count = 0;
+static int8_t hash_slots[SENSOR_BINDING_HASH_SLOTS];
+static channel_vote_t votes[SWITCH_CHANNEL_COUNT];
+static uint16_t expiry_s = SENSOR_BINDING_DEFAULT_EXPIRY_S;
+static uint8_t provisioned_mac[6];
+static bool provisioned_mac_valid = false;
+static SemaphoreHandle_t binding_lock = NULL;
+
+/* ---------------- Hash table ---------------- */
+static uint32_t binding_hash(const uint8_t mac[6], uint8_t channel)
+{
+    // FNV-1a over the MAC and channel
+    uint32_t h = 2166136261u;
+    for (int i = 0; i < 6; i++) {
+        h = (h ^ mac[i]) * 16777619u;
+    }
+    return (h ^ channel) * 16777619u;
+}
+
+static int binding_find(const uint8_t mac[6], uint8_t channel)
+{
+    uint32_t slot = binding_hash(mac, channel) & HASH_MASK;
+    while (hash_slots[slot] != HASH_EMPTY) {
+        binding_t *b = &bindings[hash_slots[slot]];
+        if (b->channel == channel && memcmp(b->mac, mac, 6) == 0) {
+            return hash_slots[slot];
+        }
+        slot = (slot + 1) & HASH_MASK;
+    }
+    return -1;
+}
+
+static void hash_insert(int index)
+{
+    uint32_t slot = binding_hash(bindings[index].mac, bindings[index].channel) & HASH_MASK;
+    while (hash_slots[slot] != HASH_EMPTY) {
+        slot = (slot + 1) & HASH_MASK;
+    }
+    hash_slots[slot] = (int8_t)index;
+}
+
+static void hash_rebuild(void)
+{
+    memset(hash_slots, HASH_EMPTY, sizeof(hash_slots));
+    for (size_t i = 0; i < binding_count; i++) {
+        hash_insert(i);
+    }
+}
+
+/* ---------------- Voting ---------------- */
+static void vote_remove(const binding_t *b)
+{
+    if (b->live && b->voter) {
+        votes[b->channel].voters--;
+        if (b->occupied) {
+            votes[b->channel].occupied--;
+        }
+    }
+}
+
+static void vote_add(const binding_t *b)
+{
+    if (b->live && b->voter) {
+        votes[b->channel].voters++;
+        if (b->occupied) {
+            votes[b->channel].occupied++;
+        }
+    }
+}
+
+static bool vote_result(uint8_t channel)
+{
+    const channel_vote_t *v = &votes[channel];
+    switch (v->mode) {
+        case FUSION_AND:
+            return v->voters > 0 && v->occupied == v->voters;
+        case FUSION_QUORUM:
+            return v->occupied >= (v->quorum > 0 ? v->quorum : 1);
+        default:
+            return v->occupied > 0;
+    }
+}
+
+/* ---------------- Persistence ---------------- */
+static esp_err_t binding_save(void)
+{
+    static uint8_t blob[BLOB_MAX_LEN];
+
+    memset(blob, 0, BLOB_HEADER_LEN);
+    blob[0] = BLOB_MAGIC;
+    blob[1] = BLOB_VERSION;
+    blob[2] = (uint8_t)binding_count;
+    blob[4] = (uint8_t)expiry_s;
+    blob[5] = (uint8_t)(expiry_s >> 8);
+    for (int ch = 0; ch < SWITCH_CHANNEL_COUNT; ch++) {
+        blob[8 + ch * 2] = (uint8_t)votes[ch].mode;
+        blob[8 + ch * 2 + 1] = votes[ch].quorum;
+    }
+
+    uint8_t *p = blob + BLOB_HEADER_LEN;
+    for (size_t i = 0; i < binding_count; i++, p += BLOB_ENTRY_LEN) {
+        memcpy(p, bindings[i].mac, 6);
+        p[6] = bindings[i].channel;
+    }
+    return nvs_store_sensor_bindings(blob, p - blob);
+}
+
+static bool binding_load(void)
+{
+    static uint8_t blob[BLOB_MAX_LEN];
+    size_t len = sizeof(blob);
+
+    if (nvs_load_sensor_bindings(blob, &len) != ESP_OK) {
+        return false;
+    }
+    if (len < BLOB_HEADER_LEN || blob[0] != BLOB_MAGIC || blob[1] != BLOB_VERSION ||
+        blob[2] > SENSOR_BINDING_MAX || len != BLOB_HEADER_LEN + blob[2] * BLOB_ENTRY_LEN) {
+        ESP_LOGW(TAG, "Ignoring malformed binding blob (%d bytes)", (int)len);
+        return false;
+    }
+
+    expiry_s = (uint16_t)(blob[4] | (blob[5] << 8));
+    for (int ch = 0; ch < SWITCH_CHANNEL_COUNT; ch++) {
+        votes[ch].mode = blob[8 + ch * 2] <= FUSION_QUORUM ? (fusion_mode_t)blob[8 + ch * 2] : FUSION_OR;
+        votes[ch].quorum = blob[8 + ch * 2 + 1];
+    }
+
+    const uint8_t *p = blob + BLOB_HEADER_LEN;
+    for (int i = 0; i < blob[2]; i++, p += BLOB_ENTRY_LEN) {
+        // Skip bindings for channels this board does not have
+        if (p[6] >= SWITCH_CHANNEL_COUNT || binding_find(p, p[6]) >= 0) {
+            continue;
+        }
+        binding_t *b = &bindings[binding_count];
+        memset(b, 0, sizeof(*b));
+        memcpy(b->mac, p, 6);
+        b->channel = p[6];
+        hash_insert(binding_count++);
+    }
+    return true;
+}
+
+static bool binding_insert(const uint8_t mac[6], uint8_t channel)
+{
+    if (binding_find(mac, channel) >= 0) {
+        return true;
+    }
+    if (binding_count >= SENSOR_BINDING_MAX) {
+        return false;
+    }
+    binding_t *b = &bindings[binding_count];
+    memset(b, 0, sizeof(*b));
+    memcpy(b->mac, mac, 6);
+    b->channel = channel;
+    hash_insert(binding_count++);
+    return true;
+}
+
+/* ---------------- Sequence window ---------------- */
+static void seq_window_reset(binding_t *b, const sensor_seq_t *seq)
+{
+    b->seq_valid = true;
+    b->seq_high = seq->seq;
+    b->seq_seen = 1;
+    b->sender_ms = seq->sender_ms;
+}
+
+static sensor_report_t seq_window_check(binding_t *b, const sensor_seq_t *seq, int64_t now_us)
+{
+    if (!b->seq_valid || !b->live) {
+        // First packet, or the sensor was silent long enough to have expired
+        seq_window_reset(b, seq);
+        return SENSOR_REPORT_OK;
+    }
+
+    int32_t ahead = (int32_t)(seq->seq - b->seq_high);
+    if (ahead > 0) {
+        b->seq_seen = ahead >= SENSOR_SEQ_WINDOW ? 1 : (b->seq_seen << ahead) | 1;
+        b->seq_high = seq->seq;
+        b->sender_ms = seq->sender_ms;
+        return SENSOR_REPORT_OK;
+    }
+
+    uint32_t behind = b->seq_high - seq->seq;
+    if (behind < SENSOR_SEQ_WINDOW) {
+        uint64_t bit = 1ULL << behind;
+        if (b->seq_seen & bit) {
+            return SENSOR_REPORT_DUPLICATE;
+        }
+        // Remember it, so further copies count as duplicates
+        b->seq_seen |= bit;
+        return SENSOR_REPORT_REORDERED;
+    }
+
+    /*
+     * Far behind: a rebooted sensor counts from zero again. Only believe it if
+     * the sender has been up for less time than has passed since its last
+     * accepted packet; a late or replayed packet has an old uptime that fails
+     * this. Without a timestamp there is no telling, so it is stale.
+     */
+    if (seq->has_ts && b->last_seen_us != 0 &&
+        (int64_t)seq->sender_ms * 1000 < now_us - b->last_seen_us) {
+        seq_window_reset(b, seq);
+        return SENSOR_REPORT_RESTART;
+    }
+    return SENSOR_REPORT_STALE;
+}
+
+/* ---------------- Public API ---------------- */
+esp_err_t sensor_binding_init(const char *legacy_device_id)
+{
+    if (binding_lock == NULL) {
+        binding_lock = xSemaphoreCreateMutex();
+        if (binding_lock == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    xSemaphoreTake(binding_lock, portMAX_DELAY);
+    binding_count = 0;
+    memset(hash_slots, HASH_EMPTY, sizeof(hash_slots));
+    memset(votes, 0, sizeof(votes));
+
+    bool dirty = false;
+    if (!binding_load()) {
+        // First boot with the table: carry over the per-channel device IDs
+        ESP_LOGI(TAG, "No binding table in NVS, migrating channel bindings");
+        for (uint8_t ch = 1; ch < SWITCH_CHANNEL_COUNT; ch++) {
+            char device_id[32];
+            uint8_t mac[6];
+            if (nvs_load_channel_binding(ch, device_id, sizeof(device_id)) == ESP_OK &&
+                wire_mac_from_string(device_id, strlen(device_id), mac)) {
+                binding_insert(mac, ch);
+            }
+        }
+        dirty = true;
+    }
+
+    // The provisioned device_id always drives channel 0
+    provisioned_mac_valid = legacy_device_id != NULL &&
+        wire_mac_from_string(legacy_device_id, strlen(legacy_device_id), provisioned_mac);
+    if (provisioned_mac_valid && binding_find(provisioned_mac, 0) < 0) {
+        dirty |= binding_insert(provisioned_mac, 0);
+    } else if (!provisioned_mac_valid && legacy_device_id != NULL && legacy_device_id[0] != '\0') {
+        ESP_LOGW(TAG, "Device ID %s is not a MAC address and cannot be bound", legacy_device_id);
+    }
+
+    esp_err_t err = dirty ? binding_save() : ESP_OK;
+    ESP_LOGI(TAG, "%d sensor bindings, expiry %u s", (int)binding_count, expiry_s);
+    xSemaphoreGive(binding_lock);
+    return err;
+}
+
+esp_err_t sensor_binding_add(const uint8_t mac[6], uint8_t channel)
+{
+    if (binding_lock == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (channel >= SWITCH_CHANNEL_COUNT) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    xSemaphoreTake(binding_lock, portMAX_DELAY);
+    esp_err_t err = ESP_OK;
+    if (binding_find(mac, channel) < 0) {
+        err = binding_insert(mac, channel) ? binding_save() : ESP_ERR_NO_MEM;
+    }
+    xSemaphoreGive(binding_lock);
+    return err;
+}
+
+esp_err_t sensor_binding_remove(const uint8_t mac[6], uint8_t channel)
+{
+    if (binding_lock == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (channel == 0 && provisioned_mac_valid && memcmp(mac, provisioned_mac, 6) == 0) {
+        // Would be re-added on the next boot; re-provision instead
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    xSemaphoreTake(binding_lock, portMAX_DELAY);
+    esp_err_t err = ESP_ERR_NOT_FOUND;
+    int index = binding_find(mac, channel);
+    if (index >= 0) {
+        vote_remove(&bindings[index]);
+        bindings[index] = bindings[--binding_count];
+        hash_rebuild();
+        err = binding_save();
+    }
+    xSemaphoreGive(binding_lock);
+    return err;
+}
+
+size_t sensor_binding_count(void)
+{
+    return binding_count;
+}
+
+sensor_report_t sensor_binding_report(const uint8_t mac[6], uint8_t channel,
+                                      const sensor_reading_t *reading,
+                                      const sensor_seq_t *seq, bool *occupied)
+{
+    if (binding_lock == NULL) {
+        return SENSOR_REPORT_UNBOUND;
+    }
+
+    sensor_report_t result = SENSOR_REPORT_UNBOUND;
+    xSemaphoreTake(binding_lock, portMAX_DELAY);
+    int index = binding_find(mac, channel);
+    int64_t now = esp_timer_get_time();
+    if (index >= 0) {
+        binding_t *b = &bindings[index];
+        result = (seq != NULL && seq->has_seq) ? seq_window_check(b, seq, now) : SENSOR_REPORT_OK;
+    }
+    if (sensor_report_accepted(result)) {
+        binding_t *b = &bindings[index];
+        vote_remove(b);
+        b->live = true;
+        b->last_seen_us = now;
+        if (reading->has & SENSOR_HAS_OCCUPANCY) {
+            b->voter = true;
+            b->occupied = reading->presence_detected || reading->motion_detected;
+        }
+        vote_add(b);
+        *occupied = vote_result(channel);
+    }
+    xSemaphoreGive(binding_lock);
+    return result;
+}
+
+bool sensor_binding_occupied(uint8_t channel)
+{
+    if (binding_lock == NULL || channel >= SWITCH_CHANNEL_COUNT) {
+        return false;
+    }
+    xSemaphoreTake(binding_lock, portMAX_DELAY);
+    bool occupied = vote_result(channel);
+    xSemaphoreGive(binding_lock);
+    return occupied;
+}
+
+uint32_t sensor_binding_expire(void)
+{
+    if (binding_lock == NULL) {
+        return 0;
+    }
+
+    uint32_t changed = 0;
+    int64_t cutoff = esp_timer_get_time() - (int64_t)expiry_s * 1000000;
+
+    xSemaphoreTake(binding_lock, portMAX_DELAY);
+    for (size_t i = 0; i < binding_count; i++) {
+        binding_t *b = &bindings[i];
+        if (b->live && b->last_seen_us < cutoff) {
+            vote_remove(b);
+            b->live = false;
+            if (b->voter) {
+                changed |= 1u << b->channel;
+            }
+        }
+    }
+    xSemaphoreGive(binding_lock);
+    return changed;
+}
+
+esp_err_t sensor_binding_set_fusion(uint8_t channel, fusion_mode_t mode, uint8_t quorum)
+{
+    if (binding_lock == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (channel >= SWITCH_CHANNEL_COUNT || mode > FUSION_QUORUM ||
+        (mode == FUSION_QUORUM && (quorum == 0 || quorum > SENSOR_BINDING_MAX))) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    xSemaphoreTake(binding_lock, portMAX_DELAY);
+    votes[channel].mode = mode;
+    votes[channel].quorum = quorum;
+    esp_err_t err = binding_save();
+    xSemaphoreGive(binding_lock);
+    return err;
+}
+
+esp_err_t sensor_binding_set_expiry(uint16_t new_expiry_s)
+{
+    if (binding_lock == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (new_expiry_s == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    xSemaphoreTake(binding_lock, portMAX_DELAY);
+    expiry_s = new_expiry_s;
+    esp_err_t err = binding_save();
+    xSemaphoreGive(binding_lock);
+    return err;
+}
+
+void sensor_binding_get_fusion(uint8_t channel, fusion_mode_t *mode, uint8_t *quorum)
+{
+    *mode = channel < SWITCH_CHANNEL_COUNT ? votes[channel].mode : FUSION_OR;
+    *quorum = channel < SWITCH_CHANNEL_COUNT ? votes[channel].quorum : 0;
+}
+
+uint16_t sensor_binding_get_expiry(void)
+{
+    return expiry_s;
+}
+
+size_t sensor_binding_list(size_t offset, sensor_binding_info_t *out, size_t max)
+{
+    if (binding_lock == NULL) {
+        return 0;
+    }
+
+    size_t n = 0;
+    int64_t now = esp_timer_get_time();
+
+    xSemaphoreTake(binding_lock, portMAX_DELAY);
+    for (size_t i = offset; i < binding_count && n < max; i++, n++) {
+        const binding_t *b = &bindings[i];
+        memcpy(out[n].mac, b->mac, 6);
+        out[n].channel = b->channel;
+        out[n].live = b->live;
+        out[n].occupied = b->occupied;
+        out[n].age_s = b->last_seen_us == 0 ? UINT32_MAX : (uint32_t)((now - b->last_seen_us) / 1000000);
+    }
+    xSemaphoreGive(binding_lock);
+    return n;
+}
+
+const char *fusion_mode_name(fusion_mode_t mode)
+{
+    switch (mode) {
+        case FUSION_AND:    return "AND";
+        case FUSION_QUORUM: return "QUORUM";
+        default:            return "OR";
+    }
+}
+
+bool fusion_mode_from_string(const char *str, fusion_mode_t *mode)
+{
+    if (str == NULL) {
+        return false;
+    }
+    if (strcmp(str, "OR") == 0) {
+        *mode = FUSION_OR;
+    } else if (strcmp(str, "AND") == 0) {
+        *mode = FUSION_AND;
+    } else if (strcmp(str, "QUORUM") == 0) {
+        *mode = FUSION_QUORUM;
+    } else {
+        return false;
+    }
+    return true;
+}
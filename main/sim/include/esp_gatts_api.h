@@ -0,0 +1,10 @@
+#ifndef SIM_ESP_GATTS_API_H
+#define SIM_ESP_GATTS_API_H
+
+/* Just enough of the Bluedroid GATT server types for bluetooth.h (linux target only) */
+
+#include <stdint.h>
+
+typedef uint8_t esp_gatt_if_t;
+
+#endif /* SIM_ESP_GATTS_API_H */
@@ -0,0 +1,13 @@
+#ifndef SIM_LWIP_SOCKETS_H
+#define SIM_LWIP_SOCKETS_H
+
+/* The simulation uses the host's POSIX sockets in place of lwIP (linux target only) */
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#endif /* SIM_LWIP_SOCKETS_H */
@@ -0,0 +1,8 @@
+#ifndef SIM_LWIP_STATS_H
+#define SIM_LWIP_STATS_H
+
+/* No lwIP counters on the host; drops are reported as zero */
+#define LWIP_STATS 0
+#define UDP_STATS 0
+
+#endif /* SIM_LWIP_STATS_H */
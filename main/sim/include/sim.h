@@ -0,0 +1,13 @@
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdbool.h>
+#include "driver/gpio.h"
+
+// Drive an input pin from outside the firmware, running its ISR on a matching edge
+void sim_gpio_drive(gpio_num_t gpio_num, int level);
+
+// Level last written to an output pin
+int sim_gpio_output_level(gpio_num_t gpio_num);
+
+#endif /* SIM_H */
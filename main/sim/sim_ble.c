@@ -0,0 +1,74 @@
+#include <stdio.h>
+#include <string.h>
+#include "esp_log.h"
+#include "bluetooth.h"
+#include "ble_frame.h"
+
+/*
+ * BLE stand-in for the host simulation. There is no radio: commands are
+ * typed on the console and handed to ble_command_dispatch(), and anything
+ * the firmware would notify to the app is printed instead. Replies go
+ * through the same fragmenter as on the device, at the smallest ATT MTU,
+ * and are put back together by the reassembler an app would run.
+ */
+
+#define SIM_BLE_MTU 23
+
+static const char *TAG = "sim_ble";
+
+volatile bool wifi_creds_ready = false;
+volatile bool reconnecting_to_previous = false;
+char BLE_DEVICE_NAME[30] = {0};
+char DEVICE_ID[30] = {0};
+wifi_credentials_t wifi_credentials;
+
+esp_err_t bluetooth_init(void)
+{
+    ESP_LOGI(TAG, "No BLE stack in the simulation, use the 'ble' console command");
+    return ESP_OK;
+}
+
+void bluetooth_start_advertising(void)
+{
+    ESP_LOGI(TAG, "Advertising as %s", BLE_DEVICE_NAME);
+}
+
+void bluetooth_stop_advertising(void)
+{
+}
+
+esp_err_t ble_send(const void *data, size_t len)
+{
+    static uint8_t id;
+    static uint8_t scratch[SIM_BLE_MTU];
+    static uint8_t message[BLE_FRAME_MAX_MESSAGE];
+    ble_reasm_t reasm;
+    ble_frag_t frag;
+    const uint8_t *out;
+    size_t n;
+    int fragments = 0, result = -1;
+
+    ble_reasm_init(&reasm, message, sizeof(message));
+    ble_frag_begin(&frag, data, len, SIM_BLE_MTU - 3, id++);
+    while ((n = ble_frag_next(&frag, scratch, &out)) > 0) {
+        fragments++;
+        result = ble_reasm_feed(&reasm, out, n);
+    }
+    if (result != (int)len || memcmp(message, data, len) != 0) {
+        ESP_LOGE(TAG, "Reassembly failed: %d of %u bytes, %lu errors",
+                 result, (unsigned)len, (unsigned long)reasm.errors);
+        return ESP_FAIL;
+    }
+    if (fragments > 1) {
+        printf("ble< [%d fragments] %.*s\n", fragments, (int)len, (const char *)message);
+    } else {
+        printf("ble< %.*s\n", (int)len, (const char *)message);
+    }
+    fflush(stdout);
+    return ESP_OK;
+}
+
+void ble_client_send(char *data)
+{
+    ble_send(data, strlen(data));
+}
@@ -0,0 +1,162 @@
+#include <string.h>
+#include "esp_log.h"
+#include "driver/gpio.h"
+#include "sim.h"
+
+/*
+ * GPIO model for the host simulation: one level per pin, plus the
+ * interrupt type and handler the firmware registered. Pins float high
+ * (the buttons are wired with pull-ups) until the console drives them.
+ */
+
+static const char *TAG = "sim_gpio";
+
+typedef struct {
+    int level;
+    gpio_mode_t mode;
+    gpio_int_type_t intr_type;
+    gpio_isr_t handler;
+    void *arg;
+} sim_pin_t;
+
+static sim_pin_t pins[GPIO_NUM_MAX];
+static bool pins_ready = false;
+
+static sim_pin_t *sim_pin(gpio_num_t gpio_num)
+{
+    if (gpio_num < 0 || gpio_num >= GPIO_NUM_MAX) {
+        return NULL;
+    }
+    if (!pins_ready) {
+        for (int i = 0; i < GPIO_NUM_MAX; i++) {
+            pins[i].level = 1;
+        }
+        pins_ready = true;
+    }
+    return &pins[gpio_num];
+}
+
+esp_err_t gpio_config(const gpio_config_t *config)
+{
+    for (int i = 0; i < GPIO_NUM_MAX; i++) {
+        if (config->pin_bit_mask & (1ULL << i)) {
+            sim_pin_t *pin = sim_pin(i);
+            pin->mode = config->mode;
+            pin->intr_type = config->intr_type;
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t gpio_reset_pin(gpio_num_t gpio_num)
+{
+    sim_pin_t *pin = sim_pin(gpio_num);
+    if (pin == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pin->mode = GPIO_MODE_INPUT;
+    pin->intr_type = GPIO_INTR_DISABLE;
+    pin->handler = NULL;
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_direction(gpio_num_t gpio_num, gpio_mode_t mode)
+{
+    sim_pin_t *pin = sim_pin(gpio_num);
+    if (pin == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pin->mode = mode;
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_pull_mode(gpio_num_t gpio_num, gpio_pull_mode_t pull)
+{
+    return sim_pin(gpio_num) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t gpio_set_intr_type(gpio_num_t gpio_num, gpio_int_type_t intr_type)
+{
+    sim_pin_t *pin = sim_pin(gpio_num);
+    if (pin == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pin->intr_type = intr_type;
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level)
+{
+    sim_pin_t *pin = sim_pin(gpio_num);
+    if (pin == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (pin->level != (int)(level != 0)) {
+        ESP_LOGD(TAG, "GPIO %d -> %u", gpio_num, (unsigned)(level != 0));
+    }
+    pin->level = (level != 0);
+    return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t gpio_num)
+{
+    sim_pin_t *pin = sim_pin(gpio_num);
+    return pin ? pin->level : 0;
+}
+
+esp_err_t gpio_install_isr_service(int intr_alloc_flags)
+{
+    return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_add(gpio_num_t gpio_num, gpio_isr_t isr_handler, void *args)
+{
+    sim_pin_t *pin = sim_pin(gpio_num);
+    if (pin == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pin->handler = isr_handler;
+    pin->arg = args;
+    return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_remove(gpio_num_t gpio_num)
+{
+    sim_pin_t *pin = sim_pin(gpio_num);
+    if (pin == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pin->handler = NULL;
+    return ESP_OK;
+}
+
+/* ---------------- Simulation hooks ---------------- */
+void sim_gpio_drive(gpio_num_t gpio_num, int level)
+{
+    sim_pin_t *pin = sim_pin(gpio_num);
+    if (pin == NULL) {
+        return;
+    }
+
+    int old = pin->level;
+    pin->level = (level != 0);
+
+    bool fire = false;
+    switch (pin->intr_type) {
+        case GPIO_INTR_POSEDGE:    fire = (!old && pin->level); break;
+        case GPIO_INTR_NEGEDGE:    fire = (old && !pin->level); break;
+        case GPIO_INTR_ANYEDGE:    fire = (old != pin->level); break;
+        case GPIO_INTR_LOW_LEVEL:  fire = !pin->level; break;
+        case GPIO_INTR_HIGH_LEVEL: fire = pin->level; break;
+        default: break;
+    }
+    // Called from the console task; the handlers only use *FromISR calls, which are safe here too
+    if (fire && pin->handler) {
+        pin->handler(pin->arg);
+    }
+}
+
+int sim_gpio_output_level(gpio_num_t gpio_num)
+{
+    return gpio_get_level(gpio_num);
+}
@@ -0,0 +1,299 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "lwip/sockets.h"
+#include "esp_log.h"
+#include "version.h"
+#include "bluetooth.h"
+#include "ble_commands.h"
+#include "nvs.h"
+#include "config_store.h"
+#include "journal.h"
+#include "relay_usage.h"
+#include "boot_phase.h"
+#include "switch_controller.h"
+#include "control_event.h"
+#include "wifi_reconnect.h"
+#include "sim.h"
+
+/*
+ * Entry point of the host simulation (idf.py --preview set-target linux).
+ * Runs the real switch controller against simulated GPIO and BLE, with a
+ * line console on stdin standing in for the buttons and the phone app:
+ *
+ *   press <ch> [ms] press the button of a channel, with contact bounce,
+ *                   and release it after ms (default 100; 3000+ is a
+ *                   long press)
+ *   relay           print the relay level of every channel
+ *   ble <json>      hand a BLE command to the dispatcher
+ *   latency         print event-to-relay latency per event type
+ *   history [seq]   print journalled relay changes older than seq
+ *   loadtest [s]    flood UDP 9999 from several loopback sources while
+ *                   pressing button 0, then report button-to-relay latency
+ *   reconnect [n]   replay an AP outage and a password change against the
+ *                   Wi-Fi backoff on a fake clock, for n devices (default 1)
+ *   quit
+ *
+ * Sensor packets go to UDP port 9999 on the host, as on the device.
+ */
+
+static const char *TAG = "SIM";
+
+// Locally administered MAC standing in for the eFuse one
+static const uint8_t sim_mac[6] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x01};
+
+static void gpio_init(void)
+{
+    for (int ch = 0; ch < SWITCH_CHANNEL_COUNT; ch++) {
+        int level = switch_controller_power_on_state(ch) ? 1 : 0;
+        gpio_set_direction(g_channel_pins[ch].relay, GPIO_MODE_OUTPUT);
+        gpio_set_level(g_channel_pins[ch].relay, level);
+        if (g_channel_pins[ch].led != GPIO_NUM_NC) {
+            gpio_set_direction(g_channel_pins[ch].led, GPIO_MODE_OUTPUT);
+            gpio_set_level(g_channel_pins[ch].led, level);
+        }
+    }
+}
+
+// A mechanical contact chatters for a few edges on each transition
+static void sim_drive_bouncy(gpio_num_t pin, int level)
+{
+    sim_gpio_drive(pin, level);
+    sim_gpio_drive(pin, !level);
+    sim_gpio_drive(pin, level);
+}
+
+static void sim_press(int ch, int hold_ms)
+{
+    if (ch < 0 || ch >= SWITCH_CHANNEL_COUNT) {
+        printf("channel must be 0..%d\n", SWITCH_CHANNEL_COUNT - 1);
+        return;
+    }
+    if (hold_ms <= 0) {
+        hold_ms = 100;
+    }
+    sim_drive_bouncy(g_channel_pins[ch].button, 0);
+    vTaskDelay(pdMS_TO_TICKS(hold_ms));
+    sim_drive_bouncy(g_channel_pins[ch].button, 1);
+}
+
+static void sim_print_relays(void)
+{
+    for (int ch = 0; ch < SWITCH_CHANNEL_COUNT; ch++) {
+        printf("relay %d (GPIO %d): %s\n", ch, g_channel_pins[ch].relay,
+               sim_gpio_output_level(g_channel_pins[ch].relay) ? "ON" : "OFF");
+    }
+}
+
+static void sim_print_latency(void)
+{
+    for (int type = 0; type < CTRL_EVT_COUNT; type++) {
+        latency_stats_t stats;
+        switch_controller_get_latency(type, &stats);
+        printf("%-8s count=%lu avg=%lu us max=%lu us dropped=%lu\n",
+               ctrl_event_type_name(type), (unsigned long)stats.count,
+               stats.count ? (unsigned long)(stats.total_us / stats.count) : 0UL,
+               (unsigned long)stats.max_us, (unsigned long)stats.dropped);
+    }
+}
+
+/* ---------------- Load test ---------------- */
+#define FLOOD_SOURCES     8         // 127.0.0.2 .. 127.0.0.9
+#define LOADTEST_PRESS_MS 300
+
+static volatile bool flood_running;
+static volatile uint32_t flood_sent;
+
+static void flood_task(void *arg)
+{
+    static const char packet[] =
+        "{\"source\":\"AIOS_SENSOR\",\"device_id\":\"02:00:00:00:00:01\",\"presence_detected\":true}";
+    int socks[FLOOD_SOURCES];
+    struct sockaddr_in dst = {
+        .sin_family = AF_INET,
+        .sin_port = htons(UDP_PORT),
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+
+    for (int i = 0; i < FLOOD_SOURCES; i++) {
+        struct sockaddr_in src = {
+            .sin_family = AF_INET,
+            .sin_addr.s_addr = htonl(INADDR_LOOPBACK + 1 + i),
+        };
+        socks[i] = socket(AF_INET, SOCK_DGRAM, 0);
+        bind(socks[i], (struct sockaddr *)&src, sizeof(src));
+    }
+
+    for (uint32_t n = 0; flood_running; n++) {
+        // Non-blocking: a full socket buffer just means the receiver is saturated
+        if (sendto(socks[n % FLOOD_SOURCES], packet, sizeof(packet) - 1, MSG_DONTWAIT,
+                   (struct sockaddr *)&dst, sizeof(dst)) > 0) {
+            flood_sent++;
+        }
+        if ((n & 63) == 63) {
+            taskYIELD();
+        }
+    }
+
+    for (int i = 0; i < FLOOD_SOURCES; i++) {
+        close(socks[i]);
+    }
+    vTaskDelete(NULL);
+}
+
+static void sim_loadtest(int seconds)
+{
+    if (seconds <= 0) {
+        seconds = 5;
+    }
+    switch_controller_reset_stats();
+    flood_sent = 0;
+    flood_running = true;
+    xTaskCreate(flood_task, "flood", 4096, NULL, 1, NULL);
+
+    int presses = seconds * 1000 / LOADTEST_PRESS_MS;
+    for (int i = 0; i < presses; i++) {
+        sim_press(0, 100);
+        vTaskDelay(pdMS_TO_TICKS(LOADTEST_PRESS_MS - 100));
+    }
+    flood_running = false;
+    vTaskDelay(pdMS_TO_TICKS(200));
+
+    switch_stats_t stats;
+    switch_controller_get_stats(&stats);
+    const latency_stats_t *button = &stats.latency[CTRL_EVT_BUTTON];
+    printf("flood: sent=%lu received=%lu rate_limited=%lu global_limited=%lu\n",
+           (unsigned long)flood_sent, (unsigned long)stats.rx.received,
+           (unsigned long)stats.rx.rate_limited, (unsigned long)stats.rx.global_limited);
+    printf("button: presses=%d relayed=%lu avg=%lu us max=%lu us dropped=%lu\n",
+           presses, (unsigned long)button->count,
+           button->count ? (unsigned long)(button->total_us / button->count) : 0UL,
+           (unsigned long)button->max_us, (unsigned long)button->dropped);
+}
+
+/* ---------------- Reconnect drill ---------------- */
+#define DRILL_ATTEMPT_MS  3000      // a failed attempt takes this long to report
+#define DRILL_MAX_DEVICES 8
+
+typedef struct {
+    wifi_disc_class_t cls;
+    int failures;                // attempts that fail with cls before one succeeds
+} drill_outage_t;
+
+// AP drops off the air, reboots for a while, then a new password locks the switch out
+static const drill_outage_t drill_outages[] = {
+    { WIFI_DISC_LINK, 1 },
+    { WIFI_DISC_NO_AP, 6 },
+    { WIFI_DISC_AUTH, 6 },
+};
+
+static void sim_reconnect_drill(int devices)
+{
+    if (devices <= 0) {
+        devices = 1;
+    } else if (devices > DRILL_MAX_DEVICES) {
+        devices = DRILL_MAX_DEVICES;
+    }
+
+    for (int d = 0; d < devices; d++) {
+        uint8_t mac[6];
+        memcpy(mac, sim_mac, sizeof(mac));
+        mac[5] += d;
+        wifi_reconnect_t rc;
+        wifi_reconnect_init(&rc, mac);
+
+        int64_t now_us = 0;
+        wifi_reconnect_attempt(&rc, now_us);
+        wifi_reconnect_connected(&rc, now_us);
+        printf("device %02X:%02X:%02X:%02X:%02X:%02X\n", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+
+        for (size_t o = 0; o < sizeof(drill_outages) / sizeof(drill_outages[0]); o++) {
+            const drill_outage_t *outage = &drill_outages[o];
+            now_us += 60 * 1000000LL;          // a minute of working link between outages
+            // The link loss itself, then each failed attempt
+            for (int i = 0; i <= outage->failures; i++) {
+                uint32_t wait_ms = wifi_reconnect_disconnected(&rc, outage->cls, now_us);
+                printf("  t=%8.1f s  %-5s failed=%-2u wait=%lu ms\n", now_us / 1e6,
+                       wifi_disc_class_name(outage->cls), rc.failures, (unsigned long)wait_ms);
+                now_us += (int64_t)wait_ms * 1000;
+                if (!wifi_reconnect_due(&rc, now_us)) {
+                    printf("  retry not due at its deadline\n");
+                }
+                wifi_reconnect_attempt(&rc, now_us);
+                now_us += DRILL_ATTEMPT_MS * 1000;
+            }
+            printf("  t=%8.1f s  connected, down %lu ms\n", now_us / 1e6,
+                   (unsigned long)wifi_reconnect_connected(&rc, now_us));
+        }
+    }
+}
+
+static void sim_console(void)
+{
+    char line[512];
+
+    while (fgets(line, sizeof(line), stdin) != NULL) {
+        line[strcspn(line, "\r\n")] = '\0';
+
+        if (strncmp(line, "press", 5) == 0) {
+            int ch = 0, hold_ms = 0;
+            sscanf(line + 5, "%d %d", &ch, &hold_ms);
+            sim_press(ch, hold_ms);
+        } else if (strcmp(line, "relay") == 0) {
+            sim_print_relays();
+        } else if (strncmp(line, "ble ", 4) == 0) {
+            ble_command_dispatch(line + 4, strlen(line + 4));
+        } else if (strcmp(line, "latency") == 0) {
+            sim_print_latency();
+        } else if (strncmp(line, "history", 7) == 0) {
+            char history[SWITCH_STATS_JSON_MAX];
+            switch_controller_format_history(strtoul(line + 7, NULL, 10), SWITCH_HISTORY_UDP_PAGE,
+                                             history, sizeof(history));
+            printf("%s\n", history);
+        } else if (strncmp(line, "loadtest", 8) == 0) {
+            sim_loadtest(atoi(line + 8));
+        } else if (strncmp(line, "reconnect", 9) == 0) {
+            sim_reconnect_drill(atoi(line + 9));
+        } else if (strcmp(line, "quit") == 0) {
+            config_store_flush();
+            relay_usage_flush();
+            break;
+        } else if (line[0] != '\0') {
+            printf("commands: press <ch> [ms] | relay | ble <json> | latency | history [seq] | loadtest [s] | reconnect [n] | quit\n");
+        }
+        fflush(stdout);
+    }
+}
+
+void app_main(void)
+{
+    boot_phase_mark(BOOT_PHASE_APP);
+    ESP_LOGI(TAG, "Starting simulation - Firmware Version: %s", SW_FIRMWARE_VERSION);
+
+    snprintf(BLE_DEVICE_NAME, sizeof(BLE_DEVICE_NAME), "SE-16A-SW-%02X:%02X:%02X:%02X:%02X:%02X",
+             sim_mac[0], sim_mac[1], sim_mac[2], sim_mac[3], sim_mac[4], sim_mac[5]);
+    snprintf(DEVICE_ID, sizeof(DEVICE_ID), "%02X:%02X:%02X:%02X:%02X:%02X",
+             sim_mac[0], sim_mac[1], sim_mac[2], sim_mac[3], sim_mac[4], sim_mac[5]);
+    ESP_LOGI(TAG, "Device ID: %s", DEVICE_ID);
+
+    nvs_init();
+    config_store_init();
+    journal_init();
+    relay_usage_init();
+    boot_phase_mark(BOOT_PHASE_STORAGE);
+    gpio_init();
+    boot_phase_mark(BOOT_PHASE_RELAYS);
+    switch_controller_init();
+    boot_phase_mark(BOOT_PHASE_CONTROL);
+    wifi_init_sta();
+    boot_phase_mark(BOOT_PHASE_WIFI_START);
+    switch_controller_start_udp();
+    bluetooth_init();
+    boot_phase_mark(BOOT_PHASE_BLE);
+
+    ESP_LOGI(TAG, "Switch ready, reading commands from stdin");
+    sim_console();
+    exit(0);
+}
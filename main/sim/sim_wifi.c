@@ -0,0 +1,35 @@
+#include <string.h>
+#include "esp_log.h"
+#include "bluetooth.h"
+#include "config_store.h"
+#include "boot_phase.h"
+#include "scan_cache.h"
+
+/* Wi-Fi stand-in for the host simulation: the firmware uses the host's network directly */
+
+static const char *TAG = "sim_wifi";
+
+EventGroupHandle_t s_wifi_event_group;
+
+void wifi_init_sta(void)
+{
+    s_wifi_event_group = xEventGroupCreate();
+    ESP_LOGI(TAG, "Using the host network, UDP sockets bind on this machine");
+    boot_phase_mark(BOOT_PHASE_WIFI_IP);
+}
+
+void scan_wifi_networks(char *response)
+{
+    static scan_cache_t cache;   // the host has no radio: always the empty list
+
+    scan_cache_format(&cache, response, 1000);
+}
+
+void connect_wifi_with_new_credentials_task(void)
+{
+    ESP_LOGI(TAG, "Credentials for '%s' stored, nothing to connect to",
+             wifi_credentials.ssid ? (char *)wifi_credentials.ssid : "");
+    config_store_set_wifi((char *)wifi_credentials.ssid, (char *)wifi_credentials.password);
+    config_store_set_device_id((char *)wifi_credentials.device_id);
+    config_store_flush();
+}
@@ -1,43 +1,112 @@
 #include <string.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
-#include "freertos/timers.h"
-#include "freertos/queue.h"
+#include "freertos/semphr.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "lwip/sockets.h"
-#include "cJSON.h"
+#include "lwip/stats.h"
 #include "driver/gpio.h"
-#include "led.h"
 #include "nvs.h"
+#include "config_store.h"
+#include "journal.h"
+#include "relay_usage.h"
+#include "boot_phase.h"
+#include "wifi_stats.h"
 #include "main.h"
 #include "switch_controller.h"
+#include "cmd_parser.h"
+#include "wire_format.h"
+#include "rule_engine.h"
+#include "timer_wheel.h"
+#include "sensor_binding.h"
+#include "control_event.h"
+#include "trace.h"
+#include "rate_limit.h"
+#include "button_gesture.h"
+#include "bluetooth.h"
 
 static const char *TAG = "SWITCH_CTRL";
 
 /* ---------------- Configuration ---------------- */
-#define TEMP_DELAY_MS     60000   // 1 minute for TEMP origin
-#define MOTION_DELAY_MS   5000   // 5 secs minimum safe delay
 #define DEFAULT_DELAY_MS  6000    // Default delay
 #define UDP_BUFFER_SIZE   512
+#define UDP_HOUSEKEEPING_MS 1000  // select() timeout for periodic housekeeping
+#define UDP_BATCH_MAX     32      // datagrams drained per wake before yielding
+#define WHEEL_TICK_MS     50      // resolution of the delayed-OFF timers
+
+/* Pin map; channels beyond SWITCH_CHANNEL_COUNT are unused on smaller boards */
+const switch_channel_pins_t g_channel_pins[SWITCH_CHANNEL_COUNT] = {
+    { RELAY_PIN,   LED_PIN,     SWITCH_PIN  },
+#if SWITCH_CHANNEL_COUNT > 1
+    { GPIO_NUM_4,  GPIO_NUM_6,  GPIO_NUM_10 },
+#endif
+#if SWITCH_CHANNEL_COUNT > 2
+    { GPIO_NUM_1,  GPIO_NUM_NC, GPIO_NUM_0  },
+    { GPIO_NUM_18, GPIO_NUM_NC, GPIO_NUM_19 },
+#endif
+};
 
 /* ---------------- Global Variables ---------------- */
-static TimerHandle_t off_timer = NULL;
+typedef struct {
+    uint8_t index;
+    bool state;                  // false = OFF, true = ON
+    bool last_command_was_on;    // Track last command to avoid duplicates
+    uint8_t reason;              // rule_reason_t of the last sensor decision, for the journal
+    uint32_t delay_ms;
+    timer_wheel_entry_t off_timer;
+} switch_channel_t;
+
+static switch_channel_t channels[SWITCH_CHANNEL_COUNT];
 
-static uint32_t current_delay_ms = DEFAULT_DELAY_MS;
-static bool current_switch_state = false; // false = OFF, true = ON
-static bool last_command_was_on = false; // Track last command to avoid duplicates
+/* All delayed-OFF timers share one wheel, advanced by one esp_timer */
+static timer_wheel_t off_wheel;
+static esp_timer_handle_t wheel_timer = NULL;
+static int64_t wheel_epoch_us;   // esp_timer time of wheel tick 0
+
+/* Control task: sole owner of channels[], the wheel and the relay GPIOs */
+static ctrl_ring_t ctrl_ring;
+static TaskHandle_t ctrl_task_handle = NULL;
+static int64_t relay_set_us;     // when the event being handled last drove a relay, 0 if not
+static uint8_t relay_set_channel;
+static uint8_t relay_source;     // ctrl_event_type_t of the event being handled
+static latency_stats_t ctrl_latency[CTRL_EVT_COUNT];
+static atomic_uint ctrl_dropped[CTRL_EVT_COUNT];   // bumped by every producer task
+static uint32_t ctrl_duplicates;
+static uint32_t relay_transitions;
 
 int8_t g_temperature_threshold = 0; // Global temperature threshold
 uint16_t g_lux_threshold = 0; // Global light threshold (0-3000)
-char g_switch_mode[10] = "OFF"; // Default to Auto mode
-char g_device_id[32] = {0}; // Global device ID
+switch_mode_t g_switch_mode = SWITCH_MODE_OFF; // Default to Auto mode
+char g_device_id[32] = {0}; // Global device ID (sensor bound to channel 0)
+
+/* Button handling: edges captured by the ISR, consumed by the button task */
+#define BUTTON_EDGE_RING_SIZE 16    // power of two
+#define BUTTON_EDGE_RING_MASK (BUTTON_EDGE_RING_SIZE - 1)
 
-/* Button handling */
-static QueueHandle_t gpio_evt_queue = NULL;
-static const TickType_t DEBOUNCE_TICKS = pdMS_TO_TICKS(50);
+typedef struct {
+    uint8_t channel;
+    bool pressed;                // pin level sampled in the ISR (active low)
+    int64_t timestamp_us;        // time of the edge
+} button_edge_t;
+
+static button_edge_t button_edges[BUTTON_EDGE_RING_SIZE];
+static atomic_uint button_edge_head;     // ISR only
+static atomic_uint button_edge_tail;     // button task only
+static atomic_bool button_edge_overflow;
+static TaskHandle_t button_task_handle = NULL;
+static button_gesture_t button_gestures[SWITCH_CHANNEL_COUNT];
 
 sensor_config_t g_sensor_config;
 
+/*
+ * Decision table. The control task evaluates it for every sensor event while
+ * the BLE command worker may replace it, so both sides hold rule_lock; the
+ * lock only covers an 84-byte copy or one row lookup.
+ */
+static rule_table_t rule_table;
+static SemaphoreHandle_t rule_lock = NULL;
+
 /* ---------------- Updating Functions ---------------- */
 void update_temperature_threshold(int8_t new_threshold) {
     g_temperature_threshold = new_threshold;
@@ -45,202 +114,730 @@ void update_temperature_threshold(int8_t new_threshold) {
 }
 
 void update_presence_switch_state(char *new_state){
-    strncpy(g_switch_mode, new_state, sizeof(g_switch_mode) - 1);
-    g_switch_mode[sizeof(g_switch_mode) - 1] = '\0';
-    ESP_LOGI(TAG, "Presence switch state updated to: %s", g_switch_mode);
+    g_switch_mode = switch_mode_from_string(new_state);
+    ESP_LOGI(TAG, "Presence switch state updated to: %s", switch_mode_name(g_switch_mode));
 }
 
 void update_light_threshold(uint16_t new_threshold){
     g_lux_threshold = new_threshold;
     ESP_LOGI(TAG, "Light threshold updated to: %d", g_lux_threshold);
 }
+
+esp_err_t switch_controller_set_rule_table(const rule_table_t *table)
+{
+    if (!rule_table_validate(table)) {
+        ESP_LOGW(TAG, "Rejected invalid rule table");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    xSemaphoreTake(rule_lock, portMAX_DELAY);
+    rule_table = *table;
+    xSemaphoreGive(rule_lock);
+    ESP_LOGI(TAG, "Rule table updated");
+
+    return nvs_store_rule_table(table);
+}
+
+void switch_controller_get_rule_table(rule_table_t *table)
+{
+    xSemaphoreTake(rule_lock, portMAX_DELAY);
+    *table = rule_table;
+    xSemaphoreGive(rule_lock);
+}
 /* ---------------- Helper Functions ---------------- */
-void set_switch_state(bool on)
+/* Usage attribution of the event being handled */
+static usage_origin_t relay_usage_origin(uint8_t channel)
 {
+    switch (relay_source) {
+        case CTRL_EVT_BUTTON:   return USAGE_ORIGIN_BUTTON;
+        case CTRL_EVT_OVERRIDE: return USAGE_ORIGIN_OVERRIDE;
+        default:
+            break;
+    }
+    switch (channels[channel].reason) {
+        case RULE_REASON_TEMP:     return USAGE_ORIGIN_TEMP;
+        case RULE_REASON_PRESENCE: return USAGE_ORIGIN_PRESENCE;
+        case RULE_REASON_LUX:      return USAGE_ORIGIN_LUX;
+        default:                   return USAGE_ORIGIN_OTHER;
+    }
+}
+
+/* Control task only */
+static void set_channel_state(uint8_t channel, bool on)
+{
+    if (channel >= SWITCH_CHANNEL_COUNT) {
+        return;
+    }
+    const switch_channel_pins_t *pins = &g_channel_pins[channel];
     int level = on ? 1 : 0;
-    ESP_LOGI(TAG, "Setting physical RELAY/LED to %d", level);
+    ESP_LOGD(TAG, "Setting physical RELAY/LED of channel %d to %d", channel, level);
     // Set relay and status LED GPIOs
-    gpio_set_level(RELAY_PIN, level);
-    gpio_set_level(LED_PIN, level);
+    gpio_set_level(pins->relay, level);
+    if (pins->led != GPIO_NUM_NC) {
+        gpio_set_level(pins->led, level);
+    }
+    relay_set_us = esp_timer_get_time();
+    relay_set_channel = channel;
 
-    current_switch_state = on;
+    if (channels[channel].state != on) {
+        relay_transitions++;
+        uint8_t origin = (relay_source == CTRL_EVT_SENSOR || relay_source == CTRL_EVT_TIMER) ?
+                         channels[channel].reason : RULE_REASON_NONE;
+        journal_append(channel, on, relay_source, origin);
+        relay_usage_switch(channel, on, relay_usage_origin(channel));
+    }
+    channels[channel].state = on;
     // if(on){
     //     rgb_led_set_blue();
     // }else{
     //     rgb_led_set_orange();
     // }
 
-    ESP_LOGI(TAG, "Switch %s", on ? "ON" : "OFF");
+    ESP_LOGD(TAG, "Switch %d %s", channel, on ? "ON" : "OFF");
 }
 
-/* ---------------- Timer Callback ---------------- */
-static void off_timer_callback(TimerHandle_t xTimer)
+void set_switch_state(bool on)
 {
-    set_switch_state(false);
-    ESP_LOGI(TAG, "Switch OFF (delayed)");
+    switch_controller_override(0, on);
 }
 
-/* ---------------- Sensor Data Processor ---------------- */
-void process_sensor_data(const char *sensor_json)
+bool switch_controller_get_channel_state(uint8_t channel)
 {
-    if (!sensor_json) {
-        ESP_LOGW(TAG, "Invalid sensor data");
-        return;
+    return channel < SWITCH_CHANNEL_COUNT && channels[channel].state;
+}
+
+/* ---------------- Event Posting ---------------- */
+static bool ctrl_post(ctrl_event_t *event)
+{
+    // Sensor and timer events cannot fill the last cells: a press always finds room
+    bool urgent = (event->type == CTRL_EVT_BUTTON || event->type == CTRL_EVT_OVERRIDE);
+    unsigned int headroom = urgent ? 0 : CTRL_RING_RESERVED;
+
+    if (ctrl_task_handle == NULL || !ctrl_ring_push(&ctrl_ring, event, headroom)) {
+        atomic_fetch_add_explicit(&ctrl_dropped[event->type], 1, memory_order_relaxed);
+        trace_record(TRACE_CTRL_DROP, event->type, event->channel, 0);
+        return false;
     }
+    xTaskNotifyGive(ctrl_task_handle);
+    return true;
+}
 
-    cJSON *sensor_data = cJSON_Parse(sensor_json);
-    if (!sensor_data) {
-        ESP_LOGW(TAG, "Failed to parse sensor JSON");
-        return;
+esp_err_t switch_controller_override(uint8_t channel, bool on)
+{
+    if (channel >= SWITCH_CHANNEL_COUNT) {
+        return ESP_ERR_INVALID_ARG;
     }
+    ctrl_event_t event = {
+        .type = CTRL_EVT_OVERRIDE,
+        .channel = channel,
+        .on = on,
+        .timestamp_us = esp_timer_get_time(),
+    };
+    return ctrl_post(&event) ? ESP_OK : ESP_ERR_NO_MEM;
+}
 
-    cJSON *presence = cJSON_GetObjectItem(sensor_data, "presence_detected");
-    cJSON *motion = cJSON_GetObjectItem(sensor_data, "motion_detected");
-    cJSON *temperature = cJSON_GetObjectItem(sensor_data, "temperature");
-    cJSON *lux = cJSON_GetObjectItem(sensor_data, "lux");
+static void post_sensor_reading(uint8_t channel, const sensor_reading_t *reading, int64_t timestamp_us)
+{
+    ctrl_event_t event = {
+        .type = CTRL_EVT_SENSOR,
+        .channel = channel,
+        .timestamp_us = timestamp_us,
+        .reading = *reading,
+    };
+    if (!ctrl_post(&event)) {
+        ESP_LOGD(TAG, "Control queue full, sensor update for channel %d dropped", channel);
+    }
+}
 
-    bool presence_detected = presence && cJSON_IsBool(presence) ? cJSON_IsTrue(presence) : false;
-    bool motion_detected = motion && cJSON_IsBool(motion) ? cJSON_IsTrue(motion) : false;
-    float temp_value = temperature && cJSON_IsNumber(temperature) ? (float)cJSON_GetNumberValue(temperature) : 0.0;
-    float lux_value = lux && cJSON_IsNumber(lux) ? (float)cJSON_GetNumberValue(lux) : 0.0;
+void switch_controller_get_latency(ctrl_event_type_t source, latency_stats_t *stats)
+{
+    if (source < CTRL_EVT_COUNT) {
+        *stats = ctrl_latency[source];
+        stats->dropped = atomic_load_explicit(&ctrl_dropped[source], memory_order_relaxed);
+    }
+}
 
-    ESP_LOGI(TAG, "Sensor data - Presence: %s, Temp: %.2f°C, Threshold: %d°C", 
-             (motion_detected || presence_detected) ? "YES" : "NO", temp_value, g_temperature_threshold);
+/* ---------------- Statistics ---------------- */
+static udp_rx_stats_t udp_rx_stats;
 
-    // Determine switch action based on conditions
-    bool should_turn_on = false;
-    const char* trigger_reason = "NONE";
-    
-    if (g_temperature_threshold != 0) {
-        if (temp_value >= g_temperature_threshold) {
-            // Temperature exceeds threshold
-            ESP_LOGW(TAG, "Temperature %.2f°C exceeds threshold %d°C", temp_value, g_temperature_threshold);
-            if (strcmp(g_switch_mode, "ON") == 0) {
-                // Switch mode ON + temp exceeded -> use presence for decision
-                if (presence_detected || motion_detected) {
-                    should_turn_on = true;
-                    trigger_reason = "PRESENCE";
-                    current_delay_ms = MOTION_DELAY_MS;
-                } else {
-                    should_turn_on = false;
-                    trigger_reason = "PRESENCE"; // temp ON but above threshold + presence OFF -> OFF (reason: PRESENCE)
-                    current_delay_ms = MOTION_DELAY_MS;
-                }
-            } else {
-                // Switch mode OFF + temp exceeded -> turn OFF
-                should_turn_on = false;
-                trigger_reason = "PRESENCE";
-                current_delay_ms = MOTION_DELAY_MS;
-            }
-        } else {
-            // Temperature below threshold -> turn OFF
-            should_turn_on = false;
-            trigger_reason = "TEMP"; // temp ON but below threshold -> OFF (reason: TEMP)
-            current_delay_ms = TEMP_DELAY_MS;
+void switch_controller_get_rx_stats(udp_rx_stats_t *stats)
+{
+    *stats = udp_rx_stats;
+#if LWIP_STATS && UDP_STATS
+    stats->dropped = lwip_stats.udp.drop;
+#endif
+}
+
+void switch_controller_get_stats(switch_stats_t *stats)
+{
+    switch_controller_get_rx_stats(&stats->rx);
+    stats->duplicates = ctrl_duplicates;
+    stats->relay_transitions = relay_transitions;
+    config_store_stats_t config_stats;
+    config_store_get_stats(&config_stats);
+    stats->settings_writes = config_stats.flash_writes;
+    stats->settings_saved = config_stats.writes_saved;
+    for (int type = 0; type < CTRL_EVT_COUNT; type++) {
+        switch_controller_get_latency(type, &stats->latency[type]);
+    }
+}
+
+/*
+ * Counters are written without locks by their owning task; a reset that
+ * races an update may leave that one update behind, which is fine here.
+ */
+void switch_controller_reset_stats(void)
+{
+    memset(&udp_rx_stats, 0, sizeof(udp_rx_stats));
+    memset(ctrl_latency, 0, sizeof(ctrl_latency));
+    for (int type = 0; type < CTRL_EVT_COUNT; type++) {
+        atomic_store_explicit(&ctrl_dropped[type], 0, memory_order_relaxed);
+    }
+    ctrl_duplicates = 0;
+    relay_transitions = 0;
+    config_store_reset_stats();
+    ESP_LOGI(TAG, "Statistics reset");
+}
+
+int switch_controller_format_stats(char *buf, size_t size)
+{
+    switch_stats_t stats;
+    switch_controller_get_stats(&stats);
+
+    size_t n = snprintf(buf, size,
+                        "{\"rx\":%lu,\"rl_src\":%lu,\"rl_all\":%lu,\"parse_err\":%lu,\"id_mismatch\":%lu,"
+                        "\"seq_dup\":%lu,\"seq_ooo\":%lu,\"seq_stale\":%lu,\"restarts\":%lu,\"collapsed\":%lu,"
+                        "\"lwip_drop\":%lu,\"dup\":%lu,\"relay\":%lu,\"cfg_wr\":%lu,\"cfg_saved\":%lu,\"lat\":{",
+                        (unsigned long)stats.rx.received, (unsigned long)stats.rx.rate_limited,
+                        (unsigned long)stats.rx.global_limited, (unsigned long)stats.rx.parse_errors,
+                        (unsigned long)stats.rx.id_mismatch, (unsigned long)stats.rx.seq_duplicate,
+                        (unsigned long)stats.rx.seq_reordered, (unsigned long)stats.rx.seq_stale,
+                        (unsigned long)stats.rx.sender_restarts, (unsigned long)stats.rx.collapsed,
+                        (unsigned long)stats.rx.dropped, (unsigned long)stats.duplicates,
+                        (unsigned long)stats.relay_transitions, (unsigned long)stats.settings_writes,
+                        (unsigned long)stats.settings_saved);
+
+    for (int type = 0; type < CTRL_EVT_COUNT && n < size; type++) {
+        const latency_stats_t *lat = &stats.latency[type];
+        int used = LATENCY_BUCKET_COUNT;
+        while (used > 0 && lat->buckets[used - 1] == 0) {
+            used--;
         }
-    } else {
-        // No temperature threshold set - use switch mode
-        if (strcmp(g_switch_mode, "ON") == 0) {
-            if (presence_detected || motion_detected) {
-                should_turn_on = true;
-                trigger_reason = "PRESENCE";
-                current_delay_ms = MOTION_DELAY_MS;
-            } else {
-                should_turn_on = false;
-                trigger_reason = "PRESENCE";
-                current_delay_ms = MOTION_DELAY_MS;
-            }
-        } else {
-            // Switch mode OFF -> turn OFF
-            should_turn_on = false;
-            trigger_reason = "PRESENCE";
-            current_delay_ms = MOTION_DELAY_MS;
+
+        n += snprintf(buf + n, size - n, "%s\"%s\":{\"n\":%lu,\"avg\":%lu,\"max\":%lu,\"drop\":%lu,\"h\":[",
+                      type ? "," : "", ctrl_event_type_name(type), (unsigned long)lat->count,
+                      (unsigned long)(lat->count ? lat->total_us / lat->count : 0),
+                      (unsigned long)lat->max_us, (unsigned long)lat->dropped);
+        for (int b = 0; b < used && n < size; b++) {
+            n += snprintf(buf + n, size - n, "%s%lu", b ? "," : "", (unsigned long)lat->buckets[b]);
+        }
+        if (n < size) {
+            n += snprintf(buf + n, size - n, "]}");
         }
     }
-    if(g_lux_threshold >= 5){
-        if(strcmp(g_switch_mode, "ON") == 0){
-            if((presence_detected || motion_detected) && (lux_value <= g_lux_threshold)){
-                // Dark (lux ≤ threshold) + presence detected -> turn ON
-                should_turn_on = true;
-                trigger_reason = "LUX";
-            }
-            else{
-                // Bright (lux > threshold) OR no presence -> turn OFF
-                should_turn_on = false;
-                trigger_reason = "LUX";
-                current_delay_ms = MOTION_DELAY_MS;
+    if (n < size) {
+        n += snprintf(buf + n, size - n, "}}");
+    }
+    return n < size ? (int)n : (int)size - 1;
+}
+
+int switch_controller_format_history(uint32_t before, int max, char *buf, size_t size)
+{
+    journal_record_t records[SWITCH_HISTORY_UDP_PAGE];
+    if (max > SWITCH_HISTORY_UDP_PAGE) {
+        max = SWITCH_HISTORY_UDP_PAGE;
+    }
+    int count = journal_read(before, records, max);
+
+    size_t n = snprintf(buf, size, "{\"history\":[");
+    for (int i = 0; i < count && n < size; i++) {
+        const journal_record_t *r = &records[i];
+        n += snprintf(buf + n, size - n, "%s{\"seq\":%lu,\"%s\":%lu,\"ch\":%u,\"on\":%s,\"src\":\"%s\",\"why\":\"%s\"}",
+                      i ? "," : "", (unsigned long)r->seq, (r->flags & JOURNAL_FLAG_WALL_CLOCK) ? "t" : "up",
+                      (unsigned long)r->time,
+                      r->channel, (r->flags & JOURNAL_FLAG_ON) ? "true" : "false",
+                      r->source == JOURNAL_SOURCE_POWER_ON ? "power_on" : ctrl_event_type_name(r->source),
+                      rule_reason_name(r->origin));
+    }
+    if (n < size) {
+        n += snprintf(buf + n, size - n, "],\"next\":%lu,\"last\":%s}",
+                      count ? (unsigned long)records[count - 1].seq : 0UL, count < max ? "true" : "false");
+    }
+    return n < size ? (int)n : (int)size - 1;
+}
+
+bool switch_controller_power_on_state(uint8_t channel)
+{
+    device_config_t config;
+    config_store_get(&config);
+
+    bool on = false;
+    switch (config.power_on) {
+        case CONFIG_POWER_ON_ON:
+            on = true;
+            break;
+        case CONFIG_POWER_ON_RESTORE:
+            if (!journal_last_state(channel, &on)) {
+                on = false;
             }
-        }
+            break;
+        default:
+            break;
+    }
+    return on;
+}
+
+/* ---------------- Timer Wheel ---------------- */
+static uint32_t wheel_ticks_now(void)
+{
+    return (uint32_t)((esp_timer_get_time() - wheel_epoch_us) / (WHEEL_TICK_MS * 1000));
+}
+
+/* esp_timer task: hand the tick to the control task, which owns the wheel */
+static void wheel_timer_callback(void *arg)
+{
+    ctrl_event_t event = {
+        .type = CTRL_EVT_TIMER,
+        .timestamp_us = esp_timer_get_time(),
+    };
+    // A dropped tick is harmless: the next one catches up
+    ctrl_post(&event);
+}
+
+static void wheel_tick(void)
+{
+    // Catch up on any ticks that were late or dropped
+    timer_wheel_advance(&off_wheel, wheel_ticks_now() - off_wheel.now);
+    if (timer_wheel_empty(&off_wheel)) {
+        // Nothing pending: stop ticking until the next OFF is scheduled
+        esp_timer_stop(wheel_timer);
+    }
+}
+
+static void off_timer_callback(timer_wheel_entry_t *entry, void *arg)
+{
+    switch_channel_t *ch = arg;
+    trace_record(TRACE_OFF_TIMER_FIRE, ch->index, 0, 0);
+    set_channel_state(ch->index, false);
+    ESP_LOGD(TAG, "Switch %d OFF (delayed)", ch->index);
+}
+
+static void off_timer_start(switch_channel_t *ch, uint32_t delay_ms)
+{
+    if (!esp_timer_is_active(wheel_timer)) {
+        // The wheel was idle: realign its clock so tick counting resumes from now
+        wheel_epoch_us = esp_timer_get_time() - (int64_t)off_wheel.now * WHEEL_TICK_MS * 1000;
+        esp_timer_start_periodic(wheel_timer, WHEEL_TICK_MS * 1000);
+    }
+    timer_wheel_schedule(&off_wheel, &ch->off_timer, (delay_ms + WHEEL_TICK_MS - 1) / WHEEL_TICK_MS);
+}
+
+static bool off_timer_stop(switch_channel_t *ch)
+{
+    bool was_pending = timer_wheel_pending(&ch->off_timer);
+    timer_wheel_cancel(&off_wheel, &ch->off_timer);
+    return was_pending;
+}
+
+/* ---------------- Sensor Data Processor ---------------- */
+/* Control task only */
+static void process_sensor_data(uint8_t channel, const sensor_reading_t *reading)
+{
+    if (!reading || channel >= SWITCH_CHANNEL_COUNT) {
+        ESP_LOGW(TAG, "Invalid sensor data");
+        return;
+    }
+
+    switch_channel_t *ch = &channels[channel];
+    bool presence_detected = reading->presence_detected;
+    bool motion_detected = reading->motion_detected;
+    float temp_value = reading->temperature;
+
+    ESP_LOGD(TAG, "Sensor data (channel %d) - Presence: %s, Temp: %.2f°C, Threshold: %d°C", channel,
+             (motion_detected || presence_detected) ? "YES" : "NO", temp_value, g_temperature_threshold);
+
+    // Constant-time lookup in the decision table
+    rule_decision_t decision;
+    uint8_t inputs = rule_inputs(reading, g_temperature_threshold, g_lux_threshold, g_switch_mode);
+    xSemaphoreTake(rule_lock, portMAX_DELAY);
+    rule_evaluate(&rule_table, inputs, &decision);
+    xSemaphoreGive(rule_lock);
+    trace_record(TRACE_SENSOR_EVAL, channel, inputs, decision.turn_on | (decision.reason << 8));
+
+    bool should_turn_on = decision.turn_on;
+    const char* trigger_reason = rule_reason_name(decision.reason);
+    ch->reason = decision.reason;
+    if (!should_turn_on) {
+        ch->delay_ms = decision.off_delay_ms;
     }
 
     // Execute command with deduplication
     if (should_turn_on) {
         // ON command - execute only if not already ON
-        if (!last_command_was_on) {
-            if (off_timer && xTimerIsTimerActive(off_timer)) {
-                xTimerStop(off_timer, 0);
-                ESP_LOGI(TAG, "OFF timer stopped");
+        if (!ch->last_command_was_on) {
+            if (off_timer_stop(ch)) {
+                ESP_LOGD(TAG, "OFF timer stopped");
             }
-            set_switch_state(true);
-            last_command_was_on = true;
-            ESP_LOGI(TAG, "Switch ON triggered by %s", trigger_reason);
+            set_channel_state(channel, true);
+            ch->last_command_was_on = true;
+            ESP_LOGD(TAG, "Switch %d ON triggered by %s", channel, trigger_reason);
         } else {
+            ctrl_duplicates++;
             ESP_LOGD(TAG, "ON command ignored - already ON");
         }
     } else {
         // OFF command - execute only if not already processing OFF
-        if (last_command_was_on) {
-            if (off_timer) {
-                ESP_LOGI(TAG, "Starting OFF timer - %s (delay: %lu ms)", trigger_reason, current_delay_ms);
-                xTimerStop(off_timer, 0);
-                xTimerChangePeriod(off_timer, pdMS_TO_TICKS(current_delay_ms), 0);
-                xTimerStart(off_timer, 0);
-                last_command_was_on = false;
-            }
+        if (ch->last_command_was_on) {
+            ESP_LOGD(TAG, "Starting OFF timer - %s (delay: %lu ms)", trigger_reason, (unsigned long)ch->delay_ms);
+            trace_record(TRACE_OFF_TIMER_START, channel, 0, ch->delay_ms);
+            off_timer_start(ch, ch->delay_ms);
+            ch->last_command_was_on = false;
         } else {
+            ctrl_duplicates++;
             ESP_LOGD(TAG, "OFF command ignored - already processing OFF");
         }
     }
-    
-    cJSON_Delete(sensor_data);
 }
 
 /* ---------------- Button ISR and task ---------------- */
 static void IRAM_ATTR gpio_isr_handler(void *arg)
 {
-    uint32_t gpio_num = (uint32_t)arg;
+    uint32_t channel = (uint32_t)(uintptr_t)arg;
+    unsigned int head = atomic_load_explicit(&button_edge_head, memory_order_relaxed);
+
+    // Single producer: GPIO interrupts do not nest
+    if (head - atomic_load_explicit(&button_edge_tail, memory_order_acquire) < BUTTON_EDGE_RING_SIZE) {
+        button_edge_t *edge = &button_edges[head & BUTTON_EDGE_RING_MASK];
+        edge->channel = channel;
+        edge->pressed = gpio_get_level(g_channel_pins[channel].button) == 0;
+        edge->timestamp_us = esp_timer_get_time();
+        atomic_store_explicit(&button_edge_head, head + 1, memory_order_release);
+    } else {
+        atomic_store_explicit(&button_edge_overflow, true, memory_order_relaxed);
+    }
+
     BaseType_t xHigherPriorityTaskWoken = pdFALSE;
-    if (gpio_evt_queue) {
-        xQueueSendFromISR(gpio_evt_queue, &gpio_num, &xHigherPriorityTaskWoken);
+    if (button_task_handle) {
+        vTaskNotifyGiveFromISR(button_task_handle, &xHigherPriorityTaskWoken);
     }
     if (xHigherPriorityTaskWoken) {
         portYIELD_FROM_ISR();
     }
 }
 
+static void button_handle_events(uint8_t channel, uint32_t events, int64_t time_us)
+{
+    if (events == 0) {
+        return;
+    }
+    trace_record(TRACE_BUTTON, channel, events, button_gestures[channel].pressed);
+
+    if (events & BUTTON_EVT_PRESS) {
+        // Acted on at the first edge; the control task toggles relay and LED
+        ctrl_event_t event = {
+            .type = CTRL_EVT_BUTTON,
+            .channel = channel,
+            .timestamp_us = time_us,
+        };
+        ctrl_post(&event);
+        ESP_LOGD(TAG, "Button press on channel %u", channel);
+    }
+    if (events & BUTTON_EVT_DOUBLE) {
+        ESP_LOGI(TAG, "Double press on channel %u", channel);
+    }
+    if (events & BUTTON_EVT_LONG) {
+        ESP_LOGI(TAG, "Long press on channel %u, advertising for provisioning", channel);
+        bluetooth_start_advertising();
+    }
+}
+
 static void button_task(void *pvParameter)
 {
-    uint32_t io_num;
+    for (int i = 0; i < SWITCH_CHANNEL_COUNT; i++) {
+        button_gesture_init(&button_gestures[i], gpio_get_level(g_channel_pins[i].button) == 0);
+    }
+
     for (;;) {
-        if (xQueueReceive(gpio_evt_queue, &io_num, portMAX_DELAY)) {
-            // Debounce: wait briefly then confirm state
-            vTaskDelay(DEBOUNCE_TICKS);
-            int level = gpio_get_level((gpio_num_t)io_num);
-            // Button is active LOW: pressed -> level == 0
-            if (level == 0) {
-                // Toggle relay and LED
-                bool new_state = !current_switch_state;
-                set_switch_state(new_state);
-                ESP_LOGI(TAG, "Button press detected on GPIO %lu, toggled to %s", io_num, new_state ? "ON" : "OFF");
+        // Sleep until an edge arrives or the earliest gesture deadline is due
+        int64_t now = esp_timer_get_time();
+        int64_t deadline = 0;
+        for (int i = 0; i < SWITCH_CHANNEL_COUNT; i++) {
+            int64_t d = button_gesture_deadline(&button_gestures[i]);
+            if (d != 0 && (deadline == 0 || d < deadline)) {
+                deadline = d;
+            }
+        }
+        TickType_t wait = portMAX_DELAY;
+        if (deadline != 0) {
+            wait = deadline > now ? pdMS_TO_TICKS((deadline - now + 999) / 1000) + 1 : 0;
+        }
+        ulTaskNotifyTake(pdTRUE, wait);
+
+        unsigned int tail = atomic_load_explicit(&button_edge_tail, memory_order_relaxed);
+        while (tail != atomic_load_explicit(&button_edge_head, memory_order_acquire)) {
+            button_edge_t edge = button_edges[tail & BUTTON_EDGE_RING_MASK];
+            atomic_store_explicit(&button_edge_tail, ++tail, memory_order_release);
+            uint32_t events = button_gesture_edge(&button_gestures[edge.channel], edge.pressed,
+                                                  edge.timestamp_us);
+            button_handle_events(edge.channel, events, edge.timestamp_us);
+        }
+
+        now = esp_timer_get_time();
+        bool resync = atomic_exchange_explicit(&button_edge_overflow, false, memory_order_relaxed);
+        for (int i = 0; i < SWITCH_CHANNEL_COUNT; i++) {
+            uint32_t events = 0;
+            if (resync) {
+                // Edges were lost: feed the current pin level as a fresh edge
+                bool pressed = gpio_get_level(g_channel_pins[i].button) == 0;
+                events = button_gesture_edge(&button_gestures[i], pressed, now);
             } else {
-                // Release or bounce - ignore
-                ESP_LOGW(TAG, "GPIO %lu event but level=%d (ignored)", io_num, level);
+                events = button_gesture_poll(&button_gestures[i], now);
+            }
+            button_handle_events(i, events, now);
+        }
+    }
+}
+
+/* ---------------- Control Task ---------------- */
+static unsigned int latency_bucket(uint32_t us)
+{
+    unsigned int bucket = (us == 0) ? 0 : 32 - __builtin_clz(us);
+    return bucket < LATENCY_BUCKET_COUNT ? bucket : LATENCY_BUCKET_COUNT - 1;
+}
+
+static void control_handle_event(const ctrl_event_t *event)
+{
+    switch_channel_t *ch = &channels[event->channel];
+
+    switch (event->type) {
+        case CTRL_EVT_BUTTON: {
+            // Toggle relay and LED; a pending delayed OFF must not undo the press
+            bool new_state = !ch->state;
+            off_timer_stop(ch);
+            set_channel_state(event->channel, new_state);
+            ch->last_command_was_on = new_state;   // sensor dedup follows the relay
+            ESP_LOGD(TAG, "Button toggled channel %d to %s", event->channel, new_state ? "ON" : "OFF");
+            break;
+        }
+        case CTRL_EVT_SENSOR:
+            process_sensor_data(event->channel, &event->reading);
+            break;
+        case CTRL_EVT_TIMER:
+            wheel_tick();
+            break;
+        case CTRL_EVT_OVERRIDE:
+            // Manual control wins over a pending delayed OFF
+            off_timer_stop(ch);
+            set_channel_state(event->channel, event->on);
+            ch->last_command_was_on = event->on;
+            break;
+        default:
+            break;
+    }
+}
+
+static void control_task(void *pvParameters)
+{
+    ctrl_event_t event;
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        while (ctrl_ring_pop(&ctrl_ring, &event)) {
+            if (event.type >= CTRL_EVT_COUNT || event.channel >= SWITCH_CHANNEL_COUNT) {
+                continue;
+            }
+            relay_set_us = 0;
+            relay_source = event.type;
+            control_handle_event(&event);
+
+            // Source-to-relay latency, only for events that actually drove a relay
+            if (relay_set_us != 0) {
+                latency_stats_t *lat = &ctrl_latency[event.type];
+                uint32_t us = (uint32_t)(relay_set_us - event.timestamp_us);
+                lat->count++;
+                lat->total_us += us;
+                if (us > lat->max_us) {
+                    lat->max_us = us;
+                }
+                lat->buckets[latency_bucket(us)]++;
+                trace_record(TRACE_RELAY, relay_set_channel,
+                             channels[relay_set_channel].state | (event.type << 8), us);
             }
         }
     }
 }
 
 /* ---------------- UDP Receiver Task ---------------- */
+// Sender of the datagram being handled, for replies to requests
+typedef struct {
+    int sock;
+    const struct sockaddr_in *addr;
+} udp_peer_t;
+
+static void udp_handle_request(const udp_peer_t *peer, const udp_command_t *command)
+{
+    static char reply[SWITCH_STATS_JSON_MAX];
+    const char *cmd = command->cmd;
+    size_t cmd_len = command->cmd_len;
+    int len;
+
+    if (cmd_field_equals(cmd, cmd_len, "stats")) {
+        len = switch_controller_format_stats(reply, sizeof(reply));
+    } else if (cmd_field_equals(cmd, cmd_len, "trace")) {
+        // One page from the "from" cursor per request; the client asks again for the rest
+        uint32_t cursor = command->from;
+        len = (int)trace_dump_page(&cursor, (uint8_t *)reply,
+                                   TRACE_PAGE_HEADER + SWITCH_TRACE_UDP_PAGE * sizeof(trace_record_t));
+        if (sendto(peer->sock, reply, len, 0, (const struct sockaddr *)peer->addr, sizeof(*peer->addr)) < 0) {
+            ESP_LOGW(TAG, "Failed to send trace page: errno %d", errno);
+        }
+        return;
+    } else if (cmd_field_equals(cmd, cmd_len, "history")) {
+        len = switch_controller_format_history(command->before, SWITCH_HISTORY_UDP_PAGE, reply, sizeof(reply));
+    } else if (cmd_field_equals(cmd, cmd_len, "boot")) {
+        len = boot_phase_format(reply, sizeof(reply));
+    } else if (cmd_field_equals(cmd, cmd_len, "wifi")) {
+        len = wifi_stats_format(reply, sizeof(reply));
+    } else if (cmd_field_equals(cmd, cmd_len, "usage")) {
+        len = relay_usage_format(command->channel, reply, sizeof(reply));
+    } else if (cmd_field_equals(cmd, cmd_len, "reset_stats")) {
+        switch_controller_reset_stats();
+        len = snprintf(reply, sizeof(reply), "{\"stats_status\":\"reset\"}");
+    } else {
+        ESP_LOGD(TAG, "Unknown UDP request: %.*s", (int)cmd_len, cmd);
+        return;
+    }
+
+    if (sendto(peer->sock, reply, len, 0, (const struct sockaddr *)peer->addr, sizeof(*peer->addr)) < 0) {
+        ESP_LOGW(TAG, "Failed to send UDP reply: errno %d", errno);
+    }
+}
+
+/* Decode one datagram into a sensor reading; false if it is not a sensor packet */
+static bool udp_decode_packet(const udp_peer_t *peer, char *buffer, int len, uint8_t mac[6],
+                              uint8_t *channel, sensor_reading_t *reading, sensor_seq_t *seq)
+{
+    // Binary frames are recognised by their first byte and never reach the JSON parser
+    if (wire_is_binary((const uint8_t *)buffer, len)) {
+        wire_frame_t frame;
+        if (!wire_decode((const uint8_t *)buffer, len, &frame)) {
+            ESP_LOGD(TAG, "Invalid binary frame (len %d, version %d)", len, len > 1 ? buffer[1] : -1);
+            udp_rx_stats.parse_errors++;
+            trace_record(TRACE_UDP_REJECT, TRACE_REJECT_PARSE, 0, 0);
+            return false;
+        }
+        memcpy(mac, frame.device_mac, 6);
+        *channel = frame.channel;
+        *reading = frame.reading;
+        *seq = frame.seq;
+        return true;
+    }
+
+    ESP_LOGD(TAG, "Received UDP: %s", buffer);
+
+    // Single pass over the receive buffer, no heap allocation
+    udp_command_t cmd;
+    if (!cmd_parse_udp_packet(buffer, len, &cmd)) {
+        ESP_LOGD(TAG, "Invalid or missing JSON fields");
+        udp_rx_stats.parse_errors++;
+        trace_record(TRACE_UDP_REJECT, TRACE_REJECT_PARSE, 0, 0);
+        return false;
+    }
+    if (cmd.fields & CMD_FIELD_CMD) {
+        udp_handle_request(peer, &cmd);
+        return false;
+    }
+
+    if (!cmd_field_equals(cmd.source, cmd.source_len, "AIOS_SENSOR") ||
+        !wire_mac_from_string(cmd.device_id, cmd.device_id_len, mac)) {
+        ESP_LOGD(TAG, "Ignored packet (source/device mismatch) source: %.*s, device_id: %.*s",
+                 (int)cmd.source_len, cmd.source, (int)cmd.device_id_len, cmd.device_id);
+        udp_rx_stats.id_mismatch++;
+        trace_record(TRACE_UDP_REJECT, TRACE_REJECT_SOURCE, cmd.channel, 0);
+        return false;
+    }
+
+    *channel = cmd.channel;
+    *reading = cmd.reading;
+    *seq = cmd.seq;
+    return true;
+}
+
+/* Newest values from each channel's bound sensors, occupancy fused (UDP task only) */
+static sensor_reading_t udp_channel_readings[SWITCH_CHANNEL_COUNT];
+
+/* Fold one reading into its channel; the channel is posted once per batch */
+static void udp_batch_add(const udp_peer_t *peer, char *buffer, int len, int64_t rx_us,
+                          int64_t *pending_us)
+{
+    uint8_t mac[6];
+    uint8_t channel;
+    sensor_reading_t reading;
+    sensor_seq_t seq;
+    bool occupied;
+
+    if (!udp_decode_packet(peer, buffer, len, mac, &channel, &reading, &seq)) {
+        return;
+    }
+
+    // Duplicate and late packets are dropped here, before they reach the vote or the rules
+    switch (sensor_binding_report(mac, channel, &reading, &seq, &occupied)) {
+        case SENSOR_REPORT_OK:
+            break;
+        case SENSOR_REPORT_RESTART:
+            ESP_LOGI(TAG, "Sensor on channel %d restarted its sequence at %lu", channel, (unsigned long)seq.seq);
+            udp_rx_stats.sender_restarts++;
+            break;
+        case SENSOR_REPORT_UNBOUND:
+            ESP_LOGD(TAG, "Ignored packet (sensor not bound to channel %d)", channel);
+            udp_rx_stats.id_mismatch++;
+            trace_record(TRACE_UDP_REJECT, TRACE_REJECT_UNBOUND, channel, 0);
+            return;
+        case SENSOR_REPORT_DUPLICATE:
+            udp_rx_stats.seq_duplicate++;
+            trace_record(TRACE_UDP_REJECT, TRACE_REJECT_DUPLICATE, channel, seq.seq);
+            return;
+        case SENSOR_REPORT_REORDERED:
+            udp_rx_stats.seq_reordered++;
+            trace_record(TRACE_UDP_REJECT, TRACE_REJECT_REORDERED, channel, seq.seq);
+            return;
+        case SENSOR_REPORT_STALE:
+            udp_rx_stats.seq_stale++;
+            trace_record(TRACE_UDP_REJECT, TRACE_REJECT_STALE, channel, seq.seq);
+            return;
+    }
+
+    sensor_reading_t *merged = &udp_channel_readings[channel];
+    if (reading.has & SENSOR_HAS_TEMPERATURE) {
+        merged->temperature = reading.temperature;
+    }
+    if (reading.has & SENSOR_HAS_LUX) {
+        merged->lux = reading.lux;
+    }
+    merged->presence_detected = occupied;
+    merged->motion_detected = false;
+    merged->origin = reading.origin;
+    merged->has |= reading.has;
+
+    if (pending_us[channel] != 0) {
+        udp_rx_stats.collapsed++;
+    }
+    pending_us[channel] = rx_us;
+}
+
+/* Re-evaluate channels whose vote changed because a sensor went silent */
+static void udp_expire_sensors(void)
+{
+    uint32_t changed = sensor_binding_expire();
+    for (int ch = 0; ch < SWITCH_CHANNEL_COUNT; ch++) {
+        if ((changed & (1u << ch)) && udp_channel_readings[ch].has != 0) {
+            ESP_LOGI(TAG, "Sensor expired on channel %d", ch);
+            udp_channel_readings[ch].presence_detected = sensor_binding_occupied(ch);
+            post_sensor_reading(ch, &udp_channel_readings[ch], esp_timer_get_time());
+        }
+    }
+}
+
 void udp_receiver_task(void *pvParameters)
 {
     int sock = socket(AF_INET, SOCK_DGRAM, 0);
@@ -263,57 +860,106 @@ void udp_receiver_task(void *pvParameters)
     }
 
     ESP_LOGI(TAG, "UDP receiver listening on port %d", UDP_PORT);
+    boot_phase_mark(BOOT_PHASE_UDP);
 
     char buffer[UDP_BUFFER_SIZE];
     struct sockaddr_in source_addr;
-    socklen_t socklen = sizeof(source_addr);
+    socklen_t socklen;
+    udp_peer_t peer = { .sock = sock, .addr = &source_addr };
+    int64_t pending_us[SWITCH_CHANNEL_COUNT];   // receive time of the newest packet per channel, 0 if none
+    uint32_t last_dropped = 0;
+    TickType_t last_housekeeping = xTaskGetTickCount();
+    static rate_limiter_t limiter;     // UDP task only
+    rate_limit_init(&limiter, esp_timer_get_time());
 
-    ESP_LOGI(TAG, "Using Device ID: %s", g_device_id);
+    ESP_LOGI(TAG, "%d sensors bound", (int)sensor_binding_count());
 
     while (1) {
-        int len = recvfrom(sock, buffer, sizeof(buffer) - 1, 0,
-                           (struct sockaddr *)&source_addr, &socklen);
-
-        if (len > 0) {
-            buffer[len] = '\0';
-            ESP_LOGI(TAG, "Received UDP: %s", buffer);
+        // Block until a datagram arrives, waking periodically for housekeeping
+        fd_set read_fds;
+        FD_ZERO(&read_fds);
+        FD_SET(sock, &read_fds);
+        struct timeval timeout = {
+            .tv_sec = UDP_HOUSEKEEPING_MS / 1000,
+            .tv_usec = (UDP_HOUSEKEEPING_MS % 1000) * 1000,
+        };
 
-            cJSON *json = cJSON_Parse(buffer);
-            if (json) {
-                cJSON *command = cJSON_GetObjectItem(json, "command");
-                cJSON *source  = cJSON_GetObjectItem(json, "source");
-                // cJSON *origin  = cJSON_GetObjectItem(json, "origin");
-                cJSON *sensor_device_id = cJSON_GetObjectItem(json, "device_id");
+        int ready = select(sock + 1, &read_fds, NULL, NULL, &timeout);
+        if (ready < 0 && errno == EINTR) {
+            // Only seen in the host simulation, where the scheduler tick is a signal
+            continue;
+        }
+        if (ready < 0) {
+            ESP_LOGE(TAG, "select failed: errno %d", errno);
+            vTaskDelay(pdMS_TO_TICKS(UDP_HOUSEKEEPING_MS));
+            continue;
+        }
 
-                if (command && cJSON_IsString(command) &&
-                    source && cJSON_IsString(source) &&
-                    sensor_device_id && cJSON_IsString(sensor_device_id)) {
+        // Housekeeping also runs under steady traffic, not only on select timeout
+        if (xTaskGetTickCount() - last_housekeeping >= pdMS_TO_TICKS(UDP_HOUSEKEEPING_MS)) {
+            last_housekeeping = xTaskGetTickCount();
+            udp_rx_stats_t stats;
+            switch_controller_get_rx_stats(&stats);
+            if (stats.dropped != last_dropped) {
+                ESP_LOGW(TAG, "UDP datagrams dropped by lwIP: %lu (total %lu)",
+                         (unsigned long)(stats.dropped - last_dropped), (unsigned long)stats.dropped);
+                last_dropped = stats.dropped;
+            }
+            udp_expire_sensors();
+        }
 
-                    ESP_LOGI(TAG, "Parsed JSON - command: %s, sensor_id: %s",
-                             command->valuestring, sensor_device_id->valuestring);
+        if (ready == 0) {
+            continue;
+        }
 
-                    if (strcmp(source->valuestring, "AIOS_SENSOR") == 0 &&
-                        strcmp(sensor_device_id->valuestring, g_device_id) == 0) {
+        // Drain what is queued (up to a batch) before evaluating any of it
+        memset(pending_us, 0, sizeof(pending_us));
+        int batch;
+        for (batch = 0; batch < UDP_BATCH_MAX; batch++) {
+            socklen = sizeof(source_addr);
+            int len = recvfrom(sock, buffer, sizeof(buffer) - 1, MSG_DONTWAIT,
+                               (struct sockaddr *)&source_addr, &socklen);
+            if (len < 0) {
+                if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                    ESP_LOGE(TAG, "recvfrom failed: errno %d", errno);
+                }
+                break;
+            }
+            if (len == 0) {
+                continue;
+            }
 
-                        ESP_LOGI(TAG, "Valid sensor data from matching device");
-                        process_sensor_data(command->valuestring);
-                    } else {
-                        //print log for source and deviceid
-                        ESP_LOGE(TAG, "source: %s, device_id: %s", source->valuestring, g_device_id);
-                        ESP_LOGW(TAG, "Ignored packet (source/device mismatch)");
-                    }
+            int64_t rx_us = esp_timer_get_time();
+            uint32_t src_ip = ntohl(source_addr.sin_addr.s_addr);
+            udp_rx_stats.received++;
+            trace_record(TRACE_UDP_RX, 0, len, src_ip);
 
+            // Admission control before any parsing
+            rate_limit_result_t admit = rate_limit_admit(&limiter, src_ip, rx_us);
+            if (admit != RATE_LIMIT_PASS) {
+                if (admit == RATE_LIMIT_SOURCE) {
+                    udp_rx_stats.rate_limited++;
                 } else {
-                    ESP_LOGW(TAG, "Invalid or missing JSON fields");
+                    udp_rx_stats.global_limited++;
                 }
+                trace_record(TRACE_UDP_REJECT, TRACE_REJECT_RATE, admit, src_ip);
+                continue;
+            }
+            buffer[len] = '\0';
+            udp_batch_add(&peer, buffer, len, rx_us, pending_us);
+        }
 
-                cJSON_Delete(json);
-            } else {
-                ESP_LOGW(TAG, "Failed to parse JSON");
+        for (int ch = 0; ch < SWITCH_CHANNEL_COUNT; ch++) {
+            if (pending_us[ch] != 0) {
+                ESP_LOGD(TAG, "Valid sensor data from matching device");
+                post_sensor_reading(ch, &udp_channel_readings[ch], pending_us[ch]);
             }
         }
 
-        vTaskDelay(pdMS_TO_TICKS(10));
+        if (batch == UDP_BATCH_MAX) {
+            // Still flooded: give lower-priority tasks a tick before draining more
+            vTaskDelay(1);
+        }
     }
 
     close(sock);
@@ -323,52 +969,100 @@ void udp_receiver_task(void *pvParameters)
 /* ---------------- Initialization ---------------- */
 void switch_controller_init(void)
 {
-    // Load settings from NVS directly into global variables
-    nvs_read_wifi_credentials(NULL, NULL, g_device_id, &g_temperature_threshold, g_switch_mode, &g_lux_threshold);
-    
-    ESP_LOGI(TAG, "Loaded settings from NVS - Device ID: %s, Temp Threshold: %d, Switch Mode: %s", 
-             g_device_id, g_temperature_threshold, g_switch_mode);
-    
-    // Configure switch pin as input with pull-up and falling-edge interrupt
-    gpio_reset_pin(SWITCH_PIN);
-    gpio_set_direction(SWITCH_PIN, GPIO_MODE_INPUT);
-    gpio_set_pull_mode(SWITCH_PIN, GPIO_PULLUP_ONLY);
-    gpio_set_intr_type(SWITCH_PIN, GPIO_INTR_NEGEDGE);
-
-    // Create queue for gpio events
-    gpio_evt_queue = xQueueCreate(10, sizeof(uint32_t));
-    if (gpio_evt_queue == NULL) {
-        ESP_LOGE(TAG, "Failed to create gpio event queue");
-    }
-
-    // Install ISR service and add handler (install once globally is fine)
-    gpio_install_isr_service(0);
-    gpio_isr_handler_add(SWITCH_PIN, gpio_isr_handler, (void *)SWITCH_PIN);
+    // Settings come from the RAM copy loaded at boot
+    device_config_t config;
+    config_store_get(&config);
+    strlcpy(g_device_id, config.device_id, sizeof(g_device_id));
+    g_temperature_threshold = config.temperature_threshold;
+    g_lux_threshold = config.lux_threshold;
+    g_switch_mode = switch_mode_from_string(config.presence_state);
+    g_sensor_config.temperature_value = config.temperature_threshold;
+    g_sensor_config.light_value = config.lux_threshold;
+    strlcpy(g_sensor_config.presence_state, config.presence_state, sizeof(g_sensor_config.presence_state));
 
-    // Create button task (lower priority so network/UDP processing isn't starved)
-    if (xTaskCreate(button_task, "button_task", 2048, NULL, 3, NULL) != pdPASS) {
-        ESP_LOGE(TAG, "Failed to create button task");
-    } else {
-        ESP_LOGI(TAG, "Button task started");
+    ESP_LOGI(TAG, "Loaded settings - Device ID: %s, Temp Threshold: %d, Switch Mode: %s",
+             g_device_id, g_temperature_threshold, switch_mode_name(g_switch_mode));
+
+    // Created before the control task, the only other user of the table
+    rule_lock = xSemaphoreCreateMutex();
+    if (rule_lock == NULL) {
+        ESP_LOGE(TAG, "Failed to create rule table lock");
+    }
+    if (nvs_load_rule_table(&rule_table) != ESP_OK || !rule_table_validate(&rule_table)) {
+        ESP_LOGI(TAG, "Using default rule table");
+        rule_table_build_default(&rule_table);
     }
 
-    // Create delayed OFF timer
-    off_timer = xTimerCreate("off_timer", pdMS_TO_TICKS(DEFAULT_DELAY_MS),
-                             pdFALSE, NULL, off_timer_callback);
+    for (int i = 0; i < SWITCH_CHANNEL_COUNT; i++) {
+        switch_channel_t *ch = &channels[i];
+        ch->index = i;
+        ch->delay_ms = DEFAULT_DELAY_MS;
+        timer_wheel_entry_init(&ch->off_timer, off_timer_callback, ch);
+        // Initialize channel state from the physical relay pin (set by the power-on policy)
+        ch->state = (gpio_get_level(g_channel_pins[i].relay) != 0);
+        ch->last_command_was_on = ch->state;
+        // Log a power-on state that differs from the journal, so history stays continuous
+        bool journaled = false;
+        bool known = journal_last_state(i, &journaled);
+        if (known ? journaled != ch->state : ch->state) {
+            journal_append(i, ch->state, JOURNAL_SOURCE_POWER_ON, RULE_REASON_NONE);
+        }
+        relay_usage_switch(i, ch->state, USAGE_ORIGIN_POWER_ON);
+    }
+
+    if (sensor_binding_init(g_device_id) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to initialise sensor bindings");
+    }
 
-    if (off_timer == NULL) {
+    // One wheel and one esp_timer serve the delayed OFF of every channel
+    timer_wheel_init(&off_wheel);
+    const esp_timer_create_args_t wheel_timer_args = {
+        .callback = wheel_timer_callback,
+        .name = "off_wheel",
+    };
+    if (esp_timer_create(&wheel_timer_args, &wheel_timer) != ESP_OK) {
         ESP_LOGE(TAG, "Failed to create OFF timer!");
     } else {
-        ESP_LOGI(TAG, "OFF timer created successfully");
+        ESP_LOGI(TAG, "OFF timer wheel created successfully");
     }
 
-    // Start UDP receiver task (give slightly higher priority than button task)
+    // The control task must exist before anything can post to it
+    ctrl_ring_init(&ctrl_ring);
+    if (xTaskCreate(control_task, "control_task", 3072, NULL, 7, &ctrl_task_handle) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create control task");
+    } else {
+        ESP_LOGI(TAG, "Control task started");
+    }
+
+    // Pins and button task come before the ISRs, so every edge has a task to wake
+    for (int i = 0; i < SWITCH_CHANNEL_COUNT; i++) {
+        gpio_num_t button = g_channel_pins[i].button;
+        gpio_reset_pin(button);
+        gpio_set_direction(button, GPIO_MODE_INPUT);
+        gpio_set_pull_mode(button, GPIO_PULLUP_ONLY);
+    }
+    // Button task sits above the UDP receiver so a flood cannot delay a press; it mostly sleeps
+    if (xTaskCreate(button_task, "button_task", 2048, NULL, 8, &button_task_handle) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create button task");
+    } else {
+        ESP_LOGI(TAG, "Button task started");
+    }
+
+    // Install ISR service once, then one both-edge handler per channel button
+    gpio_install_isr_service(0);
+    for (int i = 0; i < SWITCH_CHANNEL_COUNT; i++) {
+        gpio_num_t button = g_channel_pins[i].button;
+        gpio_set_intr_type(button, GPIO_INTR_ANYEDGE);
+        gpio_isr_handler_add(button, gpio_isr_handler, (void *)(uintptr_t)i);
+    }
+}
+
+void switch_controller_start_udp(void)
+{
+    // The UDP receiver (6) runs below the control task (7) and the button task (8), so a packet flood cannot delay a press
     if (xTaskCreate(udp_receiver_task, "udp_receiver_task", 4096, NULL, 6, NULL) != pdPASS) {
         ESP_LOGE(TAG, "Failed to create UDP receiver task");
     } else {
         ESP_LOGI(TAG, "UDP receiver task started");
     }
-
-    // Initialize current_switch_state from physical relay pin
-    current_switch_state = (gpio_get_level(RELAY_PIN) != 0);
 }
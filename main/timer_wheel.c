@@ -0,0 +1,141 @@
+#include <string.h>
+#include "timer_wheel.h"
+
+#define L0_MASK (TIMER_WHEEL_L0_SIZE - 1)
+#define LN_MASK (TIMER_WHEEL_LN_SIZE - 1)
+
+// First tick bit used to index level `level` (1..LEVELS-1)
+#define LEVEL_SHIFT(level) (TIMER_WHEEL_L0_BITS + ((level) - 1) * TIMER_WHEEL_LN_BITS)
+
+/* ---------------- List helpers ---------------- */
+static void list_push(timer_wheel_entry_t **head, timer_wheel_entry_t *entry)
+{
+    entry->slot = head;
+    entry->prev = NULL;
+    entry->next = *head;
+    if (*head != NULL) {
+        (*head)->prev = entry;
+    }
+    *head = entry;
+}
+
+static timer_wheel_entry_t **slot_for(timer_wheel_t *wheel, uint32_t expires)
+{
+    uint32_t delta = expires - wheel->now;
+
+    if ((int32_t)delta < 0) {
+        // Already due: fire on the next processed tick
+        return &wheel->l0[wheel->now & L0_MASK];
+    }
+    if (delta < TIMER_WHEEL_L0_SIZE) {
+        return &wheel->l0[expires & L0_MASK];
+    }
+    for (int level = 1; level < TIMER_WHEEL_LEVELS; level++) {
+        if (level == TIMER_WHEEL_LEVELS - 1 || delta < (1u << LEVEL_SHIFT(level + 1))) {
+            return &wheel->ln[level - 1][(expires >> LEVEL_SHIFT(level)) & LN_MASK];
+        }
+    }
+    return NULL;  // not reached
+}
+
+static void unlink_entry(timer_wheel_entry_t *entry)
+{
+    if (entry->prev != NULL) {
+        entry->prev->next = entry->next;
+    } else {
+        *entry->slot = entry->next;
+    }
+    if (entry->next != NULL) {
+        entry->next->prev = entry->prev;
+    }
+    entry->next = NULL;
+    entry->prev = NULL;
+    entry->slot = NULL;
+}
+
+/* Move every entry of a higher-level slot down to where it now belongs */
+static uint32_t cascade(timer_wheel_t *wheel, int level)
+{
+    uint32_t index = (wheel->now >> LEVEL_SHIFT(level)) & LN_MASK;
+    timer_wheel_entry_t *entry = wheel->ln[level - 1][index];
+    wheel->ln[level - 1][index] = NULL;
+
+    while (entry != NULL) {
+        timer_wheel_entry_t *next = entry->next;
+        list_push(slot_for(wheel, entry->expires), entry);
+        entry = next;
+    }
+    return index;
+}
+
+/* ---------------- Public API ---------------- */
+void timer_wheel_init(timer_wheel_t *wheel)
+{
+    memset(wheel, 0, sizeof(*wheel));
+}
+
+void timer_wheel_entry_init(timer_wheel_entry_t *entry, timer_wheel_cb_t callback, void *arg)
+{
+    memset(entry, 0, sizeof(*entry));
+    entry->callback = callback;
+    entry->arg = arg;
+}
+
+void timer_wheel_schedule(timer_wheel_t *wheel, timer_wheel_entry_t *entry, uint32_t delay_ticks)
+{
+    if (entry->pending) {
+        timer_wheel_cancel(wheel, entry);
+    }
+    if (delay_ticks > TIMER_WHEEL_MAX_TICKS) {
+        delay_ticks = TIMER_WHEEL_MAX_TICKS;
+    }
+
+    entry->expires = wheel->now + delay_ticks;
+    entry->pending = true;
+    list_push(slot_for(wheel, entry->expires), entry);
+    wheel->count++;
+}
+
+void timer_wheel_cancel(timer_wheel_t *wheel, timer_wheel_entry_t *entry)
+{
+    if (!entry->pending) {
+        return;
+    }
+    unlink_entry(entry);
+    entry->pending = false;
+    wheel->count--;
+}
+
+void timer_wheel_advance(timer_wheel_t *wheel, uint32_t ticks)
+{
+    while (ticks-- > 0) {
+        uint32_t index = wheel->now & L0_MASK;
+
+        // Wrapping level 0 pulls the next slot of each higher level down
+        if (index == 0) {
+            for (int level = 1; level < TIMER_WHEEL_LEVELS; level++) {
+                if (cascade(wheel, level) != 0) {
+                    break;
+                }
+            }
+        }
+
+        // Detach the due list first so callbacks may reschedule or cancel freely
+        timer_wheel_entry_t *due = wheel->l0[index];
+        wheel->l0[index] = NULL;
+        for (timer_wheel_entry_t *e = due; e != NULL; e = e->next) {
+            e->slot = &due;
+        }
+        wheel->now++;
+
+        while (due != NULL) {
+            timer_wheel_entry_t *entry = due;
+            unlink_entry(entry);
+            entry->pending = false;
+            wheel->count--;
+            if (entry->callback != NULL) {
+                entry->callback(entry, entry->arg);
+            }
+        }
+    }
+}
@@ -0,0 +1,106 @@
+#include <stdatomic.h>
+#include <string.h>
+#include "esp_timer.h"
+#include "trace.h"
+
+#define TRACE_RING_MASK (TRACE_RING_SIZE - 1)
+#define TRACE_SEQ_WRITING UINT32_MAX     // record is being overwritten
+
+// Same layout as trace_record_t, with the sequence number atomic
+typedef struct {
+    atomic_uint seq;
+    uint32_t timestamp_us;
+    uint8_t id;
+    uint8_t a0;
+    uint16_t a1;
+    uint32_t a2;
+} trace_cell_t;
+
+static trace_cell_t ring[TRACE_RING_SIZE];
+static atomic_uint ring_head;            // sequence number of the next record
+
+void trace_record(uint8_t id, uint8_t a0, uint16_t a1, uint32_t a2)
+{
+    uint32_t seq = atomic_fetch_add_explicit(&ring_head, 1, memory_order_relaxed);
+    trace_cell_t *rec = &ring[seq & TRACE_RING_MASK];
+
+    // Invalidate first so a concurrent dump never takes a half-written record for a whole one
+    atomic_store_explicit(&rec->seq, TRACE_SEQ_WRITING, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    rec->timestamp_us = (uint32_t)esp_timer_get_time();
+    rec->id = id;
+    rec->a0 = a0;
+    rec->a1 = a1;
+    rec->a2 = a2;
+    atomic_store_explicit(&rec->seq, seq, memory_order_release);
+}
+
+static void put_u32(uint8_t *p, uint32_t v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+size_t trace_dump_page(uint32_t *cursor, uint8_t *buf, size_t size)
+{
+    if (size < TRACE_PAGE_HEADER + sizeof(trace_record_t)) {
+        return 0;
+    }
+
+    uint32_t head = atomic_load_explicit(&ring_head, memory_order_acquire);
+    uint32_t seq = *cursor;
+    if (head - seq > TRACE_RING_SIZE) {
+        // Older records have been overwritten: start at the oldest one still held
+        seq = head > TRACE_RING_SIZE ? head - TRACE_RING_SIZE : 0;
+    }
+
+    size_t max = (size - TRACE_PAGE_HEADER) / sizeof(trace_record_t);
+    if (max > UINT8_MAX) {
+        max = UINT8_MAX;
+    }
+    uint8_t count = 0;
+    uint8_t *out = buf + TRACE_PAGE_HEADER;
+
+    for (; seq != head && count < max; seq++) {
+        trace_cell_t *rec = &ring[seq & TRACE_RING_MASK];
+        if (atomic_load_explicit(&rec->seq, memory_order_acquire) != seq) {
+            continue;
+        }
+        trace_record_t copy = {
+            .seq = seq,
+            .timestamp_us = rec->timestamp_us,
+            .id = rec->id,
+            .a0 = rec->a0,
+            .a1 = rec->a1,
+            .a2 = rec->a2,
+        };
+        atomic_thread_fence(memory_order_acquire);
+        // Skip records overwritten while we copied them; id 0 is a cell never written
+        if (atomic_load_explicit(&rec->seq, memory_order_relaxed) != seq || copy.id == 0) {
+            continue;
+        }
+        put_u32(out, copy.seq);
+        put_u32(out + 4, copy.timestamp_us);
+        out[8] = copy.id;
+        out[9] = copy.a0;
+        out[10] = copy.a1;
+        out[11] = copy.a1 >> 8;
+        put_u32(out + 12, copy.a2);
+        out += sizeof(trace_record_t);
+        count++;
+    }
+    *cursor = seq;
+
+    uint64_t now = esp_timer_get_time();
+    buf[0] = TRACE_PAGE_MAGIC;
+    buf[1] = TRACE_PAGE_VERSION;
+    buf[2] = count;
+    buf[3] = (seq == head) ? TRACE_PAGE_LAST : 0;
+    put_u32(buf + 4, (uint32_t)now);
+    put_u32(buf + 8, (uint32_t)(now >> 32));
+    put_u32(buf + 12, head);
+
+    return TRACE_PAGE_HEADER + count * sizeof(trace_record_t);
+}
@@ -1,9 +1,16 @@
 #include "wifi.h"
 #include "bluetooth.h"
 #include "driver/gpio.h"
+#include "esp_mac.h"
 #include <stdlib.h>
 #include "led.h"
-#include "nvs.h"
+#include "config_store.h"
+#include "boot_phase.h"
+#include "wifi_stats.h"
+#include "wifi_reconnect.h"
+#include "esp_timer.h"
+#include "scan_cache.h"
+#include "freertos/semphr.h"
 
 // Define the TAG for logging
 static const char *TAG = "wifi_station";
@@ -14,6 +21,102 @@ EventGroupHandle_t s_wifi_event_group;
 int s_retry_num = 0;
 esp_netif_t *sta_netif = NULL;
 bool is_connected = false;
+static bool associated = false;  // between STA_CONNECTED and STA_DISCONNECTED
+
+/* ---------------- Reconnect ---------------- */
+#define WIFI_SCAN_HOLD_MS 1000        // recheck interval while a scan holds off a due retry
+
+// Posted by the retry timer so the attempt runs on the event task, like every other transition
+ESP_EVENT_DEFINE_BASE(WIFI_RETRY_EVENT);
+
+static wifi_reconnect_t reconnect;    // event task only
+static esp_timer_handle_t retry_timer = NULL;
+static volatile bool scan_in_progress = false;
+
+static void retry_timer_callback(void *arg)
+{
+    esp_event_post(WIFI_RETRY_EVENT, 0, NULL, 0, 0);
+}
+
+static wifi_disc_class_t wifi_disc_class(uint8_t reason)
+{
+    switch (reason) {
+        case WIFI_REASON_AUTH_FAIL:
+        case WIFI_REASON_4WAY_HANDSHAKE_TIMEOUT:
+        case WIFI_REASON_HANDSHAKE_TIMEOUT:
+            return WIFI_DISC_AUTH;
+        case WIFI_REASON_NO_AP_FOUND:
+            return WIFI_DISC_NO_AP;
+        default:
+            return WIFI_DISC_LINK;
+    }
+}
+
+/* True while the STA config points at the cached AP instead of scanning */
+static bool wifi_config_is_direct(void)
+{
+    wifi_config_t wifi_config;
+    return esp_wifi_get_config(WIFI_IF_STA, &wifi_config) == ESP_OK && wifi_config.sta.bssid_set;
+}
+
+static void wifi_connect_tracked(void)
+{
+    esp_timer_stop(retry_timer);
+    wifi_reconnect_attempt(&reconnect, esp_timer_get_time());
+    wifi_stats_connect_start(wifi_config_is_direct());
+    esp_wifi_connect();
+}
+
+/* The cached AP did not answer: scan all channels for the SSID from now on. True if it switched */
+static bool wifi_fall_back_to_scan(void)
+{
+    wifi_config_t wifi_config;
+    if (esp_wifi_get_config(WIFI_IF_STA, &wifi_config) != ESP_OK || !wifi_config.sta.bssid_set) {
+        return false;
+    }
+    ESP_LOGW(TAG, "Cached AP " MACSTR " on channel %d not reachable, falling back to a full scan",
+             MAC2STR(wifi_config.sta.bssid), wifi_config.sta.channel);
+    wifi_config.sta.bssid_set = false;
+    memset(wifi_config.sta.bssid, 0, sizeof(wifi_config.sta.bssid));
+    wifi_config.sta.channel = 0;
+    wifi_config.sta.threshold.authmode = WIFI_AUTH_WPA2_PSK;
+    esp_wifi_set_config(WIFI_IF_STA, &wifi_config);
+    wifi_stats_fallback();
+    return true;
+}
+
+/* Retry timer fired */
+static void wifi_retry_due(void)
+{
+    if (scan_in_progress) {
+        // The scan needs the radio; try again once it is done
+        esp_timer_start_once(retry_timer, WIFI_SCAN_HOLD_MS * 1000);
+        return;
+    }
+    if (wifi_reconnect_due(&reconnect, esp_timer_get_time())) {
+        wifi_connect_tracked();
+    }
+}
+
+void wifi_cache_current_ap(void)
+{
+    wifi_ap_record_t ap;
+    device_config_t config;
+
+    if (esp_wifi_sta_get_ap_info(&ap) != ESP_OK) {
+        return;
+    }
+    config_store_get(&config);
+    // Only for the stored network; during provisioning the new SSID is not stored yet
+    if (strncmp((const char *)ap.ssid, config.ssid, sizeof(ap.ssid)) != 0) {
+        return;
+    }
+    config_store_set_ap(ap.bssid, ap.primary, ap.authmode);
+    if (config_store_dirty() & CONFIG_FIELD_AP) {
+        ESP_LOGI(TAG, "Caching AP " MACSTR " on channel %d for direct reconnects", MAC2STR(ap.bssid), ap.primary);
+        config_store_save_later();
+    }
+}
 
 
 static void event_handler(void* arg, esp_event_base_t event_base,
@@ -21,8 +124,6 @@ static void event_handler(void* arg, esp_event_base_t event_base,
 {
     if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
         // Check if we have valid credentials before attempting to connect
-        char ssid[100] = {0};
-        char password[100] = {0};
      
         // First check if we have credentials in memory (from BLE)
         bool has_credentials_in_memory = (wifi_credentials.ssid != NULL &&
@@ -32,13 +133,14 @@ static void event_handler(void* arg, esp_event_base_t event_base,
         if (has_credentials_in_memory) {
             // We have credentials in memory, use them directly
             ESP_LOGI(TAG, "WIFI_EVENT_STA_START: Using credentials from memory");
-            esp_wifi_connect();
+            wifi_connect_tracked();
         } else {
-            // Try to read from NVS as fallback
-            nvs_read_wifi_credentials(ssid, password, NULL, NULL, NULL, NULL);
+            // Fall back to the stored settings
+            device_config_t config;
+            config_store_get(&config);
 
-            if (strlen(ssid) > 0) {
-                esp_wifi_connect();
+            if (strlen(config.ssid) > 0) {
+                wifi_connect_tracked();
                 ESP_LOGI(TAG, "WIFI_EVENT_STA_START: Attempting to connect to WiFi using NVS credentials");
             } else {
                 ESP_LOGI(TAG, "WIFI_EVENT_STA_START: No credentials available, not connecting");
@@ -52,152 +154,249 @@ static void event_handler(void* arg, esp_event_base_t event_base,
         // Log the reason for disconnection
         ESP_LOGI(TAG, "WiFi disconnected, reason: %d", event->reason);
 
+        is_connected = false;
+        // A direct attempt that never associated gets one chance only; the scan follows at once
+        bool fell_back = !associated && wifi_fall_back_to_scan();
+        associated = false;
+
         // Handle different disconnection reasons
-        switch (event->reason) {            case WIFI_REASON_AUTH_FAIL:
+        wifi_disc_class_t cls = wifi_disc_class(event->reason);
+        switch (cls) {
+            case WIFI_DISC_AUTH:
                 ESP_LOGE(TAG, "WiFi authentication failed - check password");
                 xEventGroupSetBits(s_wifi_event_group, WIFI_FAIL_BIT);
-                s_retry_num = 5; // Force stop retrying for auth failures
                 // rgb_led_set_red(); // Red LED for disconnected
                 break;
-            case WIFI_REASON_NO_AP_FOUND:
+            case WIFI_DISC_NO_AP:
                 ESP_LOGE(TAG, "WiFi AP not found - check SSID or AP availability");
                 xEventGroupSetBits(s_wifi_event_group, WIFI_FAIL_BIT);
-                s_retry_num = 5; // Force stop retrying for AP not found
-                // rgb_led_set_red(); // Red LED for disconnected
-                break;
-            case WIFI_REASON_BEACON_TIMEOUT:
-                ESP_LOGE(TAG, "WiFi beacon timeout - AP may be too far or congested");
-                xEventGroupSetBits(s_wifi_event_group, WIFI_FAIL_BIT);
-                s_retry_num = 5; // Force stop retrying for beacon timeout
                 // rgb_led_set_red(); // Red LED for disconnected
                 break;
             default:
-                ESP_LOGE(TAG, "WiFi disconnected with reason: %d", event->reason);
+                if (event->reason == WIFI_REASON_BEACON_TIMEOUT) {
+                    ESP_LOGE(TAG, "WiFi beacon timeout - AP may be too far or congested");
+                    xEventGroupSetBits(s_wifi_event_group, WIFI_FAIL_BIT);
+                }
                 // rgb_led_set_red(); // Red LED for disconnected
                 break;
         }
-        esp_wifi_connect();
+
+        if (fell_back) {
+            wifi_connect_tracked();
+        } else {
+            uint32_t wait_ms = wifi_reconnect_disconnected(&reconnect, cls, esp_timer_get_time());
+            s_retry_num = reconnect.failures;
+            wifi_stats_disconnected(cls, wait_ms);
+            ESP_LOGI(TAG, "Reconnecting in %lu ms (%s, %d failed attempts)",
+                     (unsigned long)wait_ms, wifi_disc_class_name(cls), s_retry_num);
+            esp_timer_stop(retry_timer);
+            esp_timer_start_once(retry_timer, (uint64_t)wait_ms * 1000);
+        }
+    } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_CONNECTED) {
+        wifi_event_sta_connected_t* event = (wifi_event_sta_connected_t*) event_data;
+        associated = true;
+        wifi_stats_associated(event->channel, wifi_config_is_direct());
     } else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
         ip_event_got_ip_t* event = (ip_event_got_ip_t*) event_data;
         ESP_LOGI(TAG, "Got IP address: " IPSTR, IP2STR(&event->ip_info.ip));
         s_retry_num = 0;
+        is_connected = true;
+        uint32_t down_ms = wifi_reconnect_connected(&reconnect, esp_timer_get_time());
+        if (down_ms > 0) {
+            ESP_LOGI(TAG, "Link back after %lu ms", (unsigned long)down_ms);
+            wifi_stats_reconnected(down_ms);
+        }
+        boot_phase_mark(BOOT_PHASE_WIFI_IP);
+        wifi_stats_got_ip();
+        wifi_cache_current_ap();
         xEventGroupSetBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
         // rgb_led_set_green(); // Green LED for connected
+    } else if (event_base == WIFI_RETRY_EVENT) {
+        wifi_retry_due();
     }
 }
 
-void scan_wifi_networks(char* response) {
-    ESP_LOGI(TAG, "Starting WiFi scan...");
-    // Force stop any ongoing connection attempts
-    esp_wifi_disconnect();
-    vTaskDelay(200 / portTICK_PERIOD_MS);
-
-    // Ensure WiFi is in station mode
-    wifi_mode_t mode;
-    esp_wifi_get_mode(&mode);
-    if (mode != WIFI_MODE_STA && mode != WIFI_MODE_APSTA) {
-        ESP_LOGE(TAG, "WiFi not in station mode");
-        snprintf(response, 1000, "{\"event_type\":\"scan_list\",\"data\":{\"error\":\"WiFi not in station mode\"}}");
-        return;
-    }
+/* ---------------- Scan service ---------------- */
+#define SCAN_RESPONSE_SIZE 1000       // callers hand in a buffer this large
+#define SCAN_MAX_RECORDS   32         // records fetched from the driver per channel
+#define SCAN_START_TRIES   4
+#define SCAN_RETRY_MS      500        // wait for a connect attempt to finish
 
-    // Reset WiFi state
-    xEventGroupClearBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
-    xEventGroupSetBits(s_wifi_event_group, WIFI_FAIL_BIT);
-
-    // Stop any ongoing scan
-    esp_wifi_scan_stop();
-    vTaskDelay(100 / portTICK_PERIOD_MS);
+static SemaphoreHandle_t scan_lock = NULL;   // one scan at a time; waiters get its result
+static scan_cache_t scan_cache;              // under scan_lock
 
+/* One channel, blocking; refused while a connect attempt runs, so retry for a while */
+static esp_err_t wifi_scan_channel(uint8_t channel)
+{
     wifi_scan_config_t scan_config = {
         .ssid = NULL,
         .bssid = NULL,
-        .channel = 0,
-        .show_hidden = true
+        .channel = channel,
+        .show_hidden = false
     };
 
-    // Try to start scan with retries
     esp_err_t err;
-    int retry_count = 0;
+    int tries = 0;
     do {
         err = esp_wifi_scan_start(&scan_config, true);
         if (err != ESP_OK) {
-            ESP_LOGW(TAG, "Scan attempt %d failed: %s", retry_count + 1, esp_err_to_name(err));
-            vTaskDelay(200 / portTICK_PERIOD_MS);
-
-            // Additional reset if scan fails
-            esp_wifi_stop();
-            vTaskDelay(100 / portTICK_PERIOD_MS);
-            esp_wifi_start();
-            vTaskDelay(100 / portTICK_PERIOD_MS);
+            ESP_LOGW(TAG, "Scan of channel %d, attempt %d failed: %s", channel, tries + 1, esp_err_to_name(err));
+            vTaskDelay(pdMS_TO_TICKS(SCAN_RETRY_MS));
         }
-        retry_count++;
-    } while (err != ESP_OK && retry_count < 3);
+        tries++;
+    } while (err != ESP_OK && tries < SCAN_START_TRIES);
+    return err;
+}
 
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "WiFi scan failed after all retries: %s", esp_err_to_name(err));
-        snprintf(response, 1000, "{\"event_type\":\"scan_list\",\"data\":{\"error\":\"%s\"}}", esp_err_to_name(err));
-        return;
+/*
+ * Scan channel by channel without leaving the AP (the driver returns to the
+ * home channel in between). found() gets each AP that is new or stronger than
+ * before in this scan, then NULL when its channel is done. The cache is only
+ * replaced when every channel was scanned.
+ */
+static esp_err_t wifi_scan_refresh(scan_found_t found, void *ctx)
+{
+    uint8_t first_ch = 1, last_ch = 13;
+    wifi_country_t country;
+    if (esp_wifi_get_country(&country) == ESP_OK && country.nchan > 0) {
+        first_ch = country.schan;
+        last_ch = country.schan + country.nchan - 1;
     }
 
-    uint16_t ap_num = 0;
-    ESP_ERROR_CHECK(esp_wifi_scan_get_ap_num(&ap_num));
-
-    if (ap_num > 15) {
-        ap_num = 15;
-        ESP_LOGW(TAG, "Limiting APs to 15");
+    scan_cache_t *staging = malloc(sizeof(scan_cache_t));
+    wifi_ap_record_t *ap_records = malloc(sizeof(wifi_ap_record_t) * SCAN_MAX_RECORDS);
+    if (!staging || !ap_records) {
+        free(staging);
+        free(ap_records);
+        wifi_stats_scan_done(false, 0, 0);
+        return ESP_ERR_NO_MEM;
     }
-    if (ap_num > 0) {
-        wifi_ap_record_t *ap_records = malloc(sizeof(wifi_ap_record_t) * ap_num);
-        if (!ap_records) {
-            ESP_LOGE(TAG, "Memory allocation failed for AP records");
-            snprintf(response, 1000, "{\"event_type\":\"scan_list\",\"data\":{\"error\":\"malloc_failed_ap_records\"}}");
-            return;
+    scan_cache_begin(staging);
+
+    int64_t start = esp_timer_get_time();
+    uint32_t first_ms = 0;
+    int records = 0;
+    esp_err_t err = ESP_OK;
+    for (uint8_t ch = first_ch; ch <= last_ch && err == ESP_OK; ch++) {
+        err = wifi_scan_channel(ch);
+        if (err != ESP_OK) {
+            break;
+        }
+        uint16_t ap_num = SCAN_MAX_RECORDS;
+        err = esp_wifi_scan_get_ap_records(&ap_num, ap_records);
+        if (err != ESP_OK) {
+            break;
         }
-        ESP_ERROR_CHECK(esp_wifi_scan_get_ap_records(&ap_num, ap_records));
+        records += ap_num;
+        for (int i = 0; i < ap_num; i++) {
+            scan_ap_t ap = {
+                .rssi = ap_records[i].rssi,
+                .channel = ap_records[i].primary,
+                .authmode = ap_records[i].authmode,
+            };
+            strlcpy(ap.ssid, (const char *)ap_records[i].ssid, sizeof(ap.ssid));
+            memcpy(ap.bssid, ap_records[i].bssid, sizeof(ap.bssid));
+            if (scan_cache_merge(staging, &ap) && found) {
+                found(ch, &ap, ctx);
+            }
+        }
+        if (found) {
+            found(ch, NULL, ctx);
+        }
+        if (first_ms == 0 && staging->count > 0) {
+            first_ms = (uint32_t)((esp_timer_get_time() - start) / 1000);
+        }
+    }
+    free(ap_records);
 
-        // Start building the JSON response with the exact format requested
-        strcpy(response, "{\"event_type\":\"scan_list\",\"data\":{");
-        int offset = strlen(response);
+    if (err != ESP_OK) {
+        free(staging);
+        wifi_stats_scan_done(false, 0, 0);
+        return err;
+    }
+    uint32_t duration_ms = (uint32_t)((esp_timer_get_time() - start) / 1000);
+    scan_cache_finish(staging, esp_timer_get_time());
+    scan_cache = *staging;
+    free(staging);
+
+    wifi_stats_scan_done(true, duration_ms, first_ms);
+    ESP_LOGI(TAG, "Scan of channels %d-%d took %lu ms (first result after %lu ms): %d records, %d networks",
+             first_ch, last_ch, (unsigned long)duration_ms, (unsigned long)first_ms, records, scan_cache.count);
+    return ESP_OK;
+}
 
-        bool first = true;
-        for (int i = 0; i < ap_num; i++) {
-            if (strlen((char *)ap_records[i].ssid) == 0) continue;
+/* Under scan_lock: scan unless the cache is fresh. False if there is nothing to serve */
+static bool wifi_scan_cached(scan_found_t found, void *ctx, bool *cached, esp_err_t *err)
+{
+    *err = ESP_OK;
+    *cached = scan_cache_fresh(&scan_cache, esp_timer_get_time());
+    if (*cached) {
+        wifi_stats_scan_hit();
+        return true;
+    }
 
-            if (!first) {
-                offset += snprintf(response + offset, 1000 - offset, ",");
-            }
+    ESP_LOGI(TAG, "Starting WiFi scan...");
+    // Retries that fall due during the scan wait for it
+    scan_in_progress = true;
+    *err = wifi_scan_refresh(found, ctx);
+    scan_in_progress = false;
+    if (*err != ESP_OK) {
+        ESP_LOGE(TAG, "WiFi scan failed: %s", esp_err_to_name(*err));
+        // A stale list is still better than none
+        *cached = true;
+        return scan_cache.taken_us != 0;
+    }
+    return true;
+}
 
-            // Format exactly as requested: "SSID":"-RSSI"
-            offset += snprintf(response + offset, 1000 - offset,
-                  "\"%s\":\"%d\"",
-                  ap_records[i].ssid,
-                  ap_records[i].rssi);
-            first = false;
+static bool wifi_is_station(void)
+{
+    wifi_mode_t mode;
+    return esp_wifi_get_mode(&mode) == ESP_OK && (mode == WIFI_MODE_STA || mode == WIFI_MODE_APSTA);
+}
 
-            if (offset > 900) {
-                ESP_LOGW(TAG, "JSON buffer almost full, truncating...");
-                break;
-            }
+esp_err_t wifi_scan_stream(scan_found_t found, void *ctx, bool *cached, int *networks)
+{
+    if (!wifi_is_station()) {
+        ESP_LOGE(TAG, "WiFi not in station mode");
+        return ESP_ERR_WIFI_MODE;
+    }
+
+    esp_err_t err;
+    xSemaphoreTake(scan_lock, portMAX_DELAY);
+    bool ok = wifi_scan_cached(found, ctx, cached, &err);
+    if (ok && *cached) {
+        // Nothing was streamed by a scan: replay the list, strongest first
+        for (int i = 0; i < scan_cache.count; i++) {
+            found(0, &scan_cache.aps[i], ctx);
         }
+        found(0, NULL, ctx);
+    }
+    *networks = scan_cache.count;
+    xSemaphoreGive(scan_lock);
+    return ok ? ESP_OK : err;
+}
 
-        // Close the JSON object
-        snprintf(response + offset, 1000 - offset, "}}");
-        free(ap_records);
+void scan_wifi_networks(char* response) {
+    if (!wifi_is_station()) {
+        ESP_LOGE(TAG, "WiFi not in station mode");
+        snprintf(response, SCAN_RESPONSE_SIZE, "{\"event_type\":\"scan_list\",\"data\":{\"error\":\"WiFi not in station mode\"}}");
+        return;
+    }
+
+    bool cached;
+    esp_err_t err;
+    xSemaphoreTake(scan_lock, portMAX_DELAY);
+    if (wifi_scan_cached(NULL, NULL, &cached, &err)) {
+        scan_cache_format(&scan_cache, response, SCAN_RESPONSE_SIZE);
     } else {
-        // No APs found, return empty data object
-        snprintf(response, 1000, "{\"event_type\":\"scan_list\",\"data\":{}}");
+        snprintf(response, SCAN_RESPONSE_SIZE, "{\"event_type\":\"scan_list\",\"data\":{\"error\":\"%s\"}}", esp_err_to_name(err));
     }
+    xSemaphoreGive(scan_lock);
 
-    // Print response for debugging
     ESP_LOGI(TAG, "Scan Response: %s", response);
-    ESP_LOGI(TAG, "Response length: %d", strlen(response));
-
-    // If we were connected before, try to reconnect
-    if (is_connected) {
-        esp_wifi_connect();
-    }
 }
+
 void wifi_init_sta(void)
 {
     static bool is_initialized = false;
@@ -217,6 +416,7 @@ void wifi_init_sta(void)
         ESP_ERROR_CHECK(esp_wifi_init(&cfg));
 
         is_initialized = true;
+        scan_lock = xSemaphoreCreateMutex();
 
         esp_event_handler_instance_t instance_any_id;
         esp_event_handler_instance_t instance_got_ip;
@@ -230,19 +430,33 @@ void wifi_init_sta(void)
                                                         &event_handler,
                                                         NULL,
                                                         &instance_got_ip));
+        esp_event_handler_instance_t instance_retry;
+        ESP_ERROR_CHECK(esp_event_handler_instance_register(WIFI_RETRY_EVENT,
+                                                        ESP_EVENT_ANY_ID,
+                                                        &event_handler,
+                                                        NULL,
+                                                        &instance_retry));
+
+        // Backoff jitter differs per device, so switches that lost the same AP spread out
+        uint8_t mac[6];
+        esp_efuse_mac_get_default(mac);
+        wifi_reconnect_init(&reconnect, mac);
+        const esp_timer_create_args_t retry_timer_args = {
+            .callback = retry_timer_callback,
+            .name = "wifi_retry",
+        };
+        ESP_ERROR_CHECK(esp_timer_create(&retry_timer_args, &retry_timer));
     }
-    char ssid[100] = {0};
-    char password[100] = {0};
+    device_config_t config;
     ESP_LOGI(TAG, "WiFi Credentials");
-    nvs_read_wifi_credentials(ssid,password, NULL, NULL, NULL, NULL);
-    ESP_LOGI(TAG, "*******SSID for wifi: %s", ssid);
-    ESP_LOGI(TAG, "*******Password for wifi: %s", password);
+    config_store_get(&config);
+    ESP_LOGI(TAG, "*******SSID for wifi: %s", config.ssid);
 
     wifi_config_t wifi_config = {0};
 
     // Copy the SSID and password to the wifi_config structure
-    strlcpy((char*)wifi_config.sta.ssid, ssid, sizeof(wifi_config.sta.ssid));
-    strlcpy((char*)wifi_config.sta.password, password, sizeof(wifi_config.sta.password));
+    strlcpy((char*)wifi_config.sta.ssid, config.ssid, sizeof(wifi_config.sta.ssid));
+    strlcpy((char*)wifi_config.sta.password, config.password, sizeof(wifi_config.sta.password));
 
     // Log the length of the strings after copying
     ESP_LOGI(TAG, "Length of wifi_config.sta.ssid: %d characters", strlen((char*)wifi_config.sta.ssid));
@@ -258,6 +472,18 @@ void wifi_init_sta(void)
     // Set channel to 0 to scan all channels
     wifi_config.sta.channel = 0;
 
+    // Go straight to the AP of the last connect; a failed attempt falls back to the scan
+    if (config.ap_channel != 0) {
+        memcpy(wifi_config.sta.bssid, config.ap_bssid, sizeof(wifi_config.sta.bssid));
+        wifi_config.sta.bssid_set = true;
+        wifi_config.sta.channel = config.ap_channel;
+        if (config.ap_authmode > WIFI_AUTH_WPA2_PSK && config.ap_authmode < WIFI_AUTH_MAX) {
+            wifi_config.sta.threshold.authmode = config.ap_authmode;
+        }
+        ESP_LOGI(TAG, "Connecting directly to cached AP " MACSTR " on channel %d",
+                 MAC2STR(config.ap_bssid), config.ap_channel);
+    }
+
     // Set scan method to active for better AP discovery
     wifi_config.sta.scan_method = WIFI_FAST_SCAN;
 
@@ -267,7 +493,7 @@ void wifi_init_sta(void)
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
 
     // Only set WiFi config and attempt to connect if we have valid credentials
-    if (strlen(ssid) > 0) {
+    if (strlen(config.ssid) > 0) {
         ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config));
     } else {
         ESP_LOGI(TAG, "No WiFi credentials available, not attempting to connect");
@@ -298,24 +524,7 @@ void wifi_init_sta(void)
     };
     ESP_ERROR_CHECK(esp_wifi_set_country(&country));
 
-    EventBits_t bits = xEventGroupWaitBits(s_wifi_event_group,
-            WIFI_CONNECTED_BIT | WIFI_FAIL_BIT,
-            pdFALSE,
-            pdFALSE,
-            portMAX_DELAY);
-
-    if (bits & WIFI_CONNECTED_BIT) {
-        ESP_LOGI(TAG, "connected to ap SSID:%s password:%s",
-                 ssid, password);
-        is_connected = true;
-    } else if (bits & WIFI_FAIL_BIT) {
-        ESP_LOGI(TAG, "Failed to connect to SSID:%s, password:%s",
-                 ssid, password);
-        is_connected = false;
-    } else {
-        ESP_LOGE(TAG, "UNEXPECTED EVENT");
-        is_connected = false;
-    }
+    // No waiting here: the event handler connects, retries and sets is_connected
 }
 
 void wifi_scan_task(void *pvParameters) {
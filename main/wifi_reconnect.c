@@ -0,0 +1,102 @@
+#include "wifi_reconnect.h"
+
+static const uint32_t base_ms[WIFI_DISC_CLASS_COUNT] = {
+    [WIFI_DISC_LINK]  = WIFI_RECONNECT_LINK_BASE_MS,
+    [WIFI_DISC_NO_AP] = WIFI_RECONNECT_NO_AP_BASE_MS,
+    [WIFI_DISC_AUTH]  = WIFI_RECONNECT_AUTH_BASE_MS,
+};
+
+static const uint32_t cap_ms[WIFI_DISC_CLASS_COUNT] = {
+    [WIFI_DISC_LINK]  = WIFI_RECONNECT_LINK_CAP_MS,
+    [WIFI_DISC_NO_AP] = WIFI_RECONNECT_NO_AP_CAP_MS,
+    [WIFI_DISC_AUTH]  = WIFI_RECONNECT_AUTH_CAP_MS,
+};
+
+/* xorshift32 */
+static uint32_t next_random(wifi_reconnect_t *rc)
+{
+    uint32_t x = rc->rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    rc->rng = x;
+    return x;
+}
+
+void wifi_reconnect_init(wifi_reconnect_t *rc, const uint8_t mac[6])
+{
+    // FNV-1a over the MAC: neighbouring serial numbers land far apart
+    uint32_t seed = 2166136261u;
+    for (int i = 0; i < 6; i++) {
+        seed = (seed ^ mac[i]) * 16777619u;
+    }
+    rc->rng = seed ? seed : 1;
+    rc->state = WIFI_RECONNECT_IDLE;
+    rc->failures = 0;
+    rc->due_us = 0;
+    rc->down_since_us = 0;
+}
+
+void wifi_reconnect_attempt(wifi_reconnect_t *rc, int64_t now_us)
+{
+    (void)now_us;
+    rc->state = WIFI_RECONNECT_CONNECTING;
+}
+
+uint32_t wifi_reconnect_disconnected(wifi_reconnect_t *rc, wifi_disc_class_t cls, int64_t now_us)
+{
+    if (cls >= WIFI_DISC_CLASS_COUNT) {
+        cls = WIFI_DISC_LINK;
+    }
+
+    if (rc->state == WIFI_RECONNECT_CONNECTED) {
+        // Link lost: a new outage, first retry after the base wait
+        rc->down_since_us = now_us;
+        rc->failures = 0;
+    } else if (rc->failures < UINT16_MAX) {
+        // An attempt failed (or the driver reported the same loss twice)
+        rc->failures++;
+    }
+    uint32_t steps = rc->failures;
+
+    uint32_t wait = cap_ms[cls];
+    if (steps < 31 && (base_ms[cls] >> (31 - steps)) == 0) {
+        uint32_t grown = base_ms[cls] << steps;
+        if (grown < wait) {
+            wait = grown;
+        }
+    }
+    // Equal jitter: half fixed so the backoff still grows, half random per device
+    wait = wait / 2 + next_random(rc) % (wait / 2 + 1);
+
+    rc->state = WIFI_RECONNECT_WAITING;
+    rc->due_us = now_us + (int64_t)wait * 1000;
+    return wait;
+}
+
+uint32_t wifi_reconnect_connected(wifi_reconnect_t *rc, int64_t now_us)
+{
+    uint32_t down_ms = 0;
+    if (rc->down_since_us != 0 && now_us > rc->down_since_us) {
+        down_ms = (uint32_t)((now_us - rc->down_since_us) / 1000);
+    }
+    rc->state = WIFI_RECONNECT_CONNECTED;
+    rc->failures = 0;
+    rc->down_since_us = 0;
+    return down_ms;
+}
+
+bool wifi_reconnect_due(const wifi_reconnect_t *rc, int64_t now_us)
+{
+    return rc->state == WIFI_RECONNECT_WAITING && now_us >= rc->due_us;
+}
+
+const char *wifi_disc_class_name(wifi_disc_class_t cls)
+{
+    switch (cls) {
+        case WIFI_DISC_LINK:  return "link";
+        case WIFI_DISC_NO_AP: return "no_ap";
+        case WIFI_DISC_AUTH:  return "auth";
+        default:              return "unknown";
+    }
+}
@@ -0,0 +1,113 @@
+#include <stdio.h>
+#include "esp_timer.h"
+#include "wifi_stats.h"
+
+static wifi_stats_t stats;
+static int64_t cycle_start_us;   // 0 when no connect cycle is in progress
+static int64_t assoc_us;         // association time of the current cycle, 0 if not yet
+
+void wifi_stats_connect_start(bool fast)
+{
+    stats.attempts++;
+    if (fast) {
+        stats.fast_attempts++;
+    }
+    if (cycle_start_us == 0) {
+        cycle_start_us = esp_timer_get_time();
+        assoc_us = 0;
+    }
+}
+
+void wifi_stats_fallback(void)
+{
+    stats.fallbacks++;
+}
+
+void wifi_stats_associated(uint8_t channel, bool fast)
+{
+    stats.channel = channel;
+    stats.last_fast = fast;
+    if (cycle_start_us != 0) {
+        assoc_us = esp_timer_get_time();
+        stats.last_assoc_ms = (uint32_t)((assoc_us - cycle_start_us) / 1000);
+    }
+}
+
+void wifi_stats_got_ip(void)
+{
+    if (cycle_start_us == 0) {
+        return;                      // connected outside a tracked cycle (provisioning, scan)
+    }
+    uint32_t ip_ms = (uint32_t)((esp_timer_get_time() - cycle_start_us) / 1000);
+    stats.connects++;
+    stats.last_ip_ms = ip_ms;
+    stats.total_ip_ms += ip_ms;
+    if (ip_ms > stats.max_ip_ms) {
+        stats.max_ip_ms = ip_ms;
+    }
+    cycle_start_us = 0;
+}
+
+void wifi_stats_disconnected(wifi_disc_class_t cls, uint32_t retry_ms)
+{
+    if (cls < WIFI_DISC_CLASS_COUNT) {
+        stats.disconnects[cls]++;
+    }
+    stats.retry_ms = retry_ms;
+}
+
+void wifi_stats_reconnected(uint32_t down_ms)
+{
+    stats.outages++;
+    stats.last_down_ms = down_ms;
+    if (down_ms > stats.max_down_ms) {
+        stats.max_down_ms = down_ms;
+    }
+}
+
+void wifi_stats_scan_hit(void)
+{
+    stats.scan_hits++;
+}
+
+void wifi_stats_scan_done(bool ok, uint32_t duration_ms, uint32_t first_ms)
+{
+    stats.scan_misses++;
+    if (!ok) {
+        stats.scan_failures++;
+        return;
+    }
+    stats.last_scan_ms = duration_ms;
+    stats.first_result_ms = first_ms;
+    if (duration_ms > stats.max_scan_ms) {
+        stats.max_scan_ms = duration_ms;
+    }
+}
+
+void wifi_stats_get(wifi_stats_t *out)
+{
+    *out = stats;
+}
+
+int wifi_stats_format(char *buf, size_t size)
+{
+    wifi_stats_t s;
+    wifi_stats_get(&s);
+
+    int n = snprintf(buf, size,
+                     "{\"wifi\":{\"attempts\":%lu,\"fast\":%lu,\"fallbacks\":%lu,\"connects\":%lu,"
+                     "\"assoc_ms\":%lu,\"ip_ms\":%lu,\"avg_ip_ms\":%lu,\"max_ip_ms\":%lu,\"last_fast\":%s,\"ch\":%u,"
+                     "\"disc\":{\"link\":%lu,\"no_ap\":%lu,\"auth\":%lu},\"retry_ms\":%lu,"
+                     "\"outages\":%lu,\"down_ms\":%lu,\"max_down_ms\":%lu,"
+                     "\"scan\":{\"hits\":%lu,\"misses\":%lu,\"failed\":%lu,\"ms\":%lu,\"max_ms\":%lu,\"first_ms\":%lu}}}",
+                     (unsigned long)s.attempts, (unsigned long)s.fast_attempts, (unsigned long)s.fallbacks,
+                     (unsigned long)s.connects, (unsigned long)s.last_assoc_ms, (unsigned long)s.last_ip_ms,
+                     (unsigned long)(s.connects ? s.total_ip_ms / s.connects : 0), (unsigned long)s.max_ip_ms,
+                     s.last_fast ? "true" : "false", s.channel,
+                     (unsigned long)s.disconnects[WIFI_DISC_LINK], (unsigned long)s.disconnects[WIFI_DISC_NO_AP],
+                     (unsigned long)s.disconnects[WIFI_DISC_AUTH], (unsigned long)s.retry_ms,
+                     (unsigned long)s.outages, (unsigned long)s.last_down_ms, (unsigned long)s.max_down_ms,
+                     (unsigned long)s.scan_hits, (unsigned long)s.scan_misses, (unsigned long)s.scan_failures,
+                     (unsigned long)s.last_scan_ms, (unsigned long)s.max_scan_ms, (unsigned long)s.first_result_ms);
+    return (n < (int)size) ? n : (int)size - 1;
+}
@@ -0,0 +1,160 @@
+#include <stdio.h>
+#include <string.h>
+#include "wire_format.h"
+
+/* ---------------- Byte helpers ---------------- */
+static void put_u16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void put_u32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static uint16_t get_u16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t get_u32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static int16_t temperature_to_fixed(float celsius)
+{
+    float scaled = celsius * 100.0f;
+    if (scaled > INT16_MAX) {
+        return INT16_MAX;
+    }
+    if (scaled < INT16_MIN) {
+        return INT16_MIN;
+    }
+    return (int16_t)(scaled < 0 ? scaled - 0.5f : scaled + 0.5f);
+}
+
+static uint32_t lux_to_fixed(float lux)
+{
+    if (lux <= 0.0f) {
+        return 0;
+    }
+    float scaled = lux * 100.0f + 0.5f;
+    return scaled >= 4294967295.0f ? UINT32_MAX : (uint32_t)scaled;
+}
+
+/* ---------------- Frame codec ---------------- */
+size_t wire_encode(const wire_frame_t *frame, uint8_t *buf, size_t buf_len)
+{
+    size_t len = frame && frame->seq.has_seq ? WIRE_FRAME_V2_LEN : WIRE_FRAME_V1_LEN;
+    if (frame == NULL || buf == NULL || buf_len < len) {
+        return 0;
+    }
+
+    uint8_t flags = frame->flags & (WIRE_FLAG_HAS_TEMP | WIRE_FLAG_HAS_LUX | WIRE_FLAG_HAS_OCCUPANCY);
+    if (frame->reading.presence_detected) {
+        flags |= WIRE_FLAG_PRESENCE | WIRE_FLAG_HAS_OCCUPANCY;
+    }
+    if (frame->reading.motion_detected) {
+        flags |= WIRE_FLAG_MOTION | WIRE_FLAG_HAS_OCCUPANCY;
+    }
+    if (frame->reading.has & SENSOR_HAS_OCCUPANCY) {
+        flags |= WIRE_FLAG_HAS_OCCUPANCY;
+    }
+
+    buf[0] = WIRE_MAGIC;
+    buf[1] = frame->seq.has_seq ? WIRE_VERSION_SEQ : WIRE_VERSION;
+    memcpy(&buf[2], frame->device_mac, 6);
+    buf[8] = (uint8_t)frame->reading.origin;
+    buf[9] = flags;
+    buf[10] = frame->channel;
+    buf[11] = 0;
+    put_u16(&buf[12], (uint16_t)temperature_to_fixed(frame->reading.temperature));
+    put_u32(&buf[14], lux_to_fixed(frame->reading.lux));
+    if (frame->seq.has_seq) {
+        put_u32(&buf[18], frame->seq.seq);
+        put_u32(&buf[22], frame->seq.sender_ms);
+    }
+
+    return len;
+}
+
+bool wire_decode(const uint8_t *buf, size_t len, wire_frame_t *frame)
+{
+    if (buf == NULL || frame == NULL || len < WIRE_FRAME_V1_LEN || buf[0] != WIRE_MAGIC || buf[11] != 0) {
+        return false;
+    }
+    if (!(buf[1] == WIRE_VERSION && len == WIRE_FRAME_V1_LEN) &&
+        !(buf[1] == WIRE_VERSION_SEQ && len == WIRE_FRAME_V2_LEN)) {
+        return false;
+    }
+
+    uint8_t flags = buf[9];
+    memcpy(frame->device_mac, &buf[2], 6);
+    frame->channel = buf[10];
+    frame->flags = flags;
+    frame->reading.origin = buf[8] <= SENSOR_ORIGIN_LUX ? (sensor_origin_t)buf[8] : SENSOR_ORIGIN_OTHER;
+    frame->reading.presence_detected = (flags & WIRE_FLAG_PRESENCE) != 0;
+    frame->reading.motion_detected = (flags & WIRE_FLAG_MOTION) != 0;
+    frame->reading.temperature = (flags & WIRE_FLAG_HAS_TEMP) ? (int16_t)get_u16(&buf[12]) / 100.0f : 0.0f;
+    frame->reading.lux = (flags & WIRE_FLAG_HAS_LUX) ? get_u32(&buf[14]) / 100.0f : 0.0f;
+    // Only a sensor that reports occupancy takes part in the vote
+    frame->reading.has = 0;
+    if (flags & WIRE_FLAG_HAS_OCCUPANCY) {
+        frame->reading.has |= SENSOR_HAS_OCCUPANCY;
+    }
+    if (flags & WIRE_FLAG_HAS_TEMP) {
+        frame->reading.has |= SENSOR_HAS_TEMPERATURE;
+    }
+    if (flags & WIRE_FLAG_HAS_LUX) {
+        frame->reading.has |= SENSOR_HAS_LUX;
+    }
+
+    memset(&frame->seq, 0, sizeof(frame->seq));
+    if (buf[1] == WIRE_VERSION_SEQ) {
+        frame->seq.has_seq = true;
+        frame->seq.has_ts = true;
+        frame->seq.seq = get_u32(&buf[18]);
+        frame->seq.sender_ms = get_u32(&buf[22]);
+    }
+
+    return true;
+}
+
+/* ---------------- MAC helpers ---------------- */
+static int hex_nibble(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+bool wire_mac_from_string(const char *str, size_t len, uint8_t mac[6])
+{
+    // Exactly "XX:XX:XX:XX:XX:XX"
+    if (str == NULL || len != 17) {
+        return false;
+    }
+    for (int i = 0; i < 6; i++) {
+        const char *p = str + i * 3;
+        int hi = hex_nibble(p[0]);
+        int lo = hex_nibble(p[1]);
+        if (hi < 0 || lo < 0 || (i < 5 && p[2] != ':')) {
+            return false;
+        }
+        mac[i] = (uint8_t)((hi << 4) | lo);
+    }
+    return true;
+}
+
+void wire_mac_to_string(const uint8_t mac[6], char *out, size_t out_len)
+{
+    snprintf(out, out_len, "%02X:%02X:%02X:%02X:%02X:%02X",
+             mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+}
@@ -0,0 +1,264 @@
+/*
+ * Packets per second and heap churn of cmd_parser against the cJSON path it
+ * replaced (parse the datagram, then parse the "command" string again), and
+ * of the binary frame (wire_decode/wire_encode) carrying the same reading.
+ *
+ *   bench_cmd_parser [iterations]
+ *
+ * The cJSON side is only built when CMake finds cJSON.c (ESP-IDF's copy via
+ * IDF_PATH, or -DCJSON_DIR=...). Heap churn is counted by wrapping malloc at
+ * link time, which needs GNU ld; elsewhere it is reported as n/a.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "cmd_parser.h"
+#include "host_test.h"
+#include "wire_format.h"
+#ifdef HAVE_CJSON
+#include "cJSON.h"
+#endif
+
+/* ---------------- Heap accounting ---------------- */
+static bool counting;
+static unsigned long alloc_calls;
+static unsigned long alloc_bytes;
+
+#ifdef BENCH_WRAP_MALLOC
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size)
+{
+    if (counting) {
+        alloc_calls++;
+        alloc_bytes += size;
+    }
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size)
+{
+    if (counting) {
+        alloc_calls++;
+        alloc_bytes += count * size;
+    }
+    return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    if (counting) {
+        alloc_calls++;
+        alloc_bytes += size;
+    }
+    return __real_realloc(ptr, size);
+}
+#endif
+
+/* ---------------- Packets ---------------- */
+typedef struct {
+    const char *name;
+    const char *json;
+    bool nested_string;          // the form the cJSON path understood
+} bench_packet_t;
+
+static const bench_packet_t packets[] = {
+    { "nested string",
+      "{\"command\":\"{\\\"presence_detected\\\":true,\\\"motion_detected\\\":false,"
+      "\\\"temperature\\\":23.5,\\\"lux\\\":120.25}\",\"source\":\"AIOS_SENSOR\","
+      "\"origin\":\"TEMP\",\"device_id\":\"AA:BB:CC:DD:EE:FF\"}", true },
+    { "nested string+seq",
+      "{\"command\":\"{\\\"presence_detected\\\":false,\\\"motion_detected\\\":true,"
+      "\\\"temperature\\\":-4.75,\\\"lux\\\":0}\",\"source\":\"AIOS_SENSOR\",\"origin\":\"MOTION\","
+      "\"device_id\":\"AA:BB:CC:DD:EE:FF\",\"seq\":123456,\"ts\":987654321}", true },
+    { "flat",
+      "{\"source\":\"AIOS_SENSOR\",\"device_id\":\"AA:BB:CC:DD:EE:FF\",\"origin\":\"LUX\","
+      "\"presence_detected\":true,\"motion_detected\":true,\"temperature\":19.0,\"lux\":850.5}", false },
+    { "request", "{\"cmd\":\"stats\"}", false },
+};
+#define PACKET_COUNT (sizeof(packets) / sizeof(packets[0]))
+
+/* ---------------- Parsers under test ---------------- */
+typedef struct {
+    bool ok;
+    bool presence;
+    bool motion;
+    float temperature;
+    float lux;
+} bench_result_t;
+
+static char work[512];
+
+static bench_result_t run_cmd_parser(const void *json, size_t len)
+{
+    bench_result_t r = { 0 };
+    udp_command_t cmd;
+
+    memcpy(work, json, len);
+    r.ok = cmd_parse_udp_packet(work, len, &cmd);
+    r.presence = cmd.reading.presence_detected;
+    r.motion = cmd.reading.motion_detected;
+    r.temperature = cmd.reading.temperature;
+    r.lux = cmd.reading.lux;
+    return r;
+}
+
+#ifdef HAVE_CJSON
+// The receive path before cmd_parser: two full parses, one tree node per value
+static bench_result_t run_cjson(const void *json, size_t len)
+{
+    bench_result_t r = { 0 };
+
+    memcpy(work, json, len + 1);
+    cJSON *root = cJSON_Parse(work);
+    if (root == NULL) {
+        return r;
+    }
+    cJSON *command = cJSON_GetObjectItem(root, "command");
+    cJSON *source = cJSON_GetObjectItem(root, "source");
+    cJSON *device_id = cJSON_GetObjectItem(root, "device_id");
+    if (command && cJSON_IsString(command) && source && cJSON_IsString(source) &&
+        device_id && cJSON_IsString(device_id)) {
+        cJSON *sensor = cJSON_Parse(command->valuestring);
+        if (sensor != NULL) {
+            cJSON *presence = cJSON_GetObjectItem(sensor, "presence_detected");
+            cJSON *motion = cJSON_GetObjectItem(sensor, "motion_detected");
+            cJSON *temperature = cJSON_GetObjectItem(sensor, "temperature");
+            cJSON *lux = cJSON_GetObjectItem(sensor, "lux");
+            r.ok = true;
+            r.presence = presence && cJSON_IsBool(presence) ? cJSON_IsTrue(presence) : false;
+            r.motion = motion && cJSON_IsBool(motion) ? cJSON_IsTrue(motion) : false;
+            r.temperature = temperature && cJSON_IsNumber(temperature) ? (float)cJSON_GetNumberValue(temperature) : 0.0f;
+            r.lux = lux && cJSON_IsNumber(lux) ? (float)cJSON_GetNumberValue(lux) : 0.0f;
+            cJSON_Delete(sensor);
+        }
+    }
+    cJSON_Delete(root);
+    return r;
+}
+#endif
+
+// The binary receive path: one fixed-layout frame, no text at all
+static bench_result_t run_wire_decode(const void *buf, size_t len)
+{
+    bench_result_t r = { 0 };
+    wire_frame_t frame;
+
+    r.ok = wire_decode(buf, len, &frame);
+    r.presence = frame.reading.presence_detected;
+    r.motion = frame.reading.motion_detected;
+    r.temperature = frame.reading.temperature;
+    r.lux = frame.reading.lux;
+    return r;
+}
+
+// What a sensor does per report; `len` is the frame length it must produce
+static bench_result_t run_wire_encode(const void *frame, size_t len)
+{
+    bench_result_t r = { 0 };
+    uint8_t buf[WIRE_FRAME_V2_LEN];
+
+    r.ok = wire_encode(frame, buf, sizeof(buf)) == len;
+    return r;
+}
+
+/* ---------------- Measurement ---------------- */
+typedef bench_result_t (*bench_fn_t)(const void *input, size_t len);
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Prints packets/s and allocations per packet; returns the allocations per packet
+static double measure(const char *parser, const char *name, bench_fn_t fn, const void *input, size_t len,
+                      long iterations)
+{
+    volatile bool sink = false;
+
+    alloc_calls = 0;
+    alloc_bytes = 0;
+    counting = true;
+    double start = now_s();
+    for (long i = 0; i < iterations; i++) {
+        sink ^= fn(input, len).ok;
+    }
+    double elapsed = now_s() - start;
+    counting = false;
+    (void)sink;
+
+    double calls = (double)alloc_calls / iterations;
+    printf("  %-11s %-18s %12.0f pkt/s", parser, name, iterations / elapsed);
+#ifdef BENCH_WRAP_MALLOC
+    printf("  %6.1f allocs/pkt  %8.1f bytes/pkt\n", calls, (double)alloc_bytes / iterations);
+#else
+    printf("  heap churn n/a\n");
+#endif
+    return calls;
+}
+
+int main(int argc, char **argv)
+{
+    long iterations = argc > 1 ? strtol(argv[1], NULL, 10) : 20000;
+    if (iterations <= 0) {
+        iterations = 20000;
+    }
+
+    // Both parsers must agree on what they decode before their speed means anything
+    for (size_t i = 0; i < PACKET_COUNT; i++) {
+        bench_result_t ours = run_cmd_parser(packets[i].json, strlen(packets[i].json));
+        CHECK(ours.ok);
+#ifdef HAVE_CJSON
+        if (packets[i].nested_string) {
+            bench_result_t theirs = run_cjson(packets[i].json, strlen(packets[i].json));
+            CHECK(theirs.ok);
+            CHECK_EQ(ours.presence, theirs.presence);
+            CHECK_EQ(ours.motion, theirs.motion);
+            CHECK(ours.temperature == theirs.temperature);
+            CHECK(ours.lux == theirs.lux);
+        }
+#endif
+    }
+
+    // The "nested string+seq" reading as a version 2 binary frame decodes to the same values
+    wire_frame_t frame = { .channel = 0, .flags = WIRE_FLAG_HAS_TEMP | WIRE_FLAG_HAS_LUX };
+    uint8_t binary[WIRE_FRAME_V2_LEN];
+    CHECK(wire_mac_from_string("AA:BB:CC:DD:EE:FF", 17, frame.device_mac));
+    frame.reading.motion_detected = true;
+    frame.reading.temperature = -4.75f;
+    frame.reading.origin = SENSOR_ORIGIN_MOTION;
+    frame.seq = (sensor_seq_t){ .has_seq = true, .has_ts = true, .seq = 123456, .sender_ms = 987654321 };
+    CHECK_EQ(wire_encode(&frame, binary, sizeof(binary)), sizeof(binary));
+    bench_result_t json_seq = run_cmd_parser(packets[1].json, strlen(packets[1].json));
+    bench_result_t decoded = run_wire_decode(binary, sizeof(binary));
+    CHECK(decoded.ok);
+    CHECK_EQ(decoded.presence, json_seq.presence);
+    CHECK_EQ(decoded.motion, json_seq.motion);
+    CHECK(decoded.temperature == json_seq.temperature);
+    CHECK(decoded.lux == json_seq.lux);
+
+    printf("%ld iterations per packet\n", iterations);
+    for (size_t i = 0; i < PACKET_COUNT; i++) {
+        size_t len = strlen(packets[i].json);
+        double calls = measure("cmd_parser", packets[i].name, run_cmd_parser, packets[i].json, len, iterations);
+        CHECK(calls == 0.0);
+#ifdef HAVE_CJSON
+        if (packets[i].nested_string) {
+            measure("cJSON", packets[i].name, run_cjson, packets[i].json, len, iterations);
+        }
+#endif
+    }
+    CHECK(measure("wire_decode", "binary v2", run_wire_decode, binary, sizeof(binary), iterations) == 0.0);
+    CHECK(measure("wire_encode", "binary v2", run_wire_encode, &frame, sizeof(binary), iterations) == 0.0);
+#ifndef HAVE_CJSON
+    printf("cJSON.c not found (set IDF_PATH or CJSON_DIR): cJSON path skipped\n");
+#endif
+
+    return host_test_done("bench_cmd_parser");
+}
@@ -0,0 +1,32 @@
+#ifndef HOST_TEST_H
+#define HOST_TEST_H
+
+#include <stdio.h>
+
+/* Minimal assertions for the host tests: count failures, keep going, exit non-zero */
+
+static int host_test_failures;
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            printf("%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+            host_test_failures++; \
+        } \
+    } while (0)
+
+#define CHECK_EQ(a, b) do { \
+        long long _a = (long long)(a), _b = (long long)(b); \
+        if (_a != _b) { \
+            printf("%s:%d: CHECK_EQ failed: %s == %lld, expected %s == %lld\n", \
+                   __FILE__, __LINE__, #a, _a, #b, _b); \
+            host_test_failures++; \
+        } \
+    } while (0)
+
+static inline int host_test_done(const char *name)
+{
+    printf("%s: %s\n", name, host_test_failures ? "FAILED" : "passed");
+    return host_test_failures ? 1 : 0;
+}
+
+#endif /* HOST_TEST_H */
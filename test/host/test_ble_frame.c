@@ -0,0 +1,322 @@
+/* ble_frame: fragmenting replies and reassembling them, at the MTUs phones actually negotiate,
+ * and collecting long writes from prepared-write fragments */
+#include <stdlib.h>
+#include <string.h>
+#include "host_test.h"
+#include "ble_frame.h"
+
+#define MAX_PAYLOAD  8192
+#define MAX_FRAGS    (MAX_PAYLOAD / (BLE_FRAME_MIN_CHUNK - 1) + 2)
+
+typedef struct {
+    uint8_t *data[MAX_FRAGS];
+    size_t len[MAX_FRAGS];
+    size_t count;
+} frag_list_t;
+
+static const size_t mtus[] = { 23, 185, 517 };
+
+static uint32_t rng = 12345;
+
+static uint32_t next_rand(void)
+{
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+}
+
+static void fill(uint8_t *buf, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        buf[i] = (uint8_t)next_rand();
+    }
+}
+
+static void split(const uint8_t *payload, size_t len, size_t chunk, uint8_t id, frag_list_t *out)
+{
+    static uint8_t scratch[600];
+    ble_frag_t frag;
+    const uint8_t *p;
+    size_t n;
+    out->count = 0;
+    ble_frag_begin(&frag, payload, len, chunk, id);
+    while ((n = ble_frag_next(&frag, scratch, &p)) > 0 && out->count < MAX_FRAGS) {
+        CHECK(n <= chunk);
+        out->data[out->count] = malloc(n);
+        memcpy(out->data[out->count], p, n);
+        out->len[out->count++] = n;
+    }
+}
+
+static void release(frag_list_t *list)
+{
+    for (size_t i = 0; i < list->count; i++) {
+        free(list->data[i]);
+    }
+    list->count = 0;
+}
+
+/* Feed a list (skipping index skip, if any); returns the number of complete messages */
+static int feed(ble_reasm_t *reasm, const frag_list_t *list, size_t skip, int *last_len)
+{
+    int complete = 0;
+    for (size_t i = 0; i < list->count; i++) {
+        if (i == skip) {
+            continue;
+        }
+        int r = ble_reasm_feed(reasm, list->data[i], list->len[i]);
+        if (r > 0) {
+            complete++;
+            *last_len = r;
+        }
+    }
+    return complete;
+}
+
+static void test_round_trip(size_t mtu)
+{
+    static uint8_t payload[MAX_PAYLOAD], buf[MAX_PAYLOAD];
+    size_t chunk = mtu - 3;
+    size_t sizes[] = { 1, chunk - 1, chunk, chunk + 1, 1024, 4096, MAX_PAYLOAD };
+    ble_reasm_t reasm;
+    ble_reasm_init(&reasm, buf, sizeof(buf));
+
+    for (int round = 0; round < 300; round++) {
+        size_t len = round < 7 ? sizes[round] : 1 + next_rand() % MAX_PAYLOAD;
+        fill(payload, len);
+        if (round % 2) {
+            payload[0] = '{';            // JSON: short ones must go out unframed
+        }
+        frag_list_t list;
+        split(payload, len, chunk, (uint8_t)round, &list);
+
+        size_t body = chunk - 1;
+        size_t expected = (len <= chunk && payload[0] < 0x80) ? 1 :
+                          (len + BLE_FRAME_FIRST_HDR_LEN - 1 + body - 1) / body;
+        CHECK_EQ(list.count, expected);
+        if (expected == 1 && payload[0] < 0x80) {
+            CHECK(list.len[0] == len && memcmp(list.data[0], payload, len) == 0);
+        }
+
+        int got = 0;
+        CHECK_EQ(feed(&reasm, &list, (size_t)-1, &got), 1);
+        CHECK_EQ(got, len);
+        CHECK(memcmp(buf, payload, len) == 0);
+        release(&list);
+    }
+    CHECK_EQ(reasm.errors, 0);
+}
+
+/* A message missing a fragment is dropped whole, and the next one still gets through */
+static void test_lost(size_t mtu)
+{
+    static uint8_t payload[MAX_PAYLOAD], buf[MAX_PAYLOAD];
+    size_t chunk = mtu - 3;
+    ble_reasm_t reasm;
+    ble_reasm_init(&reasm, buf, sizeof(buf));
+
+    for (int round = 0; round < 100; round++) {
+        size_t len = 1024 + next_rand() % (MAX_PAYLOAD - 1024);
+        fill(payload, len);
+        frag_list_t list;
+        split(payload, len, chunk, (uint8_t)round, &list);
+        CHECK(list.count >= 3);
+
+        // round % 3: lose the first, a middle or the last fragment
+        size_t skip = round % 3 == 0 ? 0 : round % 3 == 1 ? 1 + next_rand() % (list.count - 2) : list.count - 1;
+        uint32_t errors = reasm.errors;
+        int got = 0;
+        CHECK_EQ(feed(&reasm, &list, skip, &got), 0);
+        if (skip != list.count - 1) {
+            CHECK(reasm.errors > errors);
+        }
+
+        // The next message is delivered intact (a lost last fragment is counted here)
+        fill(payload, 2000);
+        frag_list_t next;
+        split(payload, 2000, chunk, (uint8_t)(round + 1), &next);
+        CHECK_EQ(feed(&reasm, &next, (size_t)-1, &got), 1);
+        CHECK_EQ(got, 2000);
+        CHECK(memcmp(buf, payload, 2000) == 0);
+        if (skip == list.count - 1) {
+            CHECK(reasm.errors > errors);
+        }
+        release(&list);
+        release(&next);
+    }
+}
+
+/* Two fragments swapped in flight: dropped, never delivered with the bytes in the wrong place */
+static void test_reordered(size_t mtu)
+{
+    static uint8_t payload[MAX_PAYLOAD], buf[MAX_PAYLOAD];
+    size_t chunk = mtu - 3;
+    ble_reasm_t reasm;
+    ble_reasm_init(&reasm, buf, sizeof(buf));
+
+    for (int round = 0; round < 100; round++) {
+        size_t len = 1024 + next_rand() % (MAX_PAYLOAD - 1024);
+        fill(payload, len);
+        frag_list_t list;
+        split(payload, len, chunk, (uint8_t)round, &list);
+
+        size_t i = next_rand() % (list.count - 1);
+        size_t j = i + 1 + next_rand() % (list.count - 1 - i);
+        if (j - i == 32 && j + 1 < list.count) {
+            j++;                         // indices 32 apart look the same modulo 32
+        }
+        uint8_t *d = list.data[i];
+        size_t l = list.len[i];
+        list.data[i] = list.data[j];
+        list.len[i] = list.len[j];
+        list.data[j] = d;
+        list.len[j] = l;
+
+        int got = 0;
+        CHECK_EQ(feed(&reasm, &list, (size_t)-1, &got), 0);
+        release(&list);
+    }
+    CHECK(reasm.errors > 0);
+}
+
+static void test_limits(void)
+{
+    static uint8_t payload[2048], buf[1024];
+    ble_reasm_t reasm;
+    ble_reasm_init(&reasm, buf, sizeof(buf));
+    fill(payload, sizeof(payload));
+
+    // Longer than the receiver's buffer: dropped at the first fragment
+    frag_list_t list;
+    split(payload, sizeof(payload), 20, 1, &list);
+    int got = 0;
+    CHECK_EQ(feed(&reasm, &list, (size_t)-1, &got), 0);
+    CHECK(reasm.errors > 0);
+    release(&list);
+
+    // A short payload starting with a header-like byte is framed, not sent raw
+    payload[0] = 0x80 | BLE_FRAME_FLAG_FIRST;
+    split(payload, 10, 20, 2, &list);
+    CHECK_EQ(list.count, 1);
+    CHECK(list.data[0][0] & BLE_FRAME_FLAG_FRAGMENT);
+    CHECK_EQ(feed(&reasm, &list, (size_t)-1, &got), 1);
+    CHECK_EQ(got, 10);
+    CHECK(memcmp(buf, payload, 10) == 0);
+    release(&list);
+
+    // Empty notifications are rejected
+    CHECK_EQ(ble_reasm_feed(&reasm, payload, 0), -1);
+}
+
+/* ---------------- Prepared writes ---------------- */
+#define PREP_CAP 4096
+
+static uint8_t prep_arena[PREP_CAP + 1];
+
+// A long write bigger than the 512-byte ATT value limit, in prepare-write sized pieces (MTU - 5)
+static void test_prep_long_write(size_t mtu)
+{
+    static uint8_t value[PREP_CAP];
+    ble_prep_t prep;
+    uint16_t handle = 0;
+    size_t chunk = mtu - 5;
+
+    fill(value, sizeof(value));
+    ble_prep_init(&prep, prep_arena, PREP_CAP);
+    for (size_t off = 0; off < sizeof(value); off += chunk) {
+        size_t n = sizeof(value) - off < chunk ? sizeof(value) - off : chunk;
+        CHECK_EQ(ble_prep_write(&prep, 42, off, value + off, n), BLE_PREP_OK);
+    }
+    CHECK_EQ(ble_prep_take(&prep, &handle), PREP_CAP);
+    CHECK_EQ(handle, 42);
+    CHECK(memcmp(prep_arena, value, sizeof(value)) == 0);
+    CHECK_EQ(prep_arena[PREP_CAP], 0);
+    ble_prep_release(&prep);
+
+    // A short value after a long one is terminated at its own length
+    CHECK_EQ(ble_prep_write(&prep, 42, 0, (const uint8_t *)"{}", 2), BLE_PREP_OK);
+    CHECK_EQ(ble_prep_take(&prep, &handle), 2);
+    CHECK(strcmp((const char *)prep_arena, "{}") == 0);
+    ble_prep_release(&prep);
+}
+
+static void test_prep_rejects(void)
+{
+    static uint8_t value[PREP_CAP + 32];
+    ble_prep_t prep;
+    uint16_t handle = 0;
+
+    fill(value, sizeof(value));
+    ble_prep_init(&prep, prep_arena, PREP_CAP);
+    CHECK_EQ(ble_prep_take(&prep, &handle), 0);
+
+    // A gap discards the whole write
+    CHECK_EQ(ble_prep_write(&prep, 42, 0, value, 18), BLE_PREP_OK);
+    CHECK_EQ(ble_prep_write(&prep, 42, 36, value, 18), BLE_PREP_BAD_OFFSET);
+    CHECK_EQ(ble_prep_write(&prep, 42, 18, value, 18), BLE_PREP_OK);
+    CHECK_EQ(ble_prep_take(&prep, &handle), 0);
+    CHECK(!prep.held);
+
+    // So does running past the arena
+    CHECK_EQ(ble_prep_write(&prep, 42, 0, value, 18), BLE_PREP_OK);
+    CHECK_EQ(ble_prep_write(&prep, 42, 18, value, PREP_CAP), BLE_PREP_TOO_LONG);
+    CHECK_EQ(ble_prep_take(&prep, &handle), 0);
+
+    // A second attribute is refused without spoiling the write in progress
+    CHECK_EQ(ble_prep_write(&prep, 42, 0, value, 18), BLE_PREP_OK);
+    CHECK_EQ(ble_prep_write(&prep, 43, 0, value, 1), BLE_PREP_OTHER_HANDLE);
+    CHECK_EQ(ble_prep_take(&prep, &handle), 18);
+    CHECK_EQ(handle, 42);
+    ble_prep_release(&prep);
+
+    // Rewriting an earlier offset is allowed and keeps the longest end
+    CHECK_EQ(ble_prep_write(&prep, 42, 0, value, 36), BLE_PREP_OK);
+    CHECK_EQ(ble_prep_write(&prep, 42, 0, (const uint8_t *)"XY", 2), BLE_PREP_OK);
+    CHECK_EQ(ble_prep_take(&prep, &handle), 36);
+    CHECK(prep_arena[0] == 'X' && prep_arena[1] == 'Y' && memcmp(prep_arena + 2, value + 2, 34) == 0);
+    ble_prep_release(&prep);
+
+    // Cancelled (or disconnected) mid-way: nothing to take
+    CHECK_EQ(ble_prep_write(&prep, 42, 0, value, 18), BLE_PREP_OK);
+    ble_prep_reset(&prep);
+    CHECK_EQ(ble_prep_take(&prep, &handle), 0);
+}
+
+// A taken value holds the arena until the worker releases it, whatever happens on the link
+static void test_prep_held(void)
+{
+    ble_prep_t prep;
+    uint16_t handle = 0;
+
+    ble_prep_init(&prep, prep_arena, PREP_CAP);
+    CHECK_EQ(ble_prep_write(&prep, 42, 0, (const uint8_t *)"{1}", 3), BLE_PREP_OK);
+    CHECK_EQ(ble_prep_take(&prep, &handle), 3);
+    CHECK(prep.held);
+
+    CHECK_EQ(ble_prep_write(&prep, 42, 0, (const uint8_t *)"{2}", 3), BLE_PREP_BUSY);
+    CHECK_EQ(ble_prep_take(&prep, &handle), 0);
+    ble_prep_reset(&prep);
+    CHECK(prep.held);
+    CHECK(strcmp((const char *)prep_arena, "{1}") == 0);
+
+    ble_prep_release(&prep);
+    CHECK_EQ(ble_prep_write(&prep, 42, 0, (const uint8_t *)"{2}", 3), BLE_PREP_OK);
+    CHECK_EQ(ble_prep_take(&prep, &handle), 3);
+    CHECK(strcmp((const char *)prep_arena, "{2}") == 0);
+    ble_prep_release(&prep);
+}
+
+int main(void)
+{
+    for (size_t i = 0; i < sizeof(mtus) / sizeof(mtus[0]); i++) {
+        test_round_trip(mtus[i]);
+        test_lost(mtus[i]);
+        test_reordered(mtus[i]);
+        test_prep_long_write(mtus[i]);
+    }
+    test_limits();
+    test_prep_rejects();
+    test_prep_held();
+    return host_test_done("test_ble_frame");
+}
@@ -0,0 +1,258 @@
+/*
+ * Host test for button_gesture: synthetic edge traces with contact bounce,
+ * fed the way button_task does (edges in order, polls at each deadline).
+ */
+#include <string.h>
+#include "button_gesture.h"
+#include "host_test.h"
+
+#define MS(x) ((int64_t)(x) * 1000)
+
+typedef struct {
+    int64_t time_us;
+    bool pressed;
+} edge_t;
+
+#define MAX_EDGES  64
+#define MAX_EVENTS 32
+
+typedef struct {
+    edge_t edges[MAX_EDGES];
+    size_t count;
+} trace_t;
+
+typedef struct {
+    int64_t time_us;
+    uint32_t events;
+} logged_t;
+
+typedef struct {
+    logged_t log[MAX_EVENTS];
+    size_t count;
+} event_log_t;
+
+static void add_edge(trace_t *trace, int64_t time_us, bool pressed)
+{
+    if (trace->count < MAX_EDGES) {
+        trace->edges[trace->count++] = (edge_t){ time_us, pressed };
+    }
+}
+
+// A contact that chatters for a few ms before settling at `pressed`
+static void add_bouncy(trace_t *trace, int64_t time_us, bool pressed)
+{
+    static const int gaps_us[] = { 300, 800, 450, 1200, 2500 };
+    bool level = pressed;
+    for (size_t i = 0; i < sizeof(gaps_us) / sizeof(gaps_us[0]); i++) {
+        add_edge(trace, time_us, level);
+        time_us += gaps_us[i];
+        level = !level;
+    }
+    add_edge(trace, time_us, pressed);
+}
+
+static void log_events(event_log_t *log, int64_t time_us, uint32_t events)
+{
+    if (events != 0 && log->count < MAX_EVENTS) {
+        log->log[log->count++] = (logged_t){ time_us, events };
+    }
+}
+
+// Poll at every deadline up to `until`, as button_task does between edges
+static void poll_until(button_gesture_t *button, int64_t until, event_log_t *log)
+{
+    int64_t deadline;
+    while ((deadline = button_gesture_deadline(button)) != 0 && deadline <= until) {
+        log_events(log, deadline, button_gesture_poll(button, deadline));
+    }
+}
+
+static void run_trace(button_gesture_t *button, const trace_t *trace, int64_t end_us, event_log_t *log)
+{
+    memset(log, 0, sizeof(*log));
+    for (size_t i = 0; i < trace->count; i++) {
+        poll_until(button, trace->edges[i].time_us, log);
+        log_events(log, trace->edges[i].time_us,
+                   button_gesture_edge(button, trace->edges[i].pressed, trace->edges[i].time_us));
+    }
+    poll_until(button, end_us, log);
+}
+
+static int count_event(const event_log_t *log, uint32_t event)
+{
+    int n = 0;
+    for (size_t i = 0; i < log->count; i++) {
+        n += (log->log[i].events & event) != 0;
+    }
+    return n;
+}
+
+// Time of the first report of `event`, or -1
+static int64_t event_time(const event_log_t *log, uint32_t event)
+{
+    for (size_t i = 0; i < log->count; i++) {
+        if (log->log[i].events & event) {
+            return log->log[i].time_us;
+        }
+    }
+    return -1;
+}
+
+/* ---------------- Traces ---------------- */
+static void test_bouncy_single(void)
+{
+    button_gesture_t button;
+    trace_t trace = { 0 };
+    event_log_t log;
+
+    button_gesture_init(&button, false);
+    add_bouncy(&trace, MS(100), true);
+    add_bouncy(&trace, MS(250), false);
+    run_trace(&button, &trace, MS(2000), &log);
+
+    CHECK_EQ(count_event(&log, BUTTON_EVT_PRESS), 1);
+    CHECK_EQ(count_event(&log, BUTTON_EVT_RELEASE), 1);
+    CHECK_EQ(count_event(&log, BUTTON_EVT_SINGLE), 1);
+    CHECK_EQ(count_event(&log, BUTTON_EVT_DOUBLE), 0);
+    CHECK_EQ(count_event(&log, BUTTON_EVT_LONG), 0);
+    // The press is acted on at its first edge, the single once the double window has passed
+    CHECK_EQ(event_time(&log, BUTTON_EVT_PRESS), MS(100));
+    CHECK_EQ(event_time(&log, BUTTON_EVT_RELEASE), MS(250));
+    CHECK_EQ(event_time(&log, BUTTON_EVT_SINGLE), MS(250) + BUTTON_DOUBLE_WINDOW_US);
+    CHECK(!button.pressed);
+    CHECK_EQ(button.state, BUTTON_IDLE);
+    CHECK_EQ(button_gesture_deadline(&button), 0);
+}
+
+static void test_bouncy_double(void)
+{
+    button_gesture_t button;
+    trace_t trace = { 0 };
+    event_log_t log;
+
+    button_gesture_init(&button, false);
+    add_bouncy(&trace, MS(100), true);
+    add_bouncy(&trace, MS(200), false);
+    add_bouncy(&trace, MS(450), true);
+    add_bouncy(&trace, MS(550), false);
+    run_trace(&button, &trace, MS(2000), &log);
+
+    CHECK_EQ(count_event(&log, BUTTON_EVT_PRESS), 2);
+    CHECK_EQ(count_event(&log, BUTTON_EVT_RELEASE), 2);
+    CHECK_EQ(count_event(&log, BUTTON_EVT_DOUBLE), 1);
+    CHECK_EQ(count_event(&log, BUTTON_EVT_SINGLE), 0);
+    CHECK_EQ(count_event(&log, BUTTON_EVT_LONG), 0);
+    CHECK_EQ(event_time(&log, BUTTON_EVT_DOUBLE), MS(550));
+    CHECK_EQ(button.state, BUTTON_IDLE);
+}
+
+// A second press after the double window is two singles
+static void test_two_singles(void)
+{
+    button_gesture_t button;
+    trace_t trace = { 0 };
+    event_log_t log;
+
+    button_gesture_init(&button, false);
+    add_bouncy(&trace, MS(100), true);
+    add_bouncy(&trace, MS(200), false);
+    add_bouncy(&trace, MS(200) + BUTTON_DOUBLE_WINDOW_US + MS(50), true);
+    add_bouncy(&trace, MS(200) + BUTTON_DOUBLE_WINDOW_US + MS(150), false);
+    run_trace(&button, &trace, MS(3000), &log);
+
+    CHECK_EQ(count_event(&log, BUTTON_EVT_PRESS), 2);
+    CHECK_EQ(count_event(&log, BUTTON_EVT_SINGLE), 2);
+    CHECK_EQ(count_event(&log, BUTTON_EVT_DOUBLE), 0);
+}
+
+static void test_long_press(void)
+{
+    button_gesture_t button;
+    trace_t trace = { 0 };
+    event_log_t log;
+
+    button_gesture_init(&button, false);
+    add_bouncy(&trace, MS(100), true);
+    add_bouncy(&trace, MS(100) + BUTTON_LONG_PRESS_US + MS(900), false);
+    run_trace(&button, &trace, MS(6000), &log);
+
+    CHECK_EQ(count_event(&log, BUTTON_EVT_PRESS), 1);
+    CHECK_EQ(count_event(&log, BUTTON_EVT_LONG), 1);
+    CHECK_EQ(count_event(&log, BUTTON_EVT_RELEASE), 1);
+    CHECK_EQ(count_event(&log, BUTTON_EVT_SINGLE), 0);
+    CHECK_EQ(count_event(&log, BUTTON_EVT_DOUBLE), 0);
+    // Reported while still held, not at release
+    CHECK_EQ(event_time(&log, BUTTON_EVT_LONG), MS(100) + BUTTON_LONG_PRESS_US);
+    CHECK_EQ(button.state, BUTTON_IDLE);
+}
+
+// A press shorter than the bounce window is still seen, and the level does not stick
+static void test_glitch(void)
+{
+    button_gesture_t button;
+    trace_t trace = { 0 };
+    event_log_t log;
+
+    button_gesture_init(&button, false);
+    add_edge(&trace, MS(100), true);
+    add_edge(&trace, MS(100) + 5, false);
+    run_trace(&button, &trace, MS(2000), &log);
+
+    CHECK_EQ(count_event(&log, BUTTON_EVT_PRESS), 1);
+    CHECK_EQ(count_event(&log, BUTTON_EVT_RELEASE), 1);
+    CHECK_EQ(event_time(&log, BUTTON_EVT_RELEASE), MS(100) + BUTTON_DEBOUNCE_US);
+    CHECK_EQ(count_event(&log, BUTTON_EVT_LONG), 0);
+    CHECK(!button.pressed);
+    CHECK_EQ(button.state, BUTTON_IDLE);
+
+    // A glitch that returns to the debounced level inside the window is ignored entirely
+    trace_t held = { 0 };
+    button_gesture_init(&button, false);
+    add_bouncy(&held, MS(100), true);
+    add_edge(&held, MS(110), false);
+    add_edge(&held, MS(110) + 5, true);
+    add_bouncy(&held, MS(300), false);
+    run_trace(&button, &held, MS(2000), &log);
+
+    CHECK_EQ(count_event(&log, BUTTON_EVT_PRESS), 1);
+    CHECK_EQ(count_event(&log, BUTTON_EVT_RELEASE), 1);
+    CHECK_EQ(count_event(&log, BUTTON_EVT_SINGLE), 1);
+}
+
+// Held at boot: the release is not a gesture, later presses are
+static void test_held_at_boot(void)
+{
+    button_gesture_t button;
+    trace_t trace = { 0 };
+    event_log_t log;
+
+    button_gesture_init(&button, true);
+    CHECK(button.pressed);
+    CHECK_EQ(button_gesture_deadline(&button), 0);
+
+    add_bouncy(&trace, MS(5000), false);
+    run_trace(&button, &trace, MS(6000), &log);
+    CHECK_EQ(count_event(&log, BUTTON_EVT_RELEASE), 1);
+    CHECK_EQ(count_event(&log, BUTTON_EVT_LONG), 0);
+    CHECK_EQ(count_event(&log, BUTTON_EVT_SINGLE), 0);
+    CHECK_EQ(count_event(&log, BUTTON_EVT_DOUBLE), 0);
+    CHECK_EQ(button.state, BUTTON_IDLE);
+
+    trace_t later = { 0 };
+    add_bouncy(&later, MS(7000), true);
+    add_bouncy(&later, MS(7100), false);
+    run_trace(&button, &later, MS(9000), &log);
+    CHECK_EQ(count_event(&log, BUTTON_EVT_PRESS), 1);
+    CHECK_EQ(count_event(&log, BUTTON_EVT_SINGLE), 1);
+}
+
+int main(void)
+{
+    test_bouncy_single();
+    test_bouncy_double();
+    test_two_singles();
+    test_long_press();
+    test_glitch();
+    test_held_at_boot();
+    return host_test_done("test_button_gesture");
+}
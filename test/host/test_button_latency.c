@@ -0,0 +1,343 @@
+/*
+ * Load test: button-to-relay latency while UDP port traffic saturates the
+ * receiver.
+ *
+ *   test_button_latency [seconds]
+ *
+ * Flooder threads blast sensor packets over loopback from several source
+ * addresses as fast as the kernel takes them. The receiver, button and
+ * control threads copy the firmware's pipeline from switch_controller.c
+ * around the real plain-C modules (rate_limit, cmd_parser, control_event):
+ * batch drain with a tick of yield, admission before parsing, per-channel
+ * coalescing, and ring headroom kept for button events. They share one CPU,
+ * as the tasks do on the ESP32-C3, with the firmware's task priorities under
+ * SCHED_FIFO when the host allows it.
+ *
+ * Fails if a press is dropped, the socket was not saturated, or a press took
+ * longer than LATENCY_BOUND_US to reach the relay.
+ */
+#define _GNU_SOURCE
+#include <arpa/inet.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include "cmd_parser.h"
+#include "control_event.h"
+#include "host_test.h"
+#include "rate_limit.h"
+
+// Copied from the firmware (switch_controller.c and the ESP-IDF default tick)
+#define UDP_BATCH_MAX      32
+#define TICK_US            10000
+#define PRIO_BUTTON        8
+#define PRIO_CONTROL       7
+#define PRIO_RECEIVER      6
+
+#define FLOODERS           4
+#define PRESS_PERIOD_US    20000
+#define SENSOR_WORK_US     200        // stand-in for rule evaluation, relay and journal per sensor event
+#define MAX_PRESSES        4096
+#define LATENCY_BOUND_US   20000      // two ticks
+
+static const char flood_packet[] =
+    "{\"command\":\"{\\\"presence_detected\\\":true,\\\"temperature\\\":21.5,\\\"lux\\\":40}\","
+    "\"source\":\"AIOS_SENSOR\",\"origin\":\"MOTION\",\"device_id\":\"AA:BB:CC:DD:EE:FF\"}";
+
+static ctrl_ring_t ring;
+static sem_t ctrl_wake;
+static atomic_bool running;             // flooders, receiver and button
+static atomic_bool control_running;     // stopped last, after a final drain
+static int rx_sock;
+static struct sockaddr_in rx_addr;
+
+static atomic_ulong flood_sent;
+static unsigned long rx_received, rx_limited, rx_parsed, sensor_posted, sensor_dropped;
+static unsigned long presses, press_dropped, sensor_handled;
+static uint32_t latencies_us[MAX_PRESSES];
+static atomic_uint latency_count;
+
+static int64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void sleep_us(int64_t us)
+{
+    struct timespec ts = { .tv_sec = us / 1000000, .tv_nsec = (us % 1000000) * 1000 };
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+    }
+}
+
+static void spin_us(int64_t us)
+{
+    int64_t end = now_us() + us;
+    while (now_us() < end) {
+    }
+}
+
+/* ---------------- Threads ---------------- */
+static void *flooder_thread(void *arg)
+{
+    int index = (int)(intptr_t)arg;
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in local = { .sin_family = AF_INET };
+    local.sin_addr.s_addr = htonl(INADDR_LOOPBACK + 2 + index);   // 127.0.0.2, .3, ...
+    if (sock < 0 || bind(sock, (struct sockaddr *)&local, sizeof(local)) != 0) {
+        perror("flooder socket");
+        return NULL;
+    }
+    while (atomic_load(&running)) {
+        if (sendto(sock, flood_packet, sizeof(flood_packet) - 1, 0,
+                   (struct sockaddr *)&rx_addr, sizeof(rx_addr)) > 0) {
+            atomic_fetch_add_explicit(&flood_sent, 1, memory_order_relaxed);
+        }
+    }
+    close(sock);
+    return NULL;
+}
+
+// udp_receiver_task: drain a batch, admit, parse, post the newest reading per channel
+static void *receiver_thread(void *arg)
+{
+    (void)arg;
+    static rate_limiter_t limiter;
+    static char buffer[1024];
+    rate_limit_init(&limiter, now_us());
+
+    while (atomic_load(&running)) {
+        fd_set read_fds;
+        FD_ZERO(&read_fds);
+        FD_SET(rx_sock, &read_fds);
+        struct timeval timeout = { .tv_sec = 0, .tv_usec = 100000 };
+        if (select(rx_sock + 1, &read_fds, NULL, NULL, &timeout) <= 0) {
+            continue;
+        }
+
+        bool pending = false;
+        int64_t pending_us = 0;
+        udp_command_t newest;
+        int batch;
+        for (batch = 0; batch < UDP_BATCH_MAX; batch++) {
+            struct sockaddr_in source;
+            socklen_t socklen = sizeof(source);
+            int len = recvfrom(rx_sock, buffer, sizeof(buffer) - 1, MSG_DONTWAIT,
+                               (struct sockaddr *)&source, &socklen);
+            if (len < 0) {
+                break;
+            }
+            int64_t rx_us = now_us();
+            rx_received++;
+            if (rate_limit_admit(&limiter, ntohl(source.sin_addr.s_addr), rx_us) != RATE_LIMIT_PASS) {
+                rx_limited++;
+                continue;
+            }
+            udp_command_t cmd;
+            if (cmd_parse_udp_packet(buffer, len, &cmd)) {
+                rx_parsed++;
+                newest = cmd;
+                pending = true;
+                pending_us = rx_us;
+            }
+        }
+
+        if (pending) {
+            ctrl_event_t event = {
+                .type = CTRL_EVT_SENSOR,
+                .channel = newest.channel,
+                .timestamp_us = pending_us,
+                .reading = newest.reading,
+            };
+            if (ctrl_ring_push(&ring, &event, CTRL_RING_RESERVED)) {
+                sensor_posted++;
+                sem_post(&ctrl_wake);
+            } else {
+                sensor_dropped++;
+            }
+        }
+        if (batch == UDP_BATCH_MAX) {
+            sleep_us(TICK_US);
+        }
+    }
+    return NULL;
+}
+
+// button_task: a debounced press is posted with no headroom, so it may use the reserve
+static void *button_thread(void *arg)
+{
+    (void)arg;
+    while (atomic_load(&running)) {
+        sleep_us(PRESS_PERIOD_US + rand() % 5000);
+        ctrl_event_t event = { .type = CTRL_EVT_BUTTON, .timestamp_us = now_us() };
+        presses++;
+        if (ctrl_ring_push(&ring, &event, 0)) {
+            sem_post(&ctrl_wake);
+        } else {
+            press_dropped++;
+        }
+    }
+    return NULL;
+}
+
+// control_task: drive the relay for each event in ring order
+static void *control_thread(void *arg)
+{
+    (void)arg;
+    ctrl_event_t event;
+    bool more = true;
+    while (more) {
+        more = atomic_load(&control_running);
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += 100000000;
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+        sem_timedwait(&ctrl_wake, &deadline);
+
+        while (ctrl_ring_pop(&ring, &event)) {
+            if (event.type == CTRL_EVT_SENSOR) {
+                spin_us(SENSOR_WORK_US);
+                sensor_handled++;
+            } else if (event.type == CTRL_EVT_BUTTON) {
+                unsigned int n = atomic_load(&latency_count);
+                if (n < MAX_PRESSES) {
+                    latencies_us[n] = (uint32_t)(now_us() - event.timestamp_us);
+                    atomic_store(&latency_count, n + 1);
+                }
+            }
+        }
+    }
+    return NULL;
+}
+
+/* ---------------- Setup ---------------- */
+static bool realtime;
+static int pinned_cpu;                  // first CPU this process may run on
+
+static void start_thread(pthread_t *thread, void *(*fn)(void *), void *arg, int priority, bool pinned)
+{
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    if (pinned) {
+        // One core, as on the ESP32-C3
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(pinned_cpu, &cpus);
+        pthread_attr_setaffinity_np(&attr, sizeof(cpus), &cpus);
+    }
+    if (realtime && priority > 0) {
+        struct sched_param param = { .sched_priority = priority };
+        pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+        pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+        pthread_attr_setschedparam(&attr, &param);
+    }
+    if (pthread_create(thread, &attr, fn, arg) != 0) {
+        fprintf(stderr, "pthread_create failed\n");
+        exit(2);
+    }
+    pthread_attr_destroy(&attr);
+}
+
+static bool can_use_fifo(void)
+{
+    struct sched_param param = { .sched_priority = 1 };
+    if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) != 0) {
+        return false;
+    }
+    param.sched_priority = 0;
+    pthread_setschedparam(pthread_self(), SCHED_OTHER, &param);
+    return true;
+}
+
+static int compare_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+int main(int argc, char **argv)
+{
+    int seconds = argc > 1 ? atoi(argv[1]) : 2;
+    if (seconds <= 0) {
+        seconds = 2;
+    }
+
+    rx_sock = socket(AF_INET, SOCK_DGRAM, 0);
+    rx_addr.sin_family = AF_INET;
+    rx_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t addr_len = sizeof(rx_addr);
+    if (rx_sock < 0 || bind(rx_sock, (struct sockaddr *)&rx_addr, sizeof(rx_addr)) != 0 ||
+        getsockname(rx_sock, (struct sockaddr *)&rx_addr, &addr_len) != 0) {
+        perror("receiver socket");
+        return 2;
+    }
+
+    ctrl_ring_init(&ring);
+    sem_init(&ctrl_wake, 0, 0);
+    atomic_store(&running, true);
+    atomic_store(&control_running, true);
+    realtime = can_use_fifo();
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0) {
+        while (pinned_cpu < CPU_SETSIZE - 1 && !CPU_ISSET(pinned_cpu, &allowed)) {
+            pinned_cpu++;
+        }
+    }
+
+    pthread_t flooders[FLOODERS], receiver, button, control;
+    start_thread(&control, control_thread, NULL, PRIO_CONTROL, true);
+    start_thread(&receiver, receiver_thread, NULL, PRIO_RECEIVER, true);
+    start_thread(&button, button_thread, NULL, PRIO_BUTTON, true);
+    for (int i = 0; i < FLOODERS; i++) {
+        start_thread(&flooders[i], flooder_thread, (void *)(intptr_t)i, 0, false);
+    }
+
+    sleep_us((int64_t)seconds * 1000000);
+    atomic_store(&running, false);
+    for (int i = 0; i < FLOODERS; i++) {
+        pthread_join(flooders[i], NULL);
+    }
+    pthread_join(button, NULL);
+    pthread_join(receiver, NULL);
+    atomic_store(&control_running, false);
+    sem_post(&ctrl_wake);
+    pthread_join(control, NULL);
+    close(rx_sock);
+
+    unsigned int n = atomic_load(&latency_count);
+    qsort(latencies_us, n, sizeof(latencies_us[0]), compare_u32);
+    unsigned long sent = atomic_load(&flood_sent);
+
+    printf("%d s, %s scheduling, receiver/button/control on one CPU\n",
+           seconds, realtime ? "SCHED_FIFO firmware-priority" : "default (no SCHED_FIFO permission)");
+    printf("flood:   %lu sent, %lu received, %lu rate-limited, %lu parsed (%.0f pkt/s offered)\n",
+           sent, rx_received, rx_limited, rx_parsed, (double)sent / seconds);
+    printf("sensor:  %lu posted, %lu dropped at the ring reserve, %lu handled\n",
+           sensor_posted, sensor_dropped, sensor_handled);
+    if (n > 0) {
+        printf("button:  %lu presses, %lu dropped, latency p50 %lu us, p99 %lu us, max %lu us (bound %d us)\n",
+               presses, press_dropped, (unsigned long)latencies_us[n / 2],
+               (unsigned long)latencies_us[(n * 99) / 100], (unsigned long)latencies_us[n - 1], LATENCY_BOUND_US);
+    }
+
+    // The socket was saturated: the receiver read far more than the limiter let through
+    CHECK(rx_received > 4 * rx_parsed);
+    CHECK(rx_parsed > 0);
+    CHECK(presses > 0);
+    CHECK_EQ(press_dropped, 0);
+    CHECK_EQ(n, presses);
+    CHECK(n > 0 && latencies_us[n - 1] <= LATENCY_BOUND_US);
+
+    return host_test_done("test_button_latency");
+}
@@ -0,0 +1,180 @@
+/* rule_engine: the default table must decide exactly as the original hard-coded tree did */
+#include <string.h>
+#include "host_test.h"
+#include "rule_engine.h"
+
+/*
+ * The decision part of process_sensor_data() as it was before the rule
+ * table, copied from the original firmware with only the JSON parsing,
+ * logging and relay deduplication taken out.
+ */
+#define TEMP_DELAY_MS     60000   // 1 minute for TEMP origin
+#define MOTION_DELAY_MS   5000   // 5 secs minimum safe delay
+#define DEFAULT_DELAY_MS  6000    // Default delay
+
+typedef struct {
+    bool should_turn_on;
+    const char *trigger_reason;
+    uint32_t current_delay_ms;
+} original_decision_t;
+
+static original_decision_t original_process_sensor_data(bool presence_detected, bool motion_detected,
+                                                        float temp_value, float lux_value,
+                                                        int8_t g_temperature_threshold,
+                                                        uint16_t g_lux_threshold, const char *g_switch_mode)
+{
+    uint32_t current_delay_ms = DEFAULT_DELAY_MS;
+    bool should_turn_on = false;
+    const char* trigger_reason = "NONE";
+
+    if (g_temperature_threshold != 0) {
+        if (temp_value >= g_temperature_threshold) {
+            if (strcmp(g_switch_mode, "ON") == 0) {
+                if (presence_detected || motion_detected) {
+                    should_turn_on = true;
+                    trigger_reason = "PRESENCE";
+                    current_delay_ms = MOTION_DELAY_MS;
+                } else {
+                    should_turn_on = false;
+                    trigger_reason = "PRESENCE";
+                    current_delay_ms = MOTION_DELAY_MS;
+                }
+            } else {
+                should_turn_on = false;
+                trigger_reason = "PRESENCE";
+                current_delay_ms = MOTION_DELAY_MS;
+            }
+        } else {
+            should_turn_on = false;
+            trigger_reason = "TEMP";
+            current_delay_ms = TEMP_DELAY_MS;
+        }
+    } else {
+        if (strcmp(g_switch_mode, "ON") == 0) {
+            if (presence_detected || motion_detected) {
+                should_turn_on = true;
+                trigger_reason = "PRESENCE";
+                current_delay_ms = MOTION_DELAY_MS;
+            } else {
+                should_turn_on = false;
+                trigger_reason = "PRESENCE";
+                current_delay_ms = MOTION_DELAY_MS;
+            }
+        } else {
+            should_turn_on = false;
+            trigger_reason = "PRESENCE";
+            current_delay_ms = MOTION_DELAY_MS;
+        }
+    }
+    if(g_lux_threshold >= 5){
+        if(strcmp(g_switch_mode, "ON") == 0){
+            if((presence_detected || motion_detected) && (lux_value <= g_lux_threshold)){
+                should_turn_on = true;
+                trigger_reason = "LUX";
+            }
+            else{
+                should_turn_on = false;
+                trigger_reason = "LUX";
+                current_delay_ms = MOTION_DELAY_MS;
+            }
+        }
+    }
+
+    original_decision_t d = { should_turn_on, trigger_reason, current_delay_ms };
+    return d;
+}
+
+/* Every combination of boundary values for each input the old tree looked at */
+static void test_default_table_matches_original(void)
+{
+    static const int8_t temp_thresholds[] = { 0, -20, 1, 24, 25, 45, 127 };
+    static const float temps[] = { -40.0f, -20.5f, 0.0f, 0.99f, 1.0f, 23.99f, 24.0f, 24.5f, 25.0f, 44.9f, 45.0f, 127.0f };
+    static const uint16_t lux_thresholds[] = { 0, 1, 4, 5, 6, 100, 3000, 3500 };
+    static const float luxes[] = { 0.0f, 4.0f, 5.0f, 5.01f, 99.5f, 100.0f, 100.01f, 3000.0f, 3500.0f, 65535.0f };
+    static const char *modes[] = { "OFF", "ON" };
+
+    rule_table_t table;
+    rule_table_build_default(&table);
+    CHECK(rule_table_validate(&table));
+
+    bool row_seen[RULE_TABLE_ROWS] = { false };
+    unsigned long cases = 0;
+
+    for (int occ = 0; occ < 4; occ++)
+    for (size_t m = 0; m < 2; m++)
+    for (size_t tt = 0; tt < sizeof(temp_thresholds) / sizeof(temp_thresholds[0]); tt++)
+    for (size_t t = 0; t < sizeof(temps) / sizeof(temps[0]); t++)
+    for (size_t lt = 0; lt < sizeof(lux_thresholds) / sizeof(lux_thresholds[0]); lt++)
+    for (size_t l = 0; l < sizeof(luxes) / sizeof(luxes[0]); l++) {
+        bool presence = occ & 1, motion = occ & 2;
+        original_decision_t want = original_process_sensor_data(presence, motion, temps[t], luxes[l],
+                                                                temp_thresholds[tt], lux_thresholds[lt], modes[m]);
+
+        sensor_reading_t reading = {
+            .presence_detected = presence,
+            .motion_detected = motion,
+            .temperature = temps[t],
+            .lux = luxes[l],
+        };
+        uint8_t in = rule_inputs(&reading, temp_thresholds[tt], lux_thresholds[lt],
+                                 switch_mode_from_string(modes[m]));
+        rule_decision_t got;
+        rule_evaluate(&table, in, &got);
+        row_seen[in] = true;
+        cases++;
+
+        bool same = got.turn_on == want.should_turn_on &&
+                    strcmp(rule_reason_name(got.reason), want.trigger_reason) == 0 &&
+                    (got.turn_on || got.off_delay_ms == want.current_delay_ms);
+        if (!same) {
+            printf("mismatch: presence=%d motion=%d temp=%.2f/%d lux=%.2f/%u mode=%s: "
+                   "table %d %s %lu, original %d %s %lu\n",
+                   presence, motion, temps[t], temp_thresholds[tt], luxes[l], lux_thresholds[lt], modes[m],
+                   got.turn_on, rule_reason_name(got.reason), (unsigned long)got.off_delay_ms,
+                   want.should_turn_on, want.trigger_reason, (unsigned long)want.current_delay_ms);
+            host_test_failures++;
+        }
+    }
+
+    // Every row the inputs can produce was compared (TEMP_ABOVE needs TEMP_ENABLED, DARK needs LUX_ENABLED)
+    for (uint32_t in = 0; in < RULE_TABLE_ROWS; in++) {
+        bool reachable = ((in & RULE_IN_TEMP_ABOVE) == 0 || (in & RULE_IN_TEMP_ENABLED)) &&
+                         ((in & RULE_IN_DARK) == 0 || (in & RULE_IN_LUX_ENABLED));
+        CHECK_EQ(row_seen[in], reachable);
+    }
+    printf("%lu input combinations compared\n", cases);
+}
+
+static void test_validate_and_hex(void)
+{
+    rule_table_t table, copy;
+    rule_table_build_default(&table);
+
+    char hex[RULE_TABLE_ROWS * 2 + 1];
+    rule_table_rows_to_hex(&table, hex, sizeof(hex));
+    CHECK_EQ(strlen(hex), RULE_TABLE_ROWS * 2);
+    memset(&copy, 0, sizeof(copy));
+    CHECK(rule_table_rows_from_hex(&copy, hex));
+    CHECK(memcmp(copy.rows, table.rows, sizeof(table.rows)) == 0);
+
+    CHECK(!rule_table_rows_from_hex(&copy, "00"));
+    hex[7] = 'g';
+    CHECK(!rule_table_rows_from_hex(&copy, hex));
+
+    copy = table;
+    copy.rows[3] = 0x40;                 // bit outside ON and the reason
+    CHECK(!rule_table_validate(&copy));
+    copy = table;
+    copy.off_delay_ms[RULE_REASON_LUX] = RULE_MAX_OFF_DELAY_MS + 1;
+    CHECK(!rule_table_validate(&copy));
+    copy = table;
+    copy.version = RULE_TABLE_VERSION + 1;
+    CHECK(!rule_table_validate(&copy));
+}
+
+int main(void)
+{
+    test_default_table_matches_original();
+    test_validate_and_hex();
+    return host_test_done("test_rule_engine");
+}
@@ -0,0 +1,249 @@
+/*
+ * Host test for scan_cache: one entry per SSID keeping the strongest BSSID,
+ * the weakest SSIDs dropped when the list is full, RSSI order, the TTL, and
+ * streamed frames that never exceed the link limit.
+ */
+#include <stdio.h>
+#include <string.h>
+#include "host_test.h"
+#include "scan_cache.h"
+
+static scan_ap_t make_ap(const char *ssid, int8_t rssi, uint8_t channel, uint8_t bssid_tail)
+{
+    scan_ap_t ap = { 0 };
+    snprintf(ap.ssid, sizeof(ap.ssid), "%s", ssid);
+    ap.bssid[0] = 0x24;
+    ap.bssid[5] = bssid_tail;
+    ap.rssi = rssi;
+    ap.channel = channel;
+    ap.authmode = 3;
+    return ap;
+}
+
+/* ---------------- Merge ---------------- */
+static void test_merge(void)
+{
+    static scan_cache_t cache;
+    scan_cache_begin(&cache);
+
+    scan_ap_t office_a = make_ap("office", -70, 1, 0xA1);
+    scan_ap_t office_b = make_ap("office", -48, 6, 0xB2);
+    scan_ap_t office_c = make_ap("office", -80, 11, 0xC3);
+    CHECK(scan_cache_merge(&cache, &office_a));
+    CHECK(scan_cache_merge(&cache, &office_b));       // stronger BSSID of a known SSID
+    CHECK(!scan_cache_merge(&cache, &office_c));      // weaker one changes nothing
+    CHECK(!scan_cache_merge(&cache, &office_b));      // equal RSSI changes nothing either
+    CHECK_EQ(cache.count, 1);
+    CHECK_EQ(cache.aps[0].bssid[5], 0xB2);
+    CHECK_EQ(cache.aps[0].channel, 6);
+    CHECK_EQ(cache.aps[0].rssi, -48);
+
+    // Hidden networks are not cached
+    scan_ap_t hidden = make_ap("", -30, 1, 0x01);
+    CHECK(!scan_cache_merge(&cache, &hidden));
+    CHECK_EQ(cache.count, 1);
+
+    // A new scan starts from an empty list
+    scan_cache_finish(&cache, 5000);
+    scan_cache_begin(&cache);
+    CHECK_EQ(cache.count, 0);
+    CHECK_EQ(cache.dropped, 0);
+    CHECK_EQ(cache.taken_us, 0);
+}
+
+// More SSIDs than fit: a stronger newcomer evicts the weakest, a weaker one is dropped
+static void test_full(void)
+{
+    static scan_cache_t cache;
+    char ssid[16];
+    scan_cache_begin(&cache);
+
+    for (int i = 0; i < SCAN_CACHE_MAX_APS; i++) {
+        snprintf(ssid, sizeof(ssid), "net%02d", i);
+        scan_ap_t ap = make_ap(ssid, (int8_t)(-30 - i), 1, (uint8_t)i);
+        CHECK(scan_cache_merge(&cache, &ap));
+    }
+    CHECK_EQ(cache.count, SCAN_CACHE_MAX_APS);
+    CHECK_EQ(cache.dropped, 0);
+
+    scan_ap_t weak = make_ap("faraway", -95, 1, 0xF0);
+    CHECK(!scan_cache_merge(&cache, &weak));
+    CHECK_EQ(cache.dropped, 1);
+
+    scan_ap_t strong = make_ap("nearby", -20, 1, 0xF1);
+    CHECK(scan_cache_merge(&cache, &strong));
+    CHECK_EQ(cache.dropped, 2);
+    CHECK_EQ(cache.count, SCAN_CACHE_MAX_APS);
+
+    scan_cache_finish(&cache, 1);
+    CHECK_EQ(strcmp(cache.aps[0].ssid, "nearby"), 0);
+    snprintf(ssid, sizeof(ssid), "net%02d", SCAN_CACHE_MAX_APS - 2);
+    CHECK_EQ(strcmp(cache.aps[SCAN_CACHE_MAX_APS - 1].ssid, ssid), 0);   // net63, the weakest, is gone
+}
+
+/* ---------------- Sort and TTL ---------------- */
+static void test_sort_ttl(void)
+{
+    static scan_cache_t cache;
+    static const struct { const char *ssid; int8_t rssi; } heard[] = {
+        { "c", -60 }, { "a", -40 }, { "d", -60 }, { "b", -50 }, { "e", -90 }, { "f", -60 },
+    };
+    static const char *const order[] = { "a", "b", "c", "d", "f", "e" };
+
+    scan_cache_begin(&cache);
+    for (size_t i = 0; i < sizeof(heard) / sizeof(heard[0]); i++) {
+        scan_ap_t ap = make_ap(heard[i].ssid, heard[i].rssi, 1, (uint8_t)i);
+        scan_cache_merge(&cache, &ap);
+    }
+    scan_cache_finish(&cache, 1000000);
+    for (size_t i = 0; i < sizeof(order) / sizeof(order[0]); i++) {
+        CHECK_EQ(strcmp(cache.aps[i].ssid, order[i]), 0);    // equal RSSI keeps the order heard
+    }
+
+    CHECK(scan_cache_fresh(&cache, 1000000));
+    CHECK(scan_cache_fresh(&cache, 1000000 + (int64_t)SCAN_CACHE_TTL_MS * 1000 - 1));
+    CHECK(!scan_cache_fresh(&cache, 1000000 + (int64_t)SCAN_CACHE_TTL_MS * 1000));
+
+    // A scan finished at time 0 still counts as taken; none at all is never fresh
+    scan_cache_finish(&cache, 0);
+    CHECK(scan_cache_fresh(&cache, 10));
+    scan_cache_begin(&cache);
+    CHECK(!scan_cache_fresh(&cache, 10));
+}
+
+/* ---------------- JSON ---------------- */
+static void test_format(void)
+{
+    static scan_cache_t cache;
+    char buf[256];
+
+    scan_cache_begin(&cache);
+    scan_ap_t quoted = make_ap("say \"hi\"\\\n", -61, 1, 1);
+    scan_ap_t plain = make_ap("home", -42, 6, 2);
+    scan_cache_merge(&cache, &quoted);
+    scan_cache_merge(&cache, &plain);
+    scan_cache_finish(&cache, 1);
+
+    int n = scan_cache_format(&cache, buf, sizeof(buf));
+    const char *expected =
+        "{\"event_type\":\"scan_list\",\"data\":{\"home\":\"-42\",\"say \\\"hi\\\"\\\\\\u000a\":\"-61\"}}";
+    CHECK_EQ(strcmp(buf, expected), 0);
+    CHECK_EQ(n, (int)strlen(expected));
+
+    // Too small for both: the weaker is left out and the JSON stays closed
+    size_t fits_one = strlen("{\"event_type\":\"scan_list\",\"data\":{\"home\":\"-42\"}}") + 1;
+    n = scan_cache_format(&cache, buf, fits_one);
+    CHECK_EQ(strcmp(buf, "{\"event_type\":\"scan_list\",\"data\":{\"home\":\"-42\"}}"), 0);
+    CHECK_EQ(n, (int)fits_one - 1);
+
+    // Too small for the header: empty, not a truncated object
+    n = scan_cache_format(&cache, buf, 10);
+    CHECK_EQ(n, 0);
+    CHECK_EQ(buf[0], '\0');
+}
+
+/* ---------------- Streaming ---------------- */
+#define MAX_FRAMES 64
+
+typedef struct {
+    char frames[MAX_FRAMES][SCAN_FRAME_MAX + 1];
+    size_t lens[MAX_FRAMES];
+    int count;
+} frame_log_t;
+
+static void log_frame(const char *frame, size_t len, void *ctx)
+{
+    frame_log_t *log = ctx;
+    CHECK_EQ(strlen(frame), len);
+    if (log->count < MAX_FRAMES) {
+        memcpy(log->frames[log->count], frame, len + 1);
+        log->lens[log->count++] = len;
+    }
+}
+
+// Number of frames that carry `"<ssid>":"`
+static int frames_with(const frame_log_t *log, const char *ssid)
+{
+    char key[48];
+    int n = 0;
+    snprintf(key, sizeof(key), "\"%s\":\"", ssid);
+    for (int i = 0; i < log->count; i++) {
+        n += strstr(log->frames[i], key) != NULL;
+    }
+    return n;
+}
+
+static void test_framer(void)
+{
+    static frame_log_t log;
+    scan_framer_t framer;
+    const size_t max_len = 100;        // a small MTU forces several frames per channel
+    char ssid[40];
+
+    memset(&log, 0, sizeof(log));
+    scan_framer_init(&framer, max_len, log_frame, &log);
+
+    // Channel 1: ten networks, more than one frame holds; channel 6: one
+    for (int i = 0; i < 10; i++) {
+        snprintf(ssid, sizeof(ssid), "ch1-net%d", i);
+        scan_ap_t ap = make_ap(ssid, (int8_t)(-40 - i), 1, (uint8_t)i);
+        scan_framer_add(&framer, 1, &ap);
+    }
+    int ch1_frames = log.count;
+    CHECK(ch1_frames >= 2);
+    scan_ap_t six = make_ap("ch6-net", -55, 6, 0x66);
+    scan_framer_add(&framer, 6, &six);                 // a new channel sends the open frame
+    CHECK(log.count == ch1_frames + 1);
+    scan_framer_flush(&framer);
+    scan_framer_flush(&framer);                        // nothing open: no empty frame
+    CHECK_EQ(log.count, ch1_frames + 2);
+
+    // A 32-byte SSID of quotes escapes to 64 bytes: too long for a 100-byte frame with its header
+    scan_ap_t huge = make_ap("\"\"\"\"\"\"\"\"\"\"\"\"\"\"\"\"\"\"\"\"\"\"\"\"\"\"\"\"\"\"\"\"", -30, 11, 0x0B);
+    scan_framer_add(&framer, 11, &huge);
+    CHECK_EQ(framer.skipped, 1);
+    scan_framer_end(&framer, 12, 2345, false);
+    CHECK_EQ(framer.frames, log.count);
+
+    for (int i = 0; i < log.count; i++) {
+        CHECK(log.lens[i] <= max_len);
+        if (i < log.count - 1) {
+            CHECK_EQ(strcmp(log.frames[i] + log.lens[i] - 2, "}}"), 0);   // closed scan_list objects
+        }
+    }
+    for (int i = 0; i <= ch1_frames; i++) {
+        CHECK_EQ(strncmp(log.frames[i], "{\"event_type\":\"scan_list\",\"ch\":1,\"data\":{\"", 42), 0);
+    }
+    CHECK_EQ(strcmp(log.frames[log.count - 2],
+                    "{\"event_type\":\"scan_list\",\"ch\":6,\"data\":{\"ch6-net\":\"-55\"}}"), 0);
+    CHECK_EQ(strcmp(log.frames[log.count - 1],
+                    "{\"event_type\":\"scan_end\",\"networks\":12,\"skipped\":1,\"cached\":false,\"ms\":2345}"), 0);
+
+    // Every network is sent exactly once, in the order heard
+    for (int i = 0; i < 10; i++) {
+        snprintf(ssid, sizeof(ssid), "ch1-net%d", i);
+        CHECK_EQ(frames_with(&log, ssid), 1);
+    }
+    CHECK_EQ(frames_with(&log, "ch6-net"), 1);
+    CHECK(strstr(log.frames[0], "ch1-net0") != NULL);
+
+    // A limit above the ATT maximum is capped; a replayed cache is sent as channel 0
+    memset(&log, 0, sizeof(log));
+    scan_framer_init(&framer, 4096, log_frame, &log);
+    CHECK_EQ(framer.max_len, SCAN_FRAME_MAX);
+    scan_framer_add(&framer, 0, &six);
+    scan_framer_end(&framer, 1, 0, true);
+    CHECK_EQ(log.count, 2);
+    CHECK_EQ(strncmp(log.frames[0], "{\"event_type\":\"scan_list\",\"ch\":0,", 33), 0);
+    CHECK(strstr(log.frames[1], "\"cached\":true") != NULL);
+}
+
+int main(void)
+{
+    test_merge();
+    test_full();
+    test_sort_ttl();
+    test_format();
+    test_framer();
+    return host_test_done("test_scan_cache");
+}
@@ -0,0 +1,190 @@
+/*
+ * Host test for timer_wheel: every entry fires on exactly its tick, whether
+ * it sits in level 0 or cascades down from levels 1-3, including delays that
+ * land on either side of a slot or level boundary.
+ *
+ * An entry scheduled `delay` ticks out is due on tick now + delay. The
+ * current tick (wheel->now, partly elapsed) is processed first, so it fires
+ * on the (delay + 1)th tick advanced: never early, at most one tick late.
+ */
+#include "host_test.h"
+#include "timer_wheel.h"
+
+#define L1_SPAN (1u << TIMER_WHEEL_L0_BITS)
+#define L2_SPAN (1u << (TIMER_WHEEL_L0_BITS + TIMER_WHEEL_LN_BITS))
+#define L3_SPAN (1u << (TIMER_WHEEL_L0_BITS + 2 * TIMER_WHEEL_LN_BITS))
+
+typedef struct {
+    timer_wheel_t *wheel;
+    uint32_t fired_at;           // tick that ran the callback
+    int fired;
+} probe_t;
+
+static void probe_cb(timer_wheel_entry_t *entry, void *arg)
+{
+    probe_t *probe = arg;
+    (void)entry;
+    probe->fired_at = probe->wheel->now - 1;
+    probe->fired++;
+}
+
+// Schedule `delay` ticks after `start` and check the entry fires on that tick, not one early or late
+static void check_delay(uint32_t start, uint32_t delay)
+{
+    timer_wheel_t wheel;
+    timer_wheel_entry_t entry;
+    probe_t probe = { &wheel, 0, 0 };
+
+    timer_wheel_init(&wheel);
+    timer_wheel_advance(&wheel, start);
+    timer_wheel_entry_init(&entry, probe_cb, &probe);
+    timer_wheel_schedule(&wheel, &entry, delay);
+    CHECK(timer_wheel_pending(&entry));
+    CHECK_EQ(wheel.count, 1);
+
+    uint32_t expected = delay < TIMER_WHEEL_MAX_TICKS ? delay : TIMER_WHEEL_MAX_TICKS;
+    CHECK_EQ(entry.expires, start + expected);
+    timer_wheel_advance(&wheel, expected);
+    CHECK_EQ(probe.fired, 0);
+    CHECK(timer_wheel_pending(&entry));
+    timer_wheel_advance(&wheel, 1);
+    CHECK_EQ(probe.fired, 1);
+    CHECK_EQ(probe.fired_at, start + expected);
+    CHECK(!timer_wheel_pending(&entry));
+    CHECK(timer_wheel_empty(&wheel));
+}
+
+/* ---------------- Cascade ---------------- */
+static void test_level_boundaries(void)
+{
+    static const uint32_t delays[] = {
+        1, 2, L1_SPAN - 1, L1_SPAN, L1_SPAN + 1,
+        L2_SPAN - 1, L2_SPAN, L2_SPAN + 1,
+        L3_SPAN - 1, L3_SPAN, L3_SPAN + 1,
+    };
+    // Aligned, just before a level-0 wrap, just after one, and mid-slot at every level
+    static const uint32_t starts[] = { 0, L1_SPAN - 1, L1_SPAN + 1, L2_SPAN - 3, 12345 };
+
+    for (size_t s = 0; s < sizeof(starts) / sizeof(starts[0]); s++) {
+        for (size_t d = 0; d < sizeof(delays) / sizeof(delays[0]); d++) {
+            check_delay(starts[s], delays[d]);
+        }
+    }
+}
+
+// The top level and the clamp: a level-3 entry cascades all the way down to level 0
+static void test_max_delay(void)
+{
+    check_delay(77, TIMER_WHEEL_MAX_TICKS - 1);
+    check_delay(0, TIMER_WHEEL_MAX_TICKS);
+    check_delay(5, TIMER_WHEEL_MAX_TICKS + 1000);   // clamped, not wrapped
+    check_delay(L1_SPAN - 1, 0);                    // due on the current tick
+}
+
+// Many entries spread across all levels fire in order, each on its own tick
+static void test_many(void)
+{
+    enum { ENTRIES = 200 };
+    timer_wheel_t wheel;
+    timer_wheel_entry_t entries[ENTRIES];
+    probe_t probes[ENTRIES];
+    uint32_t delays[ENTRIES];
+
+    timer_wheel_init(&wheel);
+    timer_wheel_advance(&wheel, 1000);
+    uint32_t rng = 0x12345678u;
+    for (int i = 0; i < ENTRIES; i++) {
+        rng = rng * 1664525u + 1013904223u;
+        // A spread of magnitudes: the top bits pick the level, the rest the offset within it
+        delays[i] = 1 + ((rng >> 8) & ((1u << (8 + (rng >> 30) * 5)) - 1));
+        probes[i] = (probe_t){ &wheel, 0, 0 };
+        timer_wheel_entry_init(&entries[i], probe_cb, &probes[i]);
+        timer_wheel_schedule(&wheel, &entries[i], delays[i]);
+    }
+    CHECK_EQ(wheel.count, ENTRIES);
+
+    timer_wheel_advance(&wheel, 1u << 24);
+    CHECK(timer_wheel_empty(&wheel));
+    for (int i = 0; i < ENTRIES; i++) {
+        CHECK_EQ(probes[i].fired, 1);
+        CHECK_EQ(probes[i].fired_at, 1000 + delays[i]);
+    }
+}
+
+/* ---------------- Cancel and reschedule ---------------- */
+static timer_wheel_entry_t *victim;
+
+static void cancel_cb(timer_wheel_entry_t *entry, void *arg)
+{
+    probe_t *probe = arg;
+    probe_cb(entry, arg);
+    timer_wheel_cancel(probe->wheel, victim);
+}
+
+static void rearm_cb(timer_wheel_entry_t *entry, void *arg)
+{
+    probe_t *probe = arg;
+    probe_cb(entry, arg);
+    if (probe->fired < 3) {
+        timer_wheel_schedule(probe->wheel, entry, L1_SPAN);
+    }
+}
+
+static void test_cancel_reschedule(void)
+{
+    timer_wheel_t wheel;
+    timer_wheel_entry_t a, b, c;
+    probe_t pa, pb, pc;
+
+    // Rescheduling a pending entry moves it; cancelling removes it from a cascaded level
+    timer_wheel_init(&wheel);
+    pa = (probe_t){ &wheel, 0, 0 };
+    pb = (probe_t){ &wheel, 0, 0 };
+    timer_wheel_entry_init(&a, probe_cb, &pa);
+    timer_wheel_entry_init(&b, probe_cb, &pb);
+    timer_wheel_schedule(&wheel, &a, L2_SPAN + 5);
+    timer_wheel_schedule(&wheel, &b, L3_SPAN);
+    timer_wheel_schedule(&wheel, &a, 10);
+    CHECK_EQ(wheel.count, 2);
+    timer_wheel_advance(&wheel, L2_SPAN);
+    timer_wheel_cancel(&wheel, &b);
+    timer_wheel_cancel(&wheel, &b);
+    CHECK(timer_wheel_empty(&wheel));
+    timer_wheel_advance(&wheel, L3_SPAN);
+    CHECK_EQ(pa.fired, 1);
+    CHECK_EQ(pa.fired_at, 10);
+    CHECK_EQ(pb.fired, 0);
+
+    // A callback may cancel another entry due on the same tick
+    timer_wheel_init(&wheel);
+    pa = (probe_t){ &wheel, 0, 0 };
+    pb = (probe_t){ &wheel, 0, 0 };
+    timer_wheel_entry_init(&a, cancel_cb, &pa);
+    timer_wheel_entry_init(&b, probe_cb, &pb);
+    timer_wheel_schedule(&wheel, &b, 200);
+    timer_wheel_schedule(&wheel, &a, 200);     // pushed last onto the same slot, so it runs first
+    victim = &b;
+    timer_wheel_advance(&wheel, 201);
+    CHECK_EQ(pa.fired, 1);
+    CHECK_EQ(pb.fired, 0);
+    CHECK(timer_wheel_empty(&wheel));
+
+    // ...and re-arm itself from its own callback, counting from the tick after its own
+    timer_wheel_init(&wheel);
+    pc = (probe_t){ &wheel, 0, 0 };
+    timer_wheel_entry_init(&c, rearm_cb, &pc);
+    timer_wheel_schedule(&wheel, &c, 1);
+    timer_wheel_advance(&wheel, 4 * L1_SPAN);
+    CHECK_EQ(pc.fired, 3);
+    CHECK_EQ(pc.fired_at, 1 + 2 * (L1_SPAN + 1));
+    CHECK(timer_wheel_empty(&wheel));
+}
+
+int main(void)
+{
+    test_level_boundaries();
+    test_max_delay();
+    test_many();
+    test_cancel_reschedule();
+    return host_test_done("test_timer_wheel");
+}
@@ -0,0 +1,191 @@
+/*
+ * Host test for wifi_reconnect, driven by synthetic disconnects and a fake
+ * clock: per-class base waits and caps, equal-jitter bounds, due times, and
+ * spread across devices.
+ */
+#include "host_test.h"
+#include "wifi_reconnect.h"
+
+static const uint32_t class_base_ms[WIFI_DISC_CLASS_COUNT] = {
+    WIFI_RECONNECT_LINK_BASE_MS, WIFI_RECONNECT_NO_AP_BASE_MS, WIFI_RECONNECT_AUTH_BASE_MS,
+};
+static const uint32_t class_cap_ms[WIFI_DISC_CLASS_COUNT] = {
+    WIFI_RECONNECT_LINK_CAP_MS, WIFI_RECONNECT_NO_AP_CAP_MS, WIFI_RECONNECT_AUTH_CAP_MS,
+};
+
+static void make_mac(uint32_t serial, uint8_t mac[6])
+{
+    mac[0] = 0x24;
+    mac[1] = 0x6F;
+    mac[2] = 0x28;
+    mac[3] = (uint8_t)(serial >> 16);
+    mac[4] = (uint8_t)(serial >> 8);
+    mac[5] = (uint8_t)serial;
+}
+
+// Un-jittered wait after `steps` failures in a row: base doubled per step, capped
+static uint32_t backoff_bound(wifi_disc_class_t cls, uint32_t steps)
+{
+    uint64_t wait = class_base_ms[cls];
+    for (uint32_t i = 0; i < steps && wait < class_cap_ms[cls]; i++) {
+        wait *= 2;
+    }
+    return wait < class_cap_ms[cls] ? (uint32_t)wait : class_cap_ms[cls];
+}
+
+/* ---------------- Backoff per class ---------------- */
+// One outage of class cls that keeps failing: every wait is within [bound/2, bound] and due on time
+static void test_outage(wifi_disc_class_t cls)
+{
+    wifi_reconnect_t rc;
+    uint8_t mac[6];
+    int64_t now = 1000000;
+    uint32_t max_wait = 0;
+    int capped_high = 0;
+
+    make_mac(42 + cls, mac);
+    wifi_reconnect_init(&rc, mac);
+    wifi_reconnect_attempt(&rc, now);
+    wifi_reconnect_connected(&rc, now);
+    CHECK(!wifi_reconnect_due(&rc, now));
+
+    now += 5000000;
+    uint32_t wait = wifi_reconnect_disconnected(&rc, cls, now);
+    for (uint32_t steps = 0; steps < 40; steps++) {
+        uint32_t bound = backoff_bound(cls, steps);
+        CHECK(wait >= bound / 2);
+        CHECK(wait <= bound);
+        if (wait > max_wait) {
+            max_wait = wait;
+        }
+        if (bound == class_cap_ms[cls] && wait > bound * 9 / 10) {
+            capped_high++;
+        }
+
+        // Due exactly `wait` ms later on the fake clock, not a microsecond before
+        int64_t due = now + (int64_t)wait * 1000;
+        CHECK_EQ(rc.due_us, due);
+        CHECK(!wifi_reconnect_due(&rc, now));
+        CHECK(!wifi_reconnect_due(&rc, due - 1));
+        CHECK(wifi_reconnect_due(&rc, due));
+
+        // Retry a little late, as the task polling the clock would; it fails again
+        now = due + 20000;
+        wifi_reconnect_attempt(&rc, now);
+        CHECK(!wifi_reconnect_due(&rc, now));
+        now += 3000000;
+        wait = wifi_reconnect_disconnected(&rc, cls, now);
+    }
+
+    CHECK(max_wait <= class_cap_ms[cls]);
+    CHECK(max_wait >= class_cap_ms[cls] / 2);
+    CHECK(capped_high > 0);   // the jitter reaches the top of the capped range
+
+    // Reconnecting reports the outage length and starts the next one at the base wait again
+    int64_t down_since = rc.down_since_us;
+    now += 1000000;
+    CHECK_EQ(wifi_reconnect_connected(&rc, now), (now - down_since) / 1000);
+    CHECK_EQ(rc.failures, 0);
+    CHECK(!wifi_reconnect_due(&rc, now + 1000000000LL));
+    wait = wifi_reconnect_disconnected(&rc, cls, now);
+    CHECK(wait >= class_base_ms[cls] / 2 && wait <= class_base_ms[cls]);
+}
+
+static void test_class_caps(void)
+{
+    for (int cls = 0; cls < WIFI_DISC_CLASS_COUNT; cls++) {
+        test_outage((wifi_disc_class_t)cls);
+    }
+    // Caps and bases are ordered by how long each cause usually lasts
+    CHECK(WIFI_RECONNECT_LINK_CAP_MS < WIFI_RECONNECT_NO_AP_CAP_MS);
+    CHECK(WIFI_RECONNECT_NO_AP_CAP_MS < WIFI_RECONNECT_AUTH_CAP_MS);
+}
+
+// The first connect has no outage to report, and its failures back off from the first step
+static void test_first_connect(void)
+{
+    wifi_reconnect_t rc;
+    uint8_t mac[6];
+    make_mac(7, mac);
+    wifi_reconnect_init(&rc, mac);
+    CHECK_EQ(rc.state, WIFI_RECONNECT_IDLE);
+    CHECK(!wifi_reconnect_due(&rc, 0));
+
+    wifi_reconnect_attempt(&rc, 100);
+    uint32_t wait = wifi_reconnect_disconnected(&rc, WIFI_DISC_NO_AP, 2000000);
+    CHECK(wait >= backoff_bound(WIFI_DISC_NO_AP, 1) / 2 && wait <= backoff_bound(WIFI_DISC_NO_AP, 1));
+    CHECK_EQ(rc.down_since_us, 0);
+    wifi_reconnect_attempt(&rc, rc.due_us);
+    CHECK_EQ(wifi_reconnect_connected(&rc, rc.due_us + 500000), 0);
+}
+
+// Unknown classes back off like a link loss; huge failure counts neither overflow nor exceed the cap
+static void test_limits(void)
+{
+    wifi_reconnect_t rc;
+    uint8_t mac[6];
+    make_mac(9, mac);
+    wifi_reconnect_init(&rc, mac);
+    wifi_reconnect_connected(&rc, 1000);
+
+    uint32_t wait = wifi_reconnect_disconnected(&rc, WIFI_DISC_CLASS_COUNT, 2000);
+    CHECK(wait >= WIFI_RECONNECT_LINK_BASE_MS / 2 && wait <= WIFI_RECONNECT_LINK_BASE_MS);
+
+    rc.failures = UINT16_MAX - 1;
+    for (int i = 0; i < 4; i++) {
+        wait = wifi_reconnect_disconnected(&rc, WIFI_DISC_AUTH, 3000);
+        CHECK(wait >= WIFI_RECONNECT_AUTH_CAP_MS / 2 && wait <= WIFI_RECONNECT_AUTH_CAP_MS);
+    }
+    CHECK_EQ(rc.failures, UINT16_MAX);
+}
+
+/* ---------------- Jitter across devices ---------------- */
+// A building of switches with consecutive MACs losing the same AP at the same instant
+static void test_fleet_spread(void)
+{
+    enum { DEVICES = 1000, BUCKETS = 10 };
+    const uint32_t base = WIFI_RECONNECT_LINK_BASE_MS;
+    int histogram[BUCKETS] = { 0 };
+    uint64_t total = 0;
+    uint32_t min = UINT32_MAX, max = 0;
+
+    for (uint32_t serial = 0; serial < DEVICES; serial++) {
+        wifi_reconnect_t rc;
+        uint8_t mac[6];
+        make_mac(serial, mac);
+        wifi_reconnect_init(&rc, mac);
+        CHECK(rc.rng != 0);
+        wifi_reconnect_connected(&rc, 0);
+        uint32_t wait = wifi_reconnect_disconnected(&rc, WIFI_DISC_LINK, 1000000);
+        total += wait;
+        min = wait < min ? wait : min;
+        max = wait > max ? wait : max;
+        histogram[(wait - base / 2) * BUCKETS / (base / 2 + 1)]++;
+
+        // Same MAC, same sequence: the jitter is per device, not per boot
+        wifi_reconnect_t again;
+        wifi_reconnect_init(&again, mac);
+        wifi_reconnect_connected(&again, 0);
+        CHECK_EQ(wifi_reconnect_disconnected(&again, WIFI_DISC_LINK, 1000000), wait);
+    }
+
+    CHECK(min >= base / 2);
+    CHECK(max <= base);
+    CHECK(min < base / 2 + base / 20);
+    CHECK(max > base - base / 20);
+    double mean = (double)total / DEVICES;
+    CHECK(mean > base * 0.72 && mean < base * 0.78);
+    for (int i = 0; i < BUCKETS; i++) {
+        // Uniform would be 100 per bucket
+        CHECK(histogram[i] > 60 && histogram[i] < 140);
+    }
+}
+
+int main(void)
+{
+    test_class_caps();
+    test_first_connect();
+    test_limits();
+    test_fleet_spread();
+    return host_test_done("test_wifi_reconnect");
+}
@@ -0,0 +1,271 @@
+/*
+ * Host test for wire_format: encode/decode round trips of version 1 and 2
+ * frames, the fixed-point limits of temperature and lux, and rejection of
+ * malformed frames.
+ */
+#include <string.h>
+#include "host_test.h"
+#include "wire_format.h"
+
+static const uint8_t test_mac[6] = { 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0x0F };
+
+static wire_frame_t make_frame(float temperature, float lux)
+{
+    wire_frame_t frame = { 0 };
+    memcpy(frame.device_mac, test_mac, sizeof(test_mac));
+    frame.channel = 1;
+    frame.flags = WIRE_FLAG_HAS_TEMP | WIRE_FLAG_HAS_LUX;
+    frame.reading.presence_detected = true;
+    frame.reading.temperature = temperature;
+    frame.reading.lux = lux;
+    frame.reading.origin = SENSOR_ORIGIN_TEMP;
+    return frame;
+}
+
+static int16_t encoded_temperature(const uint8_t *buf)
+{
+    return (int16_t)(buf[12] | (buf[13] << 8));
+}
+
+static uint32_t encoded_lux(const uint8_t *buf)
+{
+    return (uint32_t)buf[14] | ((uint32_t)buf[15] << 8) | ((uint32_t)buf[16] << 16) | ((uint32_t)buf[17] << 24);
+}
+
+/* ---------------- Round trips ---------------- */
+static void test_round_trip_v1(void)
+{
+    wire_frame_t in = make_frame(23.45f, 1234.56f);
+    in.reading.motion_detected = true;
+    uint8_t buf[WIRE_FRAME_V2_LEN];
+
+    CHECK_EQ(wire_encode(&in, buf, sizeof(buf)), WIRE_FRAME_V1_LEN);
+    CHECK_EQ(buf[0], WIRE_MAGIC);
+    CHECK_EQ(buf[1], WIRE_VERSION);
+    CHECK_EQ(buf[11], 0);
+
+    wire_frame_t out;
+    memset(&out, 0xFF, sizeof(out));
+    CHECK(wire_decode(buf, WIRE_FRAME_V1_LEN, &out));
+    CHECK(memcmp(out.device_mac, test_mac, sizeof(test_mac)) == 0);
+    CHECK_EQ(out.channel, 1);
+    CHECK_EQ(out.reading.origin, SENSOR_ORIGIN_TEMP);
+    CHECK(out.reading.presence_detected);
+    CHECK(out.reading.motion_detected);
+    CHECK(out.reading.temperature == 2345 / 100.0f);
+    CHECK(out.reading.lux == 123456 / 100.0f);
+    CHECK_EQ(out.reading.has, SENSOR_HAS_OCCUPANCY | SENSOR_HAS_TEMPERATURE | SENSOR_HAS_LUX);
+    CHECK(!out.seq.has_seq);
+    CHECK(!out.seq.has_ts);
+}
+
+static void test_round_trip_v2(void)
+{
+    wire_frame_t in = make_frame(-5.5f, 0.0f);
+    in.flags = WIRE_FLAG_HAS_TEMP;
+    in.reading.presence_detected = false;
+    in.seq.has_seq = true;
+    in.seq.seq = 0xFEDCBA98u;
+    in.seq.sender_ms = 0x01234567u;
+    uint8_t buf[WIRE_FRAME_V2_LEN];
+
+    CHECK_EQ(wire_encode(&in, buf, WIRE_FRAME_V2_LEN - 1), 0);
+    CHECK_EQ(wire_encode(&in, buf, sizeof(buf)), WIRE_FRAME_V2_LEN);
+    CHECK_EQ(buf[1], WIRE_VERSION_SEQ);
+
+    wire_frame_t out;
+    CHECK(wire_decode(buf, WIRE_FRAME_V2_LEN, &out));
+    CHECK(!out.reading.presence_detected);
+    CHECK(!out.reading.motion_detected);
+    CHECK(out.reading.temperature == -550 / 100.0f);
+    CHECK(out.reading.lux == 0.0f);
+    CHECK_EQ(out.reading.has, SENSOR_HAS_TEMPERATURE);     // neither presence nor motion reported
+    CHECK(out.seq.has_seq);
+    CHECK(out.seq.has_ts);
+    CHECK_EQ(out.seq.seq, 0xFEDCBA98u);
+    CHECK_EQ(out.seq.sender_ms, 0x01234567u);
+}
+
+/* ---------------- Fixed-point limits ---------------- */
+static void test_temperature_limits(void)
+{
+    static const struct {
+        float celsius;
+        int16_t fixed;
+    } cases[] = {
+        { 0.0f, 0 },
+        { 0.004f, 0 },
+        { 0.006f, 1 },
+        { -0.006f, -1 },
+        { 327.67f, INT16_MAX },
+        { 400.0f, INT16_MAX },
+        { -327.68f, INT16_MIN },
+        { -400.0f, INT16_MIN },
+    };
+    uint8_t buf[WIRE_FRAME_V1_LEN];
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        wire_frame_t in = make_frame(cases[i].celsius, 0.0f);
+        wire_frame_t out;
+        CHECK_EQ(wire_encode(&in, buf, sizeof(buf)), WIRE_FRAME_V1_LEN);
+        CHECK_EQ(encoded_temperature(buf), cases[i].fixed);
+        CHECK(wire_decode(buf, sizeof(buf), &out));
+        CHECK(out.reading.temperature == cases[i].fixed / 100.0f);
+    }
+}
+
+static void test_lux_limits(void)
+{
+    static const struct {
+        float lux;
+        uint32_t fixed;
+    } cases[] = {
+        { 0.0f, 0 },
+        { -1.0f, 0 },
+        { 0.01f, 1 },
+        { 100000.0f, 10000000 },
+        { 42949672.0f, UINT32_MAX },
+        { 1e12f, UINT32_MAX },
+    };
+    uint8_t buf[WIRE_FRAME_V1_LEN];
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        wire_frame_t in = make_frame(0.0f, cases[i].lux);
+        wire_frame_t out;
+        CHECK_EQ(wire_encode(&in, buf, sizeof(buf)), WIRE_FRAME_V1_LEN);
+        CHECK_EQ(encoded_lux(buf), cases[i].fixed);
+        CHECK(wire_decode(buf, sizeof(buf), &out));
+        CHECK(out.reading.lux == cases[i].fixed / 100.0f);
+    }
+}
+
+// Values without their HAS flag are not sent, whatever the reading holds
+static void test_absent_values(void)
+{
+    wire_frame_t in = make_frame(21.0f, 300.0f);
+    in.flags = 0;
+    uint8_t buf[WIRE_FRAME_V1_LEN];
+    wire_frame_t out;
+
+    CHECK_EQ(wire_encode(&in, buf, sizeof(buf)), WIRE_FRAME_V1_LEN);
+    CHECK(wire_decode(buf, sizeof(buf), &out));
+    CHECK(out.reading.temperature == 0.0f);
+    CHECK(out.reading.lux == 0.0f);
+    CHECK_EQ(out.reading.has, SENSOR_HAS_OCCUPANCY);
+
+    buf[8] = 0x7F;  // unknown origin
+    CHECK(wire_decode(buf, sizeof(buf), &out));
+    CHECK_EQ(out.reading.origin, SENSOR_ORIGIN_OTHER);
+}
+
+// Occupancy counts only when the sensor reports it, so temperature-only sensors stay out of the vote
+static void test_occupancy_flag(void)
+{
+    uint8_t buf[WIRE_FRAME_V1_LEN];
+    wire_frame_t out;
+
+    wire_frame_t temp_only = make_frame(22.0f, 0.0f);
+    temp_only.flags = WIRE_FLAG_HAS_TEMP;
+    temp_only.reading.presence_detected = false;
+    CHECK_EQ(wire_encode(&temp_only, buf, sizeof(buf)), WIRE_FRAME_V1_LEN);
+    CHECK_EQ(buf[9] & WIRE_FLAG_HAS_OCCUPANCY, 0);
+    CHECK(wire_decode(buf, sizeof(buf), &out));
+    CHECK_EQ(out.reading.has & SENSOR_HAS_OCCUPANCY, 0);
+    CHECK_EQ(out.reading.has, SENSOR_HAS_TEMPERATURE);
+
+    // A motion sensor reporting an empty room still votes
+    wire_frame_t empty = make_frame(0.0f, 0.0f);
+    empty.flags = 0;
+    empty.reading.presence_detected = false;
+    empty.reading.has = SENSOR_HAS_OCCUPANCY;
+    CHECK_EQ(wire_encode(&empty, buf, sizeof(buf)), WIRE_FRAME_V1_LEN);
+    CHECK(buf[9] & WIRE_FLAG_HAS_OCCUPANCY);
+    CHECK(wire_decode(buf, sizeof(buf), &out));
+    CHECK_EQ(out.reading.has, SENSOR_HAS_OCCUPANCY);
+    CHECK(!out.reading.presence_detected);
+
+    // Motion alone marks the frame as an occupancy report
+    wire_frame_t motion = empty;
+    motion.reading.has = 0;
+    motion.reading.motion_detected = true;
+    CHECK_EQ(wire_encode(&motion, buf, sizeof(buf)), WIRE_FRAME_V1_LEN);
+    CHECK(wire_decode(buf, sizeof(buf), &out));
+    CHECK_EQ(out.reading.has, SENSOR_HAS_OCCUPANCY);
+    CHECK(out.reading.motion_detected);
+}
+
+/* ---------------- Rejection ---------------- */
+static void test_rejects(void)
+{
+    wire_frame_t v1 = make_frame(20.0f, 10.0f);
+    wire_frame_t v2 = v1;
+    v2.seq.has_seq = true;
+    uint8_t good1[WIRE_FRAME_V2_LEN + 1] = { 0 };
+    uint8_t good2[WIRE_FRAME_V2_LEN + 1] = { 0 };
+    uint8_t bad[WIRE_FRAME_V2_LEN + 1];
+    wire_frame_t out;
+
+    CHECK_EQ(wire_encode(&v1, good1, sizeof(good1)), WIRE_FRAME_V1_LEN);
+    CHECK_EQ(wire_encode(&v2, good2, sizeof(good2)), WIRE_FRAME_V2_LEN);
+
+    CHECK(!wire_decode(NULL, WIRE_FRAME_V1_LEN, &out));
+    CHECK(!wire_decode(good1, WIRE_FRAME_V1_LEN, NULL));
+
+    // Bad magic
+    memcpy(bad, good1, sizeof(bad));
+    bad[0] = '{';
+    CHECK(!wire_decode(bad, WIRE_FRAME_V1_LEN, &out));
+
+    // Bad version
+    memcpy(bad, good1, sizeof(bad));
+    bad[1] = 0;
+    CHECK(!wire_decode(bad, WIRE_FRAME_V1_LEN, &out));
+    bad[1] = 3;
+    CHECK(!wire_decode(bad, WIRE_FRAME_V1_LEN, &out));
+    CHECK(!wire_decode(bad, WIRE_FRAME_V2_LEN, &out));
+
+    // Bad length: every length but the exact one of the frame's version
+    for (size_t len = 0; len <= WIRE_FRAME_V2_LEN; len++) {
+        CHECK_EQ(wire_decode(good1, len, &out), len == WIRE_FRAME_V1_LEN);
+        CHECK_EQ(wire_decode(good2, len, &out), len == WIRE_FRAME_V2_LEN);
+    }
+
+    // Reserved byte 11 must be zero
+    for (int value = 1; value <= 0xFF; value++) {
+        memcpy(bad, good1, sizeof(bad));
+        bad[11] = (uint8_t)value;
+        CHECK(!wire_decode(bad, WIRE_FRAME_V1_LEN, &out));
+        memcpy(bad, good2, sizeof(bad));
+        bad[11] = (uint8_t)value;
+        CHECK(!wire_decode(bad, WIRE_FRAME_V2_LEN, &out));
+    }
+}
+
+/* ---------------- MAC helpers ---------------- */
+static void test_mac_strings(void)
+{
+    uint8_t mac[6];
+    char text[18];
+
+    CHECK(wire_mac_from_string("aa:BB:cc:DD:ee:0f", 17, mac));
+    CHECK(memcmp(mac, test_mac, sizeof(test_mac)) == 0);
+    wire_mac_to_string(mac, text, sizeof(text));
+    CHECK(strcmp(text, "AA:BB:CC:DD:EE:0F") == 0);
+
+    CHECK(!wire_mac_from_string("AA:BB:CC:DD:EE:0", 16, mac));
+    CHECK(!wire_mac_from_string("AA-BB-CC-DD-EE-0F", 17, mac));
+    CHECK(!wire_mac_from_string("AA:BB:CC:DD:EE:0G", 17, mac));
+}
+
+int main(void)
+{
+    test_round_trip_v1();
+    test_round_trip_v2();
+    test_temperature_limits();
+    test_lux_limits();
+    test_absent_values();
+    test_occupancy_flag();
+    test_rejects();
+    test_mac_strings();
+    return host_test_done("test_wire_format");
+}
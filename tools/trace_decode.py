@@ -0,0 +1,189 @@
+#!/usr/bin/env python3
+"""Decode AIOS switch trace dumps into readable log lines.
+
+Pull the trace over UDP:
+    trace_decode.py --udp 192.168.1.50
+
+Or decode pages saved earlier, either raw binary pages back to back or
+text with one page per line as hex (the "trace" field of the BLE reply,
+or the whole {"trace": ...} JSON line):
+    trace_decode.py dump.bin
+    trace_decode.py ble_pages.txt
+
+Page layout and event ids mirror main/include/trace.h.
+"""
+
+import argparse
+import ipaddress
+import json
+import socket
+import struct
+import sys
+
+PAGE_MAGIC = 0xA7
+PAGE_VERSION = 1
+PAGE_LAST = 0x01
+HEADER = struct.Struct("<BBBBQI")
+RECORD = struct.Struct("<IIBBHI")
+
+CTRL_EVENTS = ["button", "sensor", "timer", "override"]
+REJECT_REASONS = ["parse", "source", "unbound", "duplicate", "reordered", "stale", "rate"]
+RATE_LIMITS = ["pass", "source", "global"]
+RULE_REASONS = ["NONE", "TEMP", "PRESENCE", "LUX"]
+BUTTON_EVENTS = ["press", "release", "single", "double", "long"]
+
+
+def _ctrl(value):
+    return CTRL_EVENTS[value] if value < len(CTRL_EVENTS) else str(value)
+
+
+def _reason(value):
+    return RULE_REASONS[value] if value < len(RULE_REASONS) else str(value)
+
+
+def _fmt_udp_rx(a0, a1, a2):
+    return f"len={a1} from={ipaddress.IPv4Address(a2)}"
+
+
+def _fmt_udp_reject(a0, a1, a2):
+    reason = REJECT_REASONS[a0] if a0 < len(REJECT_REASONS) else str(a0)
+    if reason == "rate":
+        limit = RATE_LIMITS[a1] if a1 < len(RATE_LIMITS) else str(a1)
+        return f"reason=rate limit={limit} from={ipaddress.IPv4Address(a2)}"
+    return f"reason={reason} channel={a1}" + (f" seq={a2}" if a0 >= 3 else "")
+
+
+def _fmt_sensor_eval(a0, a1, a2):
+    return f"channel={a0} inputs=0x{a1:02x} turn_on={a2 & 1} reason={_reason(a2 >> 8)}"
+
+
+def _fmt_relay(a0, a1, a2):
+    return f"channel={a0} {'ON' if a1 & 1 else 'OFF'} source={_ctrl(a1 >> 8)} latency={a2}us"
+
+
+def _fmt_button(a0, a1, a2):
+    events = "|".join(name for bit, name in enumerate(BUTTON_EVENTS) if a1 & (1 << bit))
+    return f"channel={a0} events={events or hex(a1)} pressed={a2}"
+
+
+def _fmt_off_timer_start(a0, a1, a2):
+    return f"channel={a0} delay={a2}ms"
+
+
+def _fmt_off_timer_fire(a0, a1, a2):
+    return f"channel={a0}"
+
+
+def _fmt_ctrl_drop(a0, a1, a2):
+    return f"type={_ctrl(a0)} channel={a1}"
+
+
+def _fmt_ble_write(a0, a1, a2):
+    return f"len={a1} handle={a2}{' prepared' if a0 else ''}"
+
+
+def _fmt_ble_send(a0, a1, a2):
+    return f"len={a1} err=0x{a2:x}"
+
+
+EVENTS = {
+    1: ("udp_rx", _fmt_udp_rx),
+    2: ("udp_reject", _fmt_udp_reject),
+    3: ("sensor_eval", _fmt_sensor_eval),
+    4: ("relay", _fmt_relay),
+    5: ("button", _fmt_button),
+    6: ("off_timer_start", _fmt_off_timer_start),
+    7: ("off_timer_fire", _fmt_off_timer_fire),
+    8: ("ctrl_drop", _fmt_ctrl_drop),
+    9: ("ble_write", _fmt_ble_write),
+    10: ("ble_send", _fmt_ble_send),
+}
+
+
+def parse_page(data):
+    """Return (records, dump_time_us, last, page_length) for the page at the start of data."""
+    if len(data) < HEADER.size:
+        raise ValueError("truncated page header")
+    magic, version, count, flags, now_us, _head = HEADER.unpack_from(data)
+    if magic != PAGE_MAGIC or version != PAGE_VERSION:
+        raise ValueError(f"not a trace page (magic 0x{magic:02x}, version {version})")
+    length = HEADER.size + count * RECORD.size
+    if len(data) < length:
+        raise ValueError("truncated page")
+    records = [RECORD.unpack_from(data, HEADER.size + i * RECORD.size) for i in range(count)]
+    return records, now_us, bool(flags & PAGE_LAST), length
+
+
+def full_time_us(timestamp_us, now_us):
+    """Extend a 32-bit record timestamp using the 64-bit time of the dump."""
+    return now_us - ((now_us - timestamp_us) & 0xFFFFFFFF)
+
+
+def format_record(record, now_us):
+    seq, timestamp_us, event_id, a0, a1, a2 = record
+    name, fmt = EVENTS.get(event_id, (f"event_{event_id}", lambda *args: f"a0={a0} a1={a1} a2={a2}"))
+    t = full_time_us(timestamp_us, now_us) / 1e6
+    return f"{t:14.6f} #{seq:<8} {name:<16} {fmt(a0, a1, a2)}"
+
+
+def pages_from_bytes(data):
+    while data:
+        records, now_us, _last, length = parse_page(data)
+        yield records, now_us
+        data = data[length:]
+
+
+def pages_from_text(text):
+    for line in text.splitlines():
+        line = line.strip()
+        if not line:
+            continue
+        if line.startswith("{"):
+            line = json.loads(line)["trace"]
+        records, now_us, _last, _length = parse_page(bytes.fromhex(line))
+        yield records, now_us
+
+
+def pages_from_udp(host, port, timeout):
+    """Request one page at a time, starting each request after the last record received."""
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.settimeout(timeout)
+    cursor = 0
+    while True:
+        sock.sendto(json.dumps({"cmd": "trace", "from": cursor}).encode(), (host, port))
+        try:
+            data, _addr = sock.recvfrom(4096)
+        except socket.timeout:
+            print("warning: timed out before the last page", file=sys.stderr)
+            return
+        records, now_us, last, _length = parse_page(data)
+        yield records, now_us
+        if last or not records:
+            return
+        cursor = (records[-1][0] + 1) & 0xFFFFFFFF
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("file", nargs="?", help="saved dump, binary or hex text")
+    parser.add_argument("--udp", metavar="HOST", help="request the trace from a switch over UDP")
+    parser.add_argument("--port", type=int, default=9999)
+    parser.add_argument("--timeout", type=float, default=2.0)
+    args = parser.parse_args()
+
+    if args.udp:
+        pages = pages_from_udp(args.udp, args.port, args.timeout)
+    elif args.file:
+        with open(args.file, "rb") as f:
+            data = f.read()
+        pages = pages_from_bytes(data) if data[:1] == bytes([PAGE_MAGIC]) else pages_from_text(data.decode())
+    else:
+        parser.error("give a dump file or --udp HOST")
+
+    for records, now_us in pages:
+        for record in records:
+            print(format_record(record, now_us))
+
+
+if __name__ == "__main__":
+    main()